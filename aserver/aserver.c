@@ -663,6 +663,25 @@ static int ctl_shm_cmd(client_t *client)
 	case SNDRV_CTL_IOCTL_ELEM_WRITE:
 		ctrl->result = snd_ctl_elem_write(ctl, &ctrl->u.element_write);
 		break;
+	case SND_CTL_IOCTL_ELEM_READ_MANY:
+	case SND_CTL_IOCTL_ELEM_WRITE_MANY:
+	{
+		snd_ctl_elem_value_t *data = (snd_ctl_elem_value_t *) ctrl->data;
+		snd_ctl_elem_value_t **values;
+		unsigned int i, count = ctrl->u.element_many;
+		if (count > CTL_SHM_DATA_MAXLEN / sizeof(*data)) {
+			ctrl->result = -EFAULT;
+			break;
+		}
+		values = alloca(count * sizeof(*values));
+		for (i = 0; i < count; i++)
+			values[i] = &data[i];
+		if (cmd == SND_CTL_IOCTL_ELEM_READ_MANY)
+			ctrl->result = snd_ctl_elem_read_many(ctl, values, count);
+		else
+			ctrl->result = snd_ctl_elem_write_many(ctl, values, count);
+		break;
+	}
 	case SNDRV_CTL_IOCTL_ELEM_LOCK:
 		ctrl->result = snd_ctl_elem_lock(ctl, &ctrl->u.element_lock);
 		break;
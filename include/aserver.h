@@ -111,6 +111,8 @@ typedef struct {
 #define SND_CTL_IOCTL_CLOSE		_IO ('U', 0xf2)
 #define SND_CTL_IOCTL_POLL_DESCRIPTOR	_IO ('U', 0xf3)
 #define SND_CTL_IOCTL_ASYNC		_IO ('U', 0xf4)
+#define SND_CTL_IOCTL_ELEM_READ_MANY	_IO ('U', 0xf5)
+#define SND_CTL_IOCTL_ELEM_WRITE_MANY	_IO ('U', 0xf6)
 
 typedef struct {
 	int result;
@@ -127,6 +129,7 @@ typedef struct {
 		snd_ctl_elem_info_t element_info;
 		snd_ctl_elem_value_t element_read;
 		snd_ctl_elem_value_t element_write;
+		unsigned int element_many;	/* values in data */
 		snd_ctl_elem_id_t element_lock;
 		snd_ctl_elem_id_t element_unlock;
 		snd_hwdep_info_t hwdep_info;
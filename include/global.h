@@ -128,6 +128,28 @@ int snd_async_handler_get_fd(snd_async_handler_t *handler);
 int snd_async_handler_get_signo(snd_async_handler_t *handler);
 void *snd_async_handler_get_callback_private(snd_async_handler_t *handler);
 
+/**
+ * \brief Internal structure for a wait set.
+ *
+ * A wait set groups the poll descriptors of several PCM, control,
+ * sequencer and timer handles, to wait for all of them in one call.
+ * Applications don't access its contents directly.
+ */
+typedef struct _snd_wait_set snd_wait_set_t;
+
+/** \brief A ready handle returned by #snd_wait_set_wait(). */
+typedef struct _snd_wait_event {
+	void *handle;		/**< handle given to snd_wait_set_add_*() */
+	void *private_data;	/**< private data given with the handle */
+	unsigned short revents;	/**< poll events translated by the handle */
+} snd_wait_event_t;
+
+int snd_wait_set_open(snd_wait_set_t **wsp);
+int snd_wait_set_close(snd_wait_set_t *ws);
+int snd_wait_set_remove(snd_wait_set_t *ws, void *handle);
+int snd_wait_set_wait(snd_wait_set_t *ws, snd_wait_event_t *events,
+		      unsigned int space, int timeout);
+
 struct snd_shm_area *snd_shm_area_create(int shmid, void *ptr);
 struct snd_shm_area *snd_shm_area_share(struct snd_shm_area *area);
 int snd_shm_area_destroy(struct snd_shm_area *area);
@@ -222,6 +222,13 @@ struct _snd_async_handler {
 	struct list_head hlist;
 };
 
+/* revents translation of a handle registered in a wait set */
+typedef int (*snd_wait_revents_t)(void *handle, struct pollfd *pfds,
+				  unsigned int nfds, unsigned short *revents);
+int _snd_wait_set_add(snd_wait_set_t *ws, void *handle,
+		      const struct pollfd *pfds, unsigned int nfds,
+		      snd_wait_revents_t revents, void *private_data);
+
 typedef enum _snd_set_mode {
 	SND_CHANGE,
 	SND_TRY,
@@ -365,6 +372,15 @@ int _snd_conf_generic_id(const char *id);
 
 int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
 				  int override, const char * const *default_include_path);
+void _snd_config_cache_note_env(const char *name);
+void _snd_config_cache_note_file(const char *path);
+struct config_cache_rec;
+int _snd_config_search_definition_deps(snd_config_t *config,
+				       const char *base, const char *name,
+				       snd_config_t **result,
+				       struct config_cache_rec **deps);
+int _snd_config_deps_valid(const struct config_cache_rec *deps);
+void _snd_config_deps_free(struct config_cache_rec *deps);
 
 /* convenience macros */
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
@@ -67,6 +67,10 @@ typedef struct _snd_pcm_hw_params snd_pcm_hw_params_t;
 typedef struct _snd_pcm_sw_params snd_pcm_sw_params_t;
 /** PCM status container */
  typedef struct _snd_pcm_status snd_pcm_status_t;
+/** PCM statistics container */
+typedef struct _snd_pcm_stats snd_pcm_stats_t;
+/** PCM batch of io_uring transfers */
+typedef struct _snd_pcm_uring snd_pcm_uring_t;
 /** PCM access types mask */
 typedef struct _snd_pcm_access_mask snd_pcm_access_mask_t;
 /** PCM formats mask */
@@ -472,7 +476,9 @@ enum _snd_pcm_type {
 	SND_PCM_TYPE_EXTPLUG,
 	/** Mmap-emulation plugin */
 	SND_PCM_TYPE_MMAP_EMUL,
-	SND_PCM_TYPE_LAST = SND_PCM_TYPE_MMAP_EMUL
+	/** Virtual card plugin */
+	SND_PCM_TYPE_VIRT,
+	SND_PCM_TYPE_LAST = SND_PCM_TYPE_VIRT
 };
 
 /** PCM type */
@@ -501,6 +507,34 @@ typedef union _snd_pcm_sync_id {
 /** #SND_PCM_TYPE_METER scope handle */
 typedef struct _snd_pcm_scope snd_pcm_scope_t;
 
+/** Counters of the PCM open plan cache (see #snd_pcm_open_cache_stats) */
+typedef struct _snd_pcm_open_cache_stats {
+	/** definitions taken from the cache */
+	unsigned long hits;
+	/** definitions resolved from the configuration */
+	unsigned long misses;
+	/** resolved definitions which could not be cached */
+	unsigned long uncacheable;
+	/** definitions currently cached */
+	unsigned int entries;
+	/** total time spent on cache hits in nanoseconds */
+	unsigned long long hit_ns;
+	/** total time spent resolving cache misses in nanoseconds */
+	unsigned long long miss_ns;
+} snd_pcm_open_cache_stats_t;
+
+/** Counters of the hw_params refine memo (see #snd_pcm_refine_cache_stats) */
+typedef struct _snd_pcm_refine_cache_stats {
+	/** refine requests answered from the memo */
+	unsigned long hits;
+	/** refine requests passed to the PCM layer */
+	unsigned long misses;
+	/** constraint rule evaluations done */
+	unsigned long rules_run;
+	/** constraint rule evaluations avoided by the hits */
+	unsigned long rules_saved;
+} snd_pcm_refine_cache_stats_t;
+
 int snd_pcm_open(snd_pcm_t **pcm, const char *name, 
 		 snd_pcm_stream_t stream, int mode);
 int snd_pcm_open_lconf(snd_pcm_t **pcm, const char *name, 
@@ -509,6 +543,8 @@ int snd_pcm_open_lconf(snd_pcm_t **pcm, const char *name,
 int snd_pcm_open_fallback(snd_pcm_t **pcm, snd_config_t *root,
 			  const char *name, const char *orig_name,
 			  snd_pcm_stream_t stream, int mode);
+int snd_pcm_open_cache_stats(snd_pcm_open_cache_stats_t *stats);
+void snd_pcm_open_cache_flush(void);
 
 int snd_pcm_close(snd_pcm_t *pcm);
 const char *snd_pcm_name(snd_pcm_t *pcm);
@@ -517,6 +553,7 @@ snd_pcm_stream_t snd_pcm_stream(snd_pcm_t *pcm);
 int snd_pcm_poll_descriptors_count(snd_pcm_t *pcm);
 int snd_pcm_poll_descriptors(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int space);
 int snd_pcm_poll_descriptors_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
+int snd_wait_set_add_pcm(snd_wait_set_t *ws, snd_pcm_t *pcm, void *private_data);
 int snd_pcm_nonblock(snd_pcm_t *pcm, int nonblock);
 static __inline__ int snd_pcm_abort(snd_pcm_t *pcm) { return snd_pcm_nonblock(pcm, 2); }
 int snd_async_add_pcm_handler(snd_async_handler_t **handler, snd_pcm_t *pcm, 
@@ -526,6 +563,7 @@ int snd_pcm_info(snd_pcm_t *pcm, snd_pcm_info_t *info);
 int snd_pcm_hw_params_current(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 int snd_pcm_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 int snd_pcm_hw_free(snd_pcm_t *pcm);
+int snd_pcm_refine_cache_stats(snd_pcm_refine_cache_stats_t *stats);
 int snd_pcm_sw_params_current(snd_pcm_t *pcm, snd_pcm_sw_params_t *params);
 int snd_pcm_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params);
 int snd_pcm_prepare(snd_pcm_t *pcm);
@@ -543,6 +581,7 @@ int snd_pcm_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail, snd_htimestamp_
 snd_pcm_sframes_t snd_pcm_avail(snd_pcm_t *pcm);
 snd_pcm_sframes_t snd_pcm_avail_update(snd_pcm_t *pcm);
 int snd_pcm_avail_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *availp, snd_pcm_sframes_t *delayp);
+int snd_pcm_set_status_snapshot(snd_pcm_t *pcm, int enable);
 snd_pcm_sframes_t snd_pcm_rewindable(snd_pcm_t *pcm);
 snd_pcm_sframes_t snd_pcm_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames);
 snd_pcm_sframes_t snd_pcm_forwardable(snd_pcm_t *pcm);
@@ -1066,6 +1105,78 @@ snd_pcm_uframes_t snd_pcm_status_get_overrange(const snd_pcm_status_t *obj);
 
 /** \} */
 
+/**
+ * \defgroup PCM_Stats Statistics Functions
+ * \ingroup PCM
+ * See the \ref pcm_stats section for more details.
+ * \{
+ */
+
+/** Number of buckets of the avail histogram, each covers 1/8 of the buffer */
+#define SND_PCM_STATS_AVAIL_BUCKETS	8
+/** Maximum number of plugin layers followed by the statistics */
+#define SND_PCM_STATS_LAYERS		8
+
+int snd_pcm_stats_enable(snd_pcm_t *pcm, int enable);
+int snd_pcm_stats(snd_pcm_t *pcm, snd_pcm_stats_t *stats);
+int snd_pcm_stats_reset(snd_pcm_t *pcm);
+int snd_pcm_stats_dump(snd_pcm_t *pcm, snd_output_t *out);
+size_t snd_pcm_stats_sizeof(void);
+/** \hideinitializer
+ * \brief allocate an invalid #snd_pcm_stats_t using standard alloca
+ * \param ptr returned pointer
+ */
+#define snd_pcm_stats_alloca(ptr) __snd_alloca(ptr, snd_pcm_stats)
+int snd_pcm_stats_malloc(snd_pcm_stats_t **ptr);
+void snd_pcm_stats_free(snd_pcm_stats_t *obj);
+void snd_pcm_stats_copy(snd_pcm_stats_t *dst, const snd_pcm_stats_t *src);
+unsigned long snd_pcm_stats_get_wakeups(const snd_pcm_stats_t *obj);
+unsigned long long snd_pcm_stats_get_poll_time(const snd_pcm_stats_t *obj);
+unsigned long snd_pcm_stats_get_xruns(const snd_pcm_stats_t *obj);
+unsigned long snd_pcm_stats_get_suspends(const snd_pcm_stats_t *obj);
+unsigned long snd_pcm_stats_get_avail_histogram(const snd_pcm_stats_t *obj,
+						unsigned int bucket);
+unsigned int snd_pcm_stats_get_layers(const snd_pcm_stats_t *obj);
+snd_pcm_type_t snd_pcm_stats_get_layer_type(const snd_pcm_stats_t *obj,
+					     unsigned int layer);
+unsigned long long snd_pcm_stats_get_layer_time(const snd_pcm_stats_t *obj,
+						unsigned int layer);
+unsigned long long snd_pcm_stats_get_layer_frames(const snd_pcm_stats_t *obj,
+						  unsigned int layer);
+snd_pcm_uframes_t snd_pcm_stats_get_layer_period_size(const snd_pcm_stats_t *obj,
+						     unsigned int layer);
+
+/** \} */
+
+/**
+ * \defgroup PCM_Uring Batched Transfers
+ * \ingroup PCM
+ * See the \ref pcm_uring section for more details.
+ * \{
+ */
+
+/** \brief A completed transfer returned by #snd_pcm_uring_reap() */
+typedef struct _snd_pcm_uring_result {
+	snd_pcm_t *pcm;			/**< PCM handle of the transfer */
+	void *private_data;		/**< private data given with the transfer */
+	snd_pcm_sframes_t result;	/**< frames transferred or a negative error code */
+} snd_pcm_uring_result_t;
+
+int snd_pcm_uring_open(snd_pcm_uring_t **ringp, unsigned int entries);
+int snd_pcm_uring_close(snd_pcm_uring_t *ring);
+int snd_pcm_uring_native(snd_pcm_uring_t *ring);
+int snd_pcm_uring_writei(snd_pcm_uring_t *ring, snd_pcm_t *pcm,
+			 const void *buffer, snd_pcm_uframes_t size,
+			 void *private_data);
+int snd_pcm_uring_readi(snd_pcm_uring_t *ring, snd_pcm_t *pcm,
+			void *buffer, snd_pcm_uframes_t size,
+			void *private_data);
+int snd_pcm_uring_submit(snd_pcm_uring_t *ring, unsigned int wait_nr);
+int snd_pcm_uring_reap(snd_pcm_uring_t *ring, snd_pcm_uring_result_t *results,
+		       unsigned int space);
+
+/** \} */
+
 /**
  * \defgroup PCM_Description Description Functions
  * \ingroup PCM
@@ -428,7 +428,9 @@ beginning:</P>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <limits.h>
+#include <ctype.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <dirent.h>
 #include <locale.h>
 #ifdef HAVE_LIBPTHREAD
@@ -455,6 +457,8 @@ struct _snd_config {
 		struct {
 			struct list_head fields;
 			bool join;
+			unsigned int count;		/* number of children */
+			struct config_index *index;	/* NULL for small compounds */
 		} compound;
 	} u;
 	struct list_head list;
@@ -462,6 +466,19 @@ struct _snd_config {
 	int hop;
 };
 
+/*
+ * Hash index over the child ids of a big compound (open addressing,
+ * linear probing).  It is only an accelerator: when it cannot be
+ * allocated, the children are searched linearly.
+ */
+#define CONFIG_INDEX_MIN	16	/* children before an index is built */
+
+struct config_index {
+	unsigned int mask;		/* number of slots - 1 */
+	unsigned int used;
+	snd_config_t *slot[];
+};
+
 struct filedesc {
 	char *name;
 	snd_input_t *in;
@@ -526,6 +543,227 @@ static inline void snd_config_unlock(void) { }
 
 #endif
 
+#ifdef HAVE___THREAD
+#define TLS_PFX		__thread
+#else
+#define TLS_PFX		/* NOP */
+#endif
+
+/*
+ * Dependencies of the global configuration, recorded while it is read
+ * from the text files so that a binary snapshot of the result can be
+ * validated later (see config_cache_load()).
+ */
+enum {
+	CONFIG_CACHE_DEP_FILE,		/* file or directory with this stat */
+	CONFIG_CACHE_DEP_ABSENT,	/* path which did not exist */
+	CONFIG_CACHE_DEP_ENV,		/* environment variable with this value */
+	CONFIG_CACHE_DEP_ENV_UNSET,	/* environment variable not set */
+};
+
+struct config_cache_dep {
+	int type;
+	char *name;
+	char *value;
+	struct stat st;
+};
+
+struct config_cache_rec {
+	unsigned int count;
+	unsigned int alloc;
+	struct config_cache_dep *deps;
+	int uncacheable;
+};
+
+/* active only in the thread rereading the global configuration */
+static TLS_PFX struct config_cache_rec *config_cache_rec;
+
+static void config_cache_add(int type, const char *name, const char *value,
+			     const struct stat *st)
+{
+	struct config_cache_rec *rec = config_cache_rec;
+	struct config_cache_dep *dep;
+	unsigned int k;
+
+	for (k = 0; k < rec->count; k++) {
+		if (rec->deps[k].type == type && !strcmp(rec->deps[k].name, name))
+			return;
+	}
+	if (rec->count == rec->alloc) {
+		unsigned int alloc = rec->alloc ? rec->alloc * 2 : 32;
+		dep = realloc(rec->deps, alloc * sizeof(*dep));
+		if (!dep)
+			goto _nomem;
+		rec->deps = dep;
+		rec->alloc = alloc;
+	}
+	dep = &rec->deps[rec->count];
+	memset(dep, 0, sizeof(*dep));
+	dep->type = type;
+	dep->name = strdup(name);
+	if (value)
+		dep->value = strdup(value);
+	if (!dep->name || (value && !dep->value)) {
+		free(dep->name);
+		free(dep->value);
+		goto _nomem;
+	}
+	if (st)
+		dep->st = *st;
+	rec->count++;
+	return;
+ _nomem:
+	/* an incomplete dependency list must not be saved */
+	rec->uncacheable = 1;
+}
+
+/* the result depends on this file or directory (or on its absence) */
+static void config_cache_note_file(const char *path)
+{
+	struct stat st;
+
+	if (!config_cache_rec)
+		return;
+	if (stat(path, &st) < 0)
+		config_cache_add(CONFIG_CACHE_DEP_ABSENT, path, NULL, NULL);
+	else
+		config_cache_add(CONFIG_CACHE_DEP_FILE, path, NULL, &st);
+}
+
+/* the same for the functions which read files on their own */
+void _snd_config_cache_note_file(const char *path)
+{
+	config_cache_note_file(path);
+}
+
+/* the result depends on the value of an environment variable */
+void _snd_config_cache_note_env(const char *name)
+{
+	const char *value;
+
+	if (!config_cache_rec)
+		return;
+	value = getenv(name);
+	config_cache_add(value ? CONFIG_CACHE_DEP_ENV : CONFIG_CACHE_DEP_ENV_UNSET,
+			 name, value, NULL);
+}
+
+/* the result depends on something which cannot be checked cheaply */
+static void config_cache_note_uncacheable(void)
+{
+	if (config_cache_rec)
+		config_cache_rec->uncacheable = 1;
+}
+
+/* snd_user_file() expands ~/ and $VAR, note the variables it reads */
+static void config_cache_note_user_file(const char *fn)
+{
+	const char *p, *e;
+	char name[128];
+
+	if (!config_cache_rec)
+		return;
+	if (fn[0] == '~') {
+		if (fn[1] != '/') {
+			config_cache_note_uncacheable();
+			return;
+		}
+		_snd_config_cache_note_env("HOME");
+	}
+	/* quoting and globbing are not worth following */
+	if (strpbrk(fn, "`\\\"'*?[")) {
+		config_cache_note_uncacheable();
+		return;
+	}
+	for (p = strchr(fn, '$'); p; p = strchr(e, '$')) {
+		p++;
+		if (*p == '{')
+			p++;
+		for (e = p; *e == '_' || isalnum((unsigned char)*e); e++)
+			;
+		if (e == p || (size_t)(e - p) >= sizeof(name) ||
+		    (p[-1] == '{' && *e++ != '}')) {
+			config_cache_note_uncacheable();
+			return;
+		}
+		memcpy(name, p, e - p);
+		name[e - p] = '\0';
+		_snd_config_cache_note_env(name);
+	}
+}
+
+/*
+ * functions evaluated while the configuration is read; refer notes the
+ * file it loads on its own
+ */
+static void config_cache_note_func(const char *func, int redefined)
+{
+	static const char *const pure[] = {
+		"getenv", "igetenv", "concat", "iadd", "imul", "datadir", "refer",
+	};
+	/* these only change when a card comes or goes */
+	static const char *const card[] = {
+		"card_inum", "card_driver", "card_id", "card_name", "pcm_id",
+		"pcm_args_by_class",
+	};
+	unsigned int k;
+
+	if (!config_cache_rec)
+		return;
+	if (!redefined) {
+		for (k = 0; k < ARRAY_SIZE(pure); k++) {
+			if (!strcmp(func, pure[k]))
+				return;
+		}
+		for (k = 0; k < ARRAY_SIZE(card); k++) {
+			if (!strcmp(func, card[k])) {
+				config_cache_note_file(ALSA_DEVICE_DIRECTORY);
+				return;
+			}
+		}
+	}
+	config_cache_note_uncacheable();
+}
+
+/* still true for the current files and environment */
+static int config_cache_rec_valid(const struct config_cache_rec *rec)
+{
+	const struct config_cache_dep *dep;
+	const char *value;
+	struct stat st;
+	unsigned int k;
+
+	for (k = 0, dep = rec->deps; k < rec->count; k++, dep++) {
+		switch (dep->type) {
+		case CONFIG_CACHE_DEP_FILE:
+			if (stat(dep->name, &st) < 0 ||
+			    st.st_dev != dep->st.st_dev ||
+			    st.st_ino != dep->st.st_ino ||
+			    st.st_size != dep->st.st_size ||
+			    st.st_mtim.tv_sec != dep->st.st_mtim.tv_sec ||
+			    st.st_mtim.tv_nsec != dep->st.st_mtim.tv_nsec ||
+			    st.st_ctim.tv_sec != dep->st.st_ctim.tv_sec ||
+			    st.st_ctim.tv_nsec != dep->st.st_ctim.tv_nsec)
+				return 0;
+			break;
+		case CONFIG_CACHE_DEP_ABSENT:
+			if (stat(dep->name, &st) >= 0)
+				return 0;
+			break;
+		case CONFIG_CACHE_DEP_ENV:
+			value = getenv(dep->name);
+			if (!value || strcmp(value, dep->value))
+				return 0;
+			break;
+		case CONFIG_CACHE_DEP_ENV_UNSET:
+			if (getenv(dep->name))
+				return 0;
+			break;
+		}
+	}
+	return 1;
+}
+
 /*
  * Add a diretory to the paths to search included files.
  * param fd -  File object that owns these paths to search files included by it.
@@ -639,8 +877,10 @@ static int input_stdio_open(snd_input_t **inputp, const char *file,
 	char full_path[PATH_MAX];
 	int err;
 
-	if (file[0] == '/')
+	if (file[0] == '/') {
+		config_cache_note_file(file);
 		return snd_input_stdio_open(inputp, file, "r");
+	}
 
 	/* search file in user specified include paths. These directories
 	 * are subdirectories of /usr/share/alsa.
@@ -653,6 +893,7 @@ static int input_stdio_open(snd_input_t **inputp, const char *file,
 				continue;
 
 			snprintf(full_path, PATH_MAX, "%s/%s", path->dir, file);
+			config_cache_note_file(full_path);
 			err = snd_input_stdio_open(inputp, full_path, "r");
 			if (err == 0)
 				return 0;
@@ -805,6 +1046,7 @@ static int get_char_skip_comments(input_t *input)
 					return -ENOMEM;
 				str = tmp;
 
+				config_cache_note_file(str);
 				dirp = opendir(str);
 				if (!dirp) {
 					SNDERR("Invalid search dir %s", str);
@@ -829,6 +1071,7 @@ static int get_char_skip_comments(input_t *input)
 				if (tmp == NULL)
 					return -ENOMEM;
 				str = tmp;
+				config_cache_note_file(str);
 				err = snd_input_stdio_open(&in, str, "r");
 			} else { /* absolute or relative file path */
 				err = input_stdio_open(&in, str, input->current);
@@ -1142,6 +1385,109 @@ static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t
 }
 	
 
+static unsigned int config_index_hash(const char *id, size_t len)
+{
+	unsigned int hash = 2166136261U;
+
+	while (len-- > 0)
+		hash = (hash ^ (unsigned char)*id++) * 16777619U;
+	return hash;
+}
+
+static unsigned int config_index_hash_id(const snd_config_t *n)
+{
+	return n->id ? config_index_hash(n->id, strlen(n->id)) : 0;
+}
+
+static void config_index_insert(struct config_index *index, snd_config_t *n)
+{
+	unsigned int i = config_index_hash_id(n) & index->mask;
+
+	while (index->slot[i])
+		i = (i + 1) & index->mask;
+	index->slot[i] = n;
+	index->used++;
+}
+
+/* (re)build the index of a compound for at least size children */
+static void config_index_build(snd_config_t *config, unsigned int size)
+{
+	struct config_index *index;
+	snd_config_iterator_t i, next;
+	unsigned int slots = 32;
+
+	while (slots < size * 2)
+		slots *= 2;
+	free(config->u.compound.index);
+	index = calloc(1, sizeof(*index) + slots * sizeof(index->slot[0]));
+	config->u.compound.index = index;
+	if (!index)
+		return;
+	index->mask = slots - 1;
+	snd_config_for_each(i, next, config)
+		config_index_insert(index, snd_config_iterator_entry(i));
+}
+
+static void config_index_add(snd_config_t *parent, snd_config_t *child)
+{
+	struct config_index *index = parent->u.compound.index;
+
+	if (!index) {
+		if (parent->u.compound.count >= CONFIG_INDEX_MIN)
+			config_index_build(parent, parent->u.compound.count);
+		return;
+	}
+	if ((index->used + 1) * 2 > index->mask + 1)
+		config_index_build(parent, index->used + 1);
+	else
+		config_index_insert(index, child);
+}
+
+static void config_index_del(snd_config_t *parent, snd_config_t *child)
+{
+	struct config_index *index = parent->u.compound.index;
+	unsigned int i, j, k;
+
+	if (!index)
+		return;
+	i = config_index_hash_id(child) & index->mask;
+	while (index->slot[i] != child) {
+		if (!index->slot[i])
+			return;
+		i = (i + 1) & index->mask;
+	}
+	/* move back the entries of the same probe run */
+	for (j = (i + 1) & index->mask; index->slot[j]; j = (j + 1) & index->mask) {
+		k = config_index_hash_id(index->slot[j]) & index->mask;
+		if (((j - k) & index->mask) >= ((j - i) & index->mask)) {
+			index->slot[i] = index->slot[j];
+			i = j;
+		}
+	}
+	index->slot[i] = NULL;
+	index->used--;
+}
+
+/* insert child into the children list of parent between prev and next */
+static void config_link(snd_config_t *parent, snd_config_t *child,
+			struct list_head *prev, struct list_head *next)
+{
+	child->parent = parent;
+	list_insert(&child->list, prev, next);
+	parent->u.compound.count++;
+	config_index_add(parent, child);
+}
+
+static void config_unlink(snd_config_t *child)
+{
+	snd_config_t *parent = child->parent;
+
+	list_del(&child->list);
+	parent->u.compound.count--;
+	config_index_del(parent, child);
+	child->parent = NULL;
+}
+
 static int _snd_config_make_add(snd_config_t **config, char **id,
 				snd_config_type_t type, snd_config_t *parent)
 {
@@ -1151,8 +1497,8 @@ static int _snd_config_make_add(snd_config_t **config, char **id,
 	err = _snd_config_make(&n, id, type);
 	if (err < 0)
 		return err;
-	n->parent = parent;
-	list_add_tail(&n->list, &parent->u.compound.fields);
+	config_link(parent, n, parent->u.compound.fields.prev,
+		    &parent->u.compound.fields);
 	*config = n;
 	return 0;
 }
@@ -1161,6 +1507,24 @@ static int _snd_config_search(snd_config_t *config,
 			      const char *id, int len, snd_config_t **result)
 {
 	snd_config_iterator_t i, next;
+	struct config_index *index;
+
+	if (config->type != SND_CONFIG_TYPE_COMPOUND)
+		return -ENOENT;
+	index = config->u.compound.index;
+	if (index) {
+		size_t l = len < 0 ? strlen(id) : (size_t)len;
+		unsigned int k = config_index_hash(id, l) & index->mask;
+		snd_config_t *n;
+		for (; (n = index->slot[k]) != NULL; k = (k + 1) & index->mask) {
+			if (n->id && strncmp(n->id, id, l) == 0 && n->id[l] == '\0') {
+				if (result)
+					*result = n;
+				return 0;
+			}
+		}
+		return -ENOENT;
+	}
 	snd_config_for_each(i, next, config) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		if (len < 0) {
@@ -1729,6 +2093,9 @@ int snd_config_substitute(snd_config_t *dst, snd_config_t *src)
 		int err = snd_config_delete_compound_members(dst);
 		if (err < 0)
 			return err;
+		/* the index of src (if any) moves with its children */
+		free(dst->u.compound.index);
+		dst->u.compound.index = NULL;
 	}
 	if (dst->type == SND_CONFIG_TYPE_COMPOUND &&
 	    src->type == SND_CONFIG_TYPE_COMPOUND) {	/* overwrite */
@@ -1740,8 +2107,12 @@ int snd_config_substitute(snd_config_t *dst, snd_config_t *src)
 		src->u.compound.fields.next->prev = &dst->u.compound.fields;
 		src->u.compound.fields.prev->next = &dst->u.compound.fields;
 	}
+	if (dst->parent)
+		config_index_del(dst->parent, dst);
 	free(dst->id);
 	dst->id = src->id;
+	if (dst->parent && dst->parent->u.compound.index)
+		config_index_insert(dst->parent->u.compound.index, dst);
 	dst->type = src->type;
 	dst->u = src->u;
 	free(src);
@@ -1900,17 +2271,14 @@ int snd_config_get_id(const snd_config_t *config, const char **id)
  */
 int snd_config_set_id(snd_config_t *config, const char *id)
 {
-	snd_config_iterator_t i, next;
+	snd_config_t *n;
 	char *new_id;
 	assert(config);
 	if (id) {
-		if (config->parent) {
-			snd_config_for_each(i, next, config->parent) {
-				snd_config_t *n = snd_config_iterator_entry(i);
-				if (n != config && strcmp(id, n->id) == 0)
-					return -EEXIST;
-			}
-		}
+		if (config->parent &&
+		    _snd_config_search(config->parent, id, -1, &n) == 0 &&
+		    n != config)
+			return -EEXIST;
 		new_id = strdup(id);
 		if (!new_id)
 			return -ENOMEM;
@@ -1919,8 +2287,12 @@ int snd_config_set_id(snd_config_t *config, const char *id)
 			return -EINVAL;
 		new_id = NULL;
 	}
+	if (config->parent)
+		config_index_del(config->parent, config);
 	free(config->id);
 	config->id = new_id;
+	if (config->parent && config->parent->u.compound.index)
+		config_index_insert(config->parent->u.compound.index, config);
 	return 0;
 }
 
@@ -2134,17 +2506,13 @@ int snd_config_load_override(snd_config_t *config, snd_input_t *in)
  */
 int snd_config_add(snd_config_t *parent, snd_config_t *child)
 {
-	snd_config_iterator_t i, next;
 	assert(parent && child);
 	if (!child->id || child->parent)
 		return -EINVAL;
-	snd_config_for_each(i, next, parent) {
-		snd_config_t *n = snd_config_iterator_entry(i);
-		if (strcmp(child->id, n->id) == 0)
-			return -EEXIST;
-	}
-	child->parent = parent;
-	list_add_tail(&child->list, &parent->u.compound.fields);
+	if (_snd_config_search(parent, child->id, -1, NULL) == 0)
+		return -EEXIST;
+	config_link(parent, child, parent->u.compound.fields.prev,
+		    &parent->u.compound.fields);
 	return 0;
 }
 
@@ -2172,20 +2540,15 @@ int snd_config_add(snd_config_t *parent, snd_config_t *child)
  */
 int snd_config_add_after(snd_config_t *after, snd_config_t *child)
 {
-	snd_config_iterator_t i, next;
 	snd_config_t *parent;
 	assert(after && child);
 	parent = after->parent;
 	assert(parent);
 	if (!child->id || child->parent)
 		return -EINVAL;
-	snd_config_for_each(i, next, parent) {
-		snd_config_t *n = snd_config_iterator_entry(i);
-		if (strcmp(child->id, n->id) == 0)
-			return -EEXIST;
-	}
-	child->parent = parent;
-	list_insert(&child->list, &after->list, after->list.next);
+	if (_snd_config_search(parent, child->id, -1, NULL) == 0)
+		return -EEXIST;
+	config_link(parent, child, &after->list, after->list.next);
 	return 0;
 }
 
@@ -2213,20 +2576,15 @@ int snd_config_add_after(snd_config_t *after, snd_config_t *child)
  */
 int snd_config_add_before(snd_config_t *before, snd_config_t *child)
 {
-	snd_config_iterator_t i, next;
 	snd_config_t *parent;
 	assert(before && child);
 	parent = before->parent;
 	assert(parent);
 	if (!child->id || child->parent)
 		return -EINVAL;
-	snd_config_for_each(i, next, parent) {
-		snd_config_t *n = snd_config_iterator_entry(i);
-		if (strcmp(child->id, n->id) == 0)
-			return -EEXIST;
-	}
-	child->parent = parent;
-	list_insert(&child->list, before->list.prev, &before->list);
+	if (_snd_config_search(parent, child->id, -1, NULL) == 0)
+		return -EEXIST;
+	config_link(parent, child, before->list.prev, &before->list);
 	return 0;
 }
 
@@ -2248,8 +2606,8 @@ static int _snd_config_array_merge(snd_config_t *dst, snd_config_t *src, int ind
 			snd_config_delete(sn);
 			return err;
 		}
-		sn->parent = dst;
-		list_add_tail(&sn->list, &dst->u.compound.fields);
+		config_link(dst, sn, dst->u.compound.fields.prev,
+			    &dst->u.compound.fields);
 	}
 	snd_config_delete(src);
 	return 0;
@@ -2282,8 +2640,8 @@ static int _snd_config_array_merge(snd_config_t *dst, snd_config_t *src, int ind
  */
 int snd_config_merge(snd_config_t *dst, snd_config_t *src, int override)
 {
-	snd_config_iterator_t di, si, dnext, snext;
-	bool found;
+	snd_config_iterator_t si, snext;
+	snd_config_t *dn;
 	int err, array;
 
 	assert(dst);
@@ -2296,31 +2654,24 @@ int snd_config_merge(snd_config_t *dst, snd_config_t *src, int override)
 		return _snd_config_array_merge(dst, src, array);
 	snd_config_for_each(si, snext, src) {
 		snd_config_t *sn = snd_config_iterator_entry(si);
-		found = false;
-		snd_config_for_each(di, dnext, dst) {
-			snd_config_t *dn = snd_config_iterator_entry(di);
-			if (strcmp(sn->id, dn->id) == 0) {
-				if (override ||
-				    sn->type != SND_CONFIG_TYPE_COMPOUND ||
-				    dn->type != SND_CONFIG_TYPE_COMPOUND) {
-					snd_config_remove(sn);
-					err = snd_config_substitute(dn, sn);
-					if (err < 0)
-						return err;
-				} else {
-					err = snd_config_merge(dn, sn, 0);
-					if (err < 0)
-						return err;
-				}
-				found = true;
-				break;
+		if (_snd_config_search(dst, sn->id, -1, &dn) == 0) {
+			if (override ||
+			    sn->type != SND_CONFIG_TYPE_COMPOUND ||
+			    dn->type != SND_CONFIG_TYPE_COMPOUND) {
+				snd_config_remove(sn);
+				err = snd_config_substitute(dn, sn);
+				if (err < 0)
+					return err;
+			} else {
+				err = snd_config_merge(dn, sn, 0);
+				if (err < 0)
+					return err;
 			}
-		}
-		if (!found) {
+		} else {
 			/* move config from src to dst */
 			snd_config_remove(sn);
-			sn->parent = dst;
-			list_add_tail(&sn->list, &dst->u.compound.fields);
+			config_link(dst, sn, dst->u.compound.fields.prev,
+				    &dst->u.compound.fields);
 		}
 	}
 	snd_config_delete(src);
@@ -2344,8 +2695,7 @@ int snd_config_remove(snd_config_t *config)
 {
 	assert(config);
 	if (config->parent)
-		list_del(&config->list);
-	config->parent = NULL;
+		config_unlink(config);
 	return 0;
 }
 
@@ -2383,6 +2733,9 @@ int snd_config_delete(snd_config_t *config)
 	{
 		int err;
 		struct list_head *i;
+		/* no point in keeping the index up to date */
+		free(config->u.compound.index);
+		config->u.compound.index = NULL;
 		i = config->u.compound.fields.next;
 		while (i != &config->u.compound.fields) {
 			struct list_head *nexti = i->next;
@@ -2401,7 +2754,7 @@ int snd_config_delete(snd_config_t *config)
 		break;
 	}
 	if (config->parent)
-		list_del(&config->list);
+		config_unlink(config);
 	free(config->id);
 	free(config);
 	return 0;
@@ -3953,6 +4306,9 @@ static int snd_config_hooks_call(snd_config_t *root, snd_config_t *config, snd_c
 	}
 	assert(str);
 	err = snd_config_search_definition(root, "hook_func", str, &func_conf);
+	/* only the plain file loader is followed by the cache */
+	if (err >= 0 || strcmp(str, "load"))
+		config_cache_note_uncacheable();
 	if (err >= 0) {
 		snd_config_iterator_t i, next;
 		if (snd_config_get_type(func_conf) != SND_CONFIG_TYPE_COMPOUND) {
@@ -4086,6 +4442,7 @@ static int config_file_open(snd_config_t *root, const char *filename)
 	snd_input_t *in;
 	int err;
 
+	config_cache_note_file(filename);
 	err = snd_input_stdio_open(&in, filename, "r");
 	if (err >= 0) {
 		err = snd_config_load(root, in);
@@ -4104,6 +4461,8 @@ static int config_file_load(snd_config_t *root, const char *fn, int errors)
 	struct dirent **namelist;
 	int err, n;
 
+	/* a directory is listed again when its mtime changes */
+	config_cache_note_file(fn);
 	if (!errors && access(fn, R_OK) < 0)
 		return 1;
 	if (stat(fn, &st) < 0) {
@@ -4147,6 +4506,7 @@ static int config_file_load_user(snd_config_t *root, const char *fn, int errors)
 	char *fn2;
 	int err;
 
+	config_cache_note_user_file(fn);
 	err = snd_user_file(fn, &fn2);
 	if (err < 0)
 		return config_file_load(root, fn, errors);
@@ -4458,6 +4818,501 @@ __fin_err:
 SND_DLSYM_BUILD_VERSION(snd_config_hook_load_for_all_cards, SND_CONFIG_DLSYM_VERSION_HOOK);
 #endif
 
+#ifndef DOC_HIDDEN
+/*
+ * Binary snapshot of the global configuration
+ *
+ * When the environment variable ALSA_CONFIG_CACHE names a file, the tree
+ * built by snd_config_update_r() from the text files (after the top-level
+ * hooks) is saved there together with the list of everything it depends
+ * on: the stat of each file and directory which was read or looked up,
+ * and the environment variables used to expand the file names.  The next
+ * process maps the file, checks the dependencies and builds the tree
+ * directly from the node records, without lexing any configuration file.
+ * When anything differs, the files are parsed as usual and the snapshot
+ * is replaced.  Trees which depend on other hooks or functions (e.g.
+ * the ones reading the sound card state) are not saved.
+ */
+
+#define CONFIG_CACHE_ENV	"ALSA_CONFIG_CACHE"
+#define CONFIG_CACHE_MAGIC	"ALSACFGC"
+#define CONFIG_CACHE_FORMAT	1
+#define CONFIG_CACHE_ENDIAN	0x01020304
+#define CONFIG_CACHE_NONE	0xffffffffU
+#define CONFIG_CACHE_MAX_SIZE	(64 * 1024 * 1024)
+
+struct config_cache_header {
+	char magic[8];
+	uint32_t format;		/* CONFIG_CACHE_FORMAT */
+	uint32_t lib_version;		/* SND_LIB_VERSION of the writer */
+	uint32_t endian;		/* CONFIG_CACHE_ENDIAN in native order */
+	uint32_t size;			/* size of the whole file */
+	uint32_t configs;		/* top-level files, ':' separated */
+	uint32_t ndeps;
+	uint32_t deps;			/* offset of the dependency records */
+	uint32_t nnodes;
+	uint32_t nodes;			/* offset of the node records */
+	uint32_t strings;		/* offset of the string pool */
+	uint32_t strings_size;
+	uint32_t pad;
+};
+
+struct config_cache_file_dep {
+	uint32_t type;			/* CONFIG_CACHE_DEP_* */
+	uint32_t name;			/* string offsets */
+	uint32_t value;
+	uint32_t pad;
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime;
+	int64_t mtime_nsec;
+	int64_t ctime;
+	int64_t ctime_nsec;
+};
+
+/* nodes are stored breadth first, the children of a compound are
+ * the count records starting at index first
+ */
+struct config_cache_node {
+	uint32_t id;
+	uint32_t type;
+	uint32_t join;
+	uint32_t first;
+	uint32_t count;
+	uint32_t pad;
+	union {
+		int64_t integer;
+		double real;
+		uint32_t string;
+	} u;
+};
+
+struct config_cache_buf {
+	char *data;
+	size_t size;
+	size_t alloc;
+};
+
+static void *config_cache_buf_grow(struct config_cache_buf *buf, size_t size)
+{
+	void *ptr;
+
+	if (buf->size + size > buf->alloc) {
+		size_t alloc = buf->alloc ? buf->alloc : 4096;
+		char *data;
+		while (alloc < buf->size + size)
+			alloc *= 2;
+		data = realloc(buf->data, alloc);
+		if (!data)
+			return NULL;
+		buf->data = data;
+		buf->alloc = alloc;
+	}
+	ptr = buf->data + buf->size;
+	memset(ptr, 0, size);
+	buf->size += size;
+	return ptr;
+}
+
+/* append a string to the pool, returns its offset or CONFIG_CACHE_NONE */
+static uint32_t config_cache_buf_string(struct config_cache_buf *pool,
+					const char *str, int *err)
+{
+	size_t len, offset = pool->size;
+	char *ptr;
+
+	if (!str)
+		return CONFIG_CACHE_NONE;
+	len = strlen(str) + 1;
+	ptr = config_cache_buf_grow(pool, len);
+	if (!ptr) {
+		*err = -ENOMEM;
+		return CONFIG_CACHE_NONE;
+	}
+	memcpy(ptr, str, len);
+	return offset;
+}
+
+static char *config_cache_configs(snd_config_update_t *local)
+{
+	unsigned int k;
+	size_t len = 1;
+	char *configs;
+
+	for (k = 0; k < local->count; k++)
+		len += strlen(local->finfo[k].name) + 1;
+	configs = malloc(len);
+	if (!configs)
+		return NULL;
+	*configs = '\0';
+	for (k = 0; k < local->count; k++) {
+		if (k)
+			strcat(configs, ":");
+		strcat(configs, local->finfo[k].name);
+	}
+	return configs;
+}
+
+static int config_cache_write(int fd, const void *data, size_t size)
+{
+	const char *ptr = data;
+
+	while (size > 0) {
+		ssize_t res = write(fd, ptr, size);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		ptr += res;
+		size -= res;
+	}
+	return 0;
+}
+
+static int config_cache_save(const char *path, struct config_cache_rec *rec,
+			     snd_config_update_t *local, snd_config_t *top)
+{
+	struct config_cache_header header;
+	struct config_cache_buf deps = { 0 }, nodes = { 0 }, pool = { 0 };
+	struct config_cache_file_dep *fdep;
+	struct config_cache_node *node;
+	snd_config_t **queue = NULL;
+	size_t queue_len = 1, queue_alloc = 256, i;
+	char *configs, *tmp = NULL;
+	unsigned int k;
+	int fd = -1, err = 0;
+
+	configs = config_cache_configs(local);
+	if (!configs)
+		return -ENOMEM;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CONFIG_CACHE_MAGIC, sizeof(header.magic));
+	header.format = CONFIG_CACHE_FORMAT;
+	header.lib_version = SND_LIB_VERSION;
+	header.endian = CONFIG_CACHE_ENDIAN;
+	header.configs = config_cache_buf_string(&pool, configs, &err);
+	free(configs);
+
+	for (k = 0; k < rec->count && err >= 0; k++) {
+		struct config_cache_dep *dep = &rec->deps[k];
+		fdep = config_cache_buf_grow(&deps, sizeof(*fdep));
+		if (!fdep) {
+			err = -ENOMEM;
+			break;
+		}
+		fdep->type = dep->type;
+		fdep->name = config_cache_buf_string(&pool, dep->name, &err);
+		fdep->value = config_cache_buf_string(&pool, dep->value, &err);
+		fdep->dev = dep->st.st_dev;
+		fdep->ino = dep->st.st_ino;
+		fdep->size = dep->st.st_size;
+		fdep->mtime = dep->st.st_mtim.tv_sec;
+		fdep->mtime_nsec = dep->st.st_mtim.tv_nsec;
+		fdep->ctime = dep->st.st_ctim.tv_sec;
+		fdep->ctime_nsec = dep->st.st_ctim.tv_nsec;
+	}
+	header.ndeps = rec->count;
+
+	queue = malloc(queue_alloc * sizeof(*queue));
+	if (!queue)
+		err = -ENOMEM;
+	else
+		queue[0] = top;
+	for (i = 0; i < queue_len && err >= 0; i++) {
+		snd_config_t *n = queue[i];
+		node = config_cache_buf_grow(&nodes, sizeof(*node));
+		if (!node) {
+			err = -ENOMEM;
+			break;
+		}
+		node->id = config_cache_buf_string(&pool, i ? n->id : NULL, &err);
+		node->type = n->type;
+		switch (n->type) {
+		case SND_CONFIG_TYPE_INTEGER:
+			node->u.integer = n->u.integer;
+			break;
+		case SND_CONFIG_TYPE_INTEGER64:
+			node->u.integer = n->u.integer64;
+			break;
+		case SND_CONFIG_TYPE_REAL:
+			node->u.real = n->u.real;
+			break;
+		case SND_CONFIG_TYPE_STRING:
+			node->u.string = config_cache_buf_string(&pool, n->u.string, &err);
+			break;
+		case SND_CONFIG_TYPE_COMPOUND: {
+			snd_config_iterator_t it, next;
+			node->join = n->u.compound.join;
+			node->first = queue_len;
+			snd_config_for_each(it, next, n) {
+				if (queue_len == queue_alloc) {
+					snd_config_t **q;
+					q = realloc(queue, queue_alloc * 2 * sizeof(*queue));
+					if (!q) {
+						err = -ENOMEM;
+						break;
+					}
+					queue = q;
+					queue_alloc *= 2;
+				}
+				queue[queue_len++] = snd_config_iterator_entry(it);
+				node->count++;
+			}
+			break;
+		}
+		default:
+			/* pointers cannot be saved */
+			err = -EINVAL;
+			break;
+		}
+	}
+	header.nnodes = queue_len;
+	free(queue);
+	if (err < 0)
+		goto _end;
+
+	header.deps = sizeof(header);
+	header.nodes = header.deps + deps.size;
+	header.strings = header.nodes + nodes.size;
+	header.strings_size = pool.size;
+	if ((size_t)header.strings + pool.size > CONFIG_CACHE_MAX_SIZE) {
+		err = -EFBIG;
+		goto _end;
+	}
+	header.size = header.strings + pool.size;
+
+	/* write a new file and replace the old one at once */
+	tmp = malloc(strlen(path) + 8);
+	if (!tmp) {
+		err = -ENOMEM;
+		goto _end;
+	}
+	sprintf(tmp, "%s.XXXXXX", path);
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		err = -errno;
+		goto _end;
+	}
+	err = config_cache_write(fd, &header, sizeof(header));
+	if (err >= 0)
+		err = config_cache_write(fd, deps.data, deps.size);
+	if (err >= 0)
+		err = config_cache_write(fd, nodes.data, nodes.size);
+	if (err >= 0)
+		err = config_cache_write(fd, pool.data, pool.size);
+	if (close(fd) < 0 && err >= 0)
+		err = -errno;
+	if (err >= 0 && rename(tmp, path) < 0)
+		err = -errno;
+	if (err < 0)
+		unlink(tmp);
+ _end:
+	free(tmp);
+	free(deps.data);
+	free(nodes.data);
+	free(pool.data);
+	return err;
+}
+
+static int config_cache_check_deps(const char *base, const struct config_cache_header *h)
+{
+	const struct config_cache_file_dep *fdep;
+	const char *strings = base + h->strings;
+	const char *value;
+	struct stat st;
+	uint32_t k;
+
+	fdep = (const struct config_cache_file_dep *)(base + h->deps);
+	for (k = 0; k < h->ndeps; k++, fdep++) {
+		if (fdep->name >= h->strings_size)
+			return -EINVAL;
+		switch (fdep->type) {
+		case CONFIG_CACHE_DEP_FILE:
+			if (stat(strings + fdep->name, &st) < 0 ||
+			    fdep->dev != (uint64_t)st.st_dev ||
+			    fdep->ino != (uint64_t)st.st_ino ||
+			    fdep->size != (uint64_t)st.st_size ||
+			    fdep->mtime != st.st_mtim.tv_sec ||
+			    fdep->mtime_nsec != st.st_mtim.tv_nsec ||
+			    fdep->ctime != st.st_ctim.tv_sec ||
+			    fdep->ctime_nsec != st.st_ctim.tv_nsec)
+				return -ESTALE;
+			break;
+		case CONFIG_CACHE_DEP_ABSENT:
+			if (stat(strings + fdep->name, &st) >= 0)
+				return -ESTALE;
+			break;
+		case CONFIG_CACHE_DEP_ENV:
+			if (fdep->value >= h->strings_size)
+				return -EINVAL;
+			value = getenv(strings + fdep->name);
+			if (!value || strcmp(value, strings + fdep->value))
+				return -ESTALE;
+			break;
+		case CONFIG_CACHE_DEP_ENV_UNSET:
+			if (getenv(strings + fdep->name))
+				return -ESTALE;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+static int config_cache_strdup(const struct config_cache_header *h,
+			       const char *strings, uint32_t offset, char **str)
+{
+	if (offset >= h->strings_size)
+		return -EINVAL;
+	*str = strdup(strings + offset);
+	return *str ? 0 : -ENOMEM;
+}
+
+static int config_cache_build(const char *base, const struct config_cache_header *h,
+			      snd_config_t **top)
+{
+	const struct config_cache_node *nodes, *node;
+	const char *strings = base + h->strings;
+	snd_config_t **cfg, *n;
+	uint32_t i, c, next = 1;
+	char *id;
+	int err;
+
+	nodes = (const struct config_cache_node *)(base + h->nodes);
+	if (!h->nnodes || nodes[0].type != SND_CONFIG_TYPE_COMPOUND ||
+	    nodes[0].id != CONFIG_CACHE_NONE)
+		return -EINVAL;
+	cfg = malloc(h->nnodes * sizeof(*cfg));
+	if (!cfg)
+		return -ENOMEM;
+	err = snd_config_top(&cfg[0]);
+	if (err < 0)
+		goto _end;
+	for (i = 0; i < h->nnodes && err >= 0; i++) {
+		node = &nodes[i];
+		n = cfg[i];
+		if (node->type != n->type) {
+			err = -EINVAL;
+			break;
+		}
+		switch (node->type) {
+		case SND_CONFIG_TYPE_INTEGER:
+			n->u.integer = node->u.integer;
+			break;
+		case SND_CONFIG_TYPE_INTEGER64:
+			n->u.integer64 = node->u.integer;
+			break;
+		case SND_CONFIG_TYPE_REAL:
+			n->u.real = node->u.real;
+			break;
+		case SND_CONFIG_TYPE_STRING:
+			if (node->u.string != CONFIG_CACHE_NONE)
+				err = config_cache_strdup(h, strings, node->u.string,
+							  &n->u.string);
+			break;
+		case SND_CONFIG_TYPE_COMPOUND:
+			n->u.compound.join = node->join;
+			if (node->first != next || node->count > h->nnodes - next) {
+				err = -EINVAL;
+				break;
+			}
+			for (c = 0; c < node->count && err >= 0; c++, next++) {
+				err = config_cache_strdup(h, strings, nodes[next].id, &id);
+				if (err < 0)
+					break;
+				if (nodes[next].type > SND_CONFIG_TYPE_STRING &&
+				    nodes[next].type != SND_CONFIG_TYPE_COMPOUND) {
+					free(id);
+					err = -EINVAL;
+					break;
+				}
+				err = _snd_config_make_add(&cfg[next], &id,
+							   nodes[next].type, n);
+			}
+			break;
+		default:
+			err = -EINVAL;
+			break;
+		}
+	}
+	if (err >= 0 && next != h->nnodes)
+		err = -EINVAL;
+	if (err < 0)
+		snd_config_delete(cfg[0]);
+	else
+		*top = cfg[0];
+ _end:
+	free(cfg);
+	return err;
+}
+
+/* returns 1 when top was built from a valid snapshot */
+static int config_cache_load(const char *path, snd_config_update_t *local,
+			     snd_config_t **top)
+{
+	const struct config_cache_header *h;
+	struct stat st;
+	char *configs = NULL;
+	void *base;
+	size_t size;
+	int fd, err;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return 0;
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(*h) ||
+	    st.st_size > CONFIG_CACHE_MAX_SIZE) {
+		close(fd);
+		return 0;
+	}
+	size = st.st_size;
+	base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return 0;
+	h = base;
+	err = -EINVAL;
+	if (memcmp(h->magic, CONFIG_CACHE_MAGIC, sizeof(h->magic)) ||
+	    h->format != CONFIG_CACHE_FORMAT ||
+	    h->lib_version != SND_LIB_VERSION ||
+	    h->endian != CONFIG_CACHE_ENDIAN ||
+	    h->size != size ||
+	    h->deps != sizeof(*h) ||
+	    (size_t)h->ndeps * sizeof(struct config_cache_file_dep) != h->nodes - h->deps ||
+	    (size_t)h->nnodes * sizeof(struct config_cache_node) != h->strings - h->nodes ||
+	    h->nodes < h->deps || h->strings < h->nodes ||
+	    (size_t)h->strings + h->strings_size != size ||
+	    !h->strings_size || ((const char *)base)[size - 1] != '\0' ||
+	    h->configs >= h->strings_size)
+		goto _end;
+	configs = config_cache_configs(local);
+	if (!configs || strcmp(configs, (const char *)base + h->strings + h->configs))
+		goto _end;
+	err = config_cache_check_deps(base, h);
+	if (err < 0)
+		goto _end;
+	err = config_cache_build(base, h, top);
+ _end:
+	free(configs);
+	munmap(base, size);
+	return err < 0 ? 0 : 1;
+}
+
+static void config_cache_rec_free(struct config_cache_rec *rec)
+{
+	unsigned int k;
+
+	for (k = 0; k < rec->count; k++) {
+		free(rec->deps[k].name);
+		free(rec->deps[k].value);
+	}
+	free(rec->deps);
+}
+#endif /* DOC_HIDDEN */
+
 /** 
  * \brief Updates a configuration tree by rereading the configuration files (if needed).
  * \param[in,out] _top Address of the handle to the top-level node.
@@ -4477,6 +5332,12 @@ SND_DLSYM_BUILD_VERSION(snd_config_hook_load_for_all_cards, SND_CONFIG_DLSYM_VER
  * The global configuration files are specified in the environment variable
  * \c ALSA_CONFIG_PATH.
  *
+ * When \a cfgs is \c NULL and the environment variable \c ALSA_CONFIG_CACHE
+ * names a file, the tree read from the global configuration files is saved
+ * there in a binary form, and later calls (also from other processes) build
+ * the tree from it as long as none of the files and environment variables
+ * it was read from has changed.
+ *
  * \warning If the configuration tree is reread, all string pointers and
  * configuration node handles previously obtained from this tree become
  * invalid.
@@ -4494,6 +5355,8 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 	snd_config_update_t *local;
 	snd_config_update_t *update;
 	snd_config_t *top;
+	struct config_cache_rec rec;
+	const char *cache;
 	
 	assert(_top && _update);
 	top = *_top;
@@ -4573,6 +5436,10 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 	err = 0;
 
  _end:
+	if (config_cache_rec) {
+		config_cache_rec = NULL;
+		config_cache_rec_free(&rec);
+	}
 	if (err < 0) {
 		if (top) {
 			snd_config_delete(top);
@@ -4598,6 +5465,17 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		snd_config_delete(top);
 		top = NULL;
 	}
+	cache = cfgs || !local || config_cache_rec ? NULL : getenv(CONFIG_CACHE_ENV);
+	if (cache && *cache) {
+		if (config_cache_load(cache, local, &top) > 0)
+			goto _done;
+		/* record what the text configuration depends on */
+		memset(&rec, 0, sizeof(rec));
+		config_cache_rec = &rec;
+		_snd_config_cache_note_env("ALSA_CONFIG_DIR");
+		for (k = 0; k < local->count; ++k)
+			config_cache_note_file(local->finfo[k].name);
+	}
 	err = snd_config_top(&top);
 	if (err < 0)
 		goto _end;
@@ -4623,6 +5501,13 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		SNDERR("hooks failed, removing configuration");
 		goto _end;
 	}
+	if (config_cache_rec) {
+		config_cache_rec = NULL;
+		if (!rec.uncacheable)
+			config_cache_save(cache, &rec, local, top);
+		config_cache_rec_free(&rec);
+	}
+ _done:
 	*_top = top;
 	*_update = local;
 	return 1;
@@ -4653,6 +5538,11 @@ int snd_config_update(void)
 	snd_config_lock();
 	err = snd_config_update_r(&snd_config, &snd_config_global_update, NULL);
 	snd_config_unlock();
+#ifdef BUILD_PCM
+	/* release the replaced tree held by the open plans */
+	if (err > 0)
+		snd_pcm_open_cache_flush();
+#endif
 	return err;
 }
 
@@ -4686,6 +5576,10 @@ int snd_config_update_ref(snd_config_t **top)
 		}
 	}
 	snd_config_unlock();
+#ifdef BUILD_PCM
+	if (err > 0)
+		snd_pcm_open_cache_flush();
+#endif
 	return err;
 }
 
@@ -4762,6 +5656,9 @@ int snd_config_update_free_global(void)
 	snd_config_global_update = NULL;
 	snd_config_unlock();
 	/* FIXME: better to place this in another place... */
+#ifdef BUILD_PCM
+	snd_pcm_open_cache_flush();
+#endif
 	snd_dlobj_cache_cleanup();
 
 	return 0;
@@ -5108,6 +6005,7 @@ static int _snd_config_evaluate(snd_config_t *src,
 		}
 		assert(str);
 		err = snd_config_search_definition(root, "func", str, &func_conf);
+		config_cache_note_func(str, err >= 0);
 		if (err >= 0) {
 			snd_config_iterator_t i, next;
 			if (snd_config_get_type(func_conf) != SND_CONFIG_TYPE_COMPOUND) {
@@ -5767,6 +6665,52 @@ int snd_config_search_definition(snd_config_t *config,
 }
 
 #ifndef DOC_HIDDEN
+/*
+ * Like snd_config_search_definition(), but also records what the result
+ * depends on.  *deps is NULL when the result cannot be reused (it was
+ * expanded by functions or hooks which are not followed), otherwise the
+ * result stays valid for this tree as long as
+ * _snd_config_deps_valid(*deps) is true.
+ */
+int _snd_config_search_definition_deps(snd_config_t *config,
+				       const char *base, const char *name,
+				       snd_config_t **result,
+				       struct config_cache_rec **deps)
+{
+	struct config_cache_rec *rec;
+	int err;
+
+	*deps = NULL;
+	/* a nested search is covered by the outer recorder */
+	if (config_cache_rec)
+		return snd_config_search_definition(config, base, name, result);
+	rec = calloc(1, sizeof(*rec));
+	if (!rec)
+		return snd_config_search_definition(config, base, name, result);
+	config_cache_rec = rec;
+	err = snd_config_search_definition(config, base, name, result);
+	config_cache_rec = NULL;
+	if (err >= 0 && !rec->uncacheable) {
+		*deps = rec;
+		return err;
+	}
+	_snd_config_deps_free(rec);
+	return err;
+}
+
+int _snd_config_deps_valid(const struct config_cache_rec *deps)
+{
+	return config_cache_rec_valid(deps);
+}
+
+void _snd_config_deps_free(struct config_cache_rec *deps)
+{
+	if (deps) {
+		config_cache_rec_free(deps);
+		free(deps);
+	}
+}
+
 void snd_config_set_hop(snd_config_t *conf, int hop)
 {
 	conf->hop = hop;
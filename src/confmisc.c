@@ -313,6 +313,7 @@ int snd_func_getenv(snd_config_t **dst, snd_config_t *root, snd_config_t *src,
 					err = -EINVAL;
 					goto __error;
 				}
+				_snd_config_cache_note_env(ptr);
 				res = getenv(ptr);
 				if (res != NULL && *res != '\0')
 					goto __ok;
@@ -1347,6 +1348,7 @@ int snd_func_refer(snd_config_t **dst, snd_config_t *root, snd_config_t *src,
 	}
 	if (file) {
 		snd_input_t *input;
+		_snd_config_cache_note_file(file);
 		err = snd_input_stdio_open(&input, file, "r");
 		if (err < 0) {
 			SNDERR("Unable to open file %s: %s", file, snd_strerror(err));
@@ -357,6 +357,41 @@ int snd_ctl_poll_descriptors_revents(snd_ctl_t *ctl, struct pollfd *pfds, unsign
 	return -EINVAL;
 }
 
+static int ctl_wait_revents(void *handle, struct pollfd *pfds,
+			    unsigned int nfds, unsigned short *revents)
+{
+	return snd_ctl_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+/**
+ * \brief Add a CTL handle to a wait set
+ * \param ws Wait set
+ * \param ctl CTL handle
+ * \param private_data Value returned with the events of the handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The handle is reported by #snd_wait_set_wait() when
+ * #snd_ctl_poll_descriptors_revents() returns events for it.
+ */
+int snd_wait_set_add_ctl(snd_wait_set_t *ws, snd_ctl_t *ctl, void *private_data)
+{
+	struct pollfd *pfds;
+	int count, err;
+
+	assert(ws && ctl);
+	count = snd_ctl_poll_descriptors_count(ctl);
+	if (count <= 0)
+		return count < 0 ? count : -EINVAL;
+	pfds = alloca(count * sizeof(*pfds));
+	err = snd_ctl_poll_descriptors(ctl, pfds, count);
+	if (err < 0)
+		return err;
+	if (err == 0)
+		return -EINVAL;
+	return _snd_wait_set_add(ws, ctl, pfds, err, ctl_wait_revents,
+				 private_data);
+}
+
 /**
  * \brief Ask to be informed about events (poll, #snd_async_add_ctl_handler, #snd_ctl_read)
  * \param ctl CTL handle
@@ -1033,6 +1068,78 @@ int snd_ctl_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *data)
 	return ctl->ops->element_write(ctl, data);
 }
 
+/**
+ * \brief Get the values of several CTL elements.
+ *
+ * Same as calling snd_ctl_elem_read() for each value, but the backend
+ * may handle the whole batch at once: the shm client transfers it in
+ * a single round trip to the server and the remap plugin reads each
+ * child element only once even when several values refer to it.
+ *
+ * \param ctl CTL handle.
+ * \param data Array of \p count element values. The IDs must be set
+ *             before calling the function.
+ * \param count Number of values.
+ *
+ * \retval 0 on success
+ * \retval <0 a negative error code; the values before the failing one
+ *         may have been read already
+ */
+int snd_ctl_elem_read_many(snd_ctl_t *ctl, snd_ctl_elem_value_t **data,
+			   unsigned int count)
+{
+	unsigned int i;
+	int err;
+
+	assert(ctl && (data || !count));
+	for (i = 0; i < count; i++)
+		assert(data[i] && (data[i]->id.name[0] || data[i]->id.numid));
+	if (ctl->ops->element_read_many)
+		return ctl->ops->element_read_many(ctl, data, count);
+	for (i = 0; i < count; i++) {
+		err = ctl->ops->element_read(ctl, data[i]);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
+/**
+ * \brief Set the values of several CTL elements.
+ *
+ * Same as calling snd_ctl_elem_write() for each value in the array
+ * order; see snd_ctl_elem_read_many() for the backends handling the
+ * whole batch at once.  Unlike snd_ctl_elem_write(), the function does
+ * not tell whether an element was changed.
+ *
+ * \param ctl CTL handle.
+ * \param data Array of \p count element values. The IDs and the new
+ *             values must be set before calling the function.
+ * \param count Number of values.
+ *
+ * \retval 0 on success
+ * \retval <0 a negative error code; the values before the failing one
+ *         may have been written already
+ */
+int snd_ctl_elem_write_many(snd_ctl_t *ctl, snd_ctl_elem_value_t **data,
+			    unsigned int count)
+{
+	unsigned int i;
+	int err;
+
+	assert(ctl && (data || !count));
+	for (i = 0; i < count; i++)
+		assert(data[i] && (data[i]->id.name[0] || data[i]->id.numid));
+	if (ctl->ops->element_write_many)
+		return ctl->ops->element_write_many(ctl, data, count);
+	for (i = 0; i < count; i++) {
+		err = ctl->ops->element_write(ctl, data[i]);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
 static int snd_ctl_tlv_do(snd_ctl_t *ctl, int op_flag,
 			  const snd_ctl_elem_id_t *id,
 		          unsigned int *tlv, unsigned int tlv_size)
@@ -1306,6 +1413,20 @@ int snd_ctl_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
 	return (ctl->ops->read)(ctl, event);
 }
 
+#ifndef DOC_HIDDEN
+/*
+ * Read the pending events, up to space; the backends without a batched
+ * read return one event, so the caller reads until -EAGAIN or 0.
+ */
+int snd_ctl_read_many(snd_ctl_t *ctl, snd_ctl_event_t *events, unsigned int space)
+{
+	assert(ctl && events && space > 0);
+	if (ctl->ops->read_many)
+		return ctl->ops->read_many(ctl, events, space);
+	return (ctl->ops->read)(ctl, events);
+}
+#endif
+
 /**
  * \brief Wait for a CTL to become ready (i.e. at least one event pending)
  * \param ctl CTL handle
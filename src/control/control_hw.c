@@ -352,6 +352,22 @@ static int snd_ctl_hw_read(snd_ctl_t *handle, snd_ctl_event_t *event)
 	return 1;
 }
 
+/* the driver copies as many queued events as fit in one read */
+static int snd_ctl_hw_read_many(snd_ctl_t *handle, snd_ctl_event_t *events,
+				unsigned int space)
+{
+	snd_ctl_hw_t *hw = handle->private_data;
+	ssize_t res = read(hw->fd, events, space * sizeof(*events));
+	if (res <= 0)
+		return -errno;
+	if (CHECK_SANITY(res % sizeof(*events))) {
+		SNDMSG("snd_ctl_hw_read_many: read size error (req:%d, got:%d)\n",
+		       space * sizeof(*events), res);
+		return -EINVAL;
+	}
+	return res / sizeof(*events);
+}
+
 static const snd_ctl_ops_t snd_ctl_hw_ops = {
 	.close = snd_ctl_hw_close,
 	.nonblock = snd_ctl_hw_nonblock,
@@ -379,6 +395,7 @@ static const snd_ctl_ops_t snd_ctl_hw_ops = {
 	.set_power_state = snd_ctl_hw_set_power_state,
 	.get_power_state = snd_ctl_hw_get_power_state,
 	.read = snd_ctl_hw_read,
+	.read_many = snd_ctl_hw_read_many,
 };
 
 /**
@@ -35,6 +35,8 @@ typedef struct _snd_ctl_ops {
 	int (*element_remove)(snd_ctl_t *handle, snd_ctl_elem_id_t *id);
 	int (*element_read)(snd_ctl_t *handle, snd_ctl_elem_value_t *control);
 	int (*element_write)(snd_ctl_t *handle, snd_ctl_elem_value_t *control);
+	int (*element_read_many)(snd_ctl_t *handle, snd_ctl_elem_value_t **controls, unsigned int count);
+	int (*element_write_many)(snd_ctl_t *handle, snd_ctl_elem_value_t **controls, unsigned int count);
 	int (*element_lock)(snd_ctl_t *handle, snd_ctl_elem_id_t *lock);
 	int (*element_unlock)(snd_ctl_t *handle, snd_ctl_elem_id_t *unlock);
 	int (*element_tlv)(snd_ctl_t *handle, int op_flag, unsigned int numid,
@@ -50,6 +52,7 @@ typedef struct _snd_ctl_ops {
 	int (*set_power_state)(snd_ctl_t *handle, unsigned int state);
 	int (*get_power_state)(snd_ctl_t *handle, unsigned int *state);
 	int (*read)(snd_ctl_t *handle, snd_ctl_event_t *event);
+	int (*read_many)(snd_ctl_t *handle, snd_ctl_event_t *events, unsigned int space);
 	int (*poll_descriptors_count)(snd_ctl_t *handle);
 	int (*poll_descriptors)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int space);
 	int (*poll_revents)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
@@ -70,12 +73,21 @@ struct _snd_ctl {
 struct _snd_hctl_elem {
 	snd_ctl_elem_id_t id; 		/* must be always on top */
 	struct list_head list;		/* links for list of all helems */
-	int compare_weight;		/* compare weight (reversed) */
+	int compare_weight;		/* compare weight (reversed), -1 = unset */
 	/* event callback */
 	snd_hctl_elem_callback_t callback;
 	void *callback_private;
 	/* links */
 	snd_hctl_t *hctl;		/* associated handle */
+	struct snd_hctl_elem_cache *cache; /* info/value/TLV cache */
+	/* index */
+	unsigned int index;		/* position in pelems */
+	unsigned int hash;		/* hash of the id without numid */
+	snd_hctl_elem_t *hnext_numid;	/* next in the numid bucket */
+	snd_hctl_elem_t *hnext_id;	/* next in the id bucket */
+	/* batched events */
+	struct list_head pending;	/* link in the pending list */
+	unsigned int pending_mask;	/* VALUE/INFO events to throw */
 };
 
 struct _snd_hctl {
@@ -84,16 +96,29 @@ struct _snd_hctl {
 	unsigned int alloc;	
 	unsigned int count;
 	snd_hctl_elem_t **pelems;
+	snd_hctl_elem_t *slab;		/* elements allocated by load */
+	unsigned int slab_count;
+	int sorted;			/* pelems and elems follow compare */
+	unsigned int hsize;		/* buckets of the indexes, power of 2 */
+	snd_hctl_elem_t **hnumid;	/* elements hashed by numid */
+	snd_hctl_elem_t **hid;		/* elements hashed by the other id fields */
 	snd_hctl_compare_t compare;
 	snd_hctl_callback_t callback;
 	void *callback_private;
+	int cache;			/* serve the reads from the elem caches */
+	unsigned long cache_hits;	/* ioctls avoided by the caches */
+	int event_batch;		/* coalesce the element events */
+	struct list_head pending;	/* elements with deferred events */
+	unsigned long events_coalesced;	/* events merged into others */
 };
 
 
 /* make local functions really local */
 #define snd_ctl_new	snd1_ctl_new
+#define snd_ctl_read_many	snd1_ctl_read_many
 
 int snd_ctl_new(snd_ctl_t **ctlp, snd_ctl_type_t type, const char *name);
+int snd_ctl_read_many(snd_ctl_t *ctl, snd_ctl_event_t *events, unsigned int space);
 int _snd_ctl_poll_descriptor(snd_ctl_t *ctl);
 #define _snd_ctl_async_descriptor _snd_ctl_poll_descriptor
 int snd_ctl_hw_open(snd_ctl_t **handle, const char *name, int card, int mode);
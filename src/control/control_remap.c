@@ -471,12 +471,78 @@ static int snd_ctl_remap_elem_info(snd_ctl_t *ctl, snd_ctl_elem_info_t *info)
 	return remap_id_to_app(priv, &info->id, rid, err);
 }
 
+/* copy the mapped channels of a child value to the application value */
+static void remap_map_get(snd_ctl_map_t *map, struct snd_ctl_map_ctl *mctl,
+			  snd_ctl_elem_value_t *control,
+			  const snd_ctl_elem_value_t *control2)
+{
+	size_t index;
+
+	if (map->type == SNDRV_CTL_ELEM_TYPE_BOOLEAN ||
+	    map->type == SNDRV_CTL_ELEM_TYPE_INTEGER) {
+		for (index = 0; index < mctl->channel_map_items; index++) {
+			long src = mctl->channel_map[index];
+			if ((unsigned long)src < ARRAY_SIZE(control->value.integer.value))
+				control->value.integer.value[index] = control2->value.integer.value[src];
+		}
+	} else if (map->type == SNDRV_CTL_ELEM_TYPE_INTEGER64) {
+		for (index = 0; index < mctl->channel_map_items; index++) {
+			long src = mctl->channel_map[index];
+			if ((unsigned long)src < ARRAY_SIZE(control->value.integer64.value))
+				control->value.integer64.value[index] = control2->value.integer64.value[src];
+		}
+	} else if (map->type == SNDRV_CTL_ELEM_TYPE_BYTES) {
+		for (index = 0; index < mctl->channel_map_items; index++) {
+			long src = mctl->channel_map[index];
+			if ((unsigned long)src < ARRAY_SIZE(control->value.bytes.data))
+				control->value.bytes.data[index] = control2->value.bytes.data[src];
+		}
+	}
+}
+
+/* store the mapped channels of the application value to a child value */
+static int remap_map_put(snd_ctl_map_t *map, struct snd_ctl_map_ctl *mctl,
+			 const snd_ctl_elem_value_t *control,
+			 snd_ctl_elem_value_t *control2)
+{
+	size_t index;
+	int changes = 0;
+
+	if (map->type == SNDRV_CTL_ELEM_TYPE_BOOLEAN ||
+	    map->type == SNDRV_CTL_ELEM_TYPE_INTEGER) {
+		for (index = 0; index < mctl->channel_map_items; index++) {
+			long dst = mctl->channel_map[index];
+			if ((unsigned long)dst < ARRAY_SIZE(control->value.integer.value)) {
+				changes |= control2->value.integer.value[dst] != control->value.integer.value[index];
+				control2->value.integer.value[dst] = control->value.integer.value[index];
+			}
+		}
+	} else if (map->type == SNDRV_CTL_ELEM_TYPE_INTEGER64) {
+		for (index = 0; index < mctl->channel_map_items; index++) {
+			long dst = mctl->channel_map[index];
+			if ((unsigned long)dst < ARRAY_SIZE(control->value.integer64.value)) {
+				changes |= control2->value.integer64.value[dst] != control->value.integer64.value[index];
+				control2->value.integer64.value[dst] = control->value.integer64.value[index];
+			}
+		}
+	} else if (map->type == SNDRV_CTL_ELEM_TYPE_BYTES) {
+		for (index = 0; index < mctl->channel_map_items; index++) {
+			long dst = mctl->channel_map[index];
+			if ((unsigned long)dst < ARRAY_SIZE(control->value.bytes.data)) {
+				changes |= control2->value.bytes.data[dst] != control->value.bytes.data[index];
+				control2->value.bytes.data[dst] = control->value.bytes.data[index];
+			}
+		}
+	}
+	return changes;
+}
+
 static int remap_map_elem_read(snd_ctl_remap_t *priv, snd_ctl_elem_value_t *control)
 {
 	snd_ctl_map_t *map;
 	struct snd_ctl_map_ctl *mctl;
 	snd_ctl_elem_value_t control2;
-	size_t item, index;
+	size_t item;
 	int err;
 
 	map = remap_find_map_id(priv, &control->id);
@@ -493,26 +559,7 @@ static int remap_map_elem_read(snd_ctl_remap_t *priv, snd_ctl_elem_value_t *cont
 		err = snd_ctl_elem_read(priv->child, &control2);
 		if (err < 0)
 			return err;
-		if (map->type == SNDRV_CTL_ELEM_TYPE_BOOLEAN ||
-		    map->type == SNDRV_CTL_ELEM_TYPE_INTEGER) {
-			for (index = 0; index < mctl->channel_map_items; index++) {
-				long src = mctl->channel_map[index];
-				if ((unsigned long)src < ARRAY_SIZE(control->value.integer.value))
-					control->value.integer.value[index] = control2.value.integer.value[src];
-			}
-		} else if (map->type == SNDRV_CTL_ELEM_TYPE_INTEGER64) {
-			for (index = 0; index < mctl->channel_map_items; index++) {
-				long src = mctl->channel_map[index];
-				if ((unsigned long)src < ARRAY_SIZE(control->value.integer64.value))
-					control->value.integer64.value[index] = control2.value.integer64.value[src];
-			}
-		} else if (map->type == SNDRV_CTL_ELEM_TYPE_BYTES) {
-			for (index = 0; index < mctl->channel_map_items; index++) {
-				long src = mctl->channel_map[index];
-				if ((unsigned long)src < ARRAY_SIZE(control->value.bytes.data))
-					control->value.bytes.data[index] = control2.value.bytes.data[src];
-			}
-		}
+		remap_map_get(map, mctl, control, &control2);
 	}
 	return 0;
 }
@@ -539,7 +586,7 @@ static int remap_map_elem_write(snd_ctl_remap_t *priv, snd_ctl_elem_value_t *con
 	snd_ctl_map_t *map;
 	struct snd_ctl_map_ctl *mctl;
 	snd_ctl_elem_value_t control2;
-	size_t item, index;
+	size_t item;
 	int err, changes;
 
 	map = remap_find_map_id(priv, &control->id);
@@ -555,33 +602,7 @@ static int remap_map_elem_write(snd_ctl_remap_t *priv, snd_ctl_elem_value_t *con
 		err = snd_ctl_elem_read(priv->child, &control2);
 		if (err < 0)
 			return err;
-		changes = 0;
-		if (map->type == SNDRV_CTL_ELEM_TYPE_BOOLEAN ||
-		    map->type == SNDRV_CTL_ELEM_TYPE_INTEGER) {
-			for (index = 0; index < mctl->channel_map_items; index++) {
-				long dst = mctl->channel_map[index];
-				if ((unsigned long)dst < ARRAY_SIZE(control->value.integer.value)) {
-					changes |= control2.value.integer.value[dst] != control->value.integer.value[index];
-					control2.value.integer.value[dst] = control->value.integer.value[index];
-				}
-			}
-		} else if (map->type == SNDRV_CTL_ELEM_TYPE_INTEGER64) {
-			for (index = 0; index < mctl->channel_map_items; index++) {
-				long dst = mctl->channel_map[index];
-				if ((unsigned long)dst < ARRAY_SIZE(control->value.integer64.value)) {
-					changes |= control2.value.integer64.value[dst] != control->value.integer64.value[index];
-					control2.value.integer64.value[dst] = control->value.integer64.value[index];
-				}
-			}
-		} else if (map->type == SNDRV_CTL_ELEM_TYPE_BYTES) {
-			for (index = 0; index < mctl->channel_map_items; index++) {
-				long dst = mctl->channel_map[index];
-				if ((unsigned long)dst < ARRAY_SIZE(control->value.bytes.data)) {
-					changes |= control2.value.bytes.data[dst] != control->value.bytes.data[index];
-					control2.value.bytes.data[dst] = control->value.bytes.data[index];
-				}
-			}
-		}
+		changes = remap_map_put(map, mctl, control, &control2);
 		debug_id(&control2.id, "%s changes %d\n", __func__, changes);
 		if (changes > 0) {
 			err = snd_ctl_elem_write(priv->child, &control2);
@@ -724,6 +745,235 @@ static int snd_ctl_remap_elem_tlv(snd_ctl_t *ctl, int op_flag,
 	return priv->child->ops->element_tlv(priv->child, op_flag, map_numid->numid_child, tlv, tlv_size);
 }
 
+/*
+ * A batch reads the child controls of the maps only once, even when
+ * several map controls (or several values of the same map) share them.
+ */
+#ifndef DOC_HIDDEN
+typedef struct {
+	snd_ctl_elem_id_t *ids;		/* application ids, restored on error */
+	snd_ctl_map_t **maps;		/* map of each value or NULL */
+	snd_ctl_remap_id_t **rids;	/* remap of the other values */
+	size_t *child;			/* child value of each map control */
+	size_t items;
+	snd_ctl_elem_value_t *values;	/* distinct child controls */
+	int *changes;
+	snd_ctl_elem_value_t **ptrs;	/* the batch passed to the child */
+} snd_ctl_remap_batch_t;
+#endif
+
+static int remap_same_child(const snd_ctl_elem_id_t *id1, const snd_ctl_elem_id_t *id2)
+{
+	if (id1->numid > 0 && id2->numid > 0)
+		return id1->numid == id2->numid;
+	return snd_ctl_elem_id_compare_set(id1, id2) == 0;
+}
+
+static void remap_batch_free(snd_ctl_remap_batch_t *batch)
+{
+	free(batch->ids);
+	free(batch->maps);
+	free(batch->rids);
+	free(batch->child);
+	free(batch->values);
+	free(batch->changes);
+	free(batch->ptrs);
+}
+
+static int remap_batch_init(snd_ctl_remap_t *priv, snd_ctl_remap_batch_t *batch,
+			    snd_ctl_elem_value_t **controls, unsigned int count)
+{
+	snd_ctl_map_t *map;
+	struct snd_ctl_map_ctl *mctl;
+	size_t children = 0, k = 0, item, j;
+	unsigned int i;
+	int err;
+
+	memset(batch, 0, sizeof(*batch));
+	batch->ids = malloc(count * sizeof(*batch->ids));
+	batch->maps = malloc(count * sizeof(*batch->maps));
+	batch->rids = calloc(count, sizeof(*batch->rids));
+	if (!batch->ids || !batch->maps || !batch->rids) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	for (i = 0; i < count; i++) {
+		batch->ids[i] = controls[i]->id;
+		map = remap_find_map_id(priv, &controls[i]->id);
+		batch->maps[i] = map;
+		if (map)
+			children += map->controls_items;
+	}
+	batch->child = malloc(children * sizeof(*batch->child) + 1);
+	batch->values = malloc(children * sizeof(*batch->values) + 1);
+	batch->changes = calloc(children + 1, sizeof(*batch->changes));
+	batch->ptrs = malloc((count + children) * sizeof(*batch->ptrs) + 1);
+	if (!batch->child || !batch->values || !batch->changes || !batch->ptrs) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	for (i = 0; i < count; i++) {
+		map = batch->maps[i];
+		if (map == NULL)
+			continue;
+		for (item = 0; item < map->controls_items; item++) {
+			mctl = &map->controls[item];
+			err = remap_get_map_numid(priv, mctl);
+			if (err < 0)
+				goto _err;
+			for (j = 0; j < batch->items; j++)
+				if (remap_same_child(&batch->values[j].id, &mctl->id_child))
+					break;
+			if (j == batch->items) {
+				snd_ctl_elem_value_clear(&batch->values[j]);
+				batch->values[j].id = mctl->id_child;
+				batch->items++;
+			}
+			batch->child[k++] = j;
+		}
+	}
+	return 0;
+
+ _err:
+	remap_batch_free(batch);
+	return err;
+}
+
+static void remap_batch_restore(snd_ctl_remap_batch_t *batch,
+				snd_ctl_elem_value_t **controls, unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		controls[i]->id = batch->ids[i];
+}
+
+static int snd_ctl_remap_elem_read_many(snd_ctl_t *ctl,
+					snd_ctl_elem_value_t **controls,
+					unsigned int count)
+{
+	snd_ctl_remap_t *priv = ctl->private_data;
+	snd_ctl_remap_batch_t batch;
+	snd_ctl_map_t *map;
+	size_t item, k, n = 0;
+	unsigned int i;
+	int err;
+
+	err = remap_batch_init(priv, &batch, controls, count);
+	if (err < 0)
+		return err;
+	for (i = 0; i < count; i++) {
+		if (batch.maps[i])
+			continue;
+		err = remap_id_to_child(priv, &controls[i]->id, &batch.rids[i]);
+		if (err < 0)
+			goto _err;
+		batch.ptrs[n++] = controls[i];
+	}
+	for (item = 0; item < batch.items; item++)
+		batch.ptrs[n++] = &batch.values[item];
+	err = snd_ctl_elem_read_many(priv->child, batch.ptrs, n);
+	if (err < 0)
+		goto _err;
+	for (i = 0, k = 0; i < count; i++) {
+		map = batch.maps[i];
+		if (map == NULL) {
+			err = remap_id_to_app(priv, &controls[i]->id, batch.rids[i], 0);
+			if (err < 0)
+				goto _err;
+			continue;
+		}
+		snd_ctl_elem_value_clear(controls[i]);
+		controls[i]->id = map->map_id;
+		for (item = 0; item < map->controls_items; item++, k++)
+			remap_map_get(map, &map->controls[item], controls[i],
+				      &batch.values[batch.child[k]]);
+	}
+	remap_batch_free(&batch);
+	return 0;
+
+ _err:
+	remap_batch_restore(&batch, controls, count);
+	remap_batch_free(&batch);
+	return err;
+}
+
+static int snd_ctl_remap_elem_write_many(snd_ctl_t *ctl,
+					 snd_ctl_elem_value_t **controls,
+					 unsigned int count)
+{
+	snd_ctl_remap_t *priv = ctl->private_data;
+	snd_ctl_remap_batch_t batch;
+	snd_ctl_map_t *map;
+	size_t item, k, n = 0;
+	unsigned int i;
+	int err;
+
+	err = remap_batch_init(priv, &batch, controls, count);
+	if (err < 0)
+		return err;
+	for (i = 0; i < count; i++) {
+		if (batch.maps[i])
+			continue;
+		err = remap_id_to_child(priv, &controls[i]->id, &batch.rids[i]);
+		if (err < 0)
+			goto _err;
+		for (item = 0; item < batch.items; item++)
+			if (remap_same_child(&controls[i]->id, &batch.values[item].id))
+				goto _sequential;
+		batch.ptrs[n++] = controls[i];
+	}
+	if (batch.items > 0) {
+		for (item = 0; item < batch.items; item++)
+			batch.ptrs[n + item] = &batch.values[item];
+		err = snd_ctl_elem_read_many(priv->child, batch.ptrs + n, batch.items);
+		if (err < 0)
+			goto _err;
+	}
+	/* the later values of the batch override the earlier ones */
+	for (i = 0, k = 0; i < count; i++) {
+		map = batch.maps[i];
+		if (map == NULL)
+			continue;
+		controls[i]->id = map->map_id;
+		for (item = 0; item < map->controls_items; item++, k++)
+			batch.changes[batch.child[k]] |=
+				remap_map_put(map, &map->controls[item], controls[i],
+					      &batch.values[batch.child[k]]);
+	}
+	for (item = 0; item < batch.items; item++)
+		if (batch.changes[item])
+			batch.ptrs[n++] = &batch.values[item];
+	err = snd_ctl_elem_write_many(priv->child, batch.ptrs, n);
+	if (err < 0)
+		goto _err;
+	for (i = 0; i < count; i++) {
+		if (batch.maps[i])
+			continue;
+		err = remap_id_to_app(priv, &controls[i]->id, batch.rids[i], 0);
+		if (err < 0)
+			goto _err;
+	}
+	remap_batch_free(&batch);
+	return 0;
+
+ _sequential:
+	/* a value writes a child control of a map, keep the order */
+	remap_batch_restore(&batch, controls, count);
+	remap_batch_free(&batch);
+	for (i = 0; i < count; i++) {
+		err = snd_ctl_remap_elem_write(ctl, controls[i]);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+
+ _err:
+	remap_batch_restore(&batch, controls, count);
+	remap_batch_free(&batch);
+	return err;
+}
+
 static int snd_ctl_remap_hwdep_next_device(snd_ctl_t *ctl, int * device)
 {
 	snd_ctl_remap_t *priv = ctl->private_data;
@@ -887,6 +1137,8 @@ static const snd_ctl_ops_t snd_ctl_remap_ops = {
 	.element_info = snd_ctl_remap_elem_info,
 	.element_read = snd_ctl_remap_elem_read,
 	.element_write = snd_ctl_remap_elem_write,
+	.element_read_many = snd_ctl_remap_elem_read_many,
+	.element_write_many = snd_ctl_remap_elem_write_many,
 	.element_lock = snd_ctl_remap_elem_lock,
 	.element_unlock = snd_ctl_remap_elem_unlock,
 	.element_tlv = snd_ctl_remap_elem_tlv,
@@ -44,6 +44,7 @@ const char *_snd_module_control_shm = "";
 typedef struct {
 	int socket;
 	volatile snd_ctl_shm_ctrl_t *ctrl;
+	int no_many;		/* the server doesn't know the *_MANY commands */
 } snd_ctl_shm_t;
 #endif
 
@@ -214,6 +215,67 @@ static int snd_ctl_shm_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *control)
 	return err;
 }
 
+/* pass the values in chunks filling the data area, one round trip each;
+ * an older server refuses the command, fall back to one value per trip */
+static int snd_ctl_shm_elem_many(snd_ctl_t *ctl, int cmd,
+				 snd_ctl_elem_value_t **controls,
+				 unsigned int count)
+{
+	snd_ctl_shm_t *shm = ctl->private_data;
+	volatile snd_ctl_shm_ctrl_t *ctrl = shm->ctrl;
+	snd_ctl_elem_value_t *data = (snd_ctl_elem_value_t *)ctrl->data;
+	unsigned int maxcount = CTL_SHM_DATA_MAXLEN / sizeof(*data);
+	unsigned int i, n;
+	int err;
+
+	while (count > 0) {
+		if (shm->no_many) {
+			if (cmd == SND_CTL_IOCTL_ELEM_READ_MANY)
+				err = snd_ctl_shm_elem_read(ctl, *controls);
+			else
+				err = snd_ctl_shm_elem_write(ctl, *controls);
+			if (err < 0)
+				return err;
+			controls++;
+			count--;
+			continue;
+		}
+		n = count < maxcount ? count : maxcount;
+		for (i = 0; i < n; i++)
+			data[i] = *controls[i];
+		ctrl->u.element_many = n;
+		ctrl->cmd = cmd;
+		err = snd_ctl_shm_action(ctl);
+		if (err == -ENOSYS) {
+			shm->no_many = 1;
+			continue;
+		}
+		if (err < 0)
+			return err;
+		for (i = 0; i < n; i++)
+			*controls[i] = data[i];
+		controls += n;
+		count -= n;
+	}
+	return 0;
+}
+
+static int snd_ctl_shm_elem_read_many(snd_ctl_t *ctl,
+				      snd_ctl_elem_value_t **controls,
+				      unsigned int count)
+{
+	return snd_ctl_shm_elem_many(ctl, SND_CTL_IOCTL_ELEM_READ_MANY,
+				     controls, count);
+}
+
+static int snd_ctl_shm_elem_write_many(snd_ctl_t *ctl,
+				       snd_ctl_elem_value_t **controls,
+				       unsigned int count)
+{
+	return snd_ctl_shm_elem_many(ctl, SND_CTL_IOCTL_ELEM_WRITE_MANY,
+				     controls, count);
+}
+
 static int snd_ctl_shm_elem_lock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id)
 {
 	snd_ctl_shm_t *shm = ctl->private_data;
@@ -395,6 +457,8 @@ static const snd_ctl_ops_t snd_ctl_shm_ops = {
 	.element_info = snd_ctl_shm_elem_info,
 	.element_read = snd_ctl_shm_elem_read,
 	.element_write = snd_ctl_shm_elem_write,
+	.element_read_many = snd_ctl_shm_elem_read_many,
+	.element_write_many = snd_ctl_shm_elem_write_many,
 	.element_lock = snd_ctl_shm_elem_lock,
 	.element_unlock = snd_ctl_shm_elem_unlock,
 	.hwdep_next_device = snd_ctl_shm_hwdep_next_device,
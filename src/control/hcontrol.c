@@ -40,6 +40,45 @@
 <P> High level control interface caches the accesses to primitive controls
 to reduce overhead accessing the real controls in kernel drivers.
 
+\section hcontrol_cache Element cache
+
+<P> After #snd_hctl_set_cache(), the information, the value and the TLV
+data of each element are kept in memory after their first read, and
+the next reads don't reach the driver.  The change events of the element
+handled by #snd_hctl_handle_events() and the writes through the HCTL
+handle drop the cached data.  A cached read is thus only as fresh as the
+last handled events, so the application has to handle the events
+before the reads (as mixer applications do anyway).  The values of the
+volatile elements, which change without events, are never cached.
+The lock state in the cached information (#snd_ctl_elem_info_is_locked(),
+#snd_ctl_elem_info_is_owner(), #snd_ctl_elem_info_get_owner()) is the
+one of the last driver read: #snd_ctl_elem_lock() and
+#snd_ctl_elem_unlock() send no event, so an application tracking the
+element locks has to call #snd_ctl_elem_info() on the CTL handle.
+#snd_hctl_get_cache_hits() returns the count of reads served from
+memory.
+
+\section hcontrol_index Element lookup
+
+<P> The elements are indexed by their numid and by the rest of their
+identifier, so #snd_hctl_find_elem() doesn't depend on the number of
+elements with the default or the #snd_hctl_compare_fast() compare
+functions.  The elements added or removed by the events don't reorder
+the element list at once; it is sorted again only when it is walked
+through (#snd_hctl_first_elem() & co.).
+
+\section hcontrol_events Batched events
+
+<P> By default, #snd_hctl_handle_events() reads the events one by one
+and invokes the element callback for each of them.  After
+#snd_hctl_set_event_batch(), it drains the event queue with as few
+reads as the CTL backend allows, and the value and info events of an
+element are merged: its callback is invoked once, after all pending
+events were read, with the union of their masks.  The added and the
+removed elements are still notified in order, after the callbacks of
+the events read before them.  #snd_hctl_get_events_coalesced() returns
+the count of the merged events.
+
 */
 
 #include <stdio.h>
@@ -49,12 +88,21 @@ to reduce overhead accessing the real controls in kernel drivers.
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include "control_local.h"
-#ifdef HAVE_LIBPTHREAD
-#include <pthread.h>
-#endif
 
 #ifndef DOC_HIDDEN
 #define NOT_FOUND 1000000000
+
+#define HCTL_CACHE_INFO		(1 << 0)
+#define HCTL_CACHE_VALUE	(1 << 1)
+#define HCTL_CACHE_TLV		(1 << 2)
+
+struct snd_hctl_elem_cache {
+	unsigned int valid;		/* HCTL_CACHE_* */
+	snd_ctl_elem_info_t info;
+	snd_ctl_elem_value_t value;
+	unsigned int *tlv;
+	unsigned int tlv_size;		/* bytes in tlv */
+};
 #endif
 
 static int snd_hctl_compare_default(const snd_hctl_elem_t *c1,
@@ -95,6 +143,7 @@ int snd_hctl_open_ctl(snd_hctl_t **hctlp, snd_ctl_t *ctl)
 	if ((hctl = (snd_hctl_t *)calloc(1, sizeof(snd_hctl_t))) == NULL)
 		return -ENOMEM;
 	INIT_LIST_HEAD(&hctl->elems);
+	INIT_LIST_HEAD(&hctl->pending);
 	hctl->ctl = ctl;
 	*hctlp = hctl;
 	return 0;
@@ -343,11 +392,119 @@ static int _snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id, in
 	return idx;
 }
 
+static unsigned int snd_hctl_id_hash(const snd_ctl_elem_id_t *id)
+{
+	const unsigned char *name = id->name;
+	unsigned int k, hash = 2166136261U;	/* FNV-1a */
+
+	hash = (hash ^ id->iface) * 16777619U;
+	hash = (hash ^ id->device) * 16777619U;
+	hash = (hash ^ id->subdevice) * 16777619U;
+	hash = (hash ^ id->index) * 16777619U;
+	for (k = 0; k < sizeof(id->name) && name[k]; k++)
+		hash = (hash ^ name[k]) * 16777619U;
+	return hash;
+}
+
+static void snd_hctl_index_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	snd_hctl_elem_t **bucket;
+
+	if (elem->id.numid > 0) {
+		bucket = &hctl->hnumid[elem->id.numid & (hctl->hsize - 1)];
+		elem->hnext_numid = *bucket;
+		*bucket = elem;
+	}
+	bucket = &hctl->hid[elem->hash & (hctl->hsize - 1)];
+	elem->hnext_id = *bucket;
+	*bucket = elem;
+}
+
+static void snd_hctl_index_del(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	snd_hctl_elem_t **pos;
+
+	if (elem->id.numid > 0) {
+		pos = &hctl->hnumid[elem->id.numid & (hctl->hsize - 1)];
+		while (*pos != elem)
+			pos = &(*pos)->hnext_numid;
+		*pos = elem->hnext_numid;
+	}
+	pos = &hctl->hid[elem->hash & (hctl->hsize - 1)];
+	while (*pos != elem)
+		pos = &(*pos)->hnext_id;
+	*pos = elem->hnext_id;
+}
+
+/* keep at most one element per bucket on average */
+static int snd_hctl_index_resize(snd_hctl_t *hctl, unsigned int count)
+{
+	snd_hctl_elem_t **hnumid, **hid;
+	unsigned int k, size;
+
+	if (count <= hctl->hsize)
+		return 0;
+	for (size = 64; size < count; size *= 2)
+		;
+	hnumid = calloc(size, sizeof(*hnumid));
+	hid = calloc(size, sizeof(*hid));
+	if (!hnumid || !hid) {
+		free(hnumid);
+		free(hid);
+		return -ENOMEM;
+	}
+	free(hctl->hnumid);
+	free(hctl->hid);
+	hctl->hnumid = hnumid;
+	hctl->hid = hid;
+	hctl->hsize = size;
+	for (k = 0; k < hctl->count; k++)
+		snd_hctl_index_add(hctl, hctl->pelems[k]);
+	return 0;
+}
+
+static snd_hctl_elem_t *snd_hctl_index_find_numid(snd_hctl_t *hctl,
+						  unsigned int numid)
+{
+	snd_hctl_elem_t *elem;
+
+	if (hctl->hsize == 0)
+		return NULL;
+	elem = hctl->hnumid[numid & (hctl->hsize - 1)];
+	while (elem && elem->id.numid != numid)
+		elem = elem->hnext_numid;
+	return elem;
+}
+
+static snd_hctl_elem_t *snd_hctl_index_find_id(snd_hctl_t *hctl,
+					       const snd_ctl_elem_id_t *id)
+{
+	snd_hctl_elem_t *elem;
+	unsigned int hash;
+
+	if (hctl->hsize == 0)
+		return NULL;
+	hash = snd_hctl_id_hash(id);
+	for (elem = hctl->hid[hash & (hctl->hsize - 1)]; elem;
+	     elem = elem->hnext_id) {
+		if (elem->hash == hash &&
+		    elem->id.iface == id->iface &&
+		    elem->id.device == id->device &&
+		    elem->id.subdevice == id->subdevice &&
+		    elem->id.index == id->index &&
+		    strncmp((const char *)elem->id.name,
+			    (const char *)id->name, sizeof(id->name)) == 0)
+			return elem;
+	}
+	return NULL;
+}
+
 static int snd_hctl_elem_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
 {
-	int dir;
-	int idx; 
-	elem->compare_weight = get_compare_weight(&elem->id);
+	int err;
+
+	elem->compare_weight = -1;
+	elem->hash = snd_hctl_id_hash(&elem->id);
 	if (hctl->count == hctl->alloc) {
 		snd_hctl_elem_t **h;
 		hctl->alloc += 32;
@@ -358,40 +515,59 @@ static int snd_hctl_elem_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
 		}
 		hctl->pelems = h;
 	}
-	if (hctl->count == 0) {
-		list_add_tail(&elem->list, &hctl->elems);
-		hctl->pelems[0] = elem;
-	} else {
-		idx = _snd_hctl_find_elem(hctl, &elem->id, &dir);
-		assert(dir != 0);
-		if (dir > 0) {
-			list_add(&elem->list, &hctl->pelems[idx]->list);
-			idx++;
-		} else {
-			list_add_tail(&elem->list, &hctl->pelems[idx]->list);
-		}
-		memmove(hctl->pelems + idx + 1,
-			hctl->pelems + idx,
-			(hctl->count - idx) * sizeof(snd_hctl_elem_t *));
-		hctl->pelems[idx] = elem;
-	}
-	hctl->count++;
+	err = snd_hctl_index_resize(hctl, hctl->count + 1);
+	if (err < 0)
+		return err;
+	/* sorted when the elements are walked through */
+	list_add_tail(&elem->list, &hctl->elems);
+	elem->index = hctl->count;
+	hctl->pelems[hctl->count++] = elem;
+	hctl->sorted = hctl->count == 1;
+	snd_hctl_index_add(hctl, elem);
 	return snd_hctl_throw_event(hctl, SNDRV_CTL_EVENT_MASK_ADD, elem);
 }
 
-static void snd_hctl_elem_remove(snd_hctl_t *hctl, unsigned int idx)
+static struct snd_hctl_elem_cache *snd_hctl_elem_cache(snd_hctl_elem_t *elem)
+{
+	if (!elem->hctl->cache)
+		return NULL;
+	/* without memory, the reads simply go to the driver */
+	if (!elem->cache)
+		elem->cache = calloc(1, sizeof(*elem->cache));
+	return elem->cache;
+}
+
+static void snd_hctl_elem_invalidate(snd_hctl_elem_t *elem, unsigned int mask)
 {
-	snd_hctl_elem_t *elem = hctl->pelems[idx];
-	unsigned int m;
+	if (elem->cache)
+		elem->cache->valid &= ~mask;
+}
+
+static void snd_hctl_elem_cache_free(snd_hctl_elem_t *elem)
+{
+	if (!elem->cache)
+		return;
+	free(elem->cache->tlv);
+	free(elem->cache);
+	elem->cache = NULL;
+}
+
+static void snd_hctl_elem_remove(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	unsigned int idx = elem->index;
 	snd_hctl_elem_throw_event(elem, SNDRV_CTL_EVENT_MASK_REMOVE);
+	snd_hctl_index_del(hctl, elem);
 	list_del(&elem->list);
-	free(elem);
+	snd_hctl_elem_cache_free(elem);
+	if (elem < hctl->slab || elem >= hctl->slab + hctl->slab_count)
+		free(elem);
 	hctl->count--;
-	m = hctl->count - idx;
-	if (m > 0)
-		memmove(hctl->pelems + idx,
-			hctl->pelems + idx + 1,
-			m * sizeof(snd_hctl_elem_t *));
+	/* move the last element to the hole, sorted again lazily */
+	if (idx < hctl->count) {
+		hctl->pelems[idx] = hctl->pelems[hctl->count];
+		hctl->pelems[idx]->index = idx;
+		hctl->sorted = 0;
+	}
 }
 
 /**
@@ -402,41 +578,121 @@ static void snd_hctl_elem_remove(snd_hctl_t *hctl, unsigned int idx)
 int snd_hctl_free(snd_hctl_t *hctl)
 {
 	while (hctl->count > 0)
-		snd_hctl_elem_remove(hctl, hctl->count - 1);
+		snd_hctl_elem_remove(hctl, hctl->pelems[hctl->count - 1]);
 	free(hctl->pelems);
 	hctl->pelems = 0;
 	hctl->alloc = 0;
+	free(hctl->hnumid);
+	free(hctl->hid);
+	hctl->hnumid = NULL;
+	hctl->hid = NULL;
+	hctl->hsize = 0;
+	free(hctl->slab);
+	hctl->slab = NULL;
+	hctl->slab_count = 0;
 	INIT_LIST_HEAD(&hctl->elems);
 	return 0;
 }
 
-static snd_hctl_t *compare_hctl;
-static int hctl_compare(const void *a, const void *b) {
-	return compare_hctl->compare(*(const snd_hctl_elem_t * const *) a,
-			     *(const snd_hctl_elem_t * const *) b);
+static void snd_hctl_sift_down(snd_hctl_t *hctl, unsigned int root,
+			       unsigned int count)
+{
+	snd_hctl_elem_t **pelems = hctl->pelems, *tmp;
+	unsigned int child;
+
+	while ((child = 2 * root + 1) < count) {
+		if (child + 1 < count &&
+		    hctl->compare(pelems[child], pelems[child + 1]) < 0)
+			child++;
+		if (hctl->compare(pelems[root], pelems[child]) >= 0)
+			return;
+		tmp = pelems[root];
+		pelems[root] = pelems[child];
+		pelems[child] = tmp;
+		root = child;
+	}
 }
 
+/* in place, when there is no memory for the merge sort */
+static void snd_hctl_heap_sort(snd_hctl_t *hctl)
+{
+	snd_hctl_elem_t *tmp;
+	unsigned int k;
+
+	for (k = hctl->count / 2; k-- > 0; )
+		snd_hctl_sift_down(hctl, k, hctl->count);
+	for (k = hctl->count; k-- > 1; ) {
+		tmp = hctl->pelems[0];
+		hctl->pelems[0] = hctl->pelems[k];
+		hctl->pelems[k] = tmp;
+		snd_hctl_sift_down(hctl, 0, k);
+	}
+}
+
+static int snd_hctl_merge_sort(snd_hctl_t *hctl)
+{
+	snd_hctl_elem_t **src = hctl->pelems, **dst, **tmp;
+	unsigned int count = hctl->count, width, lo, mid, hi, i, j, k;
+
+	tmp = malloc(count * sizeof(*tmp));
+	if (!tmp)
+		return -ENOMEM;
+	dst = tmp;
+	for (width = 1; width < count; width *= 2) {
+		for (lo = 0; lo < count; lo += 2 * width) {
+			mid = lo + width < count ? lo + width : count;
+			hi = mid + width < count ? mid + width : count;
+			i = lo;
+			j = mid;
+			for (k = lo; k < hi; k++) {
+				if (i < mid &&
+				    (j >= hi || hctl->compare(src[i], src[j]) <= 0))
+					dst[k] = src[i++];
+				else
+					dst[k] = src[j++];
+			}
+		}
+		dst = src;
+		src = src == tmp ? hctl->pelems : tmp;
+	}
+	if (src != hctl->pelems)
+		memcpy(hctl->pelems, src, count * sizeof(*src));
+	free(tmp);
+	return 0;
+}
+
+/*
+ * The sorts get the compare function from the handle, unlike qsort(),
+ * so the handles may be sorted concurrently.
+ */
 static void snd_hctl_sort(snd_hctl_t *hctl)
 {
 	unsigned int k;
-#ifdef HAVE_LIBPTHREAD
-	static pthread_mutex_t sync_lock = PTHREAD_MUTEX_INITIALIZER;
-#endif
 
 	assert(hctl);
 	assert(hctl->compare);
 	INIT_LIST_HEAD(&hctl->elems);
 
-#ifdef HAVE_LIBPTHREAD
-	pthread_mutex_lock(&sync_lock);
-#endif
-	compare_hctl = hctl;
-	qsort(hctl->pelems, hctl->count, sizeof(*hctl->pelems), hctl_compare);
-#ifdef HAVE_LIBPTHREAD
-	pthread_mutex_unlock(&sync_lock);
-#endif
-	for (k = 0; k < hctl->count; k++)
+	if (hctl->compare == snd_hctl_compare_default) {
+		for (k = 0; k < hctl->count; k++) {
+			snd_hctl_elem_t *elem = hctl->pelems[k];
+			if (elem->compare_weight < 0)
+				elem->compare_weight = get_compare_weight(&elem->id);
+		}
+	}
+	if (hctl->count > 1 && snd_hctl_merge_sort(hctl) < 0)
+		snd_hctl_heap_sort(hctl);
+	for (k = 0; k < hctl->count; k++) {
+		hctl->pelems[k]->index = k;
 		list_add_tail(&hctl->pelems[k]->list, &hctl->elems);
+	}
+	hctl->sorted = 1;
+}
+
+static inline void snd_hctl_sort_lazy(snd_hctl_t *hctl)
+{
+	if (!hctl->sorted && hctl->count > 0)
+		snd_hctl_sort(hctl);
 }
 
 /**
@@ -453,6 +709,65 @@ int snd_hctl_set_compare(snd_hctl_t *hctl, snd_hctl_compare_t compare)
 	return 0;
 }
 
+/**
+ * \brief Enable or disable the element cache of an HCTL
+ * \param hctl HCTL handle
+ * \param enable 0 = disable, 1 = enable
+ * \return 0 on success otherwise a negative error code
+ *
+ * See the \ref hcontrol_cache section for details.  Disabling the cache
+ * frees the cached data of all elements.
+ */
+int snd_hctl_set_cache(snd_hctl_t *hctl, int enable)
+{
+	unsigned int k;
+
+	assert(hctl);
+	hctl->cache = !!enable;
+	if (!enable) {
+		for (k = 0; k < hctl->count; k++)
+			snd_hctl_elem_cache_free(hctl->pelems[k]);
+	}
+	return 0;
+}
+
+/**
+ * \brief Get the number of element reads served by the HCTL cache
+ * \param hctl HCTL handle
+ * \return the number of driver requests avoided by the element cache
+ */
+unsigned long snd_hctl_get_cache_hits(snd_hctl_t *hctl)
+{
+	assert(hctl);
+	return hctl->cache_hits;
+}
+
+/**
+ * \brief Enable or disable the batched event mode of an HCTL
+ * \param hctl HCTL handle
+ * \param enable 0 = disable, 1 = enable
+ * \return 0 on success otherwise a negative error code
+ *
+ * See the \ref hcontrol_events section for details.
+ */
+int snd_hctl_set_event_batch(snd_hctl_t *hctl, int enable)
+{
+	assert(hctl);
+	hctl->event_batch = !!enable;
+	return 0;
+}
+
+/**
+ * \brief Get the number of HCTL events merged by the batched event mode
+ * \param hctl HCTL handle
+ * \return the number of element callbacks avoided by the coalescing
+ */
+unsigned long snd_hctl_get_events_coalesced(snd_hctl_t *hctl)
+{
+	assert(hctl);
+	return hctl->events_coalesced;
+}
+
 /**
  * \brief A "don't care" fast compare functions that may be used with #snd_hctl_set_compare
  * \param c1 First HCTL element
@@ -498,6 +813,7 @@ static int snd_hctl_compare_default(const snd_hctl_elem_t *c1,
 snd_hctl_elem_t *snd_hctl_first_elem(snd_hctl_t *hctl)
 {
 	assert(hctl);
+	snd_hctl_sort_lazy(hctl);
 	if (list_empty(&hctl->elems))
 		return NULL;
 	return list_entry(hctl->elems.next, snd_hctl_elem_t, list);
@@ -511,6 +827,7 @@ snd_hctl_elem_t *snd_hctl_first_elem(snd_hctl_t *hctl)
 snd_hctl_elem_t *snd_hctl_last_elem(snd_hctl_t *hctl)
 {
 	assert(hctl);
+	snd_hctl_sort_lazy(hctl);
 	if (list_empty(&hctl->elems))
 		return NULL;
 	return list_entry(hctl->elems.prev, snd_hctl_elem_t, list);
@@ -524,6 +841,7 @@ snd_hctl_elem_t *snd_hctl_last_elem(snd_hctl_t *hctl)
 snd_hctl_elem_t *snd_hctl_elem_next(snd_hctl_elem_t *elem)
 {
 	assert(elem);
+	snd_hctl_sort_lazy(elem->hctl);
 	if (elem->list.next == &elem->hctl->elems)
 		return NULL;
 	return list_entry(elem->list.next, snd_hctl_elem_t, list);
@@ -537,6 +855,7 @@ snd_hctl_elem_t *snd_hctl_elem_next(snd_hctl_elem_t *elem)
 snd_hctl_elem_t *snd_hctl_elem_prev(snd_hctl_elem_t *elem)
 {
 	assert(elem);
+	snd_hctl_sort_lazy(elem->hctl);
 	if (elem->list.prev == &elem->hctl->elems)
 		return NULL;
 	return list_entry(elem->list.prev, snd_hctl_elem_t, list);
@@ -547,73 +866,136 @@ snd_hctl_elem_t *snd_hctl_elem_prev(snd_hctl_elem_t *elem)
  * \param hctl HCTL handle
  * \param id Element identifier
  * \return pointer to found HCTL element or NULL if it does not exists
+ *
+ * With the default compare function, an identifier without name is
+ * looked up by its numid.
  */
 snd_hctl_elem_t *snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id)
 {
 	int dir;
-	int res = _snd_hctl_find_elem(hctl, id, &dir);
+	int res;
+
+	assert(hctl && id);
+	if (hctl->compare == snd_hctl_compare_fast)
+		return snd_hctl_index_find_numid(hctl, id->numid);
+	if (hctl->compare == snd_hctl_compare_default || !hctl->compare) {
+		if (!id->name[0] && id->numid > 0)
+			return snd_hctl_index_find_numid(hctl, id->numid);
+		return snd_hctl_index_find_id(hctl, id);
+	}
+	/* the application compare function may match other elements */
+	snd_hctl_sort_lazy(hctl);
+	res = _snd_hctl_find_elem(hctl, id, &dir);
 	if (res < 0 || dir != 0)
 		return NULL;
 	return hctl->pelems[res];
 }
 
+#ifndef DOC_HIDDEN
+#define HCTL_LOAD_CHUNK		256	/* ids fetched per element list call */
+#endif
+
 /**
  * \brief Load an HCTL with all elements and sort them
  * \param hctl HCTL handle
  * \return 0 on success otherwise a negative error code
+ *
+ * The element identifiers are fetched in chunks and all elements are
+ * allocated at once.  Each chunk starts with the last identifier of the
+ * previous one and the load is restarted when they differ, i.e. when the
+ * elements changed between the chunks.  When no HCTL callback is set,
+ * nothing observes the order of the loaded elements yet and they are
+ * sorted only when they are walked through (see \ref hcontrol_index).
+ * The information of the elements is not fetched by the load;
+ * snd_hctl_elem_info() gets it from the driver (or the element cache)
+ * on demand.
  */
 int snd_hctl_load(snd_hctl_t *hctl)
 {
 	snd_ctl_elem_list_t list;
+	snd_hctl_elem_t *elem;
 	int err = 0;
-	unsigned int idx;
+	unsigned int idx, count, space, used;
 
 	assert(hctl);
 	assert(hctl->ctl);
 	assert(hctl->count == 0);
 	assert(list_empty(&hctl->elems));
 	memset(&list, 0, sizeof(list));
+ _again:
 	if ((err = snd_ctl_elem_list(hctl->ctl, &list)) < 0)
 		goto _end;
-	while (list.count != list.used) {
-		err = snd_ctl_elem_list_alloc_space(&list, list.count);
+	count = list.count;
+	space = count < HCTL_LOAD_CHUNK ? count : HCTL_LOAD_CHUNK;
+	if (list.space < space) {
+		err = snd_ctl_elem_list_alloc_space(&list, space);
 		if (err < 0)
 			goto _end;
-		if ((err = snd_ctl_elem_list(hctl->ctl, &list)) < 0)
-			goto _end;
 	}
-	if (hctl->alloc < list.count) {
-		hctl->alloc = list.count;
+	if (hctl->alloc < count) {
 		free(hctl->pelems);
-		hctl->pelems = malloc(hctl->alloc * sizeof(*hctl->pelems));
+		hctl->alloc = 0;
+		hctl->pelems = malloc(count * sizeof(*hctl->pelems));
 		if (!hctl->pelems) {
 			err = -ENOMEM;
 			goto _end;
 		}
+		hctl->alloc = count;
 	}
-	for (idx = 0; idx < list.count; idx++) {
-		snd_hctl_elem_t *elem;
-		elem = calloc(1, sizeof(snd_hctl_elem_t));
-		if (elem == NULL) {
+	err = snd_hctl_index_resize(hctl, count);
+	if (err < 0)
+		goto _end;
+	free(hctl->slab);
+	hctl->slab = calloc(count, sizeof(*hctl->slab));
+	if (count > 0 && !hctl->slab) {
+		err = -ENOMEM;
+		goto _end;
+	}
+	hctl->slab_count = count;
+	while (hctl->count < count) {
+		/* overlap the previous chunk by one identifier */
+		list.offset = hctl->count > 0 ? hctl->count - 1 : 0;
+		if ((err = snd_ctl_elem_list(hctl->ctl, &list)) < 0) {
 			snd_hctl_free(hctl);
-			err = -ENOMEM;
 			goto _end;
 		}
-		elem->id = list.pids[idx];
-		elem->hctl = hctl;
-		elem->compare_weight = get_compare_weight(&elem->id);
-		hctl->pelems[idx] = elem;
-		list_add_tail(&elem->list, &hctl->elems);
-		hctl->count++;
+		used = count - list.offset;
+		if (used > list.space)
+			used = list.space;
+		/* the elements changed meanwhile, the chunks don't match */
+		if (list.count != count || list.used != used ||
+		    (hctl->count > 0 &&
+		     memcmp(&list.pids[0], &hctl->pelems[hctl->count - 1]->id,
+			    sizeof(list.pids[0])))) {
+			snd_hctl_free(hctl);
+			list.offset = 0;
+			goto _again;
+		}
+		for (idx = hctl->count > 0 ? 1 : 0; idx < list.used; idx++) {
+			elem = &hctl->slab[hctl->count];
+			elem->id = list.pids[idx];
+			elem->hctl = hctl;
+			elem->compare_weight = -1;
+			elem->hash = snd_hctl_id_hash(&elem->id);
+			elem->index = hctl->count;
+			hctl->pelems[hctl->count++] = elem;
+			list_add_tail(&elem->list, &hctl->elems);
+			snd_hctl_index_add(hctl, elem);
+		}
 	}
 	if (!hctl->compare)
 		hctl->compare = snd_hctl_compare_default;
-	snd_hctl_sort(hctl);
-	for (idx = 0; idx < hctl->count; idx++) {
-		int res = snd_hctl_throw_event(hctl, SNDRV_CTL_EVENT_MASK_ADD,
-					       hctl->pelems[idx]);
-		if (res < 0)
-			return res;
+	hctl->sorted = count <= 1;
+	if (hctl->callback) {
+		snd_hctl_sort(hctl);
+		for (idx = 0; idx < hctl->count; idx++) {
+			int res = snd_hctl_throw_event(hctl, SNDRV_CTL_EVENT_MASK_ADD,
+						       hctl->pelems[idx]);
+			if (res < 0) {
+				err = res;
+				goto _end;
+			}
+		}
 	}
 	err = snd_ctl_subscribe_events(hctl->ctl, 1);
  _end:
@@ -729,6 +1111,7 @@ snd_ctl_t *snd_hctl_ctl(snd_hctl_t *hctl)
 static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 {
 	snd_hctl_elem_t *elem;
+	unsigned int mask;
 	int res;
 
 	assert(hctl);
@@ -740,11 +1123,10 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 		return 0;
 	}
 	if (event->data.elem.mask == SNDRV_CTL_EVENT_MASK_REMOVE) {
-		int dir;
-		res = _snd_hctl_find_elem(hctl, &event->data.elem.id, &dir);
-		if (res < 0 || dir != 0)
+		elem = snd_hctl_find_elem(hctl, &event->data.elem.id);
+		if (!elem)
 			return -ENOENT;
-		snd_hctl_elem_remove(hctl, (unsigned int) res);
+		snd_hctl_elem_remove(hctl, elem);
 		return 0;
 	}
 	if (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_ADD) {
@@ -757,24 +1139,106 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 		if (res < 0)
 			return res;
 	}
+	if (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_TLV) {
+		elem = snd_hctl_find_elem(hctl, &event->data.elem.id);
+		if (elem)
+			snd_hctl_elem_invalidate(elem, HCTL_CACHE_TLV);
+	}
 	if (event->data.elem.mask & (SNDRV_CTL_EVENT_MASK_VALUE |
 				     SNDRV_CTL_EVENT_MASK_INFO)) {
 		elem = snd_hctl_find_elem(hctl, &event->data.elem.id);
 		if (!elem)
 			return -ENOENT;
-		res = snd_hctl_elem_throw_event(elem, event->data.elem.mask &
-						(SNDRV_CTL_EVENT_MASK_VALUE |
-						 SNDRV_CTL_EVENT_MASK_INFO));
+		/* a new info may also change the value and the TLV */
+		if (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_INFO)
+			snd_hctl_elem_invalidate(elem, HCTL_CACHE_INFO |
+						 HCTL_CACHE_VALUE |
+						 HCTL_CACHE_TLV);
+		else
+			snd_hctl_elem_invalidate(elem, HCTL_CACHE_VALUE);
+		mask = event->data.elem.mask & (SNDRV_CTL_EVENT_MASK_VALUE |
+						SNDRV_CTL_EVENT_MASK_INFO);
+		if (hctl->event_batch &&
+		    !(event->data.elem.mask & SNDRV_CTL_EVENT_MASK_ADD)) {
+			if (elem->pending_mask)
+				hctl->events_coalesced++;
+			else
+				list_add_tail(&elem->pending, &hctl->pending);
+			elem->pending_mask |= mask;
+			return 0;
+		}
+		res = snd_hctl_elem_throw_event(elem, mask);
 		if (res < 0)
 			return res;
 	}
 	return 0;
 }
 
+/* throw the deferred events, once per element */
+static int snd_hctl_flush_events(snd_hctl_t *hctl)
+{
+	snd_hctl_elem_t *elem;
+	unsigned int mask;
+	int res, err = 0;
+
+	while (!list_empty(&hctl->pending)) {
+		elem = list_entry(hctl->pending.next, snd_hctl_elem_t, pending);
+		list_del(&elem->pending);
+		mask = elem->pending_mask;
+		elem->pending_mask = 0;
+		res = snd_hctl_elem_throw_event(elem, mask);
+		if (res < 0 && err == 0)
+			err = res;
+	}
+	return err;
+}
+
+#ifndef DOC_HIDDEN
+#define HCTL_EVENT_BATCH	64	/* events read at once */
+#endif
+
+static int snd_hctl_handle_events_batch(snd_hctl_t *hctl)
+{
+	snd_ctl_event_t events[HCTL_EVENT_BATCH], *event;
+	unsigned int count = 0;
+	int k, n, res, err = 0;
+
+	while ((n = snd_ctl_read_many(hctl->ctl, events, HCTL_EVENT_BATCH)) != 0 &&
+	       n != -EAGAIN) {
+		if (n < 0) {
+			err = n;
+			break;
+		}
+		for (k = 0; k < n; k++) {
+			event = &events[k];
+			/* the element list changes keep their order */
+			if (event->type == SND_CTL_EVENT_ELEM &&
+			    (event->data.elem.mask == SNDRV_CTL_EVENT_MASK_REMOVE ||
+			     (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_ADD))) {
+				res = snd_hctl_flush_events(hctl);
+				if (res < 0 && err == 0)
+					err = res;
+			}
+			res = snd_hctl_handle_event(hctl, event);
+			if (res < 0 && err == 0)
+				err = res;
+		}
+		count += n;
+	}
+	res = snd_hctl_flush_events(hctl);
+	if (res < 0 && err == 0)
+		err = res;
+	return err < 0 ? err : (int)count;
+}
+
 /**
  * \brief Handle pending HCTL events invoking callbacks
  * \param hctl HCTL handle
  * \return 0 otherwise a negative error code on failure
+ *
+ * In the batched event mode (see #snd_hctl_set_event_batch()), all
+ * pending events are handled even when one fails, and the first error
+ * is returned.
  */
 int snd_hctl_handle_events(snd_hctl_t *hctl)
 {
@@ -784,6 +1248,8 @@ int snd_hctl_handle_events(snd_hctl_t *hctl)
 	
 	assert(hctl);
 	assert(hctl->ctl);
+	if (hctl->event_batch)
+		return snd_hctl_handle_events_batch(hctl);
 	while ((res = snd_ctl_read(hctl->ctl, &event)) != 0 &&
 	       res != -EAGAIN) {
 		if (res < 0)
@@ -804,11 +1270,44 @@ int snd_hctl_handle_events(snd_hctl_t *hctl)
  */
 int snd_hctl_elem_info(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info)
 {
+	struct snd_hctl_elem_cache *cache;
+	int err;
+
 	assert(elem);
 	assert(elem->hctl);
 	assert(info);
 	info->id = elem->id;
-	return snd_ctl_elem_info(elem->hctl->ctl, info);
+	cache = snd_hctl_elem_cache(elem);
+	if (!cache)
+		return snd_ctl_elem_info(elem->hctl->ctl, info);
+	/* the enumerated item name depends on the requested item */
+	if ((cache->valid & HCTL_CACHE_INFO) &&
+	    (cache->info.type != SND_CTL_ELEM_TYPE_ENUMERATED ||
+	     cache->info.value.enumerated.item == info->value.enumerated.item)) {
+		*info = cache->info;
+		elem->hctl->cache_hits++;
+		return 0;
+	}
+	err = snd_ctl_elem_info(elem->hctl->ctl, info);
+	if (err < 0)
+		return err;
+	cache->info = *info;
+	cache->valid |= HCTL_CACHE_INFO;
+	return err;
+}
+
+/* the value of a volatile element changes without any event */
+static int snd_hctl_elem_cacheable(snd_hctl_elem_t *elem,
+				   struct snd_hctl_elem_cache *cache)
+{
+	if (!(cache->valid & HCTL_CACHE_INFO)) {
+		memset(&cache->info, 0, sizeof(cache->info));
+		cache->info.id = elem->id;
+		if (snd_ctl_elem_info(elem->hctl->ctl, &cache->info) < 0)
+			return 0;
+		cache->valid |= HCTL_CACHE_INFO;
+	}
+	return !(cache->info.access & SNDRV_CTL_ELEM_ACCESS_VOLATILE);
 }
 
 /**
@@ -819,11 +1318,27 @@ int snd_hctl_elem_info(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info)
  */
 int snd_hctl_elem_read(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value)
 {
+	struct snd_hctl_elem_cache *cache;
+	int err;
+
 	assert(elem);
 	assert(elem->hctl);
 	assert(value);
 	value->id = elem->id;
-	return snd_ctl_elem_read(elem->hctl->ctl, value);
+	cache = snd_hctl_elem_cache(elem);
+	if (!cache || !snd_hctl_elem_cacheable(elem, cache))
+		return snd_ctl_elem_read(elem->hctl->ctl, value);
+	if (cache->valid & HCTL_CACHE_VALUE) {
+		*value = cache->value;
+		elem->hctl->cache_hits++;
+		return 0;
+	}
+	err = snd_ctl_elem_read(elem->hctl->ctl, value);
+	if (err < 0)
+		return err;
+	cache->value = *value;
+	cache->valid |= HCTL_CACHE_VALUE;
+	return err;
 }
 
 /**
@@ -840,6 +1355,8 @@ int snd_hctl_elem_write(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value)
 	assert(elem->hctl);
 	assert(value);
 	value->id = elem->id;
+	/* the driver may adjust the written value */
+	snd_hctl_elem_invalidate(elem, HCTL_CACHE_VALUE);
 	return snd_ctl_elem_write(elem->hctl->ctl, value);
 }
 
@@ -852,10 +1369,35 @@ int snd_hctl_elem_write(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value)
  */
 int snd_hctl_elem_tlv_read(snd_hctl_elem_t *elem, unsigned int *tlv, unsigned int tlv_size)
 {
+	struct snd_hctl_elem_cache *cache;
+	unsigned int size, *data;
+	int err;
+
 	assert(elem);
 	assert(tlv);
 	assert(tlv_size >= 12);
-	return snd_ctl_elem_tlv_read(elem->hctl->ctl, &elem->id, tlv, tlv_size);
+	cache = snd_hctl_elem_cache(elem);
+	/* a too small buffer gets the error of the driver */
+	if (cache && (cache->valid & HCTL_CACHE_TLV) &&
+	    cache->tlv_size <= tlv_size) {
+		memcpy(tlv, cache->tlv, cache->tlv_size);
+		elem->hctl->cache_hits++;
+		return 0;
+	}
+	err = snd_ctl_elem_tlv_read(elem->hctl->ctl, &elem->id, tlv, tlv_size);
+	if (err < 0 || !cache)
+		return err;
+	size = 2 * sizeof(int) + tlv[SNDRV_CTL_TLVO_LEN];
+	if (size > tlv_size)
+		return err;
+	data = realloc(cache->tlv, size);
+	if (!data)
+		return err;
+	memcpy(data, tlv, size);
+	cache->tlv = data;
+	cache->tlv_size = size;
+	cache->valid |= HCTL_CACHE_TLV;
+	return err;
 }
 
 /**
@@ -871,6 +1413,7 @@ int snd_hctl_elem_tlv_write(snd_hctl_elem_t *elem, const unsigned int *tlv)
 	assert(elem);
 	assert(tlv);
 	assert(tlv[SNDRV_CTL_TLVO_LEN] >= 4);
+	snd_hctl_elem_invalidate(elem, HCTL_CACHE_TLV);
 	return snd_ctl_elem_tlv_write(elem->hctl->ctl, &elem->id, tlv);
 }
 
@@ -887,6 +1430,7 @@ int snd_hctl_elem_tlv_command(snd_hctl_elem_t *elem, const unsigned int *tlv)
 	assert(elem);
 	assert(tlv);
 	assert(tlv[SNDRV_CTL_TLVO_LEN] >= 4);
+	snd_hctl_elem_invalidate(elem, HCTL_CACHE_TLV);
 	return snd_ctl_elem_tlv_command(elem->hctl->ctl, &elem->id, tlv);
 }
 
@@ -236,6 +236,7 @@ int snd_mixer_attach_hctl(snd_mixer_t *mixer, snd_hctl_t *hctl)
 	}
 	snd_hctl_set_callback(hctl, hctl_event_handler);
 	snd_hctl_set_callback_private(hctl, mixer);
+	snd_hctl_set_event_batch(hctl, mixer->event_batch);
 	slave->hctl = hctl;
 	list_add_tail(&slave->list, &mixer->slaves);
 	return 0;
@@ -853,6 +854,53 @@ int snd_mixer_handle_events(snd_mixer_t *mixer)
 	return mixer->events;
 }
 
+/**
+ * \brief Enable or disable the batched event mode of a mixer
+ * \param mixer Mixer handle
+ * \param enable 0 = disable, 1 = enable
+ * \return 0 on success otherwise a negative error code
+ *
+ * Sets the batched event mode (see #snd_hctl_set_event_batch()) of
+ * the attached HCTLs and of the ones attached later.  The simple
+ * elements then re-read their controls once per
+ * #snd_mixer_handle_events() call instead of once per event.
+ */
+int snd_mixer_set_event_batch(snd_mixer_t *mixer, int enable)
+{
+	struct list_head *pos;
+	int err;
+
+	assert(mixer);
+	mixer->event_batch = !!enable;
+	list_for_each(pos, &mixer->slaves) {
+		snd_mixer_slave_t *s;
+		s = list_entry(pos, snd_mixer_slave_t, list);
+		err = snd_hctl_set_event_batch(s->hctl, enable);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
+/**
+ * \brief Get the number of events merged by the batched event mode
+ * \param mixer Mixer handle
+ * \return the sum of #snd_hctl_get_events_coalesced() of the attached HCTLs
+ */
+unsigned long snd_mixer_get_events_coalesced(snd_mixer_t *mixer)
+{
+	struct list_head *pos;
+	unsigned long count = 0;
+
+	assert(mixer);
+	list_for_each(pos, &mixer->slaves) {
+		snd_mixer_slave_t *s;
+		s = list_entry(pos, snd_mixer_slave_t, list);
+		count += snd_hctl_get_events_coalesced(s->hctl);
+	}
+	return count;
+}
+
 /**
  * \brief Set callback function for a mixer
  * \param obj mixer handle
@@ -71,6 +71,7 @@ struct _snd_mixer {
 	unsigned int count;
 	unsigned int alloc;
 	unsigned int events;
+	int event_batch;		/* batched events of the HCTLs */
 	snd_mixer_callback_t callback;
 	void *callback_private;
 	snd_mixer_compare_t compare;
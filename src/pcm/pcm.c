@@ -515,6 +515,39 @@ LIBASOUND_THREAD_SAFE=0 aplay foo.wav
 \endcode
 for making the debugging easier.
 
+\section pcm_stats Statistics
+
+#snd_pcm_stats_enable() turns on the collection of run-time statistics for
+a PCM handle: the number of wakeups and the time spent blocked in
+#snd_pcm_wait(), the xruns and suspends handled by #snd_pcm_recover(), a
+histogram of the avail value seen after each wakeup, and, for each plugin
+layer below the handle, the time spent in its own processing (not counting
+its slaves) together with the number of frames it committed.  The values
+are read with #snd_pcm_stats() or printed with #snd_pcm_stats_dump().
+
+The counters are updated with atomic operations, so they can be read from
+another thread while the stream runs.  When no PCM has the statistics
+enabled, the transfer path only checks one global flag.
+
+\section pcm_uring Batched transfers
+
+A #snd_pcm_uring_t queues the interleaved read and write transfers of
+many PCM handles and submits them to the kernel in one system call
+through io_uring; the completed transfers are collected later with
+#snd_pcm_uring_reap().  Only hw PCMs with the
+#SND_PCM_ACCESS_RW_INTERLEAVED access go through the ring.  Other handles,
+and all handles when io_uring is not available or disabled by
+the environment variable LIBASOUND_PCM_URING=0, are transferred by
+#snd_pcm_writei() or #snd_pcm_readi() at submission time and reported
+complete right away.
+
+The transfers of the same PCM submitted together are linked in their
+queueing order, so they complete in order; a short transfer cancels the
+rest of the chain with -ECANCELED.  A PCM can't get new transfers queued
+(-EBUSY) until those in the kernel are reaped, since separate chains may
+run concurrently.  The buffers must stay valid until the transfer is
+reaped.
+
 \section pcm_dev_names PCM naming conventions
 
 The ALSA library uses a generic string representation for names of devices.
@@ -692,6 +725,19 @@ static int pcm_state_to_error(snd_pcm_state_t state)
 			  P_STATE(PAUSED) | \
 			  P_STATE(DRAINING))
 
+/* a read or write call, followed by the statistics of the PCM if enabled */
+#define pcm_stats_transfer(pcm, call) ({				\
+	snd_pcm_sframes_t __result;					\
+	if ((pcm)->stats) {						\
+		struct snd_pcm_stats_scope __scope;			\
+		snd_pcm_stats_begin(pcm, &__scope);			\
+		__result = call;					\
+		snd_pcm_stats_end(&__scope);				\
+	} else {							\
+		__result = call;					\
+	}								\
+	__result; })
+
 /* check whether the PCM is in the unexpected state */
 static int bad_pcm_state(snd_pcm_t *pcm, unsigned int supported_states,
 			 unsigned int noop_states)
@@ -952,6 +998,9 @@ int snd_pcm_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
  */
 int snd_pcm_hw_free(snd_pcm_t *pcm)
 {
+#ifdef THREAD_SAFE_API
+	snd_pcm_t *fast;
+#endif
 	int err;
 	if (! pcm->setup)
 		return 0;
@@ -962,6 +1011,15 @@ int snd_pcm_hw_free(snd_pcm_t *pcm)
 	}
 	// assert(snd_pcm_state(pcm) == SND_PCM_STATE_SETUP ||
 	//        snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED);
+	snd_pcm_hw_refine_memo_free(pcm);
+#ifdef THREAD_SAFE_API
+	/* the mode was set on the handle serving the status queries */
+	fast = pcm->fast_op_arg;
+	snd_pcm_lock(fast);
+	__atomic_store_n(&fast->status_snapshot, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&fast->snapshot.seq, 0, __ATOMIC_RELEASE);
+	snd_pcm_unlock(fast);
+#endif
 	if (pcm->ops->hw_free)
 		err = pcm->ops->hw_free(pcm->op_arg);
 	else
@@ -1104,6 +1162,95 @@ int snd_pcm_hwsync(snd_pcm_t *pcm)
 	return err;
 }
 
+#ifndef DOC_HIDDEN
+#ifdef THREAD_SAFE_API
+/* called with the lock held, from snd_pcm_unlock() */
+void snd_pcm_snapshot_publish(snd_pcm_t *pcm)
+{
+	struct snd_pcm_snapshot *snap = &pcm->snapshot;
+	unsigned int seq = snap->seq;
+	snd_pcm_sframes_t avail, delay;
+	snd_htimestamp_t tstamp;
+
+	if (!pcm->setup || !pcm->hw.ptr || !pcm->appl.ptr)
+		return;
+	avail = snd_pcm_mmap_avail(pcm);
+	if (pcm->snapshot_delay_set) {
+		delay = pcm->snapshot_delay;
+		pcm->snapshot_delay_set = 0;
+	} else {
+		delay = snd_pcm_mmap_delay(pcm);
+	}
+	gettimestamp(&tstamp, pcm->tstamp_type);
+
+	__atomic_store_n(&snap->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&snap->avail, avail, __ATOMIC_RELAXED);
+	__atomic_store_n(&snap->delay, delay, __ATOMIC_RELAXED);
+	__atomic_store_n(&snap->tstamp.tv_sec, tstamp.tv_sec, __ATOMIC_RELAXED);
+	__atomic_store_n(&snap->tstamp.tv_nsec, tstamp.tv_nsec, __ATOMIC_RELAXED);
+	__atomic_store_n(&snap->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+#define SNAPSHOT_READ_RETRIES	32
+
+/* read a consistent copy of the snapshot without the lock; give up
+ * when the writer stays in the middle of a publication (it may have
+ * been preempted by the reader) */
+static int snapshot_read(snd_pcm_t *pcm, struct snd_pcm_snapshot *copy)
+{
+	const struct snd_pcm_snapshot *snap = &pcm->snapshot;
+	unsigned int seq, retries;
+
+	for (retries = 0; retries < SNAPSHOT_READ_RETRIES; retries++) {
+		seq = __atomic_load_n(&snap->seq, __ATOMIC_ACQUIRE);
+		if (!seq)
+			return -EAGAIN;
+		if (seq & 1)
+			continue;
+		copy->avail = __atomic_load_n(&snap->avail, __ATOMIC_RELAXED);
+		copy->delay = __atomic_load_n(&snap->delay, __ATOMIC_RELAXED);
+		copy->tstamp.tv_sec = __atomic_load_n(&snap->tstamp.tv_sec, __ATOMIC_RELAXED);
+		copy->tstamp.tv_nsec = __atomic_load_n(&snap->tstamp.tv_nsec, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&snap->seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+	return -EAGAIN;
+}
+#endif /* THREAD_SAFE_API */
+
+/*
+ * Take the lock for a status query.  Returns 0 instead, with the last
+ * published values in copy, when the snapshot mode is enabled and another
+ * thread holds the lock.
+ */
+static int status_lock(snd_pcm_t *pcm, struct snd_pcm_snapshot *copy)
+{
+#ifdef THREAD_SAFE_API
+	if (__atomic_load_n(&pcm->status_snapshot, __ATOMIC_RELAXED)) {
+		if (!pthread_mutex_trylock(&pcm->lock))
+			return 1;
+		if (!snapshot_read(pcm, copy))
+			return 0;
+	}
+#endif
+	snd_pcm_lock(pcm);
+	return 1;
+}
+
+/* keep the delay measured under the lock for the next publication */
+static inline void status_note_delay(snd_pcm_t *pcm, snd_pcm_sframes_t delay)
+{
+#ifdef THREAD_SAFE_API
+	if (pcm->status_snapshot) {
+		pcm->snapshot_delay = delay;
+		pcm->snapshot_delay_set = 1;
+	}
+#endif
+}
+#endif /* DOC_HIDDEN */
+
 /**
  * \brief Obtain delay for a running PCM handle
  * \param pcm PCM handle
@@ -1136,6 +1283,7 @@ int snd_pcm_hwsync(snd_pcm_t *pcm)
  */
 int snd_pcm_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 {
+	struct snd_pcm_snapshot copy;
 	int err;
 
 	assert(pcm);
@@ -1143,8 +1291,13 @@ int snd_pcm_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 		SNDMSG("PCM not set up");
 		return -EIO;
 	}
-	snd_pcm_lock(pcm->fast_op_arg);
+	if (!status_lock(pcm->fast_op_arg, &copy)) {
+		*delayp = copy.delay;
+		return 0;
+	}
 	err = __snd_pcm_delay(pcm, delayp);
+	if (err >= 0)
+		status_note_delay(pcm->fast_op_arg, *delayp);
 	snd_pcm_unlock(pcm->fast_op_arg);
 	return err;
 }
@@ -1194,6 +1347,7 @@ int snd_pcm_resume(snd_pcm_t *pcm)
  */
 int snd_pcm_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail, snd_htimestamp_t *tstamp)
 {
+	struct snd_pcm_snapshot copy;
 	int err;
 
 	assert(pcm);
@@ -1201,7 +1355,11 @@ int snd_pcm_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail, snd_htimestamp_
 		SNDMSG("PCM not set up");
 		return -EIO;
 	}
-	snd_pcm_lock(pcm->fast_op_arg);
+	if (!status_lock(pcm->fast_op_arg, &copy)) {
+		*avail = copy.avail;
+		*tstamp = copy.tstamp;
+		return 0;
+	}
 	if (pcm->fast_ops->htimestamp)
 		err = pcm->fast_ops->htimestamp(pcm->fast_op_arg, avail, tstamp);
 	else
@@ -1568,7 +1726,7 @@ snd_pcm_sframes_t snd_pcm_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_ufr
 	err = bad_pcm_state(pcm, P_STATE_RUNNABLE, 0);
 	if (err < 0)
 		return err;
-	return _snd_pcm_writei(pcm, buffer, size);
+	return pcm_stats_transfer(pcm, _snd_pcm_writei(pcm, buffer, size));
 }
 
 /**
@@ -1607,7 +1765,7 @@ snd_pcm_sframes_t snd_pcm_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t
 	err = bad_pcm_state(pcm, P_STATE_RUNNABLE, 0);
 	if (err < 0)
 		return err;
-	return _snd_pcm_writen(pcm, bufs, size);
+	return pcm_stats_transfer(pcm, _snd_pcm_writen(pcm, bufs, size));
 }
 
 /**
@@ -1646,7 +1804,7 @@ snd_pcm_sframes_t snd_pcm_readi(snd_pcm_t *pcm, void *buffer, snd_pcm_uframes_t
 	err = bad_pcm_state(pcm, P_STATE_RUNNABLE, 0);
 	if (err < 0)
 		return err;
-	return _snd_pcm_readi(pcm, buffer, size);
+	return pcm_stats_transfer(pcm, _snd_pcm_readi(pcm, buffer, size));
 }
 
 /**
@@ -1685,7 +1843,7 @@ snd_pcm_sframes_t snd_pcm_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t s
 	err = bad_pcm_state(pcm, P_STATE_RUNNABLE, 0);
 	if (err < 0)
 		return err;
-	return _snd_pcm_readn(pcm, bufs, size);
+	return pcm_stats_transfer(pcm, _snd_pcm_readn(pcm, bufs, size));
 }
 
 /**
@@ -1841,10 +1999,47 @@ int snd_pcm_poll_descriptors_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsign
 	assert(pcm && pfds && revents);
 	snd_pcm_lock(pcm->fast_op_arg);
 	err = __snd_pcm_poll_revents(pcm, pfds, nfds, revents);
+	if (pcm->stats && err >= 0 && (*revents & (POLLIN | POLLOUT)))
+		snd_pcm_stats_wakeup(pcm->stats, 0, 1);
 	snd_pcm_unlock(pcm->fast_op_arg);
 	return err;
 }
 
+static int pcm_wait_revents(void *handle, struct pollfd *pfds,
+			    unsigned int nfds, unsigned short *revents)
+{
+	return snd_pcm_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+/**
+ * \brief Add a PCM handle to a wait set
+ * \param ws Wait set
+ * \param pcm PCM handle
+ * \param private_data Value returned with the events of the handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The handle is reported by #snd_wait_set_wait() when
+ * #snd_pcm_poll_descriptors_revents() returns events for it.
+ */
+int snd_wait_set_add_pcm(snd_wait_set_t *ws, snd_pcm_t *pcm, void *private_data)
+{
+	struct pollfd *pfds;
+	int count, err;
+
+	assert(ws && pcm);
+	count = snd_pcm_poll_descriptors_count(pcm);
+	if (count <= 0)
+		return count < 0 ? count : -EINVAL;
+	pfds = alloca(count * sizeof(*pfds));
+	err = snd_pcm_poll_descriptors(pcm, pfds, count);
+	if (err < 0)
+		return err;
+	if (err == 0)
+		return -EINVAL;
+	return _snd_wait_set_add(ws, pcm, pfds, err, pcm_wait_revents,
+				 private_data);
+}
+
 static int __snd_pcm_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds,
 				  unsigned int nfds, unsigned short *revents)
 {
@@ -2050,11 +2245,13 @@ static const char *const snd_pcm_type_names[] = {
 	PCMTYPE(DMIX), 
 	PCMTYPE(JACK),
 	PCMTYPE(DSNOOP),
+	PCMTYPE(DSHARE),
 	PCMTYPE(IEC958),
 	PCMTYPE(SOFTVOL),
 	PCMTYPE(IOPLUG),
 	PCMTYPE(EXTPLUG),
 	PCMTYPE(MMAP_EMUL),
+	PCMTYPE(VIRT),
 };
 
 static const char *const snd_pcm_subformat_names[] = {
@@ -2498,9 +2695,257 @@ static const char *const build_in_pcms[] = {
 	"adpcm", "alaw", "copy", "dmix", "file", "hooks", "hw", "ladspa", "lfloat",
 	"linear", "meter", "mulaw", "multi", "null", "empty", "plug", "rate", "route", "share",
 	"shm", "dsnoop", "dshare", "asym", "iec958", "softvol", "mmap_emul",
+	"virt",
 	NULL
 };
 
+/*
+ * Open plan cache
+ *
+ * snd_pcm_open() resolves definitions in the global configuration: the
+ * PCM named by the caller, its slaves which are given by name, and the
+ * pcm_type entries.  Each of them is kept here in its expanded form, so
+ * opening the same name again only copies the cached subtree instead of
+ * searching the aliases, expanding the arguments and evaluating the
+ * functions again.
+ *
+ * A definition is cached only when everything it was expanded from can
+ * be checked cheaply (see _snd_config_search_definition_deps()).  The
+ * environment variables and files it depends on are checked on each
+ * hit.  The cache belongs to one global configuration tree, which it
+ * references, and is dropped when snd_config_update() replaces the tree.
+ */
+#define PCM_PLAN_HASH		64
+#define PCM_PLAN_MAX		256
+
+struct pcm_plan {
+	struct pcm_plan *next;
+	const char *base;		/* "pcm" or "pcm_type" */
+	char *name;
+	snd_config_t *conf;
+	struct config_cache_rec *deps;
+};
+
+static struct {
+	snd_config_t *root;
+	struct pcm_plan *hash[PCM_PLAN_HASH];
+	snd_pcm_open_cache_stats_t stats;
+} pcm_plans;
+
+#ifdef THREAD_SAFE_API
+static pthread_mutex_t pcm_plans_mutex = PTHREAD_MUTEX_INITIALIZER;
+static inline void pcm_plans_lock(void)
+{
+	pthread_mutex_lock(&pcm_plans_mutex);
+}
+static inline void pcm_plans_unlock(void)
+{
+	pthread_mutex_unlock(&pcm_plans_mutex);
+}
+#else
+static inline void pcm_plans_lock(void) {}
+static inline void pcm_plans_unlock(void) {}
+#endif
+
+static int pcm_plans_enabled(void)
+{
+	static int enabled = -1;
+
+	/* evaluate env var only once for consistency */
+	if (enabled < 0) {
+		const char *p = getenv("LIBASOUND_PCM_OPEN_CACHE");
+		enabled = !p || *p != '0';
+	}
+	return enabled;
+}
+
+static unsigned long long pcm_plan_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct pcm_plan **pcm_plan_slot(const char *base, const char *name)
+{
+	unsigned int h = 2166136261U;
+
+	while (*name)
+		h = (h ^ (unsigned char)*name++) * 16777619U;
+	h ^= base[3];	/* "pcm" or "pcm_type" */
+	return &pcm_plans.hash[h % PCM_PLAN_HASH];
+}
+
+static void pcm_plan_free(struct pcm_plan *plan)
+{
+	if (plan->conf)
+		snd_config_delete(plan->conf);
+	_snd_config_deps_free(plan->deps);
+	free(plan->name);
+	free(plan);
+}
+
+/* called with the lock held, returns the old root to unreference */
+static snd_config_t *pcm_plans_drop(void)
+{
+	snd_config_t *root = pcm_plans.root;
+	struct pcm_plan *plan;
+	unsigned int k;
+
+	for (k = 0; k < PCM_PLAN_HASH; k++) {
+		while ((plan = pcm_plans.hash[k]) != NULL) {
+			pcm_plans.hash[k] = plan->next;
+			pcm_plan_free(plan);
+		}
+	}
+	pcm_plans.stats.entries = 0;
+	pcm_plans.root = NULL;
+	return root;
+}
+
+/* the global configuration tree used by snd_pcm_open() */
+static void pcm_plans_attach(snd_config_t *root)
+{
+	snd_config_t *old = NULL;
+
+	if (!pcm_plans_enabled())
+		return;
+	pcm_plans_lock();
+	if (pcm_plans.root != root) {
+		old = pcm_plans_drop();
+		snd_config_ref(root);
+		pcm_plans.root = root;
+	}
+	pcm_plans_unlock();
+	if (old)
+		snd_config_unref(old);
+}
+
+/* snd_config_search_definition() through the open plan cache */
+static int pcm_plan_search(snd_config_t *root, const char *base,
+			   const char *name, snd_config_t **result)
+{
+	struct pcm_plan **slot, **pp, *plan;
+	struct config_cache_rec *deps;
+	unsigned long long t;
+	int err;
+
+	if (root != pcm_plans.root || !root)
+		return snd_config_search_definition(root, base, name, result);
+	t = pcm_plan_time();
+	slot = pcm_plan_slot(base, name);
+	pcm_plans_lock();
+	if (root != pcm_plans.root) {
+		pcm_plans_unlock();
+		return snd_config_search_definition(root, base, name, result);
+	}
+	for (pp = slot; (plan = *pp) != NULL; pp = &plan->next) {
+		if (strcmp(plan->base, base) || strcmp(plan->name, name))
+			continue;
+		if (!_snd_config_deps_valid(plan->deps)) {
+			*pp = plan->next;
+			pcm_plan_free(plan);
+			pcm_plans.stats.entries--;
+			break;
+		}
+		err = snd_config_copy(result, plan->conf);
+		if (err >= 0) {
+			pcm_plans.stats.hits++;
+			pcm_plans.stats.hit_ns += pcm_plan_time() - t;
+		}
+		pcm_plans_unlock();
+		return err;
+	}
+	pcm_plans_unlock();
+
+	err = _snd_config_search_definition_deps(root, base, name, result, &deps);
+	if (err < 0)
+		return err;
+	plan = NULL;
+	if (deps) {
+		plan = calloc(1, sizeof(*plan));
+		if (plan) {
+			plan->base = base;
+			plan->deps = deps;
+			plan->name = strdup(name);
+			if (!plan->name ||
+			    snd_config_copy(&plan->conf, *result) < 0) {
+				pcm_plan_free(plan);
+				plan = NULL;
+			}
+		} else {
+			_snd_config_deps_free(deps);
+		}
+	}
+	pcm_plans_lock();
+	pcm_plans.stats.misses++;
+	pcm_plans.stats.miss_ns += pcm_plan_time() - t;
+	if (!plan) {
+		pcm_plans.stats.uncacheable++;
+	} else if (root == pcm_plans.root &&
+		   pcm_plans.stats.entries < PCM_PLAN_MAX) {
+		/* another thread may have cached it meanwhile */
+		for (pp = slot; *pp; pp = &(*pp)->next) {
+			if (!strcmp((*pp)->base, base) &&
+			    !strcmp((*pp)->name, name))
+				break;
+		}
+		if (!*pp) {
+			plan->next = *slot;
+			*slot = plan;
+			pcm_plans.stats.entries++;
+			plan = NULL;
+		}
+	}
+	pcm_plans_unlock();
+	if (plan)
+		pcm_plan_free(plan);
+	return err;
+}
+
+/**
+ * \brief Get the counters of the PCM open plan cache
+ * \param stats Returned counters
+ * \return 0 on success otherwise a negative error code
+ *
+ * #snd_pcm_open keeps the definitions it resolves in the global
+ * configuration (the PCM, its slaves given by name and the plugin
+ * types) in an expanded form, so that opening the same PCM again does
+ * not evaluate the configuration again.  Definitions which depend on
+ * anything but the configuration files, the environment variables and
+ * the list of sound cards are not cached.  The cache is dropped when
+ * #snd_config_update rereads the configuration.
+ *
+ * Setting the environment variable \c LIBASOUND_PCM_OPEN_CACHE to 0
+ * disables the cache.
+ */
+int snd_pcm_open_cache_stats(snd_pcm_open_cache_stats_t *stats)
+{
+	assert(stats);
+	pcm_plans_lock();
+	*stats = pcm_plans.stats;
+	pcm_plans_unlock();
+	return 0;
+}
+
+/**
+ * \brief Drop all definitions kept by the PCM open plan cache
+ *
+ * Applications which modify the global configuration tree #snd_config
+ * directly must call this function before opening PCMs again.
+ */
+void snd_pcm_open_cache_flush(void)
+{
+	snd_config_t *old;
+
+	pcm_plans_lock();
+	old = pcm_plans_drop();
+	pcm_plans_unlock();
+	if (old)
+		snd_config_unref(old);
+}
+
 static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 			     snd_config_t *pcm_root, snd_config_t *pcm_conf,
 			     snd_pcm_stream_t stream, int mode)
@@ -2543,7 +2988,7 @@ static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 		SNDERR("Invalid type for %s", id);
 		return err;
 	}
-	err = snd_config_search_definition(pcm_root, "pcm_type", str, &type_conf);
+	err = pcm_plan_search(pcm_root, "pcm_type", str, &type_conf);
 	if (err >= 0) {
 		if (snd_config_get_type(type_conf) != SND_CONFIG_TYPE_COMPOUND) {
 			SNDERR("Invalid type for PCM type %s definition", str);
@@ -2659,7 +3104,7 @@ static int snd_pcm_open_noupdate(snd_pcm_t **pcmp, snd_config_t *root,
 	snd_config_t *pcm_conf;
 	const char *str;
 
-	err = snd_config_search_definition(root, "pcm", name, &pcm_conf);
+	err = pcm_plan_search(root, "pcm", name, &pcm_conf);
 	if (err < 0) {
 		SNDERR("Unknown PCM %s", name);
 		return err;
@@ -2698,6 +3143,7 @@ int snd_pcm_open(snd_pcm_t **pcmp, const char *name,
 		err = snd_config_update_ref(&top);
 		if (err < 0)
 			return err;
+		pcm_plans_attach(top);
 	}
 	err = snd_pcm_open_noupdate(pcmp, top, name, stream, mode, 0);
 	snd_config_unref(top);
@@ -2804,6 +3250,8 @@ int snd_pcm_free(snd_pcm_t *pcm)
 	free(pcm->hw.link_dst);
 	free(pcm->appl.link_dst);
 	snd_dlobj_cache_put(pcm->open_func);
+	snd_pcm_stats_release(pcm);
+	snd_pcm_hw_refine_memo_free(pcm);
 #ifdef THREAD_SAFE_API
 	pthread_mutex_destroy(&pcm->lock);
 #endif
@@ -2878,6 +3326,8 @@ int snd_pcm_wait_nocheck(snd_pcm_t *pcm, int timeout)
 {
 	struct pollfd *pfd;
 	unsigned short revents = 0;
+	snd_pcm_stats_t *stats = NULL;
+	unsigned long long t = 0;
 	int npfds, err, err_poll;
 	
 	npfds = __snd_pcm_poll_descriptors_count(pcm);
@@ -2893,6 +3343,11 @@ int snd_pcm_wait_nocheck(snd_pcm_t *pcm, int timeout)
 		SNDMSG("invalid poll descriptors %d\n", err);
 		return -EIO;
 	}
+	if (snd_pcm_stats_active()) {
+		stats = snd_pcm_stats_current(pcm);
+		if (stats)
+			t = snd_pcm_stats_time();
+	}
 	do {
 		__snd_pcm_unlock(pcm->fast_op_arg);
 		err_poll = poll(pfd, npfds, timeout);
@@ -2924,6 +3379,8 @@ int snd_pcm_wait_nocheck(snd_pcm_t *pcm, int timeout)
 		}
 	}
 #endif
+	if (stats)
+		snd_pcm_stats_wakeup(stats, snd_pcm_stats_time() - t, err_poll > 0);
 	return err_poll > 0 ? 1 : 0;
 }
 #endif
@@ -2977,6 +3434,7 @@ snd_pcm_sframes_t snd_pcm_avail_update(snd_pcm_t *pcm)
  */
 snd_pcm_sframes_t snd_pcm_avail(snd_pcm_t *pcm)
 {
+	struct snd_pcm_snapshot copy;
 	int err;
 	snd_pcm_sframes_t result;
 
@@ -2985,7 +3443,8 @@ snd_pcm_sframes_t snd_pcm_avail(snd_pcm_t *pcm)
 		SNDMSG("PCM not set up");
 		return -EIO;
 	}
-	snd_pcm_lock(pcm->fast_op_arg);
+	if (!status_lock(pcm->fast_op_arg, &copy))
+		return copy.avail;
 	err = __snd_pcm_hwsync(pcm);
 	if (err < 0)
 		result = err;
@@ -3010,6 +3469,7 @@ int snd_pcm_avail_delay(snd_pcm_t *pcm,
 			snd_pcm_sframes_t *availp,
 			snd_pcm_sframes_t *delayp)
 {
+	struct snd_pcm_snapshot copy;
 	snd_pcm_sframes_t sf;
 	int err;
 
@@ -3018,7 +3478,11 @@ int snd_pcm_avail_delay(snd_pcm_t *pcm,
 		SNDMSG("PCM not set up");
 		return -EIO;
 	}
-	snd_pcm_lock(pcm->fast_op_arg);
+	if (!status_lock(pcm->fast_op_arg, &copy)) {
+		*availp = copy.avail;
+		*delayp = copy.delay;
+		return 0;
+	}
 	err = __snd_pcm_hwsync(pcm);
 	if (err < 0)
 		goto unlock;
@@ -3030,6 +3494,7 @@ int snd_pcm_avail_delay(snd_pcm_t *pcm,
 	err = __snd_pcm_delay(pcm, delayp);
 	if (err < 0)
 		goto unlock;
+	status_note_delay(pcm->fast_op_arg, *delayp);
 	*availp = sf;
 	err = 0;
  unlock:
@@ -3037,6 +3502,48 @@ int snd_pcm_avail_delay(snd_pcm_t *pcm,
 	return err;
 }
 
+/**
+ * \brief Let status queries use the last published status instead of waiting
+ * \param pcm PCM handle
+ * \param enable 0 = disable, 1 = enable the snapshot mode
+ * \return 0 on success otherwise a negative error code
+ *
+ * In the snapshot mode, #snd_pcm_avail(), #snd_pcm_delay(),
+ * #snd_pcm_avail_delay() and #snd_pcm_htimestamp() never wait for the PCM
+ * lock.  When another thread holds it (typically the thread transferring
+ * the samples), they return the values published when the lock was last
+ * released, under a sequence counter, instead of syncing with the
+ * hardware.  The timestamp returned by #snd_pcm_htimestamp() is the time
+ * of the publication.  When the lock is free, the queries behave as usual.
+ *
+ * The published avail and delay are the ring buffer positions after the
+ * last locked operation; the delay is the one measured by the last
+ * #snd_pcm_delay() call if any was made meanwhile.  Errors like an xrun
+ * are not reported from the snapshot.
+ *
+ * The PCM must be set up; the mode is reset by #snd_pcm_hw_free().  It
+ * has no effect on PCMs which don't need the lock (e.g. hw) or when
+ * the locking is disabled via $LIBASOUND_THREAD_SAFE.
+ */
+int snd_pcm_set_status_snapshot(snd_pcm_t *pcm, int enable)
+{
+	assert(pcm);
+	if (CHECK_SANITY(! pcm->setup)) {
+		SNDMSG("PCM not set up");
+		return -EIO;
+	}
+#ifdef THREAD_SAFE_API
+	pcm = pcm->fast_op_arg;
+	if (!pcm->lock_enabled || !pcm->need_lock)
+		return 0;
+	snd_pcm_lock(pcm);
+	pcm->snapshot_delay_set = 0;
+	__atomic_store_n(&pcm->status_snapshot, !!enable, __ATOMIC_RELAXED);
+	snd_pcm_unlock(pcm);	/* publishes the first snapshot */
+#endif
+	return 0;
+}
+
 /**
  * \brief Silence an area
  * \param dst_area area specification
@@ -3068,8 +3575,13 @@ int snd_pcm_area_silence(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes
 		unsigned int dwords = samples * width / 64;
 		uint64_t *dstp = (uint64_t *)dst;
 		samples -= dwords * 64 / width;
-		while (dwords-- > 0)
-			*dstp++ = silence;
+		if (silence == 0) {
+			memset(dstp, 0, dwords * 8);
+			dstp += dwords;
+		} else {
+			while (dwords-- > 0)
+				*dstp++ = silence;
+		}
 		if (samples == 0)
 			return 0;
 		dst = (char *)dstp;
@@ -3164,6 +3676,8 @@ int snd_pcm_areas_silence(const snd_pcm_channel_area_t *dst_areas, snd_pcm_ufram
 			  unsigned int channels, snd_pcm_uframes_t frames, snd_pcm_format_t format)
 {
 	int width = snd_pcm_format_physical_width(format);
+	if (snd_pcm_areas_silence_fast(dst_areas, dst_offset, channels, frames, format))
+		return 0;
 	while (channels > 0) {
 		void *addr = dst_areas->addr;
 		unsigned int step = dst_areas->step;
@@ -3347,6 +3861,9 @@ int snd_pcm_areas_copy(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_
 		SNDMSG("invalid frames %ld", frames);
 		return -EINVAL;
 	}
+	if (snd_pcm_areas_copy_fast(dst_areas, dst_offset, src_areas, src_offset,
+				    channels, frames, format))
+		return 0;
 	while (channels > 0) {
 		unsigned int step = src_areas->step;
 		void *src_addr = src_areas->addr;
@@ -7362,10 +7879,11 @@ snd_pcm_sframes_t __snd_pcm_mmap_commit(snd_pcm_t *pcm,
 		       snd_pcm_mmap_avail(pcm));
 		return -EPIPE;
 	}
-	if (pcm->fast_ops->mmap_commit)
-		return pcm->fast_ops->mmap_commit(pcm->fast_op_arg, offset, frames);
-	else
+	if (!pcm->fast_ops->mmap_commit)
 		return -ENOSYS;
+	if (snd_pcm_stats_active())
+		return snd_pcm_stats_mmap_commit(pcm, offset, frames);
+	return pcm->fast_ops->mmap_commit(pcm->fast_op_arg, offset, frames);
 }
 
 int _snd_pcm_poll_descriptor(snd_pcm_t *pcm)
@@ -8558,6 +9076,8 @@ int snd_pcm_recover(snd_pcm_t *pcm, int err, int silent)
                 err = -err;
         if (err == -EINTR)	/* nothing to do, continue */
                 return 0;
+	if (pcm->stats)
+		snd_pcm_stats_recover(pcm, err);
         if (err == -EPIPE) {
                 const char *s;
                 if (snd_pcm_stream(pcm) == SND_PCM_STREAM_PLAYBACK)
@@ -0,0 +1,313 @@
+/*
+ *  PCM Interface - channel area copy and silence kernels
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Fast paths for snd_pcm_areas_copy() and snd_pcm_areas_silence():
+ *
+ *  - interleaved <-> non-interleaved transposition of 2, 4, 6 and 8
+ *    channels with 16 or 32-bit samples,
+ *  - copy and silence of a group of adjacent channels inside a larger
+ *    frame (e.g. 2 channels out of an interleaved 8 channel buffer),
+ *    one block per frame instead of one sample per channel.
+ *
+ * The transposition kernels are plain loops written so that the compiler
+ * vectorizes them (one load or store stream per channel, a fixed number
+ * of channels per frame).  On x86 they are built a second time for AVX2;
+ * the variant is chosen by snd_pcm_areas_select() from hw_params.
+ */
+
+#include "config.h"
+#include <string.h>
+#include "pcm_local.h"
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define AREAS_SIMD_X86
+#endif
+
+typedef void (*areas_interleave_f)(char *dst, char *const *src,
+				   snd_pcm_uframes_t frames);
+typedef void (*areas_deinterleave_f)(char *const *dst, const char *src,
+				     snd_pcm_uframes_t frames);
+
+/* indexed by [16/32-bit][2/4/6/8 channels] */
+struct areas_kernels {
+	areas_interleave_f interleave[2][4];
+	areas_deinterleave_f deinterleave[2][4];
+};
+
+#define AREAS_CH2(X, t)		X(t, 0) X(t, 1)
+#define AREAS_CH4(X, t)		AREAS_CH2(X, t) X(t, 2) X(t, 3)
+#define AREAS_CH6(X, t)		AREAS_CH4(X, t) X(t, 4) X(t, 5)
+#define AREAS_CH8(X, t)		AREAS_CH6(X, t) X(t, 6) X(t, 7)
+
+#define AREAS_SRC_DECL(t, c)	const t *restrict s##c = (const t *)src[c];
+#define AREAS_SRC_GET(t, c)	d[c] = s##c[i];
+#define AREAS_DST_DECL(t, c)	t *restrict d##c = (t *)dst[c];
+#define AREAS_DST_PUT(t, c)	d##c[i] = s[c];
+
+#define AREAS_KERNELS(isa, attr, t, bits, n)				\
+static attr void isa##_interleave_##bits##_##n(char *dst,		\
+					       char *const *src,	\
+					       snd_pcm_uframes_t frames) \
+{									\
+	t *restrict d = (t *)dst;					\
+	snd_pcm_uframes_t i;						\
+	AREAS_CH##n(AREAS_SRC_DECL, t)					\
+	for (i = 0; i < frames; i++) {					\
+		AREAS_CH##n(AREAS_SRC_GET, t)				\
+		d += n;							\
+	}								\
+}									\
+static attr void isa##_deinterleave_##bits##_##n(char *const *dst,	\
+						 const char *src,	\
+						 snd_pcm_uframes_t frames) \
+{									\
+	const t *restrict s = (const t *)src;				\
+	snd_pcm_uframes_t i;						\
+	AREAS_CH##n(AREAS_DST_DECL, t)					\
+	for (i = 0; i < frames; i++) {					\
+		AREAS_CH##n(AREAS_DST_PUT, t)				\
+		s += n;							\
+	}								\
+}
+
+#define AREAS_KERNEL_SET(isa, attr)					\
+AREAS_KERNELS(isa, attr, uint16_t, 16, 2)				\
+AREAS_KERNELS(isa, attr, uint16_t, 16, 4)				\
+AREAS_KERNELS(isa, attr, uint16_t, 16, 6)				\
+AREAS_KERNELS(isa, attr, uint16_t, 16, 8)				\
+AREAS_KERNELS(isa, attr, uint32_t, 32, 2)				\
+AREAS_KERNELS(isa, attr, uint32_t, 32, 4)				\
+AREAS_KERNELS(isa, attr, uint32_t, 32, 6)				\
+AREAS_KERNELS(isa, attr, uint32_t, 32, 8)				\
+static const struct areas_kernels isa##_kernels = {			\
+	.interleave = {							\
+		{ isa##_interleave_16_2, isa##_interleave_16_4,		\
+		  isa##_interleave_16_6, isa##_interleave_16_8 },	\
+		{ isa##_interleave_32_2, isa##_interleave_32_4,		\
+		  isa##_interleave_32_6, isa##_interleave_32_8 },	\
+	},								\
+	.deinterleave = {						\
+		{ isa##_deinterleave_16_2, isa##_deinterleave_16_4,	\
+		  isa##_deinterleave_16_6, isa##_deinterleave_16_8 },	\
+		{ isa##_deinterleave_32_2, isa##_deinterleave_32_4,	\
+		  isa##_deinterleave_32_6, isa##_deinterleave_32_8 },	\
+	},								\
+};
+
+AREAS_KERNEL_SET(generic, SND_PCM_VECTORIZE)
+#ifdef AREAS_SIMD_X86
+AREAS_KERNEL_SET(avx2, SND_PCM_VECTORIZE __attribute__((target("avx2"))))
+#endif
+
+static const struct areas_kernels *areas_kernels = &generic_kernels;
+
+/* pick the kernel variant for this CPU, called from hw_params */
+void snd_pcm_areas_select(void)
+{
+#ifdef AREAS_SIMD_X86
+	if (__builtin_cpu_supports("avx2"))
+		areas_kernels = &avx2_kernels;
+#endif
+}
+
+/* copy one block of bytes per frame, with constant sizes for the common cases */
+#define AREAS_COPY_FRAMES(bytes)			\
+	while (frames-- > 0) {				\
+		memcpy(dst, src, bytes);		\
+		dst += dst_step;			\
+		src += src_step;			\
+	}						\
+	break
+
+static void areas_copy_frames(char *dst, unsigned int dst_step,
+			      const char *src, unsigned int src_step,
+			      unsigned int bytes, snd_pcm_uframes_t frames)
+{
+	switch (bytes) {
+	case 4:
+		AREAS_COPY_FRAMES(4);
+	case 6:
+		AREAS_COPY_FRAMES(6);
+	case 8:
+		AREAS_COPY_FRAMES(8);
+	case 12:
+		AREAS_COPY_FRAMES(12);
+	case 16:
+		AREAS_COPY_FRAMES(16);
+	case 24:
+		AREAS_COPY_FRAMES(24);
+	case 32:
+		AREAS_COPY_FRAMES(32);
+	default:
+		AREAS_COPY_FRAMES(bytes);
+	}
+}
+
+/*
+ * every sample of the area is naturally aligned, so the kernels may
+ * access 16, 32 and 64-bit samples through typed pointers on
+ * strict-alignment architectures; other widths need byte alignment
+ */
+int snd_pcm_area_aligned(const snd_pcm_channel_area_t *area,
+			 unsigned int width)
+{
+	unsigned int align = 8;
+
+	if (width == 16 || width == 32 || width == 64)
+		align = width;
+	return area->addr && (uintptr_t)area->addr % (align / 8) == 0 &&
+	       area->first % align == 0 && area->step % align == 0;
+}
+
+/* all channels in one buffer, adjacent inside each frame */
+int snd_pcm_areas_packed(const snd_pcm_channel_area_t *areas,
+			 unsigned int channels, unsigned int width)
+{
+	unsigned int c;
+
+	if (!snd_pcm_area_aligned(&areas[0], width) ||
+	    areas[0].step < channels * width)
+		return 0;
+	for (c = 1; c < channels; c++) {
+		if (areas[c].addr != areas[0].addr ||
+		    areas[c].step != areas[0].step ||
+		    areas[c].first != areas[0].first + c * width)
+			return 0;
+	}
+	return 1;
+}
+
+/* each channel in its own contiguous run of samples */
+static int areas_planar(const snd_pcm_channel_area_t *areas,
+			unsigned int channels, unsigned int width)
+{
+	unsigned int c;
+
+	for (c = 0; c < channels; c++) {
+		if (areas[c].step != width ||
+		    !snd_pcm_area_aligned(&areas[c], width))
+			return 0;
+	}
+	return 1;
+}
+
+static int areas_kernel_index(unsigned int channels, unsigned int width)
+{
+	if (width != 16 && width != 32)
+		return -1;
+	switch (channels) {
+	case 2:
+		return 0;
+	case 4:
+		return 1;
+	case 6:
+		return 2;
+	case 8:
+		return 3;
+	default:
+		return -1;
+	}
+}
+
+/*
+ * Try the fast paths of snd_pcm_areas_copy(); returns 1 when the copy
+ * was done, 0 when the generic code has to handle it.
+ */
+int snd_pcm_areas_copy_fast(const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_offset,
+			    unsigned int channels, snd_pcm_uframes_t frames,
+			    snd_pcm_format_t format)
+{
+	int width = snd_pcm_format_physical_width(format);
+	int idx = areas_kernel_index(channels, width);
+	char *ptrs[8];
+	unsigned int c;
+
+	if (channels < 2 || width < 8 || width % 8)
+		return 0;
+
+	if (idx >= 0 &&
+	    snd_pcm_areas_packed(src_areas, channels, width) &&
+	    src_areas[0].step == channels * width &&
+	    areas_planar(dst_areas, channels, width)) {
+		for (c = 0; c < channels; c++)
+			ptrs[c] = snd_pcm_channel_area_addr(&dst_areas[c], dst_offset);
+		areas_kernels->deinterleave[width / 32][idx](ptrs,
+			snd_pcm_channel_area_addr(src_areas, src_offset), frames);
+		return 1;
+	}
+	if (idx >= 0 &&
+	    areas_planar(src_areas, channels, width) &&
+	    snd_pcm_areas_packed(dst_areas, channels, width) &&
+	    dst_areas[0].step == channels * width) {
+		for (c = 0; c < channels; c++)
+			ptrs[c] = snd_pcm_channel_area_addr(&src_areas[c], src_offset);
+		areas_kernels->interleave[width / 32][idx](
+			snd_pcm_channel_area_addr(dst_areas, dst_offset), ptrs, frames);
+		return 1;
+	}
+
+	/* a group of channels between frames of different sizes; the
+	 * fully contiguous case is a plain memcpy in the generic code
+	 */
+	if (snd_pcm_areas_packed(src_areas, channels, width) &&
+	    snd_pcm_areas_packed(dst_areas, channels, width) &&
+	    src_areas[0].addr != dst_areas[0].addr &&
+	    (src_areas[0].step != channels * width ||
+	     dst_areas[0].step != channels * width)) {
+		areas_copy_frames(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+				  dst_areas[0].step / 8,
+				  snd_pcm_channel_area_addr(src_areas, src_offset),
+				  src_areas[0].step / 8,
+				  channels * width / 8, frames);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Try the fast paths of snd_pcm_areas_silence(); returns 1 when the
+ * areas were silenced, 0 when the generic code has to handle it.
+ */
+int snd_pcm_areas_silence_fast(const snd_pcm_channel_area_t *dst_areas,
+			       snd_pcm_uframes_t dst_offset,
+			       unsigned int channels, snd_pcm_uframes_t frames,
+			       snd_pcm_format_t format)
+{
+	int width = snd_pcm_format_physical_width(format);
+	unsigned char pattern[64];
+	unsigned int bytes;
+
+	if (channels < 2 || width < 8 || width % 8)
+		return 0;
+	bytes = channels * width / 8;
+	if (bytes > sizeof(pattern) ||
+	    !snd_pcm_areas_packed(dst_areas, channels, width) ||
+	    dst_areas[0].step == channels * width)
+		return 0;
+	snd_pcm_format_set_silence(format, pattern, channels);
+	areas_copy_frames(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+			  dst_areas[0].step / 8, (const char *)pattern, 0,
+			  bytes, frames);
+	return 1;
+}
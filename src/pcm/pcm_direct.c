@@ -40,17 +40,6 @@
 #include <sys/mman.h>
 #include "pcm_direct.h"
 
-/*
- *
- */
- 
-union semun {
-	int              val;    /* Value for SETVAL */
-	struct semid_ds *buf;    /* Buffer for IPC_STAT, IPC_SET */
-	unsigned short  *array;  /* Array for GETALL, SETALL */
-	struct seminfo  *__buf;  /* Buffer for IPC_INFO (Linux specific) */
-};
- 
 /*
  * FIXME:
  *  add possibility to use futexes here
@@ -1398,7 +1387,7 @@ int snd_pcm_direct_initialize_slave(snd_pcm_direct_t *dmix, snd_pcm_t *spcm, str
 
 	spcm->donot_close = 1;
 
-	{
+	if (snd_pcm_type(spcm) == SND_PCM_TYPE_HW) {
 		int ver = 0;
 		ioctl(spcm->poll_fd, SNDRV_PCM_IOCTL_PVERSION, &ver);
 		if (ver < SNDRV_PROTOCOL_VERSION(2, 0, 8))
@@ -1423,6 +1412,25 @@ int snd_pcm_direct_initialize_poll_fd(snd_pcm_direct_t *dmix)
 	dmix->tread = 1;
 	dmix->timer_need_poll = 0;
 	dmix->timer_ticks = 1;
+#ifdef BUILD_PCM_PLUGIN_VIRT
+	if (snd_pcm_type(dmix->spcm) == SND_PCM_TYPE_VIRT) {
+		/* the period timer of the virtual card has no old versions */
+		ret = snd_pcm_virt_timer_open(&dmix->timer, dmix->spcm,
+					      SND_TIMER_OPEN_NONBLOCK |
+					      SND_TIMER_OPEN_TREAD);
+		if (ret < 0) {
+			SNDERR("unable to open the timer of the virtual card");
+			return ret;
+		}
+		snd_timer_poll_descriptors(dmix->timer, &dmix->timer_fd, 1);
+		dmix->poll_fd = dmix->timer_fd.fd;
+		dmix->timer_events = (1<<SND_TIMER_EVENT_MSUSPEND) |
+				     (1<<SND_TIMER_EVENT_MRESUME) |
+				     (1<<SND_TIMER_EVENT_MSTOP) |
+				     (1<<SND_TIMER_EVENT_STOP);
+		return 0;
+	}
+#endif
 	ret = snd_pcm_info(dmix->spcm, &info);
 	if (ret < 0) {
 		SNDERR("unable to info for slave pcm");
@@ -1821,6 +1829,11 @@ static int _snd_pcm_direct_get_slave_ipc_offset(snd_config_t *root,
 				SNDERR("Invalid value for PCM type definition\n");
 				return -EINVAL;
 			}
+#ifdef BUILD_PCM_PLUGIN_VIRT
+			/* a virtual card has no card and device fields */
+			if (strcmp(str, "virt") == 0)
+				continue;
+#endif
 			if (strcmp(str, "hw")) {
 				SNDERR("Invalid type '%s' for slave PCM\n", str);
 				return -EINVAL;
@@ -1888,6 +1901,7 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 #endif
 	rec->hw_ptr_alignment = SND_PCM_HW_PTR_ALIGNMENT_AUTO;
 	rec->tstamp_type = -1;
+	rec->mix_slots = 0;
 
 	/* read defaults */
 	if (snd_config_search(root, "defaults.pcm.dmix_max_periods", &n) >= 0) {
@@ -2051,6 +2065,18 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 			rec->direct_memory_access = err;
 			continue;
 		}
+		if (strcmp(id, "mix_slots") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 0 || val > 256) {
+				SNDERR("Invalid mix_slots value %ld", val);
+				return -EINVAL;
+			}
+			rec->mix_slots = val;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
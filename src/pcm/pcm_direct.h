@@ -29,6 +29,12 @@
 /* slave_period time for low latency requirements in ms */
 #define LOW_LATENCY_PERIOD_TIME 10
 
+union semun {
+	int              val;    /* Value for SETVAL */
+	struct semid_ds *buf;    /* Buffer for IPC_STAT, IPC_SET */
+	unsigned short  *array;  /* Array for GETALL, SETALL */
+	struct seminfo  *__buf;  /* Buffer for IPC_INFO (Linux specific) */
+};
 
 typedef void (mix_areas_t)(unsigned int size,
 			   volatile void *dst, void *src,
@@ -121,6 +127,9 @@ typedef struct {
 		unsigned int frame_bits;
 	} s;
 	union {
+		struct {
+			unsigned int mix_slots;	/* per-client mixing slots, 0 = shared sum buffer */
+		} dmix;
 		struct {
 			unsigned long long chn_mask;
 		} dshare;
@@ -187,6 +196,9 @@ struct snd_pcm_direct {
 			mix_areas_24_t *remix_areas_24;
 			mix_areas_u8_t *remix_areas_u8;
 			unsigned int use_sem;
+			unsigned int mix_slots;		/* requested number of mixing slots */
+			int slot;			/* own mixing slot, -1 = none */
+			int semid_slots;		/* IPC semaphores owning the slots */
 		} dmix;
 		struct {
 			unsigned long long chn_mask;
@@ -264,6 +276,10 @@ struct snd_pcm_direct {
 	snd1_pcm_direct_set_chmap
 #define snd_pcm_direct_reset_slave_ptr \
 	snd1_pcm_direct_reset_slave_ptr
+#define snd_pcm_virt_fast_tstamp \
+	snd1_pcm_virt_fast_tstamp
+#define snd_pcm_virt_timer_open \
+	snd1_pcm_virt_timer_open
 
 int snd_pcm_direct_semaphore_create_or_connect(snd_pcm_direct_t *dmix);
 
@@ -348,8 +364,29 @@ int snd_pcm_direct_slave_recover(snd_pcm_direct_t *direct);
 int snd_pcm_direct_client_chk_xrun(snd_pcm_direct_t *direct, snd_pcm_t *pcm);
 int snd_timer_async(snd_timer_t *timer, int sig, pid_t pid);
 struct timespec snd_pcm_hw_fast_tstamp(snd_pcm_t *pcm);
+struct timespec snd_pcm_virt_fast_tstamp(snd_pcm_t *pcm);
+int snd_pcm_virt_timer_open(snd_timer_t **timerp, snd_pcm_t *pcm, int mode);
 void snd_pcm_direct_reset_slave_ptr(snd_pcm_t *pcm, snd_pcm_direct_t *dmix);
 
+/* the slave is a hw PCM or a virtual card */
+static inline int snd_pcm_direct_slave_supported(snd_pcm_t *spcm)
+{
+#ifdef BUILD_PCM_PLUGIN_VIRT
+	if (snd_pcm_type(spcm) == SND_PCM_TYPE_VIRT)
+		return 1;
+#endif
+	return snd_pcm_type(spcm) == SND_PCM_TYPE_HW;
+}
+
+static inline struct timespec snd_pcm_direct_slave_tstamp(snd_pcm_t *spcm)
+{
+#ifdef BUILD_PCM_PLUGIN_VIRT
+	if (snd_pcm_type(spcm) == SND_PCM_TYPE_VIRT)
+		return snd_pcm_virt_fast_tstamp(spcm);
+#endif
+	return snd_pcm_hw_fast_tstamp(spcm);
+}
+
 struct snd_pcm_direct_open_conf {
 	key_t ipc_key;
 	mode_t ipc_perm;
@@ -360,6 +397,7 @@ struct snd_pcm_direct_open_conf {
 	int direct_memory_access;
 	snd_pcm_direct_hw_ptr_alignment_t hw_ptr_alignment;
 	int tstamp_type;
+	unsigned int mix_slots;
 	snd_config_t *slave;
 	snd_config_t *bindings;
 };
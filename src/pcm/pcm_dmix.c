@@ -60,6 +60,8 @@ const char *_snd_module_pcm_dmix = "";
  */
 
 static int shm_sum_discard(snd_pcm_direct_t *dmix);
+static size_t dmix_slots_shm_size(snd_pcm_direct_share_t *shm);
+static void dmix_slots_sem_discard(snd_pcm_direct_t *dmix);
 
 /*
  *  sum ring buffer shared memory area 
@@ -70,9 +72,12 @@ static int shm_sum_create_or_connect(snd_pcm_direct_t *dmix)
 	int tmpid, err;
 	size_t size;
 
-	size = dmix->shmptr->s.channels *
-	       dmix->shmptr->s.buffer_size *
-	       sizeof(signed int);	
+	if (dmix->shmptr->u.dmix.mix_slots)
+		size = dmix_slots_shm_size(dmix->shmptr);
+	else
+		size = dmix->shmptr->s.channels *
+		       dmix->shmptr->s.buffer_size *
+		       sizeof(signed int);
 retryshm:
 	dmix->u.dmix.shmid_sum = shmget(dmix->ipc_key + 1, size,
 					IPC_CREAT | dmix->ipc_perm);
@@ -121,12 +126,56 @@ static int shm_sum_discard(snd_pcm_direct_t *dmix)
 	if (buf.shm_nattch == 0) {	/* we're the last user, destroy the segment */
 		if (shmctl(dmix->u.dmix.shmid_sum, IPC_RMID, NULL) < 0)
 			return -errno;
+		/* and the slot semaphores with it */
+		dmix_slots_sem_discard(dmix);
 		ret = 1;
 	}
 	dmix->u.dmix.shmid_sum = -1;
 	return ret;
 }
 
+/*
+ * create or connect the semaphore set of the slots; the first instance
+ * replaces a stale set of another size.  Called with the client
+ * semaphore held.
+ */
+static int slots_sem_create_or_connect(snd_pcm_direct_t *dmix,
+				       int first_instance)
+{
+	unsigned int slots = dmix->shmptr->u.dmix.mix_slots;
+	unsigned short *vals;
+	union semun s;
+	struct semid_ds buf;
+	int tmpid;
+
+retrysem:
+	dmix->u.dmix.semid_slots = semget(dmix->ipc_key + 1, slots,
+					  IPC_CREAT | dmix->ipc_perm);
+	if (dmix->u.dmix.semid_slots < 0) {
+		if (errno == EINVAL && first_instance)
+		if ((tmpid = semget(dmix->ipc_key + 1, 0, dmix->ipc_perm)) != -1)
+		if (!semctl(tmpid, 0, IPC_RMID, NULL))
+			goto retrysem;
+		return -errno;
+	}
+	if (first_instance) {
+		/* nobody can own a slot yet */
+		vals = alloca(slots * sizeof(*vals));
+		memset(vals, 0, slots * sizeof(*vals));
+		s.array = vals;
+		if (semctl(dmix->u.dmix.semid_slots, 0, SETALL, s) < 0)
+			return -errno;
+	}
+	if (dmix->ipc_gid >= 0) {
+		s.buf = &buf;
+		if (semctl(dmix->u.dmix.semid_slots, 0, IPC_STAT, s) < 0)
+			return -errno;
+		buf.sem_perm.gid = dmix->ipc_gid;
+		semctl(dmix->u.dmix.semid_slots, 0, IPC_SET, s);
+	}
+	return 0;
+}
+
 static void dmix_server_free(snd_pcm_direct_t *dmix)
 {
 	/* remove the memory region */
@@ -140,14 +189,21 @@ static void dmix_server_free(snd_pcm_direct_t *dmix)
  */
 
 #include "pcm_dmix_generic.c"
+#include "pcm_dmix_simd.c"
+#include "pcm_dmix_slots.c"
 #if defined(__i386__)
 #include "pcm_dmix_i386.c"
 #elif defined(__x86_64__)
 #include "pcm_dmix_x86_64.c"
 #else
 #ifndef DOC_HIDDEN
-#define mix_select_callbacks(x)	generic_mix_select_callbacks(x)
 #define dmix_supported_format generic_dmix_supported_format
+
+static void mix_select_callbacks(snd_pcm_direct_t *dmix)
+{
+	if (!simd_mix_select_callbacks(dmix))
+		generic_mix_select_callbacks(dmix);
+}
 #endif
 #endif
 
@@ -312,7 +368,7 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
 	snd_pcm_uframes_t slave_hw_ptr, slave_appl_ptr, slave_size;
-	snd_pcm_uframes_t appl_ptr, size, transfer;
+	snd_pcm_uframes_t appl_ptr, size, transfer, slave_pos;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
 	
 	/* calculate the size to transfer */
@@ -360,6 +416,7 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 	appl_ptr = dmix->last_appl_ptr % pcm->buffer_size;
 	dmix->last_appl_ptr += size;
 	dmix->last_appl_ptr %= pcm->boundary;
+	slave_pos = dmix->slave_appl_ptr;
 	slave_appl_ptr = dmix->slave_appl_ptr % dmix->slave_buffer_size;
 	dmix->slave_appl_ptr += size;
 	dmix->slave_appl_ptr %= dmix->slave_boundary;
@@ -370,12 +427,17 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 			transfer = pcm->buffer_size - appl_ptr;
 		if (slave_appl_ptr + transfer > dmix->slave_buffer_size)
 			transfer = dmix->slave_buffer_size - slave_appl_ptr;
-		mix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
+		if (dmix->u.dmix.mix_slots)
+			mix_slots_areas(dmix, src_areas, dst_areas, appl_ptr, slave_pos, transfer, 0);
+		else
+			mix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
 		size -= transfer;
 		if (! size)
 			break;
 		slave_appl_ptr += transfer;
 		slave_appl_ptr %= dmix->slave_buffer_size;
+		slave_pos += transfer;
+		slave_pos %= dmix->slave_boundary;
 		appl_ptr += transfer;
 		appl_ptr %= pcm->buffer_size;
 	}
@@ -696,6 +758,7 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 	snd_pcm_direct_t *dmix = pcm->private_data;
 	snd_pcm_uframes_t slave_appl_ptr, slave_size;
 	snd_pcm_uframes_t appl_ptr, size, transfer, result, frames_to_remix;
+	snd_pcm_uframes_t slave_pos;
 	int err;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
 
@@ -745,6 +808,7 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 	appl_ptr = dmix->last_appl_ptr % pcm->buffer_size;
 	dmix->slave_appl_ptr -= size;
 	dmix->slave_appl_ptr %= dmix->slave_boundary;
+	slave_pos = dmix->slave_appl_ptr;
 	slave_appl_ptr = dmix->slave_appl_ptr % dmix->slave_buffer_size;
 	dmix_down_sem(dmix);
 	for (;;) {
@@ -753,12 +817,17 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 			transfer = pcm->buffer_size - appl_ptr;
 		if (slave_appl_ptr + transfer > dmix->slave_buffer_size)
 			transfer = dmix->slave_buffer_size - slave_appl_ptr;
-		remix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
+		if (dmix->u.dmix.mix_slots)
+			mix_slots_areas(dmix, src_areas, dst_areas, appl_ptr, slave_pos, transfer, 1);
+		else
+			remix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
 		size -= transfer;
 		if (! size)
 			break;
 		slave_appl_ptr += transfer;
 		slave_appl_ptr %= dmix->slave_buffer_size;
+		slave_pos += transfer;
+		slave_pos %= dmix->slave_boundary;
 		appl_ptr += transfer;
 		appl_ptr %= pcm->buffer_size;
 	}
@@ -811,6 +880,8 @@ static int snd_pcm_dmix_close(snd_pcm_t *pcm)
  		snd_pcm_direct_server_discard(dmix);
  	if (dmix->client)
  		snd_pcm_direct_client_discard(dmix);
+	if (dmix->u.dmix.mix_slots)
+		dmix_slots_release(dmix);
  	shm_sum_discard(dmix);
 	if (snd_pcm_direct_shm_discard(dmix)) {
 		if (snd_pcm_direct_semaphore_discard(dmix))
@@ -897,7 +968,7 @@ static int snd_pcm_dmix_htimestamp(snd_pcm_t *pcm,
 		if (ok && *avail == avail1)
 			break;
 		*avail = avail1;
-		*tstamp = snd_pcm_hw_fast_tstamp(dmix->spcm);
+		*tstamp = snd_pcm_direct_slave_tstamp(dmix->spcm);
 		ok = 1;
 	}
 	return 0;
@@ -1021,6 +1092,8 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	dmix->hw_ptr_alignment = opts->hw_ptr_alignment;
 	dmix->sync_ptr = snd_pcm_dmix_sync_ptr;
 	dmix->direct_memory_access = opts->direct_memory_access;
+	dmix->u.dmix.slot = -1;
+	dmix->u.dmix.semid_slots = -1;
 
  retry:
 	if (first_instance) {
@@ -1033,8 +1106,8 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 			goto _err;
 		}
 	
-		if (snd_pcm_type(spcm) != SND_PCM_TYPE_HW) {
-			SNDERR("dmix plugin can be only connected to hw plugin");
+		if (!snd_pcm_direct_slave_supported(spcm)) {
+			SNDERR("dmix plugin can be only connected to hw or virt plugin");
 			ret = -EINVAL;
 			goto _err;
 		}
@@ -1058,6 +1131,7 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		}
 
 		dmix->shmptr->type = spcm->type;
+		dmix->shmptr->u.dmix.mix_slots = opts->mix_slots;
 	} else {
 		if (dmix->shmptr->use_server) {
 			/* up semaphore to avoid deadlock */
@@ -1089,8 +1163,8 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 				SNDERR("unable to open slave");
 				goto _err;
 			}
-			if (snd_pcm_type(spcm) != SND_PCM_TYPE_HW) {
-				SNDERR("dmix plugin can be only connected to hw plugin");
+			if (!snd_pcm_direct_slave_supported(spcm)) {
+				SNDERR("dmix plugin can be only connected to hw or virt plugin");
 				ret = -EINVAL;
 				goto _err;
 			}
@@ -1111,6 +1185,26 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		goto _err;
 	}
 
+	dmix->u.dmix.mix_slots = dmix->shmptr->u.dmix.mix_slots;
+	if (dmix->u.dmix.mix_slots) {
+		if (dmix->shmptr->s.channels > DMIX_SLOT_BLOCK) {
+			SNDERR("too many channels for mix_slots");
+			ret = -EINVAL;
+			goto _err;
+		}
+		ret = slots_sem_create_or_connect(dmix, first_instance);
+		if (ret < 0) {
+			SNDERR("unable to create the mixing slot semaphores");
+			goto _err;
+		}
+		ret = dmix_slots_claim(dmix);
+		if (ret < 0) {
+			SNDERR("no free mixing slot (mix_slots %u)",
+			       dmix->u.dmix.mix_slots);
+			goto _err;
+		}
+	}
+
 	ret = snd_pcm_direct_initialize_poll_fd(dmix);
 	if (ret < 0) {
 		SNDERR("unable to initialize poll_fd");
@@ -1118,6 +1212,9 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	}
 
 	mix_select_callbacks(dmix);
+	/* the slots are mixed without any lock */
+	if (dmix->u.dmix.mix_slots)
+		dmix->u.dmix.use_sem = 0;
 		
 	pcm->poll_fd = dmix->poll_fd;
 	pcm->poll_events = POLLIN;	/* it's different than other plugins */
@@ -1143,6 +1240,8 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		snd_pcm_direct_client_discard(dmix);
 	if (spcm)
 		snd_pcm_close(spcm);
+	if (dmix->u.dmix.slot >= 0)
+		dmix_slots_release(dmix);
 	if (dmix->u.dmix.shmid_sum >= 0)
 		shm_sum_discard(dmix);
 	if ((dmix->shmid >= 0) && (snd_pcm_direct_shm_discard(dmix))) {
@@ -1201,6 +1300,8 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	mix_slots INT		# number of lock-free per-client mixing slots
+				# (0 = shared sum buffer, default)
 }
 \endcode
 
@@ -1233,6 +1334,15 @@ the possible configurations:
   case of a dependency to another sound device (e.g. forwarding of
   microphone to speaker). Else "no" will be chosen.
 
+<code>mix_slots</code> switches to lock-free mixing.  Each client gets
+a private slot in the shared memory and the slave buffer is rebuilt
+from the sum of all slots for each written region, so the clients do
+not serialize on the IPC semaphore or on per-sample atomic operations.
+The value is the maximum number of concurrently opened clients; opening
+one more fails with \c -EBUSY.  The shared memory grows by one buffer
+of 32-bit samples per slot.  The setting of the first opened client is
+used by all others.
+
 Note that the dmix plugin itself supports only a single configuration.
 That is, it supports only the fixed rate (default 48000), format
 (\c S16), channels (2), and period_time (125000).
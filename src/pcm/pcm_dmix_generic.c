@@ -330,7 +330,7 @@ static void generic_mix_areas_32_swap(unsigned int size,
 	register signed int sample;
 
 	for (;;) {
-		sample = bswap_32(*src) >> 8;
+		sample = (signed int) bswap_32(*src) >> 8;
 		if (! *dst) {
 			*sum = sample;
 			*dst = *src;
@@ -364,10 +364,10 @@ static void generic_remix_areas_32_swap(unsigned int size,
 	register signed int sample;
 
 	for (;;) {
-		sample = bswap_32(*src) >> 8;
+		sample = (signed int) bswap_32(*src) >> 8;
 		if (! *dst) {
 			*sum = -sample;
-			*dst = bswap_32(-sample);
+			*dst = bswap_32(-(signed int) bswap_32(*src));
 		} else {
 			*sum = sample = *sum - sample;
 			if (sample > 0x7fffff)
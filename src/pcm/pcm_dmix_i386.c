@@ -87,13 +87,15 @@ static void mix_select_callbacks(snd_pcm_direct_t *dmix)
 {
 	static int smp = 0, mmx = 0, cmov = 0;
 
-	if (!dmix->direct_memory_access) {
-		generic_mix_select_callbacks(dmix);
-		return;
-	}
-
-	if (!((1ULL<< dmix->shmptr->s.format) & i386_dmix_supported_format)) {
-		generic_mix_select_callbacks(dmix);
+	/*
+	 * the atomic kernels below mix without the client semaphore and
+	 * stay the default, the vectorized ones replace only the generic
+	 * kernels which run under the semaphore anyway
+	 */
+	if (!dmix->direct_memory_access ||
+	    !((1ULL<< dmix->shmptr->s.format) & i386_dmix_supported_format)) {
+		if (!simd_mix_select_callbacks(dmix))
+			generic_mix_select_callbacks(dmix);
 		return;
 	}
 
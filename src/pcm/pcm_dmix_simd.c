@@ -0,0 +1,442 @@
+/*
+ * vectorized mixing code (SSE2 / AVX2 / NEON)
+ *
+ * The instruction set is chosen at runtime in simd_mix_select_callbacks();
+ * the kernels themselves live in pcm_dmix_simd.h.
+ */
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define DMIX_SIMD_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DMIX_SIMD_NEON
+#endif
+
+#ifdef DMIX_SIMD_X86
+
+#include <immintrin.h>
+
+/*
+ *  SSE2
+ */
+
+#define SIMD_FN(x)		sse2_##x
+#define SIMD_ATTR		__attribute__((target("sse2")))
+#define SIMD_VEC		__m128i
+#define SIMD_LANES		4
+#define SIMD_S24_SLACK		1
+#define SIMD_LOAD(p)		_mm_loadu_si128((const __m128i *)(p))
+#define SIMD_STORE(p, v)	_mm_storeu_si128((__m128i *)(p), (v))
+#define SIMD_SET1(x)		_mm_set1_epi32(x)
+#define SIMD_ADD(a, b)		_mm_add_epi32(a, b)
+#define SIMD_SUB(a, b)		_mm_sub_epi32(a, b)
+#define SIMD_ANDNOT(m, a)	_mm_andnot_si128(m, a)
+#define SIMD_CMPEQ(a, b)	_mm_cmpeq_epi32(a, b)
+#define SIMD_CMPGT(a, b)	_mm_cmpgt_epi32(a, b)
+#define SIMD_BLEND(m, a, b)	sse2_blend(m, a, b)
+#define SIMD_MIN(a, b)		sse2_blend(_mm_cmpgt_epi32(a, b), b, a)
+#define SIMD_MAX(a, b)		sse2_blend(_mm_cmpgt_epi32(a, b), a, b)
+#define SIMD_SRAI(v, n)		_mm_srai_epi32(v, n)
+#define SIMD_SLLI(v, n)		_mm_slli_epi32(v, n)
+
+static SIMD_ATTR inline __m128i sse2_blend(__m128i m, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+}
+
+static SIMD_ATTR inline __m128i sse2_swap16(__m128i x)
+{
+	return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+static SIMD_ATTR inline __m128i sse2_bswap32(__m128i x)
+{
+	x = sse2_swap16(x);
+	return _mm_or_si128(_mm_slli_epi32(x, 16), _mm_srli_epi32(x, 16));
+}
+
+static SIMD_ATTR inline __m128i sse2_extend_s16(__m128i x)
+{
+	return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+}
+
+static SIMD_ATTR inline __m128i sse2_pack_s16(__m128i v)
+{
+	v = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+	return _mm_packs_epi32(v, v);
+}
+
+static SIMD_ATTR inline __m128i sse2_load_s16(const signed short *p)
+{
+	return sse2_extend_s16(_mm_loadl_epi64((const __m128i *)p));
+}
+
+static SIMD_ATTR inline void sse2_store_s16(signed short *p, __m128i v)
+{
+	_mm_storel_epi64((__m128i *)p, sse2_pack_s16(v));
+}
+
+static SIMD_ATTR inline __m128i sse2_load_s16_swap(const signed short *p)
+{
+	return sse2_extend_s16(sse2_swap16(_mm_loadl_epi64((const __m128i *)p)));
+}
+
+static SIMD_ATTR inline void sse2_store_s16_swap(signed short *p, __m128i v)
+{
+	_mm_storel_epi64((__m128i *)p, sse2_swap16(sse2_pack_s16(v)));
+}
+
+static inline int load_le32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+/* each lane reads 4 bytes, so one sample of slack is needed */
+static SIMD_ATTR inline __m128i sse2_load_s24(const unsigned char *p)
+{
+	__m128i x = _mm_setr_epi32(load_le32(p), load_le32(p + 3),
+				   load_le32(p + 6), load_le32(p + 9));
+
+	return _mm_srai_epi32(_mm_slli_epi32(x, 8), 8);
+}
+
+static SIMD_ATTR inline void sse2_store_s24(unsigned char *p, __m128i v)
+{
+	unsigned int i;
+	int x;
+
+	for (i = 0; i < 4; i++, p += 3) {
+		x = _mm_cvtsi128_si32(v);
+		p[0] = x;
+		p[1] = x >> 8;
+		p[2] = x >> 16;
+		v = _mm_srli_si128(v, 4);
+	}
+}
+
+static SIMD_ATTR inline __m128i sse2_load_u8(const unsigned char *p)
+{
+	const __m128i zero = _mm_setzero_si128();
+	int v;
+
+	memcpy(&v, p, sizeof(v));
+	return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero), zero);
+}
+
+static SIMD_ATTR inline void sse2_store_u8(unsigned char *p, __m128i v)
+{
+	int r;
+
+	v = _mm_and_si128(v, _mm_set1_epi32(0xff));
+	v = _mm_packs_epi32(v, v);
+	r = _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+	memcpy(p, &r, sizeof(r));
+}
+
+#include "pcm_dmix_simd.h"
+
+#undef SIMD_FN
+#undef SIMD_ATTR
+#undef SIMD_VEC
+#undef SIMD_LANES
+#undef SIMD_S24_SLACK
+#undef SIMD_LOAD
+#undef SIMD_STORE
+#undef SIMD_SET1
+#undef SIMD_ADD
+#undef SIMD_SUB
+#undef SIMD_ANDNOT
+#undef SIMD_CMPEQ
+#undef SIMD_CMPGT
+#undef SIMD_BLEND
+#undef SIMD_MIN
+#undef SIMD_MAX
+#undef SIMD_SRAI
+#undef SIMD_SLLI
+
+/*
+ *  AVX2
+ */
+
+#define SIMD_FN(x)		avx2_##x
+#define SIMD_ATTR		__attribute__((target("avx2")))
+#define SIMD_VEC		__m256i
+#define SIMD_LANES		8
+#define SIMD_S24_SLACK		2
+#define SIMD_LOAD(p)		_mm256_loadu_si256((const __m256i *)(p))
+#define SIMD_STORE(p, v)	_mm256_storeu_si256((__m256i *)(p), (v))
+#define SIMD_SET1(x)		_mm256_set1_epi32(x)
+#define SIMD_ADD(a, b)		_mm256_add_epi32(a, b)
+#define SIMD_SUB(a, b)		_mm256_sub_epi32(a, b)
+#define SIMD_ANDNOT(m, a)	_mm256_andnot_si256(m, a)
+#define SIMD_CMPEQ(a, b)	_mm256_cmpeq_epi32(a, b)
+#define SIMD_CMPGT(a, b)	_mm256_cmpgt_epi32(a, b)
+#define SIMD_BLEND(m, a, b)	_mm256_blendv_epi8(b, a, m)
+#define SIMD_MIN(a, b)		_mm256_min_epi32(a, b)
+#define SIMD_MAX(a, b)		_mm256_max_epi32(a, b)
+#define SIMD_SRAI(v, n)		_mm256_srai_epi32(v, n)
+#define SIMD_SLLI(v, n)		_mm256_slli_epi32(v, n)
+
+static SIMD_ATTR inline __m128i avx2_swap16(__m128i x)
+{
+	return _mm_shuffle_epi8(x, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+						 9, 8, 11, 10, 13, 12, 15, 14));
+}
+
+static SIMD_ATTR inline __m256i avx2_bswap32(__m256i x)
+{
+	return _mm256_shuffle_epi8(x, _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+						       11, 10, 9, 8, 15, 14, 13, 12,
+						       3, 2, 1, 0, 7, 6, 5, 4,
+						       11, 10, 9, 8, 15, 14, 13, 12));
+}
+
+/* truncate the lanes to 16 bits and gather them into the low 128 bits */
+static SIMD_ATTR inline __m128i avx2_pack_s16(__m256i v)
+{
+	v = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+	v = _mm256_permute4x64_epi64(_mm256_packs_epi32(v, v), 0x08);
+	return _mm256_castsi256_si128(v);
+}
+
+static SIMD_ATTR inline __m256i avx2_load_s16(const signed short *p)
+{
+	return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)p));
+}
+
+static SIMD_ATTR inline void avx2_store_s16(signed short *p, __m256i v)
+{
+	_mm_storeu_si128((__m128i *)p, avx2_pack_s16(v));
+}
+
+static SIMD_ATTR inline __m256i avx2_load_s16_swap(const signed short *p)
+{
+	return _mm256_cvtepi16_epi32(avx2_swap16(_mm_loadu_si128((const __m128i *)p)));
+}
+
+static SIMD_ATTR inline void avx2_store_s16_swap(signed short *p, __m256i v)
+{
+	_mm_storeu_si128((__m128i *)p, avx2_swap16(avx2_pack_s16(v)));
+}
+
+/*
+ * S24_3LE is spread to the upper three bytes of each lane and shifted
+ * down with sign; the upper half is loaded from byte 12 and reads four
+ * bytes past the vector, hence two samples of slack
+ */
+static SIMD_ATTR inline __m256i avx2_load_s24(const unsigned char *p)
+{
+	const __m128i mask = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+					   -1, 6, 7, 8, -1, 9, 10, 11);
+	__m128i lo = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), mask);
+	__m128i hi = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 12)), mask);
+	__m256i x = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+	return _mm256_srai_epi32(x, 8);
+}
+
+static SIMD_ATTR inline void avx2_store_s24_half(unsigned char *p, __m128i x)
+{
+	const __m128i mask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9,
+					   10, 12, 13, 14, -1, -1, -1, -1);
+	int r;
+
+	x = _mm_shuffle_epi8(x, mask);
+	_mm_storel_epi64((__m128i *)p, x);
+	r = _mm_cvtsi128_si32(_mm_srli_si128(x, 8));
+	memcpy(p + 8, &r, sizeof(r));
+}
+
+static SIMD_ATTR inline void avx2_store_s24(unsigned char *p, __m256i v)
+{
+	avx2_store_s24_half(p, _mm256_castsi256_si128(v));
+	avx2_store_s24_half(p + 12, _mm256_extracti128_si256(v, 1));
+}
+
+static SIMD_ATTR inline __m256i avx2_load_u8(const unsigned char *p)
+{
+	return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+}
+
+static SIMD_ATTR inline void avx2_store_u8(unsigned char *p, __m256i v)
+{
+	__m128i x;
+
+	x = avx2_pack_s16(_mm256_and_si256(v, _mm256_set1_epi32(0xff)));
+	_mm_storel_epi64((__m128i *)p, _mm_packus_epi16(x, x));
+}
+
+#include "pcm_dmix_simd.h"
+
+#undef SIMD_FN
+#undef SIMD_ATTR
+#undef SIMD_VEC
+#undef SIMD_LANES
+#undef SIMD_S24_SLACK
+#undef SIMD_LOAD
+#undef SIMD_STORE
+#undef SIMD_SET1
+#undef SIMD_ADD
+#undef SIMD_SUB
+#undef SIMD_ANDNOT
+#undef SIMD_CMPEQ
+#undef SIMD_CMPGT
+#undef SIMD_BLEND
+#undef SIMD_MIN
+#undef SIMD_MAX
+#undef SIMD_SRAI
+#undef SIMD_SLLI
+
+#endif /* DMIX_SIMD_X86 */
+
+#ifdef DMIX_SIMD_NEON
+
+#include <arm_neon.h>
+
+/*
+ *  NEON
+ */
+
+#define SIMD_FN(x)		neon_##x
+#define SIMD_ATTR
+#define SIMD_VEC		int32x4_t
+#define SIMD_LANES		4
+#define SIMD_S24_SLACK		0
+#define SIMD_LOAD(p)		vld1q_s32((const int32_t *)(p))
+#define SIMD_STORE(p, v)	vst1q_s32((int32_t *)(p), (v))
+#define SIMD_SET1(x)		vdupq_n_s32(x)
+#define SIMD_ADD(a, b)		vaddq_s32(a, b)
+#define SIMD_SUB(a, b)		vsubq_s32(a, b)
+#define SIMD_ANDNOT(m, a)	vbicq_s32(a, m)
+#define SIMD_CMPEQ(a, b)	vreinterpretq_s32_u32(vceqq_s32(a, b))
+#define SIMD_CMPGT(a, b)	vreinterpretq_s32_u32(vcgtq_s32(a, b))
+#define SIMD_BLEND(m, a, b)	vbslq_s32(vreinterpretq_u32_s32(m), a, b)
+#define SIMD_MIN(a, b)		vminq_s32(a, b)
+#define SIMD_MAX(a, b)		vmaxq_s32(a, b)
+#define SIMD_SRAI(v, n)		vshrq_n_s32(v, n)
+#define SIMD_SLLI(v, n)		vshlq_n_s32(v, n)
+
+static inline int16x4_t neon_swap16(int16x4_t x)
+{
+	return vreinterpret_s16_u8(vrev16_u8(vreinterpret_u8_s16(x)));
+}
+
+static inline int32x4_t neon_bswap32(int32x4_t x)
+{
+	return vreinterpretq_s32_u8(vrev32q_u8(vreinterpretq_u8_s32(x)));
+}
+
+static inline int32x4_t neon_load_s16(const signed short *p)
+{
+	return vmovl_s16(vld1_s16((const int16_t *)p));
+}
+
+static inline void neon_store_s16(signed short *p, int32x4_t v)
+{
+	vst1_s16((int16_t *)p, vmovn_s32(v));
+}
+
+static inline int32x4_t neon_load_s16_swap(const signed short *p)
+{
+	return vmovl_s16(neon_swap16(vld1_s16((const int16_t *)p)));
+}
+
+static inline void neon_store_s16_swap(signed short *p, int32x4_t v)
+{
+	vst1_s16((int16_t *)p, neon_swap16(vmovn_s32(v)));
+}
+
+static inline int32_t neon_s24(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (((signed char)p[2]) << 16);
+}
+
+static inline int32x4_t neon_load_s24(const unsigned char *p)
+{
+	int32x4_t v = vdupq_n_s32(neon_s24(p));
+
+	v = vsetq_lane_s32(neon_s24(p + 3), v, 1);
+	v = vsetq_lane_s32(neon_s24(p + 6), v, 2);
+	return vsetq_lane_s32(neon_s24(p + 9), v, 3);
+}
+
+static inline void neon_put_s24(unsigned char *p, int32_t x)
+{
+	p[0] = x;
+	p[1] = x >> 8;
+	p[2] = x >> 16;
+}
+
+static inline void neon_store_s24(unsigned char *p, int32x4_t v)
+{
+	neon_put_s24(p, vgetq_lane_s32(v, 0));
+	neon_put_s24(p + 3, vgetq_lane_s32(v, 1));
+	neon_put_s24(p + 6, vgetq_lane_s32(v, 2));
+	neon_put_s24(p + 9, vgetq_lane_s32(v, 3));
+}
+
+static inline int32x4_t neon_load_u8(const unsigned char *p)
+{
+	uint16x8_t x;
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	x = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(v)));
+	return vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(x)));
+}
+
+static inline void neon_store_u8(unsigned char *p, int32x4_t v)
+{
+	uint16x4_t h;
+	uint32_t r;
+
+	h = vmovn_u32(vandq_u32(vreinterpretq_u32_s32(v), vdupq_n_u32(0xff)));
+	r = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(h, h))), 0);
+	memcpy(p, &r, sizeof(r));
+}
+
+#include "pcm_dmix_simd.h"
+
+#undef SIMD_FN
+#undef SIMD_ATTR
+#undef SIMD_VEC
+#undef SIMD_LANES
+#undef SIMD_S24_SLACK
+#undef SIMD_LOAD
+#undef SIMD_STORE
+#undef SIMD_SET1
+#undef SIMD_ADD
+#undef SIMD_SUB
+#undef SIMD_ANDNOT
+#undef SIMD_CMPEQ
+#undef SIMD_CMPGT
+#undef SIMD_BLEND
+#undef SIMD_MIN
+#undef SIMD_MAX
+#undef SIMD_SRAI
+#undef SIMD_SLLI
+
+#endif /* DMIX_SIMD_NEON */
+
+/*
+ * install the vectorized callbacks if the CPU supports them,
+ * returns zero when the caller has to fall back to other code
+ */
+static int simd_mix_select_callbacks(snd_pcm_direct_t *dmix)
+{
+#if defined(DMIX_SIMD_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		avx2_mix_select_callbacks(dmix);
+		return 1;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		sse2_mix_select_callbacks(dmix);
+		return 1;
+	}
+#elif defined(DMIX_SIMD_NEON)
+	neon_mix_select_callbacks(dmix);
+	return 1;
+#endif
+	return 0;
+}
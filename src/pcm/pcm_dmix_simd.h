@@ -0,0 +1,454 @@
+/**
+ * \file pcm/pcm_dmix_simd.h
+ * \ingroup PCM_Plugins
+ * \brief PCM Direct Stream Mixing (dmix) Plugin Interface - SIMD mixing kernels
+ */
+/*
+ *  PCM - Direct Stream Mixing
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * This file is included once per instruction set by pcm_dmix_simd.c.
+ * The includer defines:
+ *
+ *   SIMD_FN(x)		function name prefix
+ *   SIMD_ATTR		function attributes (target selection)
+ *   SIMD_VEC		vector type holding SIMD_LANES signed 32-bit lanes
+ *   SIMD_LOAD/STORE	unaligned 32-bit loads and stores
+ *   SIMD_SET1/ADD/SUB/ANDNOT/CMPEQ/CMPGT/BLEND/MIN/MAX/SRAI/SLLI
+ *
+ * and the format helpers SIMD_FN(load_s16), SIMD_FN(store_s16),
+ * SIMD_FN(load_s16_swap), SIMD_FN(store_s16_swap), SIMD_FN(bswap32),
+ * SIMD_FN(load_s24), SIMD_FN(store_s24), SIMD_FN(load_u8) and
+ * SIMD_FN(store_u8).  The stores truncate, the kernels clamp explicitly.
+ * The packed 24-bit loads may read past the last sample, SIMD_S24_SLACK
+ * is the number of samples which must follow a vector.
+ *
+ * The kernels have the same semantics as the generic (non-concurrent)
+ * ones and are used with the client semaphore.  Only the contiguous case
+ * (interleaved access) is vectorized, strided areas and the tail of
+ * each run are passed to the generic code.
+ */
+
+static SIMD_ATTR void SIMD_FN(mix_areas_16_native)(unsigned int size,
+						   volatile signed short *dst,
+						   signed short *src,
+						   volatile signed int *sum,
+						   size_t dst_step,
+						   size_t src_step,
+						   size_t sum_step)
+{
+	const SIMD_VEC smin = SIMD_SET1(-0x8000), smax = SIMD_SET1(0x7fff);
+	const SIMD_VEC zero = SIMD_SET1(0);
+	SIMD_VEC s, d, z, n;
+
+	if (dst_step != 2 || src_step != 2 || sum_step != 4)
+		goto __generic;
+	for (; size >= SIMD_LANES; size -= SIMD_LANES) {
+		s = SIMD_FN(load_s16)(src);
+		d = SIMD_FN(load_s16)((signed short *)dst);
+		z = SIMD_CMPEQ(d, zero);
+		n = SIMD_ADD(SIMD_ANDNOT(z, SIMD_LOAD(sum)), s);
+		SIMD_STORE(sum, n);
+		SIMD_FN(store_s16)((signed short *)dst, SIMD_MIN(SIMD_MAX(n, smin), smax));
+		src += SIMD_LANES;
+		dst += SIMD_LANES;
+		sum += SIMD_LANES;
+	}
+	if (!size)
+		return;
+      __generic:
+	generic_mix_areas_16_native(size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SIMD_ATTR void SIMD_FN(remix_areas_16_native)(unsigned int size,
+						     volatile signed short *dst,
+						     signed short *src,
+						     volatile signed int *sum,
+						     size_t dst_step,
+						     size_t src_step,
+						     size_t sum_step)
+{
+	const SIMD_VEC smin = SIMD_SET1(-0x8000), smax = SIMD_SET1(0x7fff);
+	const SIMD_VEC zero = SIMD_SET1(0);
+	SIMD_VEC s, d, z, n;
+
+	if (dst_step != 2 || src_step != 2 || sum_step != 4)
+		goto __generic;
+	for (; size >= SIMD_LANES; size -= SIMD_LANES) {
+		s = SIMD_FN(load_s16)(src);
+		d = SIMD_FN(load_s16)((signed short *)dst);
+		z = SIMD_CMPEQ(d, zero);
+		n = SIMD_SUB(SIMD_ANDNOT(z, SIMD_LOAD(sum)), s);
+		SIMD_STORE(sum, n);
+		SIMD_FN(store_s16)((signed short *)dst,
+				   SIMD_BLEND(z, n, SIMD_MIN(SIMD_MAX(n, smin), smax)));
+		src += SIMD_LANES;
+		dst += SIMD_LANES;
+		sum += SIMD_LANES;
+	}
+	if (!size)
+		return;
+      __generic:
+	generic_remix_areas_16_native(size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SIMD_ATTR void SIMD_FN(mix_areas_16_swap)(unsigned int size,
+						 volatile signed short *dst,
+						 signed short *src,
+						 volatile signed int *sum,
+						 size_t dst_step,
+						 size_t src_step,
+						 size_t sum_step)
+{
+	const SIMD_VEC smin = SIMD_SET1(-0x8000), smax = SIMD_SET1(0x7fff);
+	const SIMD_VEC zero = SIMD_SET1(0);
+	SIMD_VEC s, d, z, n;
+
+	if (dst_step != 2 || src_step != 2 || sum_step != 4)
+		goto __generic;
+	for (; size >= SIMD_LANES; size -= SIMD_LANES) {
+		s = SIMD_FN(load_s16_swap)(src);
+		d = SIMD_FN(load_s16_swap)((signed short *)dst);
+		z = SIMD_CMPEQ(d, zero);
+		n = SIMD_ADD(SIMD_ANDNOT(z, SIMD_LOAD(sum)), s);
+		SIMD_STORE(sum, n);
+		SIMD_FN(store_s16_swap)((signed short *)dst, SIMD_MIN(SIMD_MAX(n, smin), smax));
+		src += SIMD_LANES;
+		dst += SIMD_LANES;
+		sum += SIMD_LANES;
+	}
+	if (!size)
+		return;
+      __generic:
+	generic_mix_areas_16_swap(size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SIMD_ATTR void SIMD_FN(remix_areas_16_swap)(unsigned int size,
+						   volatile signed short *dst,
+						   signed short *src,
+						   volatile signed int *sum,
+						   size_t dst_step,
+						   size_t src_step,
+						   size_t sum_step)
+{
+	const SIMD_VEC smin = SIMD_SET1(-0x8000), smax = SIMD_SET1(0x7fff);
+	const SIMD_VEC zero = SIMD_SET1(0);
+	SIMD_VEC s, d, z, n;
+
+	if (dst_step != 2 || src_step != 2 || sum_step != 4)
+		goto __generic;
+	for (; size >= SIMD_LANES; size -= SIMD_LANES) {
+		s = SIMD_FN(load_s16_swap)(src);
+		d = SIMD_FN(load_s16_swap)((signed short *)dst);
+		z = SIMD_CMPEQ(d, zero);
+		n = SIMD_SUB(SIMD_ANDNOT(z, SIMD_LOAD(sum)), s);
+		SIMD_STORE(sum, n);
+		SIMD_FN(store_s16_swap)((signed short *)dst,
+					SIMD_BLEND(z, n, SIMD_MIN(SIMD_MAX(n, smin), smax)));
+		src += SIMD_LANES;
+		dst += SIMD_LANES;
+		sum += SIMD_LANES;
+	}
+	if (!size)
+		return;
+      __generic:
+	generic_remix_areas_16_swap(size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+/*
+ * 32-bit samples are mixed with 24-bit precision, the saturated result is
+ * scaled back; a silent destination takes the source sample as it is
+ */
+static SIMD_ATTR SIMD_VEC SIMD_FN(scale_s32)(SIMD_VEC n)
+{
+	const SIMD_VEC smin = SIMD_SET1(-0x800000), smax = SIMD_SET1(0x7fffff);
+
+	return SIMD_BLEND(SIMD_CMPGT(n, smax), SIMD_SET1(0x7fffffff),
+			  SIMD_SLLI(SIMD_MAX(n, smin), 8));
+}
+
+static SIMD_ATTR void SIMD_FN(mix_areas_32_native)(unsigned int size,
+						   volatile signed int *dst,
+						   signed int *src,
+						   volatile signed int *sum,
+						   size_t dst_step,
+						   size_t src_step,
+						   size_t sum_step)
+{
+	const SIMD_VEC zero = SIMD_SET1(0);
+	SIMD_VEC r, s, z, n;
+
+	if (dst_step != 4 || src_step != 4 || sum_step != 4)
+		goto __generic;
+	for (; size >= SIMD_LANES; size -= SIMD_LANES) {
+		r = SIMD_LOAD(src);
+		s = SIMD_SRAI(r, 8);
+		z = SIMD_CMPEQ(SIMD_LOAD((signed int *)dst), zero);
+		n = SIMD_ADD(SIMD_ANDNOT(z, SIMD_LOAD(sum)), s);
+		SIMD_STORE(sum, n);
+		SIMD_STORE((signed int *)dst, SIMD_BLEND(z, r, SIMD_FN(scale_s32)(n)));
+		src += SIMD_LANES;
+		dst += SIMD_LANES;
+		sum += SIMD_LANES;
+	}
+	if (!size)
+		return;
+      __generic:
+	generic_mix_areas_32_native(size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SIMD_ATTR void SIMD_FN(remix_areas_32_native)(unsigned int size,
+						     volatile signed int *dst,
+						     signed int *src,
+						     volatile signed int *sum,
+						     size_t dst_step,
+						     size_t src_step,
+						     size_t sum_step)
+{
+	const SIMD_VEC zero = SIMD_SET1(0);
+	SIMD_VEC r, s, z, n;
+
+	if (dst_step != 4 || src_step != 4 || sum_step != 4)
+		goto __generic;
+	for (; size >= SIMD_LANES; size -= SIMD_LANES) {
+		r = SIMD_LOAD(src);
+		s = SIMD_SRAI(r, 8);
+		z = SIMD_CMPEQ(SIMD_LOAD((signed int *)dst), zero);
+		n = SIMD_SUB(SIMD_ANDNOT(z, SIMD_LOAD(sum)), s);
+		SIMD_STORE(sum, n);
+		SIMD_STORE((signed int *)dst,
+			   SIMD_BLEND(z, SIMD_SUB(zero, r), SIMD_FN(scale_s32)(n)));
+		src += SIMD_LANES;
+		dst += SIMD_LANES;
+		sum += SIMD_LANES;
+	}
+	if (!size)
+		return;
+      __generic:
+	generic_remix_areas_32_native(size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SIMD_ATTR void SIMD_FN(mix_areas_32_swap)(unsigned int size,
+						 volatile signed int *dst,
+						 signed int *src,
+						 volatile signed int *sum,
+						 size_t dst_step,
+						 size_t src_step,
+						 size_t sum_step)
+{
+	const SIMD_VEC zero = SIMD_SET1(0);
+	SIMD_VEC r, s, z, n;
+
+	if (dst_step != 4 || src_step != 4 || sum_step != 4)
+		goto __generic;
+	for (; size >= SIMD_LANES; size -= SIMD_LANES) {
+		r = SIMD_FN(bswap32)(SIMD_LOAD(src));
+		s = SIMD_SRAI(r, 8);
+		z = SIMD_CMPEQ(SIMD_LOAD((signed int *)dst), zero);
+		n = SIMD_ADD(SIMD_ANDNOT(z, SIMD_LOAD(sum)), s);
+		SIMD_STORE(sum, n);
+		SIMD_STORE((signed int *)dst,
+			   SIMD_FN(bswap32)(SIMD_BLEND(z, r, SIMD_FN(scale_s32)(n))));
+		src += SIMD_LANES;
+		dst += SIMD_LANES;
+		sum += SIMD_LANES;
+	}
+	if (!size)
+		return;
+      __generic:
+	generic_mix_areas_32_swap(size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SIMD_ATTR void SIMD_FN(remix_areas_32_swap)(unsigned int size,
+						   volatile signed int *dst,
+						   signed int *src,
+						   volatile signed int *sum,
+						   size_t dst_step,
+						   size_t src_step,
+						   size_t sum_step)
+{
+	const SIMD_VEC zero = SIMD_SET1(0);
+	SIMD_VEC r, s, z, n;
+
+	if (dst_step != 4 || src_step != 4 || sum_step != 4)
+		goto __generic;
+	for (; size >= SIMD_LANES; size -= SIMD_LANES) {
+		r = SIMD_FN(bswap32)(SIMD_LOAD(src));
+		s = SIMD_SRAI(r, 8);
+		z = SIMD_CMPEQ(SIMD_LOAD((signed int *)dst), zero);
+		n = SIMD_SUB(SIMD_ANDNOT(z, SIMD_LOAD(sum)), s);
+		SIMD_STORE(sum, n);
+		SIMD_STORE((signed int *)dst,
+			   SIMD_FN(bswap32)(SIMD_BLEND(z, SIMD_SUB(zero, r),
+						       SIMD_FN(scale_s32)(n))));
+		src += SIMD_LANES;
+		dst += SIMD_LANES;
+		sum += SIMD_LANES;
+	}
+	if (!size)
+		return;
+      __generic:
+	generic_remix_areas_32_swap(size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SIMD_ATTR void SIMD_FN(mix_areas_24)(unsigned int size,
+					    volatile unsigned char *dst,
+					    unsigned char *src,
+					    volatile signed int *sum,
+					    size_t dst_step,
+					    size_t src_step,
+					    size_t sum_step)
+{
+	const SIMD_VEC smin = SIMD_SET1(-0x800000), smax = SIMD_SET1(0x7fffff);
+	const SIMD_VEC zero = SIMD_SET1(0);
+	SIMD_VEC s, z, n;
+
+	if (dst_step != 3 || src_step != 3 || sum_step != 4)
+		goto __generic;
+	for (; size >= SIMD_LANES + SIMD_S24_SLACK; size -= SIMD_LANES) {
+		s = SIMD_FN(load_s24)(src);
+		z = SIMD_CMPEQ(SIMD_FN(load_s24)((unsigned char *)dst), zero);
+		n = SIMD_ADD(SIMD_ANDNOT(z, SIMD_LOAD(sum)), s);
+		SIMD_STORE(sum, n);
+		SIMD_FN(store_s24)((unsigned char *)dst, SIMD_MIN(SIMD_MAX(n, smin), smax));
+		src += 3 * SIMD_LANES;
+		dst += 3 * SIMD_LANES;
+		sum += SIMD_LANES;
+	}
+	if (!size)
+		return;
+      __generic:
+	generic_mix_areas_24(size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SIMD_ATTR void SIMD_FN(remix_areas_24)(unsigned int size,
+					      volatile unsigned char *dst,
+					      unsigned char *src,
+					      volatile signed int *sum,
+					      size_t dst_step,
+					      size_t src_step,
+					      size_t sum_step)
+{
+	const SIMD_VEC smin = SIMD_SET1(-0x800000), smax = SIMD_SET1(0x7fffff);
+	const SIMD_VEC zero = SIMD_SET1(0);
+	SIMD_VEC s, z, n;
+
+	if (dst_step != 3 || src_step != 3 || sum_step != 4)
+		goto __generic;
+	for (; size >= SIMD_LANES + SIMD_S24_SLACK; size -= SIMD_LANES) {
+		s = SIMD_FN(load_s24)(src);
+		z = SIMD_CMPEQ(SIMD_FN(load_s24)((unsigned char *)dst), zero);
+		n = SIMD_SUB(SIMD_ANDNOT(z, SIMD_LOAD(sum)), s);
+		SIMD_STORE(sum, n);
+		SIMD_FN(store_s24)((unsigned char *)dst,
+				   SIMD_BLEND(z, n, SIMD_MIN(SIMD_MAX(n, smin), smax)));
+		src += 3 * SIMD_LANES;
+		dst += 3 * SIMD_LANES;
+		sum += SIMD_LANES;
+	}
+	if (!size)
+		return;
+      __generic:
+	generic_remix_areas_24(size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SIMD_ATTR void SIMD_FN(mix_areas_u8)(unsigned int size,
+					    volatile unsigned char *dst,
+					    unsigned char *src,
+					    volatile signed int *sum,
+					    size_t dst_step,
+					    size_t src_step,
+					    size_t sum_step)
+{
+	const SIMD_VEC smin = SIMD_SET1(-0x80), smax = SIMD_SET1(0x7f);
+	const SIMD_VEC bias = SIMD_SET1(0x80);
+	SIMD_VEC s, d, z, n;
+
+	if (dst_step != 1 || src_step != 1 || sum_step != 4)
+		goto __generic;
+	for (; size >= SIMD_LANES; size -= SIMD_LANES) {
+		s = SIMD_SUB(SIMD_FN(load_u8)(src), bias);
+		d = SIMD_FN(load_u8)((unsigned char *)dst);
+		z = SIMD_CMPEQ(d, bias);
+		n = SIMD_ADD(SIMD_ANDNOT(z, SIMD_LOAD(sum)), s);
+		SIMD_STORE(sum, n);
+		SIMD_FN(store_u8)((unsigned char *)dst,
+				  SIMD_ADD(SIMD_MIN(SIMD_MAX(n, smin), smax), bias));
+		src += SIMD_LANES;
+		dst += SIMD_LANES;
+		sum += SIMD_LANES;
+	}
+	if (!size)
+		return;
+      __generic:
+	generic_mix_areas_u8(size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static SIMD_ATTR void SIMD_FN(remix_areas_u8)(unsigned int size,
+					      volatile unsigned char *dst,
+					      unsigned char *src,
+					      volatile signed int *sum,
+					      size_t dst_step,
+					      size_t src_step,
+					      size_t sum_step)
+{
+	const SIMD_VEC smin = SIMD_SET1(-0x80), smax = SIMD_SET1(0x7f);
+	const SIMD_VEC bias = SIMD_SET1(0x80);
+	SIMD_VEC s, d, z, n;
+
+	if (dst_step != 1 || src_step != 1 || sum_step != 4)
+		goto __generic;
+	for (; size >= SIMD_LANES; size -= SIMD_LANES) {
+		s = SIMD_SUB(SIMD_FN(load_u8)(src), bias);
+		d = SIMD_FN(load_u8)((unsigned char *)dst);
+		z = SIMD_CMPEQ(d, bias);
+		n = SIMD_SUB(SIMD_ANDNOT(z, SIMD_LOAD(sum)), s);
+		SIMD_STORE(sum, n);
+		SIMD_FN(store_u8)((unsigned char *)dst,
+				  SIMD_ADD(SIMD_BLEND(z, n, SIMD_MIN(SIMD_MAX(n, smin), smax)), bias));
+		src += SIMD_LANES;
+		dst += SIMD_LANES;
+		sum += SIMD_LANES;
+	}
+	if (!size)
+		return;
+      __generic:
+	generic_remix_areas_u8(size, dst, src, sum, dst_step, src_step, sum_step);
+}
+
+static void SIMD_FN(mix_select_callbacks)(snd_pcm_direct_t *dmix)
+{
+	if (snd_pcm_format_cpu_endian(dmix->shmptr->s.format)) {
+		dmix->u.dmix.mix_areas_16 = SIMD_FN(mix_areas_16_native);
+		dmix->u.dmix.mix_areas_32 = SIMD_FN(mix_areas_32_native);
+		dmix->u.dmix.remix_areas_16 = SIMD_FN(remix_areas_16_native);
+		dmix->u.dmix.remix_areas_32 = SIMD_FN(remix_areas_32_native);
+	} else {
+		dmix->u.dmix.mix_areas_16 = SIMD_FN(mix_areas_16_swap);
+		dmix->u.dmix.mix_areas_32 = SIMD_FN(mix_areas_32_swap);
+		dmix->u.dmix.remix_areas_16 = SIMD_FN(remix_areas_16_swap);
+		dmix->u.dmix.remix_areas_32 = SIMD_FN(remix_areas_32_swap);
+	}
+	dmix->u.dmix.mix_areas_24 = SIMD_FN(mix_areas_24);
+	dmix->u.dmix.mix_areas_u8 = SIMD_FN(mix_areas_u8);
+	dmix->u.dmix.remix_areas_24 = SIMD_FN(remix_areas_24);
+	dmix->u.dmix.remix_areas_u8 = SIMD_FN(remix_areas_u8);
+	dmix->u.dmix.use_sem = 1;
+}
@@ -0,0 +1,555 @@
+/*
+ * per-client mixing slots
+ *
+ * Instead of summing into one shared buffer with per-sample atomics (or
+ * under the client semaphore), each client converts its samples into a
+ * private slot of the shared memory area and the touched slave period
+ * is then rebuilt as the saturated sum over all slots.
+ *
+ * Every slave period has a generation counter which a client bumps after
+ * writing its slot.  The rebuild of a period is combined: whoever finds
+ * the period busy just returns, and the client doing the rebuild repeats
+ * it until the generation stays stable, so nobody waits on the mixing
+ * path.  Data left behind by clients which stopped writing is ignored
+ * using a stamp per slot and period recording the buffer cycle the data
+ * belongs to.  The cycle is counted in the shared memory, so it doesn't
+ * fall back when the slave position wraps the boundary (which is not
+ * the same for 32 and 64-bit clients), and only the part of a period
+ * not played yet and written in that cycle is rebuilt.
+ *
+ * A slot is owned by holding its semaphore in a SysV set with SEM_UNDO,
+ * so the kernel frees the slots of crashed clients, also across PID
+ * namespaces.  The set uses the key ipc_key + 1 like the sum memory.
+ *
+ * Shared memory layout (in 32-bit words):
+ *
+ *   cycle			newest buffer cycle written (wraps at 2^32)
+ *   gen[chunks]		generation counter per slave period
+ *   cur[chunks]		newest stamp published for the period
+ *   busy[chunks]		slot + 1 of the client rebuilding the period, 0 = none
+ *   stamp[slots][chunks]	buffer cycle of the slot data
+ *   fill[slots][chunks]	frames of the period written in that cycle
+ *   data[slots][frames * channels]	samples in the sum buffer scale
+ */
+
+#define DMIX_SLOT_BLOCK		1024	/* reduction block in samples */
+#define DMIX_SLOT_ALIGN(x)	(((x) + 15) & ~15)
+#define DMIX_SLOT_LAG		2	/* cycles a client may lag behind */
+
+static unsigned int dmix_slots_chunks(snd_pcm_direct_share_t *shm)
+{
+	return (shm->s.buffer_size + shm->s.period_size - 1) / shm->s.period_size;
+}
+
+static size_t dmix_slots_header(snd_pcm_direct_share_t *shm)
+{
+	unsigned int slots = shm->u.dmix.mix_slots;
+	unsigned int chunks = dmix_slots_chunks(shm);
+
+	return DMIX_SLOT_ALIGN(1 + 3 * chunks + 2 * slots * chunks);
+}
+
+static size_t dmix_slots_len(snd_pcm_direct_share_t *shm)
+{
+	return DMIX_SLOT_ALIGN(shm->s.buffer_size * shm->s.channels);
+}
+
+static size_t dmix_slots_shm_size(snd_pcm_direct_share_t *shm)
+{
+	return (dmix_slots_header(shm) +
+		shm->u.dmix.mix_slots * dmix_slots_len(shm)) * sizeof(signed int);
+}
+
+static inline unsigned int *dmix_slots_cycle(snd_pcm_direct_t *dmix)
+{
+	return (unsigned int *)dmix->u.dmix.sum_buffer;
+}
+
+static inline unsigned int *dmix_slots_gen(snd_pcm_direct_t *dmix)
+{
+	return dmix_slots_cycle(dmix) + 1;
+}
+
+static inline unsigned int *dmix_slots_cur(snd_pcm_direct_t *dmix)
+{
+	return dmix_slots_gen(dmix) + dmix_slots_chunks(dmix->shmptr);
+}
+
+static inline unsigned int *dmix_slots_busy(snd_pcm_direct_t *dmix)
+{
+	return dmix_slots_cur(dmix) + dmix_slots_chunks(dmix->shmptr);
+}
+
+static inline unsigned int *dmix_slots_stamp(snd_pcm_direct_t *dmix,
+					     unsigned int slot)
+{
+	unsigned int chunks = dmix_slots_chunks(dmix->shmptr);
+
+	return dmix_slots_busy(dmix) + chunks + slot * chunks;
+}
+
+static inline unsigned int *dmix_slots_fill(snd_pcm_direct_t *dmix,
+					    unsigned int slot)
+{
+	snd_pcm_direct_share_t *shm = dmix->shmptr;
+	unsigned int chunks = dmix_slots_chunks(shm);
+
+	return dmix_slots_stamp(dmix, 0) + (shm->u.dmix.mix_slots + slot) * chunks;
+}
+
+static inline signed int *dmix_slots_data(snd_pcm_direct_t *dmix,
+					  unsigned int slot)
+{
+	snd_pcm_direct_share_t *shm = dmix->shmptr;
+
+	return dmix->u.dmix.sum_buffer + dmix_slots_header(shm) +
+		slot * dmix_slots_len(shm);
+}
+
+static void dmix_slots_sem_discard(snd_pcm_direct_t *dmix)
+{
+	if (dmix->u.dmix.semid_slots < 0)
+		return;
+	semctl(dmix->u.dmix.semid_slots, 0, IPC_RMID, NULL);
+	dmix->u.dmix.semid_slots = -1;
+}
+
+/*
+ * tell whether the client owning the given slot is still there
+ */
+static int dmix_slots_alive(snd_pcm_direct_t *dmix, unsigned int slot)
+{
+	return semctl(dmix->u.dmix.semid_slots, slot, GETVAL) != 0;
+}
+
+/*
+ * claim a free slot; called with the client semaphore held
+ */
+static int dmix_slots_claim(snd_pcm_direct_t *dmix)
+{
+	struct sembuf op[2] = { { 0, 0, IPC_NOWAIT },
+				{ 0, 1, SEM_UNDO | IPC_NOWAIT } };
+	unsigned int *busy = dmix_slots_busy(dmix);
+	unsigned int slot, chunk, chunks, holder, old;
+
+	for (slot = 0; slot < dmix->shmptr->u.dmix.mix_slots; slot++) {
+		op[0].sem_num = op[1].sem_num = slot;
+		if (!semop(dmix->u.dmix.semid_slots, op, 2))
+			break;
+		if (errno != EAGAIN)
+			return -errno;
+	}
+	if (slot >= dmix->shmptr->u.dmix.mix_slots)
+		return -EBUSY;
+	chunks = dmix_slots_chunks(dmix->shmptr);
+	/* the data of the previous owner belongs to no recent cycle */
+	old = __atomic_load_n(dmix_slots_cycle(dmix), __ATOMIC_RELAXED) + 0x80000000U;
+	for (chunk = 0; chunk < chunks; chunk++)
+		__atomic_store_n(dmix_slots_stamp(dmix, slot) + chunk, old,
+				 __ATOMIC_RELAXED);
+	/* drop the rebuilds a crashed previous owner left behind */
+	for (chunk = 0; chunk < chunks; chunk++) {
+		holder = slot + 1;
+		__atomic_compare_exchange_n(busy + chunk, &holder, 0, 0,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	}
+	dmix->u.dmix.slot = slot;
+	return 0;
+}
+
+static void dmix_slots_release(snd_pcm_direct_t *dmix)
+{
+	struct sembuf op = { 0, -1, SEM_UNDO | IPC_NOWAIT };
+
+	if (dmix->u.dmix.slot < 0)
+		return;
+	op.sem_num = dmix->u.dmix.slot;
+	semop(dmix->u.dmix.semid_slots, &op, 1);
+	dmix->u.dmix.slot = -1;
+}
+
+/*
+ * publish a write of the given stamp; a client lagging behind must not
+ * move the period back to an older buffer cycle
+ */
+static void dmix_slots_publish(unsigned int *cur, unsigned int stamp)
+{
+	unsigned int old = __atomic_load_n(cur, __ATOMIC_RELAXED);
+
+	while ((int)(stamp - old) > 0 &&
+	       !__atomic_compare_exchange_n(cur, &old, stamp, 1,
+					    __ATOMIC_RELEASE,
+					    __ATOMIC_RELAXED))
+		;
+}
+
+/*
+ * count of buffer cycles all the clients agree on: the slave boundary is
+ * the buffer size times a power of two, the smallest for 32-bit clients
+ */
+static unsigned int dmix_slots_cycles(snd_pcm_direct_share_t *shm)
+{
+	unsigned long long buffer_size = shm->s.buffer_size;
+	unsigned int cycles = 1;
+
+	while ((2ULL * cycles + 1) * buffer_size <= 0x7fffffffULL)
+		cycles *= 2;
+	return cycles;
+}
+
+/*
+ * distance in cycles from the shared cycle counter to the cycle of the
+ * slave position; a position at most DMIX_SLOT_LAG cycles behind is a
+ * lagging client, anything else is ahead
+ */
+static int dmix_slots_cycle_diff(snd_pcm_direct_t *dmix,
+				 snd_pcm_uframes_t slave_ptr,
+				 unsigned int cycle)
+{
+	unsigned int mask = dmix_slots_cycles(dmix->shmptr) - 1;
+	unsigned int d;
+
+	d = ((unsigned int)(slave_ptr / dmix->shmptr->s.buffer_size) - cycle) & mask;
+	if (mask >= 4 * DMIX_SLOT_LAG && mask - d < DMIX_SLOT_LAG)
+		return -(int)(mask + 1 - d);
+	return d;
+}
+
+/*
+ * stamp of the buffer cycle of the slave position, moving the shared
+ * counter forward
+ */
+static unsigned int dmix_slots_cycle_of(snd_pcm_direct_t *dmix,
+					snd_pcm_uframes_t slave_ptr)
+{
+	unsigned int *cycle = dmix_slots_cycle(dmix);
+	unsigned int old = __atomic_load_n(cycle, __ATOMIC_ACQUIRE);
+	unsigned int stamp = old + dmix_slots_cycle_diff(dmix, slave_ptr, old);
+
+	dmix_slots_publish(cycle, stamp);
+	return stamp;
+}
+
+/*
+ * run op(dst sample, src sample) over size samples; the packed case has
+ * its own loop so that it can be vectorized (steps are in elements)
+ */
+#define DMIX_SLOTS_LOOP(d, dstep, s, sstep, op) \
+	do { \
+		if ((dstep) == 1 && (sstep) == 1) { \
+			for (i = 0; i < size; i++) \
+				op(d[i], s[i]); \
+		} else { \
+			for (i = 0; i < size; i++) \
+				op(d[i * (dstep)], s[i * (sstep)]); \
+		} \
+	} while (0)
+
+#define SLOT_LOAD_S16(d, s)		((d) = (signed short)(s))
+#define SLOT_LOAD_S16_SWAP(d, s)	((d) = (signed short) bswap_16(s))
+#define SLOT_LOAD_S32(d, s)		((d) = (signed int)(s) >> 8)
+#define SLOT_LOAD_S32_SWAP(d, s)	((d) = (signed int) bswap_32(s) >> 8)
+#define SLOT_LOAD_U8(d, s)		((d) = (s) - 0x80)
+
+#define SLOT_CLAMP(x, lo, hi)	((x) > (hi) ? (hi) : (x) < (lo) ? (lo) : (x))
+#define SLOT_STORE_S16(d, s)		((d) = SLOT_CLAMP(s, -0x8000, 0x7fff))
+#define SLOT_STORE_S16_SWAP(d, s)	((d) = bswap_16(SLOT_CLAMP(s, -0x8000, 0x7fff)))
+#define SLOT_STORE_S32(d, s) \
+	((d) = (s) > 0x7fffff ? 0x7fffffff : \
+	       (s) < -0x800000 ? 0x80000000 : (unsigned int)(s) << 8)
+#define SLOT_STORE_S32_SWAP(d, s) \
+	((d) = bswap_32((s) > 0x7fffff ? 0x7fffffff : \
+			(s) < -0x800000 ? 0x80000000 : (unsigned int)(s) << 8))
+#define SLOT_STORE_U8(d, s)		((d) = SLOT_CLAMP(s, -0x80, 0x7f) + 0x80)
+
+/*
+ * convert client samples to the sum buffer scale
+ */
+static SND_PCM_VECTORIZE void
+dmix_slots_load(snd_pcm_format_t format, signed int *dst, size_t dst_step,
+		const unsigned char *src, size_t src_step, unsigned int size)
+{
+	int swap = !snd_pcm_format_cpu_endian(format);
+	const unsigned short *s16 = (const unsigned short *)src;
+	const unsigned int *s32 = (const unsigned int *)src;
+	unsigned int i;
+
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		if (swap)
+			DMIX_SLOTS_LOOP(dst, dst_step, s16, src_step / 2, SLOT_LOAD_S16_SWAP);
+		else
+			DMIX_SLOTS_LOOP(dst, dst_step, s16, src_step / 2, SLOT_LOAD_S16);
+		break;
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+		if (swap)
+			DMIX_SLOTS_LOOP(dst, dst_step, s32, src_step / 4, SLOT_LOAD_S32_SWAP);
+		else
+			DMIX_SLOTS_LOOP(dst, dst_step, s32, src_step / 4, SLOT_LOAD_S32);
+		break;
+	case SND_PCM_FORMAT_S24_LE:
+	case SND_PCM_FORMAT_S24_3LE:
+		for (i = 0; i < size; i++, dst += dst_step, src += src_step)
+			*dst = src[0] | (src[1] << 8) | (((signed char *)src)[2] << 16);
+		break;
+	case SND_PCM_FORMAT_U8:
+		DMIX_SLOTS_LOOP(dst, dst_step, src, src_step, SLOT_LOAD_U8);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * saturate the reduced sums and write them in the slave format
+ */
+static SND_PCM_VECTORIZE void
+dmix_slots_store(snd_pcm_format_t format, unsigned char *dst, size_t dst_step,
+		 const signed int *src, size_t src_step, unsigned int size)
+{
+	int swap = !snd_pcm_format_cpu_endian(format);
+	unsigned short *d16 = (unsigned short *)dst;
+	unsigned int *d32 = (unsigned int *)dst;
+	signed int sample;
+	unsigned int i;
+
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		if (swap)
+			DMIX_SLOTS_LOOP(d16, dst_step / 2, src, src_step, SLOT_STORE_S16_SWAP);
+		else
+			DMIX_SLOTS_LOOP(d16, dst_step / 2, src, src_step, SLOT_STORE_S16);
+		break;
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+		if (swap)
+			DMIX_SLOTS_LOOP(d32, dst_step / 4, src, src_step, SLOT_STORE_S32_SWAP);
+		else
+			DMIX_SLOTS_LOOP(d32, dst_step / 4, src, src_step, SLOT_STORE_S32);
+		break;
+	case SND_PCM_FORMAT_S24_LE:
+	case SND_PCM_FORMAT_S24_3LE:
+		for (i = 0; i < size; i++, dst += dst_step, src += src_step) {
+			sample = SLOT_CLAMP(*src, -0x800000, 0x7fffff);
+			dst[0] = sample;
+			dst[1] = sample >> 8;
+			dst[2] = sample >> 16;
+		}
+		break;
+	case SND_PCM_FORMAT_U8:
+		DMIX_SLOTS_LOOP(dst, dst_step, src, src_step, SLOT_STORE_U8);
+		break;
+	default:
+		break;
+	}
+}
+
+static SND_PCM_VECTORIZE void
+dmix_slots_add(signed int *acc, const signed int *src, unsigned int size)
+{
+	unsigned int i;
+
+	for (i = 0; i < size; i++)
+		acc[i] += src[i];
+}
+
+/*
+ * sum the slots holding data of the given stamp and write the result
+ * to the slave buffer region from dst_ofs up to the end of the data
+ * written in the period
+ */
+static void dmix_slots_reduce(snd_pcm_direct_t *dmix,
+			      const snd_pcm_channel_area_t *dst_areas,
+			      snd_pcm_uframes_t dst_ofs,
+			      unsigned int chunk, unsigned int stamp)
+{
+	snd_pcm_direct_share_t *shm = dmix->shmptr;
+	unsigned int slots = shm->u.dmix.mix_slots;
+	unsigned int channels = shm->s.channels;
+	unsigned int bytes = snd_pcm_format_physical_width(shm->s.format) / 8;
+	unsigned int block = DMIX_SLOT_BLOCK / channels;
+	const signed int **valid = alloca(slots * sizeof(*valid));
+	signed int acc[DMIX_SLOT_BLOCK];
+	snd_pcm_uframes_t ofs, end, fill, frames;
+	unsigned int slot, nvalid, chn, samples;
+
+	end = 0;
+	for (slot = nvalid = 0; slot < slots; slot++) {
+		if (__atomic_load_n(dmix_slots_stamp(dmix, slot) + chunk,
+				    __ATOMIC_ACQUIRE) != stamp)
+			continue;
+		valid[nvalid++] = dmix_slots_data(dmix, slot);
+		fill = chunk * shm->s.period_size +
+			__atomic_load_n(dmix_slots_fill(dmix, slot) + chunk,
+					__ATOMIC_ACQUIRE);
+		if (fill > end)
+			end = fill;
+	}
+	for (ofs = dst_ofs; ofs < end; ofs += frames) {
+		frames = end - ofs;
+		if (frames > block)
+			frames = block;
+		samples = frames * channels;
+		memcpy(acc, valid[0] + ofs * channels, samples * sizeof(*acc));
+		for (slot = 1; slot < nvalid; slot++)
+			dmix_slots_add(acc, valid[slot] + ofs * channels, samples);
+		if (dmix->interleaved) {
+			dmix_slots_store(shm->s.format,
+					 (unsigned char *)dst_areas[0].addr +
+					 ofs * channels * bytes,
+					 bytes, acc, 1, samples);
+			continue;
+		}
+		for (chn = 0; chn < channels; chn++) {
+			dmix_slots_store(shm->s.format,
+					 snd_pcm_channel_area_addr(&dst_areas[chn], ofs),
+					 dst_areas[chn].step / 8,
+					 acc + chn, channels, frames);
+		}
+	}
+}
+
+/*
+ * rebuild the slave period from the slots of its newest stamp, leaving
+ * alone the frames already played: the driver silences them, playing
+ * them again after an underrun or at the end of the stream is wrong
+ */
+static void dmix_slots_rebuild_once(snd_pcm_direct_t *dmix,
+				    const snd_pcm_channel_area_t *dst_areas,
+				    unsigned int chunk)
+{
+	snd_pcm_direct_share_t *shm = dmix->shmptr;
+	snd_pcm_uframes_t ofs = chunk * shm->s.period_size;
+	snd_pcm_uframes_t hw_ptr = dmix->slave_hw_ptr;
+	unsigned int stamp;
+	int d;
+
+	stamp = __atomic_load_n(dmix_slots_cur(dmix) + chunk, __ATOMIC_ACQUIRE);
+	d = dmix_slots_cycle_diff(dmix, hw_ptr, stamp);
+	if (d > 0)
+		return;
+	if (d == 0 && hw_ptr % shm->s.buffer_size > ofs)
+		ofs = hw_ptr % shm->s.buffer_size;
+	dmix_slots_reduce(dmix, dst_areas, ofs, chunk, stamp);
+}
+
+/*
+ * rebuild a slave period unless another client is already doing it;
+ * that one notices the new generation and runs once more
+ */
+static void dmix_slots_rebuild(snd_pcm_direct_t *dmix,
+			       const snd_pcm_channel_area_t *dst_areas,
+			       unsigned int chunk)
+{
+	unsigned int *gen = dmix_slots_gen(dmix) + chunk;
+	unsigned int *busy = dmix_slots_busy(dmix) + chunk;
+	unsigned int self = dmix->u.dmix.slot + 1;
+	unsigned int holder, g;
+
+	for (;;) {
+		holder = 0;
+		if (!__atomic_compare_exchange_n(busy, &holder, self, 0,
+						 __ATOMIC_ACQUIRE,
+						 __ATOMIC_RELAXED)) {
+			/* take over from a crashed client */
+			if (!dmix_slots_alive(dmix, holder - 1) &&
+			    __atomic_compare_exchange_n(busy, &holder, 0, 0,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				continue;
+			return;
+		}
+		do {
+			g = __atomic_load_n(gen, __ATOMIC_SEQ_CST);
+			dmix_slots_rebuild_once(dmix, dst_areas, chunk);
+		} while (__atomic_load_n(gen, __ATOMIC_SEQ_CST) != g);
+		__atomic_store_n(busy, 0, __ATOMIC_SEQ_CST);
+		/* a writer may have given up just before the release */
+		if (__atomic_load_n(gen, __ATOMIC_SEQ_CST) == g)
+			return;
+	}
+}
+
+/*
+ * write (or with remix, withdraw) the client samples at the absolute
+ * slave position slave_ptr and rebuild the touched periods; the region
+ * must not cross the end of the client or slave ring buffer
+ */
+static void mix_slots_areas(snd_pcm_direct_t *dmix,
+			    const snd_pcm_channel_area_t *src_areas,
+			    const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t src_ofs,
+			    snd_pcm_uframes_t slave_ptr,
+			    snd_pcm_uframes_t size,
+			    int remix)
+{
+	snd_pcm_direct_share_t *shm = dmix->shmptr;
+	snd_pcm_format_t format = shm->s.format;
+	unsigned int channels = shm->s.channels;
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	snd_pcm_uframes_t period_size = shm->s.period_size;
+	snd_pcm_uframes_t buffer_size = shm->s.buffer_size;
+	snd_pcm_uframes_t dst_ofs, transfer, chunk_end;
+	unsigned int chunk, stamp, chn, dchn;
+	unsigned int *own_stamp, *own_fill;
+	signed int *data;
+
+	own_stamp = dmix_slots_stamp(dmix, dmix->u.dmix.slot);
+	own_fill = dmix_slots_fill(dmix, dmix->u.dmix.slot);
+	data = dmix_slots_data(dmix, dmix->u.dmix.slot);
+	stamp = dmix_slots_cycle_of(dmix, slave_ptr);
+	dst_ofs = slave_ptr % buffer_size;
+	while (size > 0) {
+		chunk = dst_ofs / period_size;
+		chunk_end = (chunk + 1) * period_size;
+		if (chunk_end > buffer_size)
+			chunk_end = buffer_size;
+		transfer = chunk_end - dst_ofs;
+		if (transfer > size)
+			transfer = size;
+		if (remix) {
+			if (own_stamp[chunk] == stamp)
+				memset(data + dst_ofs * channels, 0,
+				       transfer * channels * sizeof(*data));
+		} else {
+			if (own_stamp[chunk] != stamp) {
+				/* first write in this cycle, drop the old data */
+				memset(data + chunk * period_size * channels, 0,
+				       (dst_ofs - chunk * period_size) * channels * sizeof(*data));
+				memset(data + (dst_ofs + transfer) * channels, 0,
+				       (chunk_end - dst_ofs - transfer) * channels * sizeof(*data));
+				__atomic_store_n(own_fill + chunk, 0, __ATOMIC_RELAXED);
+				__atomic_store_n(own_stamp + chunk, stamp, __ATOMIC_RELEASE);
+			}
+			if (dmix->interleaved) {
+				dmix_slots_load(format, data + dst_ofs * channels, 1,
+						(unsigned char *)src_areas[0].addr +
+						src_ofs * channels * bytes,
+						bytes, transfer * channels);
+			} else {
+				for (chn = 0; chn < dmix->channels; chn++) {
+					dchn = dmix->bindings ? dmix->bindings[chn] : chn;
+					if (dchn >= channels)
+						continue;
+					dmix_slots_load(format, data + dst_ofs * channels + dchn,
+							channels,
+							snd_pcm_channel_area_addr(&src_areas[chn], src_ofs),
+							src_areas[chn].step / 8, transfer);
+				}
+			}
+			if (dst_ofs + transfer - chunk * period_size > own_fill[chunk])
+				__atomic_store_n(own_fill + chunk,
+						 dst_ofs + transfer - chunk * period_size,
+						 __ATOMIC_RELEASE);
+		}
+		dmix_slots_publish(dmix_slots_cur(dmix) + chunk, stamp);
+		__atomic_add_fetch(dmix_slots_gen(dmix) + chunk, 1, __ATOMIC_SEQ_CST);
+		dmix_slots_rebuild(dmix, dst_areas, chunk);
+		src_ofs += transfer;
+		dst_ofs += transfer;
+		size -= transfer;
+	}
+}
@@ -597,7 +597,7 @@ static int snd_pcm_dshare_htimestamp(snd_pcm_t *pcm,
 		if (ok && *avail == avail1)
 			break;
 		*avail = avail1;
-		*tstamp = snd_pcm_hw_fast_tstamp(dshare->spcm);
+		*tstamp = snd_pcm_direct_slave_tstamp(dshare->spcm);
 		ok = 1;
 	}
 	return 0;
@@ -734,8 +734,8 @@ int snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
 			goto _err;
 		}
 	
-		if (snd_pcm_type(spcm) != SND_PCM_TYPE_HW) {
-			SNDERR("dshare plugin can be only connected to hw plugin");
+		if (!snd_pcm_direct_slave_supported(spcm)) {
+			SNDERR("dshare plugin can be only connected to hw or virt plugin");
 			goto _err;
 		}
 		
@@ -788,8 +788,8 @@ int snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
 				SNDERR("unable to open slave");
 				goto _err;
 			}
-			if (snd_pcm_type(spcm) != SND_PCM_TYPE_HW) {
-				SNDERR("dshare plugin can be only connected to hw plugin");
+			if (!snd_pcm_direct_slave_supported(spcm)) {
+				SNDERR("dshare plugin can be only connected to hw or virt plugin");
 				ret = -EINVAL;
 				goto _err;
 			}
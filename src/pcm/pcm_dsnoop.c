@@ -65,7 +65,7 @@ static int snoop_timestamp(snd_pcm_t *pcm)
 		if (ptr1 == ptr2)
 			break;
 		ptr1 = ptr2;
-		dsnoop->update_tstamp = snd_pcm_hw_fast_tstamp(dsnoop->spcm);
+		dsnoop->update_tstamp = snd_pcm_direct_slave_tstamp(dsnoop->spcm);
 	}
 	dsnoop->slave_hw_ptr = ptr1;
 	return 0;
@@ -476,7 +476,7 @@ static int snd_pcm_dsnoop_htimestamp(snd_pcm_t *pcm,
 		if (ok && *avail == avail1)
 			break;
 		*avail = avail1;
-		*tstamp = snd_pcm_hw_fast_tstamp(dsnoop->spcm);
+		*tstamp = snd_pcm_direct_slave_tstamp(dsnoop->spcm);
 		ok = 1;
 	}
 	return 0;
@@ -602,8 +602,8 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 			goto _err;
 		}
 	
-		if (snd_pcm_type(spcm) != SND_PCM_TYPE_HW) {
-			SNDERR("dsnoop plugin can be only connected to hw plugin");
+		if (!snd_pcm_direct_slave_supported(spcm)) {
+			SNDERR("dsnoop plugin can be only connected to hw or virt plugin");
 			goto _err;
 		}
 		
@@ -656,8 +656,8 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 				SNDERR("unable to open slave");
 				goto _err;
 			}
-			if (snd_pcm_type(spcm) != SND_PCM_TYPE_HW) {
-				SNDERR("dsnoop plugin can be only connected to hw plugin");
+			if (!snd_pcm_direct_slave_supported(spcm)) {
+				SNDERR("dsnoop plugin can be only connected to hw or virt plugin");
 				ret = -EINVAL;
 				goto _err;
 			}
@@ -31,6 +31,10 @@
 #include <string.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#include <semaphore.h>
+#endif
 
 #ifndef PIC
 /* entry for static linking */
@@ -90,6 +94,26 @@ typedef struct {
 	struct wav_fmt wav_header;
 	size_t filelen;
 	char ifmmap_overwritten;
+	/* asynchronous writer: frames leaving wbuf are queued to a ring
+	 * (single producer, single consumer) which is written out by a
+	 * background thread, so the stream never blocks on the file
+	 */
+	int async;
+	snd_pcm_uframes_t async_frames;
+	snd_pcm_uframes_t async_dropped;
+#ifdef HAVE_LIBPTHREAD
+	char *async_buf;
+	size_t async_size;		/* power of two, in bytes */
+	size_t async_head;		/* written by the stream */
+	size_t async_tail;		/* written by the writer thread */
+	int async_running;
+	int async_quit;
+	int async_flush;
+	int async_err;
+	pthread_t async_thread;
+	sem_t async_wake;
+	sem_t async_idle;
+#endif
 } snd_pcm_file_t;
 
 #if __BYTE_ORDER == __LITTLE_ENDIAN
@@ -410,6 +434,204 @@ static void fixup_wav_header(snd_pcm_t *pcm)
 			return;
 	}
 }
+
+#ifdef HAVE_LIBPTHREAD
+static void async_sem_wait(sem_t *sem)
+{
+	while (sem_wait(sem) < 0 && errno == EINTR)
+		;
+}
+
+/* writer thread: empty the ring into the file */
+static void snd_pcm_file_async_write(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	size_t head, tail, pos, n;
+	ssize_t res;
+
+	for (;;) {
+		head = __atomic_load_n(&file->async_head, __ATOMIC_ACQUIRE);
+		tail = file->async_tail;
+		if (head == tail)
+			break;
+		if (file->format == SND_PCM_FILE_FORMAT_WAV &&
+		    !file->wav_header.fmt && !file->async_err) {
+			if (write_wav_header(pcm) < 0)
+				__atomic_store_n(&file->async_err, -EIO,
+						 __ATOMIC_RELEASE);
+		}
+		if (file->async_err) {
+			/* discard, the error is reported to the stream */
+			__atomic_store_n(&file->async_tail, head, __ATOMIC_RELEASE);
+			continue;
+		}
+		pos = tail & (file->async_size - 1);
+		n = head - tail;
+		if (n > file->async_size - pos)
+			n = file->async_size - pos;
+		res = safe_write(file->fd, file->async_buf + pos, n);
+		if (res <= 0) {
+			SYSERR("%s write failed, file data may be corrupt", file->fname);
+			__atomic_store_n(&file->async_err, res < 0 ? (int)res : -EIO,
+					 __ATOMIC_RELEASE);
+			continue;
+		}
+		file->filelen += res;
+		__atomic_store_n(&file->async_tail, tail + res, __ATOMIC_RELEASE);
+	}
+}
+
+static void *snd_pcm_file_async_thread(void *data)
+{
+	snd_pcm_t *pcm = data;
+	snd_pcm_file_t *file = pcm->private_data;
+	int quit, flush;
+
+	for (;;) {
+		async_sem_wait(&file->async_wake);
+		/* one pass empties the ring, fold the pending wakeups */
+		while (sem_trywait(&file->async_wake) == 0)
+			;
+		quit = __atomic_load_n(&file->async_quit, __ATOMIC_SEQ_CST);
+		flush = __atomic_exchange_n(&file->async_flush, 0, __ATOMIC_SEQ_CST);
+		snd_pcm_file_async_write(pcm);
+		if (flush) {
+			/* keep the header valid at drain points */
+			if (file->wav_header.fmt) {
+				fixup_wav_header(pcm);
+				lseek(file->fd, 0, SEEK_END);
+			}
+			sem_post(&file->async_idle);
+		}
+		if (quit)
+			break;
+	}
+	return NULL;
+}
+
+static int snd_pcm_file_async_start(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	size_t bytes;
+	int err;
+
+	/* the PCM itself is not set up yet, size the ring from the slave */
+	bytes = snd_pcm_frames_to_bytes(file->gen.slave, file->async_frames ?
+					file->async_frames :
+					file->gen.slave->buffer_size * 8);
+	for (file->async_size = 4096; file->async_size < bytes; )
+		file->async_size *= 2;
+	file->async_buf = malloc(file->async_size);
+	if (!file->async_buf)
+		return -ENOMEM;
+	file->async_head = file->async_tail = 0;
+	file->async_quit = file->async_flush = file->async_err = 0;
+	sem_init(&file->async_wake, 0, 0);
+	sem_init(&file->async_idle, 0, 0);
+	err = pthread_create(&file->async_thread, NULL,
+			     snd_pcm_file_async_thread, pcm);
+	if (err) {
+		SNDERR("cannot create the writer thread for %s", file->fname);
+		sem_destroy(&file->async_wake);
+		sem_destroy(&file->async_idle);
+		free(file->async_buf);
+		file->async_buf = NULL;
+		return -err;
+	}
+	file->async_running = 1;
+	return 0;
+}
+
+/* wait until the writer thread has written everything queued so far */
+static void snd_pcm_file_async_flush(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+
+	if (!file->async_running)
+		return;
+	__atomic_store_n(&file->async_flush, 1, __ATOMIC_SEQ_CST);
+	sem_post(&file->async_wake);
+	async_sem_wait(&file->async_idle);
+}
+
+static void snd_pcm_file_async_stop(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+
+	if (!file->async_running)
+		return;
+	__atomic_store_n(&file->async_quit, 1, __ATOMIC_SEQ_CST);
+	sem_post(&file->async_wake);
+	pthread_join(file->async_thread, NULL);
+	sem_destroy(&file->async_wake);
+	sem_destroy(&file->async_idle);
+	free(file->async_buf);
+	file->async_buf = NULL;
+	file->async_running = 0;
+}
+
+/*
+ * queue bytes from wbuf to the writer thread; what does not fit in the
+ * ring is dropped (whole frames) and counted, the stream never waits
+ */
+static int snd_pcm_file_async_queue(snd_pcm_t *pcm, size_t bytes)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	size_t head = file->async_head;
+	size_t space, n, pos, cont, len, part;
+	const char *src;
+	int err;
+
+	err = __atomic_load_n(&file->async_err, __ATOMIC_ACQUIRE);
+	if (err < 0) {
+		file->wbuf_used_bytes = 0;
+		file->file_ptr_bytes = 0;
+		return err;
+	}
+	space = file->async_size -
+		(head - __atomic_load_n(&file->async_tail, __ATOMIC_ACQUIRE));
+	n = bytes;
+	if (n > space)
+		n = snd_pcm_frames_to_bytes(pcm, snd_pcm_bytes_to_frames(pcm, space));
+	file->async_dropped += snd_pcm_bytes_to_frames(pcm, bytes - n);
+
+	while (bytes > 0) {
+		cont = file->wbuf_size_bytes - file->file_ptr_bytes;
+		if (cont > bytes)
+			cont = bytes;
+		/* the leading n bytes are queued, the rest is dropped */
+		len = cont < n ? cont : n;
+		n -= len;
+		src = file->wbuf + file->file_ptr_bytes;
+		while (len > 0) {
+			pos = head & (file->async_size - 1);
+			part = file->async_size - pos;
+			if (part > len)
+				part = len;
+			memcpy(file->async_buf + pos, src, part);
+			src += part;
+			head += part;
+			len -= part;
+		}
+		bytes -= cont;
+		file->wbuf_used_bytes -= cont;
+		file->file_ptr_bytes += cont;
+		if (file->file_ptr_bytes == file->wbuf_size_bytes)
+			file->file_ptr_bytes = 0;
+	}
+	__atomic_store_n(&file->async_head, head, __ATOMIC_RELEASE);
+	sem_post(&file->async_wake);
+	return 0;
+}
+#else
+static void snd_pcm_file_async_flush(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+{
+}
+
+static void snd_pcm_file_async_stop(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+{
+}
+#endif /* HAVE_LIBPTHREAD */
 #endif /* DOC_HIDDEN */
 
 
@@ -421,6 +643,11 @@ static int snd_pcm_file_write_bytes(snd_pcm_t *pcm, size_t bytes)
 	snd_pcm_sframes_t err = 0;
 	assert(bytes <= file->wbuf_used_bytes);
 
+#ifdef HAVE_LIBPTHREAD
+	if (file->async_running)
+		return snd_pcm_file_async_queue(pcm, bytes);
+#endif
+
 	if (file->format == SND_PCM_FILE_FORMAT_WAV &&
 	    !file->wav_header.fmt) {
 		err = write_wav_header(pcm);
@@ -492,6 +719,11 @@ static int snd_pcm_file_add_frames(snd_pcm_t *pcm,
 static int snd_pcm_file_close(snd_pcm_t *pcm)
 {
 	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_file_async_stop(pcm);
+	if (file->async_dropped)
+		SNDERR("%s: %lu frames dropped by the writer, file data may be incomplete",
+		       file->fname ? file->fname : "file",
+		       (unsigned long)file->async_dropped);
 	if (file->fname) {
 		if (file->wav_header.fmt)
 			fixup_wav_header(pcm);
@@ -542,6 +774,7 @@ static int snd_pcm_file_drain(snd_pcm_t *pcm)
 		__snd_pcm_lock(pcm);
 		snd_pcm_file_write_bytes(pcm, file->wbuf_used_bytes);
 		assert(file->wbuf_used_bytes == 0);
+		snd_pcm_file_async_flush(pcm);
 		__snd_pcm_unlock(pcm);
 	}
 	return err;
@@ -737,6 +970,7 @@ static int snd_pcm_file_mmap_begin(snd_pcm_t *pcm, const snd_pcm_channel_area_t
 static int snd_pcm_file_hw_free(snd_pcm_t *pcm)
 {
 	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_file_async_stop(pcm);
 	free(file->wbuf);
 	free(file->wbuf_areas);
 	free(file->final_fname);
@@ -795,6 +1029,15 @@ static int snd_pcm_file_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 			return err;
 		}
 	}
+#ifdef HAVE_LIBPTHREAD
+	if (file->async) {
+		err = snd_pcm_file_async_start(pcm);
+		if (err < 0) {
+			snd_pcm_file_hw_free(pcm);
+			return err;
+		}
+	}
+#endif
 
 	/* pointer may have changed - e.g if plug is used. */
 	snd_pcm_unlink_hw_ptr(pcm, file->gen.slave);
@@ -816,6 +1059,12 @@ static void snd_pcm_file_dump(snd_pcm_t *pcm, snd_output_t *out)
 	if (file->final_fname)
 		snd_output_printf(out, "Final file PCM (file=%s)\n",
 				file->final_fname);
+#ifdef HAVE_LIBPTHREAD
+	if (file->async_running)
+		snd_output_printf(out, "Async writer (ring=%lu frames, dropped=%lu frames)\n",
+				  (unsigned long)snd_pcm_bytes_to_frames(pcm, file->async_size),
+				  (unsigned long)file->async_dropped);
+#endif
 
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
@@ -1006,6 +1255,11 @@ pcm.name {
 	infile INT		# Input file descriptor number
 	[format STR]		# File format ("raw" or "wav")
 	[perm INT]		# Output file permission (octal, def. 0600)
+	[async BOOL]		# Write the file from a background thread
+				# (default false); frames which do not fit
+				# in the ring are dropped and counted
+	[async_buffer INT]	# Ring size in frames for the async writer
+				# (default 8 x slave buffer size)
 }
 \endcode
 
@@ -1043,6 +1297,8 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 	const char *format = NULL;
 	long fd = -1, ifd = -1, trunc = 1;
 	long perm = 0600;
+	long async_buffer = 0;
+	int async = 0;
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		const char *id;
@@ -1103,6 +1359,25 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 			trunc = err;
 			continue;
 		}
+		if (strcmp(id, "async") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return -EINVAL;
+			async = err;
+			continue;
+		}
+		if (strcmp(id, "async_buffer") == 0) {
+			err = snd_config_get_integer(n, &async_buffer);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return err;
+			}
+			if (async_buffer < 0) {
+				SNDERR("The field async_buffer must not be negative");
+				return -EINVAL;
+			}
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1121,6 +1396,12 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 		SNDERR("slave is not defined");
 		return -EINVAL;
 	}
+#ifndef HAVE_LIBPTHREAD
+	if (async) {
+		SNDERR("async writer is not supported without pthread");
+		return -EINVAL;
+	}
+#endif
 	err = snd_pcm_slave_conf(root, slave, &sconf, 0);
 	if (err < 0)
 		return err;
@@ -1135,9 +1416,16 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	err = snd_pcm_file_open(pcmp, name, fname, fd, ifname, ifd,
 				trunc, format, perm, spcm, 1, stream);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	if (async) {
+		snd_pcm_file_t *file = (*pcmp)->private_data;
+		file->async = 1;
+		file->async_frames = async_buffer;
+	}
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_file_open, SND_PCM_DLSYM_VERSION);
@@ -933,6 +933,38 @@ static snd_pcm_sframes_t snd_pcm_hw_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_u
 	return xfern.result;
 }
 
+#ifndef DOC_HIDDEN
+/*
+ * File descriptor for read() and write() transfers, which the driver
+ * accepts for the interleaved access only; used by the io_uring batches.
+ */
+int snd_pcm_hw_xfer_fd(snd_pcm_t *pcm)
+{
+	snd_pcm_hw_t *hw;
+
+	if (pcm->type != SND_PCM_TYPE_HW || !pcm->setup ||
+	    pcm->access != SND_PCM_ACCESS_RW_INTERLEAVED)
+		return -EINVAL;
+	hw = pcm->private_data;
+	return hw->fd;
+}
+
+/* finish a transfer of bytes (or a negative error) done on that fd */
+snd_pcm_sframes_t snd_pcm_hw_xfer_done(snd_pcm_t *pcm, ssize_t bytes)
+{
+	snd_pcm_hw_t *hw = pcm->private_data;
+	int err;
+
+	if (bytes < 0)
+		err = bytes;
+	else
+		err = query_status_and_control_data(hw);
+	if (err < 0)
+		return snd_pcm_check_error(pcm, err);
+	return snd_pcm_bytes_to_frames(pcm, bytes);
+}
+#endif
+
 static bool map_status_data(snd_pcm_hw_t *hw, struct snd_pcm_sync_ptr *sync_ptr,
 			    bool force_fallback)
 {
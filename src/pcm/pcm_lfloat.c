@@ -46,6 +46,12 @@ typedef double double_t;
 const char *_snd_module_pcm_lfloat = "";
 #endif
 
+/* lanes of the dither noise generator */
+#define LFLOAT_DITHER_LANES	16
+
+typedef void (*lfloat_kernel_f)(void *dst, const void *src,
+				unsigned int samples, uint32_t *dither);
+
 typedef struct {
 	/* This field need to be the first */
 	snd_pcm_plugin_t plug;
@@ -56,6 +62,11 @@ typedef struct {
 		     const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
 		     unsigned int channels, snd_pcm_uframes_t frames,
 		     unsigned int get32idx, unsigned int put32floatidx);
+	int dither;
+	lfloat_kernel_f kernel;		/* contiguous samples, native formats */
+	unsigned int src_width;
+	unsigned int dst_width;
+	uint32_t dither_state[LFLOAT_DITHER_LANES];
 } snd_pcm_lfloat_t;
 
 int snd_pcm_lfloat_get_s32_index(snd_pcm_format_t format)
@@ -183,6 +194,243 @@ void snd_pcm_lfloat_convert_float_integer(const snd_pcm_channel_area_t *dst_area
 	}
 }
 
+/*
+ * Kernels for native endian S16, S24 (in 32 bits), S32 and FLOAT, FLOAT64
+ * samples laid out back to back, giving the same results as the generic
+ * converters above.  They are plain loops which the compiler vectorizes,
+ * built a second time for AVX2 on x86.
+ *
+ * The float to integer side can add TPDF dither of one LSB of the S16 or
+ * S24 destination and round to nearest instead of truncating.  The
+ * noise comes from LFLOAT_DITHER_LANES xorshift generators, each 32-bit
+ * output giving two uniform 16-bit values.
+ */
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define LFLOAT_SIMD_X86
+#endif
+
+#define LFLOAT_LOAD_S16(x)	((int32_t)(x) * 65536)
+#define LFLOAT_LOAD_S24(x)	((int32_t)((uint32_t)(x) << 8))
+#define LFLOAT_LOAD_S32(x)	(x)
+#define LFLOAT_STORE_S16(x)	((x) >> 16)
+#define LFLOAT_STORE_S24(x)	((x) >> 8)
+#define LFLOAT_STORE_S32(x)	(x)
+
+#define LFLOAT_TO_FLOAT(isa, attr, name, itype, ftype, load)		\
+static attr void isa##_lfloat_##name(void *dst, const void *src,	\
+				     unsigned int samples,		\
+				     uint32_t *dither ATTRIBUTE_UNUSED)	\
+{									\
+	ftype *restrict d = dst;					\
+	const itype *restrict s = src;					\
+	unsigned int i;							\
+	for (i = 0; i < samples; i++)					\
+		d[i] = (ftype)load(s[i]) * (ftype)(1.0 / 2147483648.0);	\
+}
+
+/* >= 1.0 and <= -1.0 saturate, the rest is truncated like the labels */
+#define LFLOAT_FROM_FLOAT(isa, attr, name, ftype, itype, store, max)	\
+static attr void isa##_lfloat_##name(void *dst, const void *src,	\
+				     unsigned int samples,		\
+				     uint32_t *dither ATTRIBUTE_UNUSED)	\
+{									\
+	itype *restrict d = dst;					\
+	const ftype *restrict s = src;					\
+	unsigned int i;							\
+	for (i = 0; i < samples; i++) {					\
+		ftype v = s[i] * (ftype)2147483648.0;			\
+		ftype c = v > (ftype)-2147483648.0 ? v : (ftype)-2147483648.0; \
+		int32_t r = (int32_t)(c < (max) ? c : (max));		\
+		r = v >= (ftype)2147483648.0 ? 0x7fffffff : r;		\
+		d[i] = store(r);					\
+	}								\
+}
+
+#define LFLOAT_FROM_FLOAT_DITHER(isa, attr, name, ftype, itype, bits)	\
+static attr void isa##_lfloat_##name(void *dst, const void *src,	\
+				     unsigned int samples,		\
+				     uint32_t *dither)			\
+{									\
+	itype *restrict d = dst;					\
+	const ftype *restrict s = src;					\
+	uint32_t *restrict state = dither;				\
+	const ftype lo = -(ftype)(1 << ((bits) - 1));			\
+	const ftype hi = (ftype)((1 << ((bits) - 1)) - 1);		\
+	unsigned int i, j, n;						\
+	for (i = 0; i < samples; i += n) {				\
+		n = samples - i < LFLOAT_DITHER_LANES ?			\
+			samples - i : LFLOAT_DITHER_LANES;		\
+		for (j = 0; j < n; j++) {				\
+			uint32_t x = state[j];				\
+			ftype v, noise;					\
+			int32_t r;					\
+			x ^= x << 13;					\
+			x ^= x >> 17;					\
+			x ^= x << 5;					\
+			state[j] = x;					\
+			noise = (ftype)((int32_t)(x & 0xffff) +		\
+					(int32_t)(x >> 16) - 65535) *	\
+				(ftype)(1.0 / 65536.0);			\
+			v = s[i + j] * -lo + noise + (ftype)0.5;	\
+			v = v > lo ? v : lo;				\
+			v = v < hi ? v : hi;				\
+			r = (int32_t)v;					\
+			d[i + j] = r - ((ftype)r > v);			\
+		}							\
+	}								\
+}
+
+#define LFLOAT_KERNELS(isa, attr)					\
+LFLOAT_TO_FLOAT(isa, attr, s16_float, int16_t, float, LFLOAT_LOAD_S16)	\
+LFLOAT_TO_FLOAT(isa, attr, s24_float, int32_t, float, LFLOAT_LOAD_S24)	\
+LFLOAT_TO_FLOAT(isa, attr, s32_float, int32_t, float, LFLOAT_LOAD_S32)	\
+LFLOAT_TO_FLOAT(isa, attr, s16_double, int16_t, double, LFLOAT_LOAD_S16) \
+LFLOAT_TO_FLOAT(isa, attr, s24_double, int32_t, double, LFLOAT_LOAD_S24) \
+LFLOAT_TO_FLOAT(isa, attr, s32_double, int32_t, double, LFLOAT_LOAD_S32) \
+LFLOAT_FROM_FLOAT(isa, attr, float_s16, float, int16_t,		\
+		  LFLOAT_STORE_S16, 2147483520.0f)			\
+LFLOAT_FROM_FLOAT(isa, attr, float_s24, float, int32_t,		\
+		  LFLOAT_STORE_S24, 2147483520.0f)			\
+LFLOAT_FROM_FLOAT(isa, attr, float_s32, float, int32_t,		\
+		  LFLOAT_STORE_S32, 2147483520.0f)			\
+LFLOAT_FROM_FLOAT(isa, attr, double_s16, double, int16_t,		\
+		  LFLOAT_STORE_S16, 2147483647.0)			\
+LFLOAT_FROM_FLOAT(isa, attr, double_s24, double, int32_t,		\
+		  LFLOAT_STORE_S24, 2147483647.0)			\
+LFLOAT_FROM_FLOAT(isa, attr, double_s32, double, int32_t,		\
+		  LFLOAT_STORE_S32, 2147483647.0)			\
+LFLOAT_FROM_FLOAT_DITHER(isa, attr, float_s16_dither, float, int16_t, 16) \
+LFLOAT_FROM_FLOAT_DITHER(isa, attr, float_s24_dither, float, int32_t, 24) \
+LFLOAT_FROM_FLOAT_DITHER(isa, attr, double_s16_dither, double, int16_t, 16) \
+LFLOAT_FROM_FLOAT_DITHER(isa, attr, double_s24_dither, double, int32_t, 24) \
+static const struct lfloat_kernels isa##_lfloat_kernels = {		\
+	.to_float = {							\
+		{ isa##_lfloat_s16_float, isa##_lfloat_s16_double },	\
+		{ isa##_lfloat_s24_float, isa##_lfloat_s24_double },	\
+		{ isa##_lfloat_s32_float, isa##_lfloat_s32_double },	\
+	},								\
+	.from_float = {							\
+		{ isa##_lfloat_float_s16, isa##_lfloat_double_s16 },	\
+		{ isa##_lfloat_float_s24, isa##_lfloat_double_s24 },	\
+		{ isa##_lfloat_float_s32, isa##_lfloat_double_s32 },	\
+	},								\
+	.from_float_dither = {						\
+		{ isa##_lfloat_float_s16_dither,			\
+		  isa##_lfloat_double_s16_dither },			\
+		{ isa##_lfloat_float_s24_dither,			\
+		  isa##_lfloat_double_s24_dither },			\
+	},								\
+};
+
+/* indexed by [S16, S24, S32][FLOAT, FLOAT64] */
+struct lfloat_kernels {
+	lfloat_kernel_f to_float[3][2];
+	lfloat_kernel_f from_float[3][2];
+	lfloat_kernel_f from_float_dither[2][2];
+};
+
+LFLOAT_KERNELS(generic, SND_PCM_VECTORIZE)
+#ifdef LFLOAT_SIMD_X86
+LFLOAT_KERNELS(avx2, SND_PCM_VECTORIZE __attribute__((target("avx2"))))
+#endif
+
+static int lfloat_int_index(snd_pcm_format_t format)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16:
+		return 0;
+#ifdef SND_LITTLE_ENDIAN
+	case SND_PCM_FORMAT_S24_LE:
+		return 1;
+#endif
+	case SND_PCM_FORMAT_S32:
+		return 2;
+	default:
+		return -1;
+	}
+}
+
+static int lfloat_float_index(snd_pcm_format_t format)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_FLOAT:
+		return 0;
+	case SND_PCM_FORMAT_FLOAT64:
+		return 1;
+	default:
+		return -1;
+	}
+}
+
+/* returns NULL when the generic converters have to be used */
+static lfloat_kernel_f lfloat_kernel_select(snd_pcm_format_t src_format,
+					    snd_pcm_format_t dst_format,
+					    int dither)
+{
+	const struct lfloat_kernels *k = &generic_lfloat_kernels;
+	int i, f;
+
+#ifdef LFLOAT_SIMD_X86
+	if (__builtin_cpu_supports("avx2"))
+		k = &avx2_lfloat_kernels;
+#endif
+	if (snd_pcm_format_linear(src_format)) {
+		i = lfloat_int_index(src_format);
+		f = lfloat_float_index(dst_format);
+		if (i < 0 || f < 0)
+			return NULL;
+		return k->to_float[i][f];
+	}
+	i = lfloat_int_index(dst_format);
+	f = lfloat_float_index(src_format);
+	if (i < 0 || f < 0)
+		return NULL;
+	if (dither && i < 2)
+		return k->from_float_dither[i][f];
+	return k->from_float[i][f];
+}
+
+static void lfloat_convert(snd_pcm_lfloat_t *lfloat,
+			   const snd_pcm_channel_area_t *dst_areas,
+			   snd_pcm_uframes_t dst_offset,
+			   const snd_pcm_channel_area_t *src_areas,
+			   snd_pcm_uframes_t src_offset,
+			   unsigned int channels, snd_pcm_uframes_t frames)
+{
+	unsigned int sw = lfloat->src_width, dw = lfloat->dst_width;
+	unsigned int ch;
+
+	if (!lfloat->kernel)
+		goto _generic;
+	if (snd_pcm_areas_packed(src_areas, channels, sw) &&
+	    snd_pcm_areas_packed(dst_areas, channels, dw) &&
+	    src_areas[0].step == channels * sw &&
+	    dst_areas[0].step == channels * dw) {
+		lfloat->kernel(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+			       snd_pcm_channel_area_addr(src_areas, src_offset),
+			       frames * channels, lfloat->dither_state);
+		return;
+	}
+	for (ch = 0; ch < channels; ch++) {
+		if (src_areas[ch].step != sw ||
+		    !snd_pcm_area_aligned(&src_areas[ch], sw) ||
+		    dst_areas[ch].step != dw ||
+		    !snd_pcm_area_aligned(&dst_areas[ch], dw))
+			goto _generic;
+	}
+	for (ch = 0; ch < channels; ch++)
+		lfloat->kernel(snd_pcm_channel_area_addr(&dst_areas[ch], dst_offset),
+			       snd_pcm_channel_area_addr(&src_areas[ch], src_offset),
+			       frames, lfloat->dither_state);
+	return;
+
+ _generic:
+	lfloat->func(dst_areas, dst_offset, src_areas, src_offset,
+		     channels, frames, lfloat->int32_idx, lfloat->float32_idx);
+}
+
 #endif /* DOC_HIDDEN */
 
 static int snd_pcm_lfloat_hw_refine_cprepare(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
@@ -271,6 +519,7 @@ static int snd_pcm_lfloat_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	snd_pcm_t *slave = lfloat->plug.gen.slave;
 	snd_pcm_format_t src_format, dst_format;
+	unsigned int i;
 	int err = snd_pcm_hw_params_slave(pcm, params,
 					  snd_pcm_lfloat_hw_refine_cchange,
 					  snd_pcm_lfloat_hw_refine_sprepare,
@@ -294,6 +543,12 @@ static int snd_pcm_lfloat_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		lfloat->float32_idx = snd_pcm_lfloat_get_s32_index(src_format);
 		lfloat->func = snd_pcm_lfloat_convert_float_integer;
 	}
+	lfloat->kernel = lfloat_kernel_select(src_format, dst_format,
+					      lfloat->dither);
+	lfloat->src_width = snd_pcm_format_physical_width(src_format);
+	lfloat->dst_width = snd_pcm_format_physical_width(dst_format);
+	for (i = 0; i < LFLOAT_DITHER_LANES; i++)
+		lfloat->dither_state[i] = 0x9e3779b9 * (i + 1);
 	return 0;
 }
 
@@ -309,10 +564,8 @@ snd_pcm_lfloat_write_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(slave_areas, slave_offset,
-		     areas, offset, 
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	lfloat_convert(lfloat, slave_areas, slave_offset,
+		       areas, offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -329,10 +582,8 @@ snd_pcm_lfloat_read_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(areas, offset, 
-		     slave_areas, slave_offset,
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	lfloat_convert(lfloat, areas, offset,
+		       slave_areas, slave_offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -342,6 +593,8 @@ static void snd_pcm_lfloat_dump(snd_pcm_t *pcm, snd_output_t *out)
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	snd_output_printf(out, "Linear Integer <-> Linear Float conversion PCM (%s)\n", 
 		snd_pcm_format_name(lfloat->sformat));
+	if (lfloat->dither)
+		snd_output_printf(out, "TPDF dither on float to S16/S24\n");
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -428,6 +681,10 @@ This plugin converts linear to float samples and float to linear samples from ma
 linear<->float conversion PCM to given slave PCM. The channel count, format and rate must
 match for both of them.
 
+With dither enabled, float samples converted to native endian S16 or S24
+get one LSB of triangular dither noise and are rounded to nearest
+instead of truncated.
+
 \code
 pcm.name {
         type lfloat             # Linear<->Float conversion PCM
@@ -439,6 +696,8 @@ pcm.name {
                 pcm { }         # Slave PCM definition
                 format STR      # Slave format
         }
+        [dither BOOL]           # TPDF dither and round when converting
+                                # float to S16 or S24 (default: false)
 }
 \endcode
 
@@ -473,6 +732,7 @@ int _snd_pcm_lfloat_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_t *spcm;
 	snd_config_t *slave = NULL, *sconf;
 	snd_pcm_format_t sformat;
+	int dither = 0;
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		const char *id;
@@ -484,6 +744,13 @@ int _snd_pcm_lfloat_open(snd_pcm_t **pcmp, const char *name,
 			slave = n;
 			continue;
 		}
+		if (strcmp(id, "dither") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			dither = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -506,9 +773,12 @@ int _snd_pcm_lfloat_open(snd_pcm_t **pcmp, const char *name,
 	if (err < 0)
 		return err;
 	err = snd_pcm_lfloat_open(pcmp, name, sformat, spcm, 1);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	((snd_pcm_lfloat_t *)(*pcmp)->private_data)->dither = dither;
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_lfloat_open, SND_PCM_DLSYM_VERSION);
@@ -187,6 +187,17 @@ typedef struct {
 	int (*mmap_begin)(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas, snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames); /* locked */
 } snd_pcm_fast_ops_t;
 
+/* status published at each unlock for the lock-free readers;
+ * seq is odd while the fields are being written, zero before the
+ * first publication
+ */
+struct snd_pcm_snapshot {
+	unsigned int seq;
+	snd_pcm_sframes_t avail;
+	snd_pcm_sframes_t delay;
+	snd_htimestamp_t tstamp;
+};
+
 struct _snd_pcm {
 	void *open_func;
 	char *name;
@@ -246,6 +257,8 @@ struct _snd_pcm {
 	snd_pcm_t *fast_op_arg;
 	void *private_data;
 	struct list_head async_handlers;
+	snd_pcm_stats_t *stats;		/* NULL unless snd_pcm_stats_enable() */
+	struct snd_pcm_refine_memo *refine_memo; /* snd_pcm_hw_refine() results */
 #ifdef THREAD_SAFE_API
 	int need_lock;		/* true = this PCM (plugin) is thread-unsafe,
 				 * thus it needs a lock.
@@ -254,6 +267,10 @@ struct _snd_pcm {
 				 * it's set depending on $LIBASOUND_THREAD_SAFE.
 				 */
 	pthread_mutex_t lock;
+	int status_snapshot;	/* snd_pcm_set_status_snapshot() */
+	int snapshot_delay_set;	/* snapshot_delay measured under the lock */
+	snd_pcm_sframes_t snapshot_delay;
+	struct snd_pcm_snapshot snapshot;
 #endif
 };
 
@@ -276,6 +293,44 @@ struct _snd_pcm {
 	snd1_pcm_areas_from_buf
 #define snd_pcm_areas_from_bufs \
 	snd1_pcm_areas_from_bufs
+#define snd_pcm_areas_select \
+	snd1_pcm_areas_select
+#define snd_pcm_areas_copy_fast \
+	snd1_pcm_areas_copy_fast
+#define snd_pcm_areas_silence_fast \
+	snd1_pcm_areas_silence_fast
+#define snd_pcm_stats_users \
+	snd1_pcm_stats_users
+#define snd_pcm_stats_avail_update \
+	snd1_pcm_stats_avail_update
+#define snd_pcm_stats_mmap_commit \
+	snd1_pcm_stats_mmap_commit
+#define snd_pcm_stats_current \
+	snd1_pcm_stats_current
+#define snd_pcm_stats_wakeup \
+	snd1_pcm_stats_wakeup
+#define snd_pcm_stats_begin \
+	snd1_pcm_stats_begin
+#define snd_pcm_stats_end \
+	snd1_pcm_stats_end
+#define snd_pcm_stats_recover \
+	snd1_pcm_stats_recover
+#define snd_pcm_stats_release \
+	snd1_pcm_stats_release
+#define snd_pcm_stats_time \
+	snd1_pcm_stats_time
+#define snd_pcm_snapshot_publish \
+	snd1_pcm_snapshot_publish
+#define snd_pcm_hw_refine_memo_free \
+	snd1_pcm_hw_refine_memo_free
+#define snd_pcm_hw_xfer_fd \
+	snd1_pcm_hw_xfer_fd
+#define snd_pcm_hw_xfer_done \
+	snd1_pcm_hw_xfer_done
+#define snd_pcm_areas_packed \
+	snd1_pcm_areas_packed
+#define snd_pcm_area_aligned \
+	snd1_pcm_area_aligned
 #define snd_pcm_open_named_slave \
 	snd1_pcm_open_named_slave
 #define snd_pcm_hw_open_fd \
@@ -371,6 +426,21 @@ int snd_pcm_free(snd_pcm_t *pcm);
 
 void snd_pcm_areas_from_buf(snd_pcm_t *pcm, snd_pcm_channel_area_t *areas, void *buf);
 void snd_pcm_areas_from_bufs(snd_pcm_t *pcm, snd_pcm_channel_area_t *areas, void **bufs);
+void snd_pcm_areas_select(void);
+int snd_pcm_areas_copy_fast(const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_offset,
+			    unsigned int channels, snd_pcm_uframes_t frames,
+			    snd_pcm_format_t format);
+int snd_pcm_areas_silence_fast(const snd_pcm_channel_area_t *dst_areas,
+			       snd_pcm_uframes_t dst_offset,
+			       unsigned int channels, snd_pcm_uframes_t frames,
+			       snd_pcm_format_t format);
+int snd_pcm_areas_packed(const snd_pcm_channel_area_t *areas,
+			 unsigned int channels, unsigned int width);
+int snd_pcm_area_aligned(const snd_pcm_channel_area_t *area,
+			 unsigned int width);
 
 int snd_pcm_async(snd_pcm_t *pcm, int sig, pid_t pid);
 int snd_pcm_mmap(snd_pcm_t *pcm);
@@ -419,6 +489,50 @@ int _snd_pcm_poll_descriptor(snd_pcm_t *pcm);
 #define _snd_pcm_link_descriptor _snd_pcm_poll_descriptor /* FIXME */
 #define _snd_pcm_async_descriptor _snd_pcm_poll_descriptor /* FIXME */
 
+struct _snd_pcm_stats {
+	unsigned long wakeups;
+	unsigned long long poll_ns;
+	unsigned long xruns;
+	unsigned long suspends;
+	unsigned long avail[SND_PCM_STATS_AVAIL_BUCKETS];
+	unsigned int layers;
+	struct {
+		snd_pcm_type_t type;
+		snd_pcm_uframes_t period_size;
+		unsigned long long ns;		/* own processing time */
+		unsigned long long frames;	/* committed frames */
+	} layer[SND_PCM_STATS_LAYERS];
+	int woken;		/* record avail at the next avail_update */
+};
+
+/* see snd_pcm_stats_begin() */
+struct snd_pcm_stats_scope {
+	snd_pcm_stats_t *sink;
+	unsigned int next;
+	unsigned long long child_ns;
+};
+
+/* number of PCMs with statistics enabled */
+extern int snd_pcm_stats_users;
+
+static inline int snd_pcm_stats_active(void)
+{
+	return __atomic_load_n(&snd_pcm_stats_users, __ATOMIC_RELAXED) != 0;
+}
+
+snd_pcm_sframes_t snd_pcm_stats_avail_update(snd_pcm_t *pcm);
+snd_pcm_sframes_t snd_pcm_stats_mmap_commit(snd_pcm_t *pcm,
+					    snd_pcm_uframes_t offset,
+					    snd_pcm_uframes_t frames);
+snd_pcm_stats_t *snd_pcm_stats_current(snd_pcm_t *pcm);
+void snd_pcm_stats_wakeup(snd_pcm_stats_t *stats, unsigned long long poll_ns,
+			  int woken);
+void snd_pcm_stats_begin(snd_pcm_t *pcm, struct snd_pcm_stats_scope *scope);
+void snd_pcm_stats_end(struct snd_pcm_stats_scope *scope);
+void snd_pcm_stats_recover(snd_pcm_t *pcm, int err);
+void snd_pcm_stats_release(snd_pcm_t *pcm);
+unsigned long long snd_pcm_stats_time(void);
+
 /* locked versions */
 int __snd_pcm_mmap_begin_generic(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas,
 				 snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames);
@@ -433,6 +547,8 @@ static inline snd_pcm_sframes_t __snd_pcm_avail_update(snd_pcm_t *pcm)
 {
 	if (!pcm->fast_ops->avail_update)
 		return -ENOSYS;
+	if (snd_pcm_stats_active())
+		return snd_pcm_stats_avail_update(pcm);
 	return pcm->fast_ops->avail_update(pcm->fast_op_arg);
 }
 
@@ -701,7 +817,15 @@ static inline int muldiv_near(int a, int b, int c)
 	return n;
 }
 
+/* GCC vectorizes plain sample loops at -O2 only with the dynamic cost model */
+#if defined(__GNUC__) && !defined(__clang__)
+#define SND_PCM_VECTORIZE	__attribute__((optimize("vect-cost-model=dynamic")))
+#else
+#define SND_PCM_VECTORIZE
+#endif
+
 int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
+void snd_pcm_hw_refine_memo_free(snd_pcm_t *pcm);
 int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 #undef _snd_pcm_hw_params
 int snd_pcm_hw_refine_soft(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
@@ -1000,6 +1124,8 @@ snd_pcm_open_slave(snd_pcm_t **pcmp, snd_config_t *root,
 
 int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
 		       int sync_ptr_ioctl);
+int snd_pcm_hw_xfer_fd(snd_pcm_t *pcm);
+snd_pcm_sframes_t snd_pcm_hw_xfer_done(snd_pcm_t *pcm, ssize_t bytes);
 int __snd_pcm_mmap_emul_open(snd_pcm_t **pcmp, const char *name,
 			     snd_pcm_t *slave, int close_slave);
 
@@ -1197,10 +1323,14 @@ static inline void __snd_pcm_lock(snd_pcm_t *pcm)
 	if (pcm->lock_enabled)
 		pthread_mutex_lock(&pcm->lock);
 }
+void snd_pcm_snapshot_publish(snd_pcm_t *pcm);
 static inline void __snd_pcm_unlock(snd_pcm_t *pcm)
 {
-	if (pcm->lock_enabled)
+	if (pcm->lock_enabled) {
+		if (pcm->status_snapshot)
+			snd_pcm_snapshot_publish(pcm);
 		pthread_mutex_unlock(&pcm->lock);
+	}
 }
 static inline void snd_pcm_lock(snd_pcm_t *pcm)
 {
@@ -1209,8 +1339,11 @@ static inline void snd_pcm_lock(snd_pcm_t *pcm)
 }
 static inline void snd_pcm_unlock(snd_pcm_t *pcm)
 {
-	if (pcm->lock_enabled && pcm->need_lock)
+	if (pcm->lock_enabled && pcm->need_lock) {
+		if (pcm->status_snapshot)
+			snd_pcm_snapshot_publish(pcm);
 		pthread_mutex_unlock(&pcm->lock);
+	}
 }
 #else /* THREAD_SAFE_API */
 #define __snd_pcm_lock(pcm)		do {} while (0)
@@ -20,6 +20,13 @@
  */
   
 #include "pcm_local.h"
+#include "pcm_generic.h"
+
+#ifdef HAVE___THREAD
+#define TLS_PFX		__thread
+#else
+#define TLS_PFX		/* NOP */
+#endif
 
 #ifndef NDEBUG
 /*
@@ -2064,6 +2071,163 @@ static const snd_interval_t refine_intervals[SND_PCM_HW_PARAM_LAST_INTERVAL - SN
 	},
 };
 
+/*
+ * Memo of snd_pcm_hw_refine() results, per PCM layer.  The negotiation
+ * refines the same parameters again and again (the set_*_near() and
+ * first/last helpers, the plugins refining their slave in each of their
+ * own refine passes), so the input parameters are looked up and the
+ * stored output is returned without running the rules of the layers
+ * below.  The memo is dropped when the PCM is set up or freed.
+ *
+ * The memo assumes that the result depends only on the input, which
+ * doesn't hold for the hw layer (e.g. the rate bound by the other
+ * running stream) nor for the ioplug and extplug constraints, which may
+ * change at any time.  It's used only for the chains of single-slave
+ * plugins ending in the null plugin.
+ */
+#define REFINE_MEMO_ENTRIES	16
+
+struct refine_memo_entry {
+	snd_pcm_hw_params_t in;
+	snd_pcm_hw_params_t out;
+	int result;
+	unsigned long rules;	/* rule evaluations done by the refine */
+};
+
+struct snd_pcm_refine_memo {
+	unsigned int count;
+	unsigned int next;	/* round-robin replacement */
+	struct refine_memo_entry entries[REFINE_MEMO_ENTRIES];
+};
+
+static snd_pcm_refine_cache_stats_t refine_stats;
+
+/* rule evaluations of this thread: run, or saved by the memo */
+static TLS_PFX unsigned long refine_rules_run;
+static TLS_PFX unsigned long refine_rules_saved;
+
+static void refine_rules_count(unsigned int nrules)
+{
+	refine_rules_run += nrules;
+	__atomic_fetch_add(&refine_stats.rules_run, nrules, __ATOMIC_RELAXED);
+}
+
+static int refine_memo_enabled(void)
+{
+	static int enabled = -1;
+
+	/* evaluate env var only once for consistency */
+	if (enabled < 0) {
+		const char *p = getenv("LIBASOUND_PCM_REFINE_CACHE");
+		enabled = !p || *p != '0';
+	}
+	return enabled;
+}
+
+/* the plugins whose refine depends only on the input and on their slave */
+static int refine_memo_stable(snd_pcm_t *pcm)
+{
+	for (;;) {
+		switch (pcm->type) {
+		case SND_PCM_TYPE_NULL:
+			return 1;
+		case SND_PCM_TYPE_HOOKS:
+		case SND_PCM_TYPE_FILE:
+		case SND_PCM_TYPE_COPY:
+		case SND_PCM_TYPE_LINEAR:
+		case SND_PCM_TYPE_ALAW:
+		case SND_PCM_TYPE_MULAW:
+		case SND_PCM_TYPE_ADPCM:
+		case SND_PCM_TYPE_RATE:
+		case SND_PCM_TYPE_ROUTE:
+		case SND_PCM_TYPE_PLUG:
+		case SND_PCM_TYPE_METER:
+		case SND_PCM_TYPE_LINEAR_FLOAT:
+		case SND_PCM_TYPE_IEC958:
+		case SND_PCM_TYPE_SOFTVOL:
+		case SND_PCM_TYPE_MMAP_EMUL:
+			pcm = ((snd_pcm_generic_t *)pcm->private_data)->slave;
+			break;
+		default:
+			return 0;
+		}
+	}
+}
+
+static struct refine_memo_entry *refine_memo_lookup(snd_pcm_t *pcm,
+						    const snd_pcm_hw_params_t *params)
+{
+	struct snd_pcm_refine_memo *memo = pcm->refine_memo;
+	unsigned int i;
+
+	if (!memo)
+		return NULL;
+	for (i = 0; i < memo->count; i++) {
+		if (!memcmp(&memo->entries[i].in, params, sizeof(*params)))
+			return &memo->entries[i];
+	}
+	return NULL;
+}
+
+static void refine_memo_store(snd_pcm_t *pcm, const snd_pcm_hw_params_t *in,
+			      const snd_pcm_hw_params_t *out, int result,
+			      unsigned long rules)
+{
+	struct snd_pcm_refine_memo *memo = pcm->refine_memo;
+	struct refine_memo_entry *e;
+
+	if (!memo) {
+		memo = calloc(1, sizeof(*memo));
+		if (!memo)
+			return;
+		pcm->refine_memo = memo;
+	}
+	if (memo->count < REFINE_MEMO_ENTRIES) {
+		e = &memo->entries[memo->count++];
+	} else {
+		e = &memo->entries[memo->next];
+		memo->next = (memo->next + 1) % REFINE_MEMO_ENTRIES;
+	}
+	e->in = *in;
+	e->out = *out;
+	e->result = result;
+	e->rules = rules;
+}
+
+/* drop the refine results of a PCM, when set up or freed */
+void snd_pcm_hw_refine_memo_free(snd_pcm_t *pcm)
+{
+	free(pcm->refine_memo);
+	pcm->refine_memo = NULL;
+}
+
+/**
+ * \brief Get the counters of the hw_params refine memo
+ * \param stats Returned counters
+ * \return 0 on success otherwise a negative error code
+ *
+ * During the negotiation of the hardware parameters, the results of
+ * each PCM layer refining a given configuration space are kept until
+ * the PCM is set up, and the same refine request returns them without
+ * evaluating the constraint rules again, for the layer and all layers
+ * below it.  Only the chains of plugins ending in the null plugin are
+ * memoized: the constraints of the hw, ioplug and extplug layers may
+ * change during the negotiation.  The counters are global for the
+ * process.
+ *
+ * Setting the environment variable \c LIBASOUND_PCM_REFINE_CACHE to 0
+ * disables the memo.
+ */
+int snd_pcm_refine_cache_stats(snd_pcm_refine_cache_stats_t *stats)
+{
+	assert(stats);
+	stats->hits = __atomic_load_n(&refine_stats.hits, __ATOMIC_RELAXED);
+	stats->misses = __atomic_load_n(&refine_stats.misses, __ATOMIC_RELAXED);
+	stats->rules_run = __atomic_load_n(&refine_stats.rules_run, __ATOMIC_RELAXED);
+	stats->rules_saved = __atomic_load_n(&refine_stats.rules_saved, __ATOMIC_RELAXED);
+	return 0;
+}
+
 #if 0
 #define RULES_DEBUG
 #endif
@@ -2074,7 +2238,7 @@ int snd_pcm_hw_refine_soft(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t
 	snd_interval_t *i;
 	unsigned int rstamps[RULES];
 	unsigned int vstamps[SND_PCM_HW_PARAM_LAST_INTERVAL + 1];
-	unsigned int stamp = 2;
+	unsigned int stamp = 2, nrules = 0;
 	int changed, again;
 #ifdef RULES_DEBUG
 	snd_output_t *log;
@@ -2132,6 +2296,7 @@ int snd_pcm_hw_refine_soft(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t
 			}
 #endif
 			changed = r->func(params, r);
+			nrules++;
 #ifdef RULES_DEBUG
 			if (r->var >= 0)
 				snd_pcm_hw_param_dump(params, r->var, log);
@@ -2166,6 +2331,7 @@ int snd_pcm_hw_refine_soft(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t
 		}
 	}
 	params->rmask = 0;
+	refine_rules_count(nrules);
 	return 0;
  _err:
 #ifdef RULES_DEBUG
@@ -2173,6 +2339,7 @@ int snd_pcm_hw_refine_soft(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t
 	snd_pcm_hw_params_dump(params, log);
 	snd_output_close(log);
 #endif
+	refine_rules_count(nrules);
 	return changed;
 }
 
@@ -2356,10 +2523,31 @@ int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	snd_output_printf(log, "REFINE called:\n");
 	snd_pcm_hw_params_dump(params, log);
 #endif
-	if (pcm->ops->hw_refine)
-		res = pcm->ops->hw_refine(pcm->op_arg, params);
-	else
+	if (!pcm->ops->hw_refine) {
 		res = -ENOSYS;
+	} else if (!refine_memo_enabled() || !refine_memo_stable(pcm)) {
+		res = pcm->ops->hw_refine(pcm->op_arg, params);
+	} else {
+		struct refine_memo_entry *e = refine_memo_lookup(pcm, params);
+
+		if (e) {
+			*params = e->out;
+			res = e->result;
+			refine_rules_saved += e->rules;
+			__atomic_fetch_add(&refine_stats.hits, 1, __ATOMIC_RELAXED);
+			__atomic_fetch_add(&refine_stats.rules_saved, e->rules,
+					   __ATOMIC_RELAXED);
+		} else {
+			snd_pcm_hw_params_t in = *params;
+			unsigned long rules = refine_rules_run + refine_rules_saved;
+
+			res = pcm->ops->hw_refine(pcm->op_arg, params);
+			/* the cost without the memo, for the later hits */
+			rules = refine_rules_run + refine_rules_saved - rules;
+			refine_memo_store(pcm, &in, params, res, rules);
+			__atomic_fetch_add(&refine_stats.misses, 1, __ATOMIC_RELAXED);
+		}
+	}
 #ifdef REFINE_DEBUG
 	snd_output_printf(log, "refine done - result = %i\n", res);
 	snd_pcm_hw_params_dump(params, log);
@@ -2401,7 +2589,9 @@ int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	if (err < 0)
 		return err;
 
+	snd_pcm_areas_select();
 	pcm->setup = 1;
+	snd_pcm_hw_refine_memo_free(pcm);
 	INTERNAL(snd_pcm_hw_params_get_access)(params, &pcm->access);
 	INTERNAL(snd_pcm_hw_params_get_format)(params, &pcm->format);
 	INTERNAL(snd_pcm_hw_params_get_subformat)(params, &pcm->subformat);
@@ -55,6 +55,7 @@ typedef struct {
 	snd_pcm_route_ttable_entry_t *ttable;
 	int ttable_ok;
 	unsigned int tt_ssize, tt_cused, tt_sused;
+	int fused;
 } snd_pcm_plug_t;
 
 #endif
@@ -388,23 +389,18 @@ static int snd_pcm_plug_change_rate(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plu
 #endif
 
 #ifdef BUILD_PCM_PLUGIN_ROUTE
-static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plug_params_t *clt, snd_pcm_plug_params_t *slv)
+/* fill a clt->channels x slv->channels ttable (slave size slv->channels) */
+static void snd_pcm_plug_build_ttable(snd_pcm_t *pcm,
+				      snd_pcm_route_ttable_entry_t *ttable,
+				      snd_pcm_plug_params_t *clt,
+				      snd_pcm_plug_params_t *slv)
 {
 	snd_pcm_plug_t *plug = pcm->private_data;
 	unsigned int tt_ssize, tt_cused, tt_sused;
-	snd_pcm_route_ttable_entry_t *ttable;
-	int err;
-	if (clt->channels == slv->channels &&
-	    (!plug->ttable || plug->ttable_ok))
-		return 0;
-	if (clt->rate != slv->rate &&
-	    clt->channels > slv->channels)
-		return 0;
-	assert(snd_pcm_format_linear(slv->format));
+
 	tt_ssize = slv->channels;
 	tt_cused = clt->channels;
 	tt_sused = slv->channels;
-	ttable = alloca(tt_cused * tt_sused * sizeof(*ttable));
 	if (plug->ttable) {	/* expand or shrink table */
 		unsigned int c = 0, s = 0;
 		for (c = 0; c < tt_cused; c++) {
@@ -419,7 +415,6 @@ static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm
 				ttable[c * tt_ssize + s] = v;
 			}
 		}
-		plug->ttable_ok = 1;
 	} else {
 		unsigned int k;
 		unsigned int c = 0, s = 0;
@@ -479,6 +474,28 @@ static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm
 			break;
 		}
 	}
+}
+
+static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plug_params_t *clt, snd_pcm_plug_params_t *slv)
+{
+	snd_pcm_plug_t *plug = pcm->private_data;
+	unsigned int tt_ssize, tt_cused, tt_sused;
+	snd_pcm_route_ttable_entry_t *ttable;
+	int err;
+	if (clt->channels == slv->channels &&
+	    (!plug->ttable || plug->ttable_ok))
+		return 0;
+	if (clt->rate != slv->rate &&
+	    clt->channels > slv->channels)
+		return 0;
+	assert(snd_pcm_format_linear(slv->format));
+	tt_ssize = slv->channels;
+	tt_cused = clt->channels;
+	tt_sused = slv->channels;
+	ttable = alloca(tt_cused * tt_sused * sizeof(*ttable));
+	snd_pcm_plug_build_ttable(pcm, ttable, clt, slv);
+	if (plug->ttable)
+		plug->ttable_ok = 1;
 	err = snd_pcm_route_open(new, NULL, slv->format, (int) slv->channels, ttable, tt_ssize, tt_cused, tt_sused, plug->gen.slave, plug->gen.slave != plug->req_slave);
 	if (err < 0)
 		return err;
@@ -490,6 +507,54 @@ static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm
 }
 #endif
 
+#if defined(BUILD_PCM_PLUGIN_RATE) && defined(BUILD_PCM_PLUGIN_ROUTE)
+/*
+ * Upmix (or custom ttable) together with a rate change: instead of stacking
+ * a rate and a route PCM, each with its own ring buffer and mmap pass, let
+ * the rate PCM apply the route matrix and the slave format conversion on
+ * its period-sized output buffer.  Downmixing is left to the layered path
+ * which resamples the smaller number of channels.
+ */
+static int snd_pcm_plug_change_fused(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plug_params_t *clt, snd_pcm_plug_params_t *slv)
+{
+	snd_pcm_plug_t *plug = pcm->private_data;
+	snd_pcm_route_ttable_entry_t *ttable;
+	int err;
+	if (!plug->fused || clt->rate == slv->rate)
+		return 0;
+	if (clt->channels > slv->channels ||
+	    (clt->channels == slv->channels &&
+	     (!plug->ttable || plug->ttable_ok)))
+		return 0;
+	assert(snd_pcm_format_linear(slv->format));
+	ttable = alloca(clt->channels * slv->channels * sizeof(*ttable));
+	snd_pcm_plug_build_ttable(pcm, ttable, clt, slv);
+	/* the slave is handed over only once the route stage is set */
+	err = snd_pcm_rate_open(new, NULL, slv->format, slv->rate, plug->rate_converter,
+				plug->gen.slave, 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_rate_set_route(*new, slv->channels, ttable, slv->channels,
+				     clt->channels, slv->channels);
+	if (err < 0) {
+		/* fall back to the separate rate and route plugins */
+		snd_pcm_close(*new);
+		*new = NULL;
+		return 0;
+	}
+	((snd_pcm_generic_t *)(*new)->private_data)->close_slave =
+		plug->gen.slave != plug->req_slave;
+	slv->channels = clt->channels;
+	if (plug->ttable)
+		plug->ttable_ok = 1;
+	slv->access = clt->access;
+	slv->rate = clt->rate;
+	if (snd_pcm_format_linear(clt->format))
+		slv->format = clt->format;
+	return 1;
+}
+#endif
+
 static int snd_pcm_plug_change_format(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plug_params_t *clt, snd_pcm_plug_params_t *slv)
 {
 	snd_pcm_plug_t *plug = pcm->private_data;
@@ -645,6 +710,9 @@ static int snd_pcm_plug_insert_plugins(snd_pcm_t *pcm,
 		snd_pcm_plug_change_mmap,
 #endif
 		snd_pcm_plug_change_format,
+#if defined(BUILD_PCM_PLUGIN_RATE) && defined(BUILD_PCM_PLUGIN_ROUTE)
+		snd_pcm_plug_change_fused,
+#endif
 #ifdef BUILD_PCM_PLUGIN_ROUTE
 		snd_pcm_plug_change_channels,
 #endif
@@ -1130,6 +1198,7 @@ int snd_pcm_plug_open(snd_pcm_t **pcmp,
 	plug->tt_ssize = tt_ssize;
 	plug->tt_cused = tt_cused;
 	plug->tt_sused = tt_sused;
+	plug->fused = 1;
 	
 	err = snd_pcm_new(&pcm, SND_PCM_TYPE_PLUG, name, slave->stream, slave->mode);
 	if (err < 0) {
@@ -1195,9 +1264,18 @@ pcm.name {
 	rate_converter [ STR1 STR2 ... ]
 				# type of rate converter
 				# default value is taken from defaults.pcm.rate_converter
+	fused BOOL		# resample and upmix/route in a single plugin pass
+				# (default yes)
 }
 \endcode
 
+When both the rate and the channel count (or a ttable) have to be converted
+and the client has no more channels than the slave, the plug plugin lets
+the rate plugin apply the route matrix and the slave format conversion
+directly on its period-sized output, instead of stacking separate rate
+and route plugins with their own ring buffers.  Set \c fused to \c false
+to get the layered chain.
+
 \subsection pcm_plugins_plug_funcref Function reference
 
 <UL>
@@ -1235,6 +1313,7 @@ int _snd_pcm_plug_open(snd_pcm_t **pcmp, const char *name,
 	unsigned int cused, sused;
 	snd_pcm_format_t sformat = SND_PCM_FORMAT_UNKNOWN;
 	int schannels = -1, srate = -1;
+	int fused = 1;
 	const snd_config_t *rate_converter = NULL;
 
 	snd_config_for_each(i, next, conf) {
@@ -1283,6 +1362,13 @@ int _snd_pcm_plug_open(snd_pcm_t **pcmp, const char *name,
 			continue;
 		}
 #endif
+		if (strcmp(id, "fused") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			fused = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1327,9 +1413,12 @@ int _snd_pcm_plug_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	err = snd_pcm_plug_open(pcmp, name, sformat, schannels, srate, rate_converter,
 				route_policy, ttable, ssize, cused, sused, spcm, 1);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	((snd_pcm_plug_t *)(*pcmp)->private_data)->fused = fused;
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_plug_open, SND_PCM_DLSYM_VERSION);
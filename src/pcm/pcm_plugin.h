@@ -134,6 +134,40 @@ void snd_pcm_mulaw_encode(const snd_pcm_channel_area_t *dst_areas,
 			  unsigned int channels, snd_pcm_uframes_t frames,
 			  unsigned int getidx);
 
+/* route matrix helpers, shared by the route plugin and the fused rate path */
+typedef struct snd_pcm_route_params snd_pcm_route_params_t;
+
+#define snd_pcm_route_params_new	snd1_pcm_route_params_new
+#define snd_pcm_route_params_free	snd1_pcm_route_params_free
+#define snd_pcm_route_params_set_format	snd1_pcm_route_params_set_format
+#define snd_pcm_route_params_get_chmap	snd1_pcm_route_params_get_chmap
+#define snd_pcm_route_convert		snd1_pcm_route_convert
+#define snd_pcm_rate_set_route		snd1_pcm_rate_set_route
+
+int snd_pcm_route_params_new(snd_pcm_route_params_t **paramsp,
+			     snd_pcm_stream_t stream,
+			     unsigned int tt_ssize,
+			     snd_pcm_route_ttable_entry_t *ttable,
+			     unsigned int tt_cused, unsigned int tt_sused);
+void snd_pcm_route_params_free(snd_pcm_route_params_t *params);
+void snd_pcm_route_params_set_format(snd_pcm_route_params_t *params,
+				     snd_pcm_format_t src_format,
+				     snd_pcm_format_t dst_format);
+snd_pcm_chmap_t *snd_pcm_route_params_get_chmap(const snd_pcm_route_params_t *params,
+						const snd_pcm_chmap_t *slave_map);
+void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
+			   snd_pcm_uframes_t dst_offset,
+			   const snd_pcm_channel_area_t *src_areas,
+			   snd_pcm_uframes_t src_offset,
+			   unsigned int src_channels,
+			   unsigned int dst_channels,
+			   snd_pcm_uframes_t frames,
+			   snd_pcm_route_params_t *params);
+int snd_pcm_rate_set_route(snd_pcm_t *pcm, unsigned int schannels,
+			   snd_pcm_route_ttable_entry_t *ttable,
+			   unsigned int tt_ssize,
+			   unsigned int tt_cused, unsigned int tt_sused);
+
 typedef struct _snd_pcm_adpcm_state {
 	int pred_val;		/* Calculated predicted value */
 	int step_idx;		/* Previous StepSize lookup index */
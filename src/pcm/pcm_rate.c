@@ -75,6 +75,8 @@ struct _snd_pcm_rate {
 	uint64_t in_formats;
 	uint64_t out_formats;
 	unsigned int format_flags;
+	snd_pcm_route_params_t *route;	/* fused route stage (plug), slave side */
+	unsigned int schannels;		/* slave channels with the route stage */
 };
 
 #define SND_PCM_RATE_PLUGIN_VERSION_OLD	0x010001	/* old rate plugin */
@@ -165,6 +167,9 @@ static int snd_pcm_rate_hw_refine_sprepare(snd_pcm_t *pcm, snd_pcm_hw_params_t *
 	}
 	_snd_pcm_hw_param_set_minmax(sparams, SND_PCM_HW_PARAM_RATE,
 				     rate->srate, 0, rate->srate + 1, -1);
+	if (rate->route)
+		_snd_pcm_hw_param_set(sparams, SND_PCM_HW_PARAM_CHANNELS,
+				      rate->schannels, 0);
 	return 0;
 }
 
@@ -175,9 +180,10 @@ static int snd_pcm_rate_hw_refine_schange(snd_pcm_t *pcm, snd_pcm_hw_params_t *p
 	snd_interval_t t, buffer_size;
 	const snd_interval_t *srate, *crate;
 	int err;
-	unsigned int links = (SND_PCM_HW_PARBIT_CHANNELS |
-			      SND_PCM_HW_PARBIT_PERIOD_TIME |
+	unsigned int links = (SND_PCM_HW_PARBIT_PERIOD_TIME |
 			      SND_PCM_HW_PARBIT_TICK_TIME);
+	if (!rate->route)
+		links |= SND_PCM_HW_PARBIT_CHANNELS;
 	if (rate->sformat == SND_PCM_FORMAT_UNKNOWN)
 		links |= (SND_PCM_HW_PARBIT_FORMAT |
 			  SND_PCM_HW_PARBIT_SUBFORMAT |
@@ -208,9 +214,10 @@ static int snd_pcm_rate_hw_refine_cchange(snd_pcm_t *pcm, snd_pcm_hw_params_t *p
 	const snd_interval_t *sbuffer_size, *buffer_size;
 	const snd_interval_t *srate, *crate;
 	int err;
-	unsigned int links = (SND_PCM_HW_PARBIT_CHANNELS |
-			      SND_PCM_HW_PARBIT_PERIOD_TIME |
+	unsigned int links = (SND_PCM_HW_PARBIT_PERIOD_TIME |
 			      SND_PCM_HW_PARBIT_TICK_TIME);
+	if (!rate->route)
+		links |= SND_PCM_HW_PARBIT_CHANNELS;
 	if (rate->sformat == SND_PCM_FORMAT_UNKNOWN)
 		links |= (SND_PCM_HW_PARBIT_FORMAT |
 			  SND_PCM_HW_PARBIT_SUBFORMAT |
@@ -395,6 +402,11 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	sinfo->rate = slave->rate;
 	sinfo->buffer_size = slave->buffer_size;
 	sinfo->period_size = slave->period_size;
+	/* the route stage converts to the slave format, so let the
+	 * converter work in the client format
+	 */
+	if (rate->route)
+		sinfo->format = cinfo->format;
 
 	if (CHECK_SANITY(rate->pareas)) {
 		SNDMSG("rate plugin already in use");
@@ -403,9 +415,11 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 
 	rate->pareas = rate_alloc_tmp_buf(cinfo->format, channels,
 					  cinfo->period_size);
-	rate->sareas = rate_alloc_tmp_buf(sinfo->format, channels,
-					  sinfo->period_size);
-	if (!rate->pareas || !rate->sareas) {
+	/* the fused route stage splits periods in its own period buffer */
+	if (!rate->route)
+		rate->sareas = rate_alloc_tmp_buf(sinfo->format, channels,
+						  sinfo->period_size);
+	if (!rate->pareas || (!rate->route && !rate->sareas)) {
 		err = -ENOMEM;
 		goto error_pareas;
 	}
@@ -438,6 +452,25 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 			need_dst_buf = 1;
 	}
 
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	/* the route stage converts between the slave and the converter
+	 * side through a period-sized buffer in one pass
+	 */
+	if (rate->route) {
+		if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+			need_dst_buf = 1;
+			snd_pcm_route_params_set_format(rate->route,
+							rate->info.out.format,
+							slave->format);
+		} else {
+			need_src_buf = 1;
+			snd_pcm_route_params_set_format(rate->route,
+							slave->format,
+							rate->info.in.format);
+		}
+	}
+#endif
+
 	if (need_src_buf) {
 		rate->src_conv_idx =
 			snd_pcm_linear_convert_index(rate->orig_in_format,
@@ -566,6 +599,56 @@ static int snd_pcm_rate_init(snd_pcm_t *pcm)
 	return 0;
 }
 
+/* convert the input side into src_buf, starting at buf_offset */
+static void rate_src_stage(snd_pcm_rate_t *rate,
+			   const snd_pcm_channel_area_t *src_areas,
+			   snd_pcm_uframes_t src_offset,
+			   snd_pcm_uframes_t buf_offset,
+			   unsigned int frames, unsigned int channels)
+{
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	if (rate->route && rate->gen.slave->stream == SND_PCM_STREAM_CAPTURE) {
+		snd_pcm_route_convert(rate->src_buf, buf_offset,
+				      src_areas, src_offset,
+				      rate->schannels, channels,
+				      frames, rate->route);
+		return;
+	}
+#endif
+	snd_pcm_linear_convert(rate->src_buf, buf_offset,
+			       src_areas, src_offset,
+			       channels, frames,
+			       rate->src_conv_idx);
+}
+
+/* convert dst_buf from buf_offset to the output side */
+static void rate_dst_stage(snd_pcm_rate_t *rate,
+			   const snd_pcm_channel_area_t *dst_areas,
+			   snd_pcm_uframes_t dst_offset,
+			   snd_pcm_uframes_t buf_offset,
+			   unsigned int frames, unsigned int channels)
+{
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	if (rate->route && rate->gen.slave->stream == SND_PCM_STREAM_PLAYBACK) {
+		snd_pcm_route_convert(dst_areas, dst_offset,
+				      rate->dst_buf, buf_offset,
+				      channels, rate->schannels,
+				      frames, rate->route);
+		return;
+	}
+#endif
+	snd_pcm_linear_convert(dst_areas, dst_offset,
+			       rate->dst_buf, buf_offset,
+			       channels, frames,
+			       rate->dst_conv_idx);
+}
+
+/*
+ * With the fused route stage there are no slave-format period areas
+ * (sareas is NULL): a NULL dst_areas keeps the output in dst_buf and a
+ * NULL src_areas means src_buf is already filled, see rate_put_slave()
+ * and rate_get_slave().
+ */
 static void do_convert(const snd_pcm_channel_area_t *dst_areas,
 		       snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
 		       const snd_pcm_channel_area_t *src_areas,
@@ -585,10 +668,9 @@ static void do_convert(const snd_pcm_channel_area_t *dst_areas,
 	}
 
 	if (rate->src_buf) {
-		snd_pcm_linear_convert(rate->src_buf, 0,
-				       src_areas, src_offset,
-				       channels, src_frames,
-				       rate->src_conv_idx);
+		if (src_areas)
+			rate_src_stage(rate, src_areas, src_offset, 0,
+				       src_frames, channels);
 		src_areas = rate->src_buf;
 		src_offset = 0;
 	}
@@ -602,11 +684,9 @@ static void do_convert(const snd_pcm_channel_area_t *dst_areas,
 				      dst_frames,
 				      snd_pcm_channel_area_addr(src_areas, src_offset),
 				      src_frames);
-	if (rate->dst_buf)
-		snd_pcm_linear_convert(dst_areas, dst_offset,
-				       rate->dst_buf, 0,
-				       channels, dst_frames,
-				       rate->dst_conv_idx);
+	if (rate->dst_buf && dst_areas)
+		rate_dst_stage(rate, dst_areas, dst_offset, 0,
+			       dst_frames, channels);
 }
 
 static inline void
@@ -768,6 +848,42 @@ static snd_pcm_sframes_t snd_pcm_rate_forward(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
         return 0;
 }
 
+/* store a fragment of the split slave period to the slave areas */
+static void rate_put_slave(snd_pcm_t *pcm,
+			   const snd_pcm_channel_area_t *slave_areas,
+			   snd_pcm_uframes_t slave_offset,
+			   snd_pcm_uframes_t offset, snd_pcm_uframes_t frames)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+
+	if (!rate->sareas)
+		rate_dst_stage(rate, slave_areas, slave_offset, offset,
+			       frames, pcm->channels);
+	else
+		snd_pcm_areas_copy(slave_areas, slave_offset,
+				   rate->sareas, offset,
+				   rate->gen.slave->channels, frames,
+				   rate->gen.slave->format);
+}
+
+/* load a fragment of the split slave period from the slave areas */
+static void rate_get_slave(snd_pcm_t *pcm,
+			   const snd_pcm_channel_area_t *slave_areas,
+			   snd_pcm_uframes_t slave_offset,
+			   snd_pcm_uframes_t offset, snd_pcm_uframes_t frames)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+
+	if (!rate->sareas)
+		rate_src_stage(rate, slave_areas, slave_offset, offset,
+			       frames, pcm->channels);
+	else
+		snd_pcm_areas_copy(rate->sareas, offset,
+				   slave_areas, slave_offset,
+				   rate->gen.slave->channels, frames,
+				   rate->gen.slave->format);
+}
+
 static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 				    snd_pcm_uframes_t appl_offset,
 				    snd_pcm_uframes_t size,
@@ -820,10 +936,7 @@ static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 		cont = slave_frames;
 		if (cont > slave_size)
 			cont = slave_size;
-		snd_pcm_areas_copy(slave_areas, slave_offset,
-				   rate->sareas, 0,
-				   pcm->channels, cont,
-				   rate->gen.slave->format);
+		rate_put_slave(pcm, slave_areas, slave_offset, 0, cont);
 		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, cont);
 		if (result < (snd_pcm_sframes_t)cont) {
 			if (result < 0)
@@ -850,10 +963,7 @@ static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 			return -EIO;
 		}
 #endif
-		snd_pcm_areas_copy(slave_areas, slave_offset,
-				   rate->sareas, xfer,
-				   pcm->channels, cont,
-				   rate->gen.slave->format);
+		rate_put_slave(pcm, slave_areas, slave_offset, xfer, cont);
 		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, cont);
 		if (result < (snd_pcm_sframes_t)cont) {
 			if (result < 0)
@@ -919,10 +1029,7 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 		cont = slave_frames;
 		if (cont > rate->gen.slave->period_size)
 			cont = rate->gen.slave->period_size;
-		snd_pcm_areas_copy(rate->sareas, 0,
-				   slave_areas, slave_offset,
-				   pcm->channels, cont,
-				   rate->gen.slave->format);
+		rate_get_slave(pcm, slave_areas, slave_offset, 0, cont);
 		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, cont);
 		if (result < (snd_pcm_sframes_t)cont) {
 			if (result < 0)
@@ -949,10 +1056,7 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 			return -EIO;
 		}
 #endif
-		snd_pcm_areas_copy(rate->sareas, xfer,
-		                   slave_areas, slave_offset,
-				   pcm->channels, cont,
-				   rate->gen.slave->format);
+		rate_get_slave(pcm, slave_areas, slave_offset, xfer, cont);
 		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, cont);
 		if (result < (snd_pcm_sframes_t)cont) {
 			if (result < 0)
@@ -1254,6 +1358,9 @@ static void snd_pcm_rate_dump(snd_pcm_t *pcm, snd_output_t *out)
 	if (rate->ops.dump)
 		rate->ops.dump(rate->obj, out);
 	snd_output_printf(out, "Protocol version: %x\n", rate->plugin_version);
+	if (rate->route)
+		snd_output_printf(out, "Fused route stage: %u slave channels\n",
+				  rate->schannels);
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -1270,9 +1377,55 @@ static int snd_pcm_rate_close(snd_pcm_t *pcm)
 		rate->ops.close(rate->obj);
 	if (rate->open_func)
 		snd_dlobj_cache_put(rate->open_func);
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	snd_pcm_route_params_free(rate->route);
+#endif
 	return snd_pcm_generic_close(pcm);
 }
 
+static snd_pcm_chmap_t *snd_pcm_rate_get_chmap(snd_pcm_t *pcm)
+{
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_chmap_t *map, *slave_map;
+
+	if (rate->route) {
+		slave_map = snd_pcm_generic_get_chmap(pcm);
+		if (!slave_map)
+			return NULL;
+		map = snd_pcm_route_params_get_chmap(rate->route, slave_map);
+		free(slave_map);
+		return map;
+	}
+#endif
+	return snd_pcm_generic_get_chmap(pcm);
+}
+
+static snd_pcm_chmap_query_t **snd_pcm_rate_query_chmaps(snd_pcm_t *pcm)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_chmap_query_t **maps;
+	snd_pcm_chmap_t *map;
+
+	if (!rate->route)
+		return snd_pcm_generic_query_chmaps(pcm);
+	map = snd_pcm_rate_get_chmap(pcm);
+	if (!map)
+		return NULL;
+	maps = _snd_pcm_make_single_query_chmaps(map);
+	free(map);
+	return maps;
+}
+
+static int snd_pcm_rate_set_chmap(snd_pcm_t *pcm, const snd_pcm_chmap_t *map)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+
+	if (rate->route)
+		return -ENXIO;
+	return snd_pcm_generic_set_chmap(pcm, map);
+}
+
 static const snd_pcm_fast_ops_t snd_pcm_rate_fast_ops = {
 	.status = snd_pcm_rate_status,
 	.state = snd_pcm_rate_state,
@@ -1315,9 +1468,9 @@ static const snd_pcm_ops_t snd_pcm_rate_ops = {
 	.async = snd_pcm_generic_async,
 	.mmap = snd_pcm_generic_mmap,
 	.munmap = snd_pcm_generic_munmap,
-	.query_chmaps = snd_pcm_generic_query_chmaps,
-	.get_chmap = snd_pcm_generic_get_chmap,
-	.set_chmap = snd_pcm_generic_set_chmap,
+	.query_chmaps = snd_pcm_rate_query_chmaps,
+	.get_chmap = snd_pcm_rate_get_chmap,
+	.set_chmap = snd_pcm_rate_set_chmap,
 };
 
 /**
@@ -1359,13 +1512,23 @@ static void rate_initial_setup(snd_pcm_rate_t *rate)
 }
 
 #ifdef PIC
+static const char *const builtin_rate_plugins[] = {
+	"linear", "polyphase", "polyphase_low", "polyphase_medium",
+	"polyphase_high", NULL
+};
+
 static int is_builtin_plugin(const char *type)
 {
-	return strcmp(type, "linear") == 0;
+	const char *const *types;
+
+	for (types = builtin_rate_plugins; *types; types++)
+		if (strcmp(type, *types) == 0)
+			return 1;
+	return 0;
 }
 
 static const char *const default_rate_plugins[] = {
-	"speexrate", "linear", NULL
+	"speexrate", "polyphase", "linear", NULL
 };
 
 static int rate_open_func(snd_pcm_rate_t *rate, const char *type, const snd_config_t *converter_conf, int verbose)
@@ -1584,6 +1747,39 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 	return 0;
 }
 
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+/*
+ * Attach a route matrix on the slave side of the rate PCM, so that the
+ * channel mapping and the slave format conversion are done in the same
+ * pass as the rate conversion.  The slave then runs with schannels while
+ * the client side keeps its own channel count.  Used by the plug plugin.
+ */
+int snd_pcm_rate_set_route(snd_pcm_t *pcm, unsigned int schannels,
+			   snd_pcm_route_ttable_entry_t *ttable,
+			   unsigned int tt_ssize,
+			   unsigned int tt_cused, unsigned int tt_sused)
+{
+	snd_pcm_rate_t *rate;
+	snd_pcm_route_params_t *route;
+	int err;
+
+	assert(pcm && ttable);
+	if (pcm->type != SND_PCM_TYPE_RATE || pcm->setup)
+		return -EINVAL;
+	rate = pcm->private_data;
+	if (rate->sformat == SND_PCM_FORMAT_UNKNOWN)
+		return -EINVAL;
+	err = snd_pcm_route_params_new(&route, pcm->stream, tt_ssize, ttable,
+				       tt_cused, tt_sused);
+	if (err < 0)
+		return err;
+	snd_pcm_route_params_free(rate->route);
+	rate->route = route;
+	rate->schannels = schannels;
+	return 0;
+}
+#endif
+
 /*! \page pcm_plugins
 
 \section pcm_plugins_rate Plugin: Rate
@@ -1615,6 +1811,16 @@ pcm.name {
 }
 \endcode
 
+Besides the external converter plugins, two converter types are built in:
+- linear: linear interpolation, cheapest but with audible aliasing.
+- polyphase: windowed-sinc FIR filter applied as precomputed
+  coefficient banks for the conversion ratio.  \c polyphase_low,
+  \c polyphase_medium and \c polyphase_high select 16, 32 and 64 taps
+  (more when decimating); plain \c polyphase is the medium quality.
+
+Without an explicit converter, speexrate is tried first, then polyphase
+and finally linear.
+
 \subsection pcm_plugins_rate_funcref Function reference
 
 <UL>
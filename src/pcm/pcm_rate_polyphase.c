@@ -0,0 +1,490 @@
+/*
+ *  Polyphase FIR rate converter plugin
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * The conversion ratio is taken from the period sizes (out / in, reduced),
+ * like the linear converter does, so that every period of input produces
+ * exactly one period of output.  For each output frame one bank of FIR
+ * coefficients (one phase of a Kaiser windowed sinc) is applied to the
+ * last "taps" input frames of the channel.  The banks are computed once
+ * per ratio at hw_params; when the ratio needs more than POLY_MAX_PHASES
+ * banks, the nearest of POLY_MAX_PHASES evenly spaced phases is used.
+ *
+ * S16 is filtered with Q15 integer coefficients (the DC gain is 32767/32768
+ * so that the center tap of phase 0 fits) up to the medium quality; the
+ * coefficient rounding noise of the longer filters would exceed the S16
+ * noise floor, so high quality and S32 are filtered in single precision
+ * float.  Other formats are converted by the rate plugin.
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include "pcm_local.h"
+#include "pcm_plugin.h"
+#include "pcm_rate.h"
+
+#define POLY_MAX_PHASES		1024
+#define POLY_MAX_TAPS		512
+#define POLY_COEF_SHIFT		15
+#define POLY_COEF_ONE		((1 << POLY_COEF_SHIFT) - 1)
+
+struct poly_quality {
+	const char *name;
+	unsigned int taps;	/* filter length without decimation */
+	double beta;		/* Kaiser window parameter */
+	double rolloff;		/* cutoff relative to the lower Nyquist frequency */
+};
+
+static const struct poly_quality poly_qualities[] = {
+	{ "low", 16, 6.0, 0.85 },
+	{ "medium", 32, 8.0, 0.91 },
+	{ "high", 64, 10.0, 0.945 },
+};
+
+struct rate_polyphase {
+	const struct poly_quality *quality;
+	snd_pcm_format_t format;
+	int fixed;			/* Q15 coefficients and S16 history */
+	unsigned int channels;
+	unsigned int up;		/* output frames per ... */
+	unsigned int down;		/* ... input frames */
+	unsigned int phases;		/* number of coefficient banks */
+	unsigned int taps;
+	unsigned int step_int;		/* down / up */
+	unsigned int step_frac;		/* down % up */
+	unsigned int max_frames;	/* input frames per convert call */
+	unsigned int hist_len;		/* taps - 1 + max_frames */
+	void *coefs;			/* [phases][taps] */
+	void *hist;			/* [channels][hist_len] */
+	unsigned int pos;		/* first history frame of the next output */
+	unsigned int phase;		/* fraction of the next output in 1/up */
+};
+
+static snd_pcm_uframes_t input_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_polyphase *rate = obj;
+	if (frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->down, rate->up);
+}
+
+static snd_pcm_uframes_t output_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_polyphase *rate = obj;
+	if (frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->up, rate->down);
+}
+
+static unsigned int gcd(unsigned int a, unsigned int b)
+{
+	while (b) {
+		unsigned int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/* zeroth order modified Bessel function of the first kind */
+static double bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	unsigned int k;
+
+	for (k = 1; k < 64; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+/* fill one bank with the filter sampled at offset frac, normalized to DC gain 1 */
+static void poly_design(const struct poly_quality *q, unsigned int taps,
+			double *h, double frac, double cutoff)
+{
+	double half = taps / 2.0;
+	double x, r, sum = 0.0;
+	unsigned int k;
+
+	for (k = 0; k < taps; k++) {
+		x = k - (half - 1.0) - frac;
+		r = x / half;
+		h[k] = 2.0 * cutoff;
+		if (x != 0.0)
+			h[k] = sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+		h[k] *= r * r < 1.0 ? bessel_i0(q->beta * sqrt(1.0 - r * r)) / bessel_i0(q->beta) : 0.0;
+		sum += h[k];
+	}
+	for (k = 0; k < taps; k++)
+		h[k] /= sum;
+}
+
+/*
+ * build the coefficient banks for the ratio up/down; the converter keeps
+ * its current banks and ratio when this fails
+ */
+static int poly_build(struct rate_polyphase *rate, unsigned int up,
+		      unsigned int down)
+{
+	unsigned int taps, phases, p, k, big;
+	double cutoff, *h;
+	void *coefs;
+	int16_t *c16;
+	float *cf;
+	int total;
+
+	/* widen the filter by the decimation factor to keep the transition band */
+	taps = rate->quality->taps;
+	cutoff = 0.5 * rate->quality->rolloff;
+	if (down > up) {
+		taps = ((uint64_t)taps * down / up + 7) & ~7;
+		if (taps > POLY_MAX_TAPS)
+			taps = POLY_MAX_TAPS;
+		cutoff = cutoff * up / down;
+	}
+	phases = up <= POLY_MAX_PHASES ? up : POLY_MAX_PHASES;
+
+	coefs = malloc(phases * taps *
+		       (rate->fixed ? sizeof(int16_t) : sizeof(float)));
+	h = malloc(taps * sizeof(*h));
+	if (!coefs || !h) {
+		free(coefs);
+		free(h);
+		return -ENOMEM;
+	}
+	c16 = coefs;
+	cf = coefs;
+	for (p = 0; p < phases; p++) {
+		poly_design(rate->quality, taps, h, (double)p / phases, cutoff);
+		if (!rate->fixed) {
+			for (k = 0; k < taps; k++)
+				*cf++ = h[k];
+			continue;
+		}
+		/* quantize, keeping the DC gain exact */
+		total = 0;
+		big = 0;
+		for (k = 0; k < taps; k++) {
+			c16[k] = lrint(h[k] * POLY_COEF_ONE);
+			total += c16[k];
+			if (abs(c16[k]) > abs(c16[big]))
+				big = k;
+		}
+		c16[big] += POLY_COEF_ONE - total;
+		c16 += taps;
+	}
+	free(h);
+
+	/* keep the fraction of the next output within the new ratio */
+	if (rate->up)
+		rate->phase = (uint64_t)rate->phase * up / rate->up;
+	free(rate->coefs);
+	rate->coefs = coefs;
+	rate->up = up;
+	rate->down = down;
+	rate->taps = taps;
+	rate->phases = phases;
+	rate->step_int = down / up;
+	rate->step_frac = down % up;
+	return 0;
+}
+
+static SND_PCM_VECTORIZE int32_t dot_s16(const int16_t *x, const int16_t *h,
+					 unsigned int taps)
+{
+	int32_t acc = 0;
+	unsigned int k;
+
+	for (k = 0; k < taps; k++)
+		acc += x[k] * h[k];
+	return acc;
+}
+
+/* eight partial sums, as float additions may not be reordered */
+static SND_PCM_VECTORIZE float dot_float(const float *x, const float *h,
+					 unsigned int taps)
+{
+	float acc[8] = { 0 };
+	unsigned int k, l;
+
+	for (k = 0; k < taps; k += 8, x += 8, h += 8)
+		for (l = 0; l < 8; l++)
+			acc[l] += x[l] * h[l];
+	return ((acc[0] + acc[4]) + (acc[1] + acc[5])) +
+	       ((acc[2] + acc[6]) + (acc[3] + acc[7]));
+}
+
+static inline unsigned int poly_bank(struct rate_polyphase *rate,
+				     unsigned int phase)
+{
+	if (rate->phases == rate->up)
+		return phase;
+	return (uint64_t)phase * rate->phases / rate->up;
+}
+
+static void poly_convert(void *obj,
+			 const snd_pcm_channel_area_t *dst_areas,
+			 snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			 const snd_pcm_channel_area_t *src_areas,
+			 snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	struct rate_polyphase *rate = obj;
+	unsigned int taps = rate->taps;
+	unsigned int channel, i, pos = 0, phase = 0;
+
+	if (CHECK_SANITY(src_frames > rate->max_frames)) {
+		SNDERR("src_frames overflow");
+		src_frames = rate->max_frames;
+	}
+
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const char *src = snd_pcm_channel_area_addr(src_area, src_offset);
+		char *dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		int src_step = snd_pcm_channel_area_step(src_area);
+		int dst_step = snd_pcm_channel_area_step(dst_area);
+
+		pos = rate->pos;
+		phase = rate->phase;
+		if (rate->fixed) {
+			int16_t *hist = (int16_t *)rate->hist + channel * rate->hist_len;
+			const int16_t *coefs = rate->coefs;
+			int32_t val;
+
+			for (i = 0; i < src_frames; i++, src += src_step)
+				hist[taps - 1 + i] = *(const int16_t *)src;
+			for (i = 0; i < dst_frames && pos < src_frames; i++) {
+				val = dot_s16(hist + pos, coefs + poly_bank(rate, phase) * taps, taps);
+				val = (val + (1 << (POLY_COEF_SHIFT - 1))) >> POLY_COEF_SHIFT;
+				if (val > 0x7fff)
+					val = 0x7fff;
+				else if (val < -0x8000)
+					val = -0x8000;
+				*(int16_t *)dst = val;
+				dst += dst_step;
+				pos += rate->step_int;
+				phase += rate->step_frac;
+				if (phase >= rate->up) {
+					phase -= rate->up;
+					pos++;
+				}
+			}
+			memmove(hist, hist + src_frames, (taps - 1) * sizeof(*hist));
+		} else {
+			float *hist = (float *)rate->hist + channel * rate->hist_len;
+			const float *coefs = rate->coefs;
+			float val;
+
+			int s16 = rate->format == SND_PCM_FORMAT_S16;
+
+			for (i = 0; i < src_frames; i++, src += src_step)
+				hist[taps - 1 + i] = s16 ? *(const int16_t *)src :
+							   *(const int32_t *)src;
+			for (i = 0; i < dst_frames && pos < src_frames; i++) {
+				val = dot_float(hist + pos, coefs + poly_bank(rate, phase) * taps, taps);
+				if (s16)
+					*(int16_t *)dst = val >= 32767.0f ? 0x7fff :
+						val <= -32768.0f ? -0x8000 : lrintf(val);
+				else if (val >= 2147483647.0f)
+					*(int32_t *)dst = 0x7fffffff;
+				else if (val <= -2147483648.0f)
+					*(int32_t *)dst = -0x7fffffff - 1;
+				else
+					*(int32_t *)dst = val;
+				dst += dst_step;
+				pos += rate->step_int;
+				phase += rate->step_frac;
+				if (phase >= rate->up) {
+					phase -= rate->up;
+					pos++;
+				}
+			}
+			memmove(hist, hist + src_frames, (taps - 1) * sizeof(*hist));
+		}
+		/* not enough input for the requested output; pad with silence */
+		if (i < dst_frames)
+			snd_pcm_area_silence(dst_area, dst_offset + i,
+					     dst_frames - i, rate->format);
+	}
+	rate->pos = pos >= src_frames ? pos - src_frames : 0;
+	rate->phase = phase;
+}
+
+static void poly_free(void *obj)
+{
+	struct rate_polyphase *rate = obj;
+
+	free(rate->coefs);
+	rate->coefs = NULL;
+	free(rate->hist);
+	rate->hist = NULL;
+}
+
+static int poly_set_ratio(struct rate_polyphase *rate, snd_pcm_rate_info_t *info)
+{
+	unsigned int up = info->out.period_size;
+	unsigned int down = info->in.period_size;
+	unsigned int d = gcd(up, down);
+
+	up /= d;
+	down /= d;
+	if (rate->coefs && up == rate->up && down == rate->down)
+		return 0;
+	return poly_build(rate, up, down);
+}
+
+static void poly_reset(void *obj)
+{
+	struct rate_polyphase *rate = obj;
+	size_t size = rate->fixed ? sizeof(int16_t) : sizeof(float);
+
+	if (rate->hist)
+		memset(rate->hist, 0, rate->channels * rate->hist_len * size);
+	rate->pos = 0;
+	rate->phase = 0;
+}
+
+static int poly_init(void *obj, snd_pcm_rate_info_t *info)
+{
+	struct rate_polyphase *rate = obj;
+	size_t size;
+	int err;
+
+	if (!info->in.period_size || !info->out.period_size)
+		return -EINVAL;
+	poly_free(rate);
+	rate->format = info->in.format;
+	rate->fixed = rate->format == SND_PCM_FORMAT_S16 &&
+		      rate->quality->taps <= 32;
+	rate->channels = info->channels;
+	err = poly_set_ratio(rate, info);
+	if (err < 0)
+		return err;
+
+	rate->max_frames = info->in.period_size;
+	rate->hist_len = POLY_MAX_TAPS - 1 + rate->max_frames;
+	size = rate->fixed ? sizeof(int16_t) : sizeof(float);
+	rate->hist = malloc(rate->channels * rate->hist_len * size);
+	if (!rate->hist)
+		return -ENOMEM;
+	poly_reset(rate);
+	return 0;
+}
+
+static int poly_adjust_pitch(void *obj, snd_pcm_rate_info_t *info)
+{
+	struct rate_polyphase *rate = obj;
+
+	return poly_set_ratio(rate, info);
+}
+
+static void poly_close(void *obj)
+{
+	poly_free(obj);
+	free(obj);
+}
+
+static int get_supported_rates(ATTRIBUTE_UNUSED void *rate,
+			       unsigned int *rate_min, unsigned int *rate_max)
+{
+	*rate_min = SND_PCM_PLUGIN_RATE_MIN;
+	*rate_max = SND_PCM_PLUGIN_RATE_MAX;
+	return 0;
+}
+
+static int get_supported_formats(ATTRIBUTE_UNUSED void *rate,
+				 uint64_t *in_formats, uint64_t *out_formats,
+				 unsigned int *flags)
+{
+	*in_formats = *out_formats = (1ULL << SND_PCM_FORMAT_S16) |
+				     (1ULL << SND_PCM_FORMAT_S32);
+	*flags = SND_PCM_RATE_FLAG_SYNC_FORMATS;
+	return 0;
+}
+
+static void poly_dump(void *obj, snd_output_t *out)
+{
+	struct rate_polyphase *rate = obj;
+
+	snd_output_printf(out, "Converter: polyphase (%s quality)\n",
+			  rate->quality->name);
+	if (rate->coefs)
+		snd_output_printf(out, "Ratio: %u/%u, taps: %u, phases: %u\n",
+				  rate->up, rate->down, rate->taps, rate->phases);
+}
+
+static const snd_pcm_rate_ops_t poly_ops = {
+	.close = poly_close,
+	.init = poly_init,
+	.free = poly_free,
+	.reset = poly_reset,
+	.adjust_pitch = poly_adjust_pitch,
+	.convert = poly_convert,
+	.input_frames = input_frames,
+	.output_frames = output_frames,
+	.version = SND_PCM_RATE_PLUGIN_VERSION,
+	.get_supported_rates = get_supported_rates,
+	.dump = poly_dump,
+	.get_supported_formats = get_supported_formats,
+};
+
+static int poly_open(unsigned int version, void **objp,
+		     snd_pcm_rate_ops_t *ops, unsigned int quality)
+{
+	struct rate_polyphase *rate;
+
+	/* get_supported_formats() is mandatory for the S16/S32 only design */
+	if (version < 0x010003)
+		return -EINVAL;
+	rate = calloc(1, sizeof(*rate));
+	if (! rate)
+		return -ENOMEM;
+	rate->quality = &poly_qualities[quality];
+
+	*objp = rate;
+	*ops = poly_ops;
+	return 0;
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase_low) (unsigned int version,
+					      void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return poly_open(version, objp, ops, 0);
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase_medium) (unsigned int version,
+						 void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return poly_open(version, objp, ops, 1);
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase_high) (unsigned int version,
+					       void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return poly_open(version, objp, ops, 2);
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase) (unsigned int version,
+					  void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return poly_open(version, objp, ops, 1);
+}
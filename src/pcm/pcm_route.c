@@ -59,7 +59,39 @@ typedef struct {
 
 typedef struct snd_pcm_route_ttable_dst snd_pcm_route_ttable_dst_t;
 
-typedef struct {
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+typedef float route_sample_t;
+typedef float route_sum_t;
+typedef float route_coef_t;
+#else
+typedef int32_t route_sample_t;
+typedef int64_t route_sum_t;
+typedef int32_t route_coef_t;
+#endif
+
+/* frames mixed per pass of the matrix kernels */
+#define ROUTE_MIX_BLOCK		128
+
+typedef void (*route_mix_load_f)(route_sample_t *x, const char *src,
+				 int src_step, unsigned int frames);
+typedef void (*route_mix_store_f)(char *dst, int dst_step,
+				  const int32_t *s, unsigned int frames);
+
+/* destinations mixing several sources, compiled to a sparse matrix */
+struct snd_pcm_route_mix {
+	unsigned int nsrcs;		/* source channels needed by the matrix */
+	unsigned int nslots;		/* source channels actually loaded */
+	unsigned int *slot_channel;	/* source channel of each slot */
+	unsigned int nrows;
+	unsigned int *row_dst;		/* destination channel of each row */
+	unsigned int *row_start;	/* nrows + 1 offsets in col_slot/coef */
+	unsigned int *row_shift;	/* normalization shift (integer sums) */
+	unsigned int *col_slot;
+	route_coef_t *coef;
+	route_sample_t *x;		/* nslots * ROUTE_MIX_BLOCK samples */
+};
+
+struct snd_pcm_route_params {
 	enum {UINT64, FLOAT} sum_idx;
 	unsigned int get_idx;
 	unsigned int put_idx;
@@ -70,7 +102,12 @@ typedef struct {
 	unsigned int nsrcs;
 	unsigned int ndsts;
 	snd_pcm_route_ttable_dst_t *dsts;
-} snd_pcm_route_params_t;
+	struct snd_pcm_route_mix mix;
+	int use_mix;
+	route_mix_load_f mix_load;
+	route_mix_store_f mix_store;
+	const struct route_mix_kernels *mix_kernels;
+};
 
 
 typedef void (*route_f)(const snd_pcm_channel_area_t *dst_area,
@@ -84,6 +121,7 @@ typedef void (*route_f)(const snd_pcm_channel_area_t *dst_area,
 
 struct snd_pcm_route_ttable_dst {
 	int att;	/* Attenuated */
+	int mixed;	/* handled by the mix matrix */
 	unsigned int nsrcs;
 	snd_pcm_route_ttable_src_t* srcs;
 	route_f func;
@@ -396,21 +434,205 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 	}
 }
 
+/*
+ * Matrix mixing: the destinations which sum several sources, or scale a
+ * single one, are mixed in blocks of ROUTE_MIX_BLOCK frames.  Each source
+ * used by the matrix is loaded once per block into a plain array, then
+ * every destination row accumulates only its nonzero coefficients over
+ * the whole block.  The inner loops run over frames, so the compiler
+ * vectorizes them; the sums, rounding and clipping are the same as in
+ * snd_pcm_route_convert1_many().
+ */
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define ROUTE_MIX_SIMD_X86
+#endif
+
+struct route_mix_kernels {
+	void (*mix)(route_sum_t *acc, const route_sample_t *x,
+		    const unsigned int *col_slot, const route_coef_t *coef,
+		    unsigned int ncols, unsigned int frames);
+	void (*norm)(int32_t *s, const route_sum_t *acc,
+		     unsigned int shift, unsigned int frames);
+};
+
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+/* rint() and clip to S32, values from 2^31 up are saturated too */
+#define ROUTE_MIX_NORM(isa, attr)					\
+static attr void isa##_route_mix_norm(int32_t *restrict s,		\
+				      const route_sum_t *restrict acc,	\
+				      unsigned int shift ATTRIBUTE_UNUSED, \
+				      unsigned int frames)		\
+{									\
+	unsigned int i;							\
+	for (i = 0; i < frames; i++) {					\
+		float v = rintf(acc[i]);				\
+		float c = v > -2147483648.0f ? v : -2147483648.0f;	\
+		int32_t r = (int32_t)(c < 2147483520.0f ? c : 2147483520.0f); \
+		s[i] = v >= 2147483648.0f ? 0x7fffffff : r;		\
+	}								\
+}
+#else
+#define ROUTE_MIX_NORM(isa, attr)					\
+static attr void isa##_route_mix_norm(int32_t *restrict s,		\
+				      const route_sum_t *restrict acc,	\
+				      unsigned int shift,		\
+				      unsigned int frames)		\
+{									\
+	unsigned int i;							\
+	for (i = 0; i < frames; i++) {					\
+		int64_t v = acc[i] >> shift;				\
+		if (v > (int64_t)0x7fffffff)				\
+			v = 0x7fffffff;					\
+		else if (v < -(int64_t)0x80000000)			\
+			v = -(int64_t)0x80000000;			\
+		s[i] = v;						\
+	}								\
+}
+#endif
+
+#define ROUTE_MIX_KERNELS(isa, attr)					\
+static attr void isa##_route_mix(route_sum_t *restrict acc,		\
+				 const route_sample_t *restrict x,	\
+				 const unsigned int *col_slot,		\
+				 const route_coef_t *coef,		\
+				 unsigned int ncols, unsigned int frames) \
+{									\
+	unsigned int i, k;						\
+	for (i = 0; i < frames; i++)					\
+		acc[i] = 0;						\
+	for (k = 0; k < ncols; k++) {					\
+		const route_sample_t *restrict xs =			\
+			x + col_slot[k] * ROUTE_MIX_BLOCK;		\
+		route_coef_t c = coef[k];				\
+		for (i = 0; i < frames; i++)				\
+			acc[i] += (route_sum_t)xs[i] * c;		\
+	}								\
+}									\
+ROUTE_MIX_NORM(isa, attr)						\
+static const struct route_mix_kernels isa##_route_mix_kernels = {	\
+	.mix = isa##_route_mix,						\
+	.norm = isa##_route_mix_norm,					\
+};
+
+ROUTE_MIX_KERNELS(generic, SND_PCM_VECTORIZE)
+#ifdef ROUTE_MIX_SIMD_X86
+ROUTE_MIX_KERNELS(avx2, SND_PCM_VECTORIZE __attribute__((target("avx2"))))
+#endif
+
+static const struct route_mix_kernels *route_mix_kernels_select(void)
+{
+#ifdef ROUTE_MIX_SIMD_X86
+	if (__builtin_cpu_supports("avx2"))
+		return &avx2_route_mix_kernels;
+#endif
+	return &generic_route_mix_kernels;
+}
+
+static void route_mix_load_s16(route_sample_t *x, const char *src,
+			       int src_step, unsigned int frames)
+{
+	unsigned int i;
+	for (i = 0; i < frames; i++) {
+		x[i] = *(const int16_t *)src * 65536;
+		src += src_step;
+	}
+}
+
+static void route_mix_load_s32(route_sample_t *x, const char *src,
+			       int src_step, unsigned int frames)
+{
+	unsigned int i;
+	for (i = 0; i < frames; i++) {
+		x[i] = *(const int32_t *)src;
+		src += src_step;
+	}
+}
+
+static void route_mix_store_s16(char *dst, int dst_step,
+				const int32_t *s, unsigned int frames)
+{
+	unsigned int i;
+	for (i = 0; i < frames; i++) {
+		*(int16_t *)dst = s[i] >> 16;
+		dst += dst_step;
+	}
+}
+
+static void route_mix_store_s32(char *dst, int dst_step,
+				const int32_t *s, unsigned int frames)
+{
+	unsigned int i;
+	for (i = 0; i < frames; i++) {
+		*(int32_t *)dst = s[i];
+		dst += dst_step;
+	}
+}
+
+static void route_mix_convert(const snd_pcm_channel_area_t *dst_areas,
+			      snd_pcm_uframes_t dst_offset,
+			      const snd_pcm_channel_area_t *src_areas,
+			      snd_pcm_uframes_t src_offset,
+			      unsigned int dst_channels,
+			      snd_pcm_uframes_t frames,
+			      const snd_pcm_route_params_t *params)
+{
+	const struct snd_pcm_route_mix *mix = &params->mix;
+	const struct route_mix_kernels *k = params->mix_kernels;
+	route_sum_t acc[ROUTE_MIX_BLOCK];
+	int32_t s[ROUTE_MIX_BLOCK];
+	unsigned int slot, row, n;
+
+	while (frames > 0) {
+		n = frames < ROUTE_MIX_BLOCK ? frames : ROUTE_MIX_BLOCK;
+		for (slot = 0; slot < mix->nslots; slot++) {
+			const snd_pcm_channel_area_t *area;
+			area = &src_areas[mix->slot_channel[slot]];
+			params->mix_load(mix->x + slot * ROUTE_MIX_BLOCK,
+					 snd_pcm_channel_area_addr(area, src_offset),
+					 snd_pcm_channel_area_step(area), n);
+		}
+		for (row = 0; row < mix->nrows; row++) {
+			const snd_pcm_channel_area_t *area;
+			unsigned int start = mix->row_start[row];
+
+			if (mix->row_dst[row] >= dst_channels)
+				continue;
+			area = &dst_areas[mix->row_dst[row]];
+			k->mix(acc, mix->x, mix->col_slot + start,
+			       mix->coef + start,
+			       mix->row_start[row + 1] - start, n);
+			k->norm(s, acc, mix->row_shift[row], n);
+			params->mix_store(snd_pcm_channel_area_addr(area, dst_offset),
+					  snd_pcm_channel_area_step(area), s, n);
+		}
+		src_offset += n;
+		dst_offset += n;
+		frames -= n;
+	}
+}
+
 #endif /* DOC_HIDDEN */
 
-static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
-				  snd_pcm_uframes_t dst_offset,
-				  const snd_pcm_channel_area_t *src_areas,
-				  snd_pcm_uframes_t src_offset,
-				  unsigned int src_channels,
-				  unsigned int dst_channels,
-				  snd_pcm_uframes_t frames,
-				  snd_pcm_route_params_t *params)
+void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
+			   snd_pcm_uframes_t dst_offset,
+			   const snd_pcm_channel_area_t *src_areas,
+			   snd_pcm_uframes_t src_offset,
+			   unsigned int src_channels,
+			   unsigned int dst_channels,
+			   snd_pcm_uframes_t frames,
+			   snd_pcm_route_params_t *params)
 {
 	unsigned int dst_channel;
 	snd_pcm_route_ttable_dst_t *dstp;
 	const snd_pcm_channel_area_t *dst_area;
+	int use_mix = params->use_mix && src_channels >= params->mix.nsrcs;
 
+	if (use_mix)
+		route_mix_convert(dst_areas, dst_offset,
+				  src_areas, src_offset,
+				  dst_channels, frames, params);
 	dstp = params->dsts;
 	dst_area = dst_areas;
 	for (dst_channel = 0; dst_channel < dst_channels; ++dst_channel) {
@@ -419,6 +641,8 @@ static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
 						    src_areas, src_offset,
 						    src_channels,
 						    frames, dstp, params);
+		else if (use_mix && dstp->mixed)
+			;
 		else
 			dstp->func(dst_area, dst_offset,
 				   src_areas, src_offset,
@@ -429,10 +653,8 @@ static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
 	}
 }
 
-static int snd_pcm_route_close(snd_pcm_t *pcm)
+static void route_free_ttable(snd_pcm_route_params_t *params)
 {
-	snd_pcm_route_t *route = pcm->private_data;
-	snd_pcm_route_params_t *params = &route->params;
 	unsigned int dst_channel;
 
 	if (params->dsts) {
@@ -440,7 +662,99 @@ static int snd_pcm_route_close(snd_pcm_t *pcm)
 			free(params->dsts[dst_channel].srcs);
 		}
 		free(params->dsts);
+		params->dsts = NULL;
 	}
+	free(params->mix.slot_channel);
+	free(params->mix.row_dst);
+	free(params->mix.row_start);
+	free(params->mix.row_shift);
+	free(params->mix.col_slot);
+	free(params->mix.coef);
+	free(params->mix.x);
+	memset(&params->mix, 0, sizeof(params->mix));
+	params->use_mix = 0;
+}
+
+/* set up the sample converters for the given source and destination formats */
+void snd_pcm_route_params_set_format(snd_pcm_route_params_t *params,
+				     snd_pcm_format_t src_format,
+				     snd_pcm_format_t dst_format)
+{
+	/* 3 bytes or 20-bit formats? */
+	params->use_getput =
+		(snd_pcm_format_physical_width(src_format) + 7) / 8 == 3 ||
+		(snd_pcm_format_physical_width(dst_format) + 7) / 8 == 3 ||
+		snd_pcm_format_width(src_format) == 20 ||
+		snd_pcm_format_width(dst_format) == 20;
+	params->get_idx = snd_pcm_linear_get_index(src_format, SND_PCM_FORMAT_S32);
+	params->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, dst_format);
+	params->conv_idx = snd_pcm_linear_convert_index(src_format, dst_format);
+	params->src_size = snd_pcm_format_width(src_format) / 8;
+	params->dst_sfmt = dst_format;
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	params->sum_idx = FLOAT;
+#else
+	params->sum_idx = UINT64;
+#endif
+
+	/* the mix matrix reads and writes native 16 and 32-bit samples */
+	switch (src_format) {
+	case SND_PCM_FORMAT_S16:
+		params->mix_load = route_mix_load_s16;
+		break;
+	case SND_PCM_FORMAT_S32:
+		params->mix_load = route_mix_load_s32;
+		break;
+	default:
+		params->mix_load = NULL;
+		break;
+	}
+	switch (dst_format) {
+	case SND_PCM_FORMAT_S16:
+		params->mix_store = route_mix_store_s16;
+		break;
+	case SND_PCM_FORMAT_S32:
+		params->mix_store = route_mix_store_s32;
+		break;
+	default:
+		params->mix_store = NULL;
+		break;
+	}
+	params->mix_kernels = route_mix_kernels_select();
+	params->use_mix = params->mix.nrows > 0 &&
+		params->mix_load && params->mix_store;
+}
+
+/* derive the client channel map from the slave map through the ttable */
+snd_pcm_chmap_t *snd_pcm_route_params_get_chmap(const snd_pcm_route_params_t *params,
+						const snd_pcm_chmap_t *slave_map)
+{
+	snd_pcm_chmap_t *map;
+	unsigned int src, dst, nsrcs;
+
+	nsrcs = params->nsrcs;
+	map = calloc(4, nsrcs + 1);
+	if (!map)
+		return NULL;
+	map->channels = nsrcs;
+	for (src = 0; src < nsrcs; src++)
+		map->pos[src] = SND_CHMAP_NA;
+	for (dst = 0; dst < params->ndsts; dst++) {
+		snd_pcm_route_ttable_dst_t *d = &params->dsts[dst];
+		for (src = 0; src < d->nsrcs; src++) {
+			unsigned int c = d->srcs[src].channel;
+			if (c < nsrcs && map->pos[c] == SND_CHMAP_NA)
+				map->pos[c] = slave_map->pos[dst];
+		}
+	}
+	return map;
+}
+
+static int snd_pcm_route_close(snd_pcm_t *pcm)
+{
+	snd_pcm_route_t *route = pcm->private_data;
+
+	route_free_ttable(&route->params);
 	free(route->chmap);
 	snd_pcm_free_chmaps(route->chmap_override);
 	return snd_pcm_generic_close(pcm);
@@ -567,22 +881,7 @@ static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	}
 	if (err < 0)
 		return err;
-	/* 3 bytes or 20-bit formats? */
-	route->params.use_getput =
-		(snd_pcm_format_physical_width(src_format) + 7) / 8 == 3 ||
-		(snd_pcm_format_physical_width(dst_format) + 7) / 8 == 3 ||
-		snd_pcm_format_width(src_format) == 20 ||
-		snd_pcm_format_width(dst_format) == 20;
-	route->params.get_idx = snd_pcm_linear_get_index(src_format, SND_PCM_FORMAT_S32);
-	route->params.put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, dst_format);
-	route->params.conv_idx = snd_pcm_linear_convert_index(src_format, dst_format);
-	route->params.src_size = snd_pcm_format_width(src_format) / 8;
-	route->params.dst_sfmt = dst_format;
-#if SND_PCM_PLUGIN_ROUTE_FLOAT
-	route->params.sum_idx = FLOAT;
-#else
-	route->params.sum_idx = UINT64;
-#endif
+	snd_pcm_route_params_set_format(&route->params, src_format, dst_format);
 	return 0;
 }
 
@@ -634,7 +933,6 @@ static snd_pcm_chmap_t *snd_pcm_route_get_chmap(snd_pcm_t *pcm)
 {
 	snd_pcm_route_t *route = pcm->private_data;
 	snd_pcm_chmap_t *map, *slave_map;
-	unsigned int src, dst, nsrcs;
 
 	if (route->chmap_override)
 		return _snd_pcm_choose_fixed_chmap(pcm, route->chmap_override);
@@ -642,23 +940,7 @@ static snd_pcm_chmap_t *snd_pcm_route_get_chmap(snd_pcm_t *pcm)
 	slave_map = snd_pcm_generic_get_chmap(pcm);
 	if (!slave_map)
 		return NULL;
-	nsrcs = route->params.nsrcs;
-	map = calloc(4, nsrcs + 1);
-	if (!map) {
-		free(slave_map);
-		return NULL;
-	}
-	map->channels = nsrcs;
-	for (src = 0; src < nsrcs; src++)
-		map->pos[src] = SND_CHMAP_NA;
-	for (dst = 0; dst < route->params.ndsts; dst++) {
-		snd_pcm_route_ttable_dst_t *d = &route->params.dsts[dst];
-		for (src = 0; src < d->nsrcs; src++) {
-			unsigned int c = d->srcs[src].channel;
-			if (c < nsrcs && map->pos[c] == SND_CHMAP_NA)
-				map->pos[c] = slave_map->pos[dst];
-		}
-	}
+	map = snd_pcm_route_params_get_chmap(&route->params, slave_map);
 	free(slave_map);
 	return map;
 }
@@ -926,6 +1208,71 @@ static const snd_pcm_ops_t snd_pcm_route_ops = {
 	.set_chmap = NULL, /* NYI */
 };
 
+/* build the sparse mix matrix from the per destination source lists */
+static int route_mix_compile(snd_pcm_route_params_t *params)
+{
+	struct snd_pcm_route_mix *mix = &params->mix;
+	unsigned int dst, src, col, nrows = 0, ncols = 0;
+	int slot_of[params->nsrcs];
+
+	for (src = 0; src < params->nsrcs; src++)
+		slot_of[src] = -1;
+	for (dst = 0; dst < params->ndsts; dst++) {
+		snd_pcm_route_ttable_dst_t *d = &params->dsts[dst];
+		d->mixed = d->nsrcs > 1 || (d->nsrcs == 1 && d->att);
+		if (!d->mixed)
+			continue;
+		nrows++;
+		ncols += d->nsrcs;
+		for (src = 0; src < d->nsrcs; src++) {
+			unsigned int c = d->srcs[src].channel;
+			if (slot_of[c] < 0)
+				slot_of[c] = mix->nslots++;
+			if (c >= mix->nsrcs)
+				mix->nsrcs = c + 1;
+		}
+	}
+	if (!nrows)
+		return 0;
+
+	mix->slot_channel = calloc(mix->nslots, sizeof(*mix->slot_channel));
+	mix->row_dst = calloc(nrows, sizeof(*mix->row_dst));
+	mix->row_start = calloc(nrows + 1, sizeof(*mix->row_start));
+	mix->row_shift = calloc(nrows, sizeof(*mix->row_shift));
+	mix->col_slot = calloc(ncols, sizeof(*mix->col_slot));
+	mix->coef = calloc(ncols, sizeof(*mix->coef));
+	mix->x = calloc(mix->nslots * ROUTE_MIX_BLOCK, sizeof(*mix->x));
+	if (!mix->slot_channel || !mix->row_dst || !mix->row_start ||
+	    !mix->row_shift || !mix->col_slot || !mix->coef || !mix->x)
+		return -ENOMEM;
+
+	for (src = 0; src < params->nsrcs; src++) {
+		if (slot_of[src] >= 0)
+			mix->slot_channel[slot_of[src]] = src;
+	}
+	col = 0;
+	for (dst = 0; dst < params->ndsts; dst++) {
+		snd_pcm_route_ttable_dst_t *d = &params->dsts[dst];
+		if (!d->mixed)
+			continue;
+		mix->row_dst[mix->nrows] = dst;
+		mix->row_start[mix->nrows] = col;
+		for (src = 0; src < d->nsrcs; src++, col++) {
+			mix->col_slot[col] = slot_of[d->srcs[src].channel];
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+			mix->coef[col] = d->srcs[src].as_float;
+#else
+			/* unattenuated sums are not divided, see div() */
+			mix->coef[col] = d->att ? d->srcs[src].as_int : 1;
+#endif
+		}
+		mix->row_shift[mix->nrows] = d->att ? 4 : 0;
+		mix->nrows++;
+	}
+	mix->row_start[mix->nrows] = col;
+	return 0;
+}
+
 static int route_load_ttable(snd_pcm_route_params_t *params, snd_pcm_stream_t stream,
 			     unsigned int tt_ssize,
 			     snd_pcm_route_ttable_entry_t *ttable,
@@ -993,9 +1340,39 @@ static int route_load_ttable(snd_pcm_route_params_t *params, snd_pcm_stream_t st
 			dptr->srcs = 0;
 		dptr++;
 	}
+	return route_mix_compile(params);
+}
+
+/* allocate a standalone route matrix, used by the fused rate path in plug */
+int snd_pcm_route_params_new(snd_pcm_route_params_t **paramsp,
+			     snd_pcm_stream_t stream,
+			     unsigned int tt_ssize,
+			     snd_pcm_route_ttable_entry_t *ttable,
+			     unsigned int tt_cused, unsigned int tt_sused)
+{
+	snd_pcm_route_params_t *params;
+	int err;
+
+	params = calloc(1, sizeof(*params));
+	if (!params)
+		return -ENOMEM;
+	err = route_load_ttable(params, stream, tt_ssize, ttable, tt_cused, tt_sused);
+	if (err < 0) {
+		snd_pcm_route_params_free(params);
+		return err;
+	}
+	*paramsp = params;
 	return 0;
 }
 
+void snd_pcm_route_params_free(snd_pcm_route_params_t *params)
+{
+	if (params) {
+		route_free_ttable(params);
+		free(params);
+	}
+}
+
 /**
  * \brief Creates a new Route & Volume PCM
  * \param pcmp Returns created PCM handle
@@ -33,6 +33,7 @@
 #include <string.h>
 #include <signal.h>
 #include <math.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <poll.h>
 #include <pthread.h>
@@ -88,14 +89,23 @@ typedef struct {
 	snd_pcm_uframes_t silence_frames;
 	snd_pcm_sw_params_t sw_params;
 	snd_pcm_uframes_t hw_ptr;
+	/* slave position published by the owner for the queries */
+	unsigned int pub_seq;	/* odd while written, 0 if not running */
+	snd_pcm_uframes_t pub_avail;
+	snd_pcm_sframes_t pub_delay;
+	snd_htimestamp_t pub_tstamp;
 	int poll[2];
 	int polling;
+	int busy;		/* owner may touch the slave and all clients */
+	int pending;		/* clients waiting for the owner to commit */
+	int waiters;		/* threads sleeping until busy is released */
 	pthread_t thread;
-	pthread_mutex_t mutex;
+	pthread_mutex_t mutex;	/* serializes the state changes */
+	pthread_mutex_t busy_mutex;
+	pthread_cond_t busy_cond;	/* signaled when busy is released */
 #ifdef MUTEX_DEBUG
 	char *mutex_holder;
 #endif
-	pthread_cond_t poll_cond;
 } snd_pcm_share_slave_t;
 
 typedef struct {
@@ -110,6 +120,8 @@ typedef struct {
 	snd_pcm_uframes_t hw_ptr;
 	snd_pcm_uframes_t appl_ptr;
 	int ready;
+	int update;		/* committed frames not yet seen by the slave */
+	int error;		/* slave commit error not yet returned */
 	int client_socket;
 	int slave_socket;
 } snd_pcm_share_t;
@@ -117,6 +129,179 @@ typedef struct {
 #endif /* DOC_HIDDEN */
 
 static void _snd_pcm_share_stop(snd_pcm_t *pcm, snd_pcm_state_t state);
+static void _snd_pcm_share_run(snd_pcm_share_slave_t *slave);
+static void _snd_pcm_share_slave_xrun(snd_pcm_share_slave_t *slave);
+
+/*
+ * The clients don't take the slave mutex on the hot path (mmap_commit,
+ * avail_update, delay, status...).  Their pointers are published with
+ * atomic stores and only the owner of slave->busy touches the slave PCM
+ * or the other clients.  A client finding the slave busy leaves its
+ * commit pending and returns, the owner runs it before releasing and
+ * keeps its error in share->error for the next commit or avail_update.
+ * Whenever it syncs the slave, the owner publishes its hw_ptr, avail,
+ * delay and time; the queries finding the slave busy serve these values.
+ */
+static inline snd_pcm_state_t snd_pcm_share_get_state(snd_pcm_share_t *share)
+{
+	return __atomic_load_n(&share->state, __ATOMIC_ACQUIRE);
+}
+
+static inline void snd_pcm_share_set_state(snd_pcm_share_t *share,
+					   snd_pcm_state_t state)
+{
+	__atomic_store_n(&share->state, state, __ATOMIC_RELEASE);
+}
+
+static inline int snd_pcm_share_slave_trylock(snd_pcm_share_slave_t *slave)
+{
+	return !__atomic_exchange_n(&slave->busy, 1, __ATOMIC_SEQ_CST);
+}
+
+#define SHARE_PUB_RETRIES	32
+
+/*
+ * Called by the owner only: sync the slave hw_ptr and publish it with
+ * the slave avail, delay and time, readers see a consistent copy or none.
+ */
+static snd_pcm_sframes_t snd_pcm_share_slave_sync(snd_pcm_share_slave_t *slave)
+{
+	snd_pcm_t *spcm = slave->pcm;
+	unsigned int seq = __atomic_load_n(&slave->pub_seq, __ATOMIC_RELAXED);
+	snd_pcm_sframes_t avail;
+	snd_htimestamp_t tstamp;
+
+	avail = snd_pcm_avail_update(spcm);
+	if (avail < 0) {
+		__atomic_store_n(&slave->hw_ptr, *spcm->hw.ptr, __ATOMIC_RELAXED);
+		__atomic_store_n(&slave->pub_seq, 0, __ATOMIC_RELEASE);
+		if (avail == -EPIPE)
+			_snd_pcm_share_slave_xrun(slave);
+		return avail;
+	}
+	gettimestamp(&tstamp, spcm->tstamp_type);
+	seq |= 1;
+	__atomic_store_n(&slave->pub_seq, seq, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&slave->hw_ptr, *spcm->hw.ptr, __ATOMIC_RELAXED);
+	__atomic_store_n(&slave->pub_avail, avail, __ATOMIC_RELAXED);
+	__atomic_store_n(&slave->pub_delay,
+			 spcm->stream == SND_PCM_STREAM_PLAYBACK ?
+			 (snd_pcm_sframes_t)spcm->buffer_size - avail : avail,
+			 __ATOMIC_RELAXED);
+	__atomic_store_n(&slave->pub_tstamp.tv_sec, tstamp.tv_sec, __ATOMIC_RELAXED);
+	__atomic_store_n(&slave->pub_tstamp.tv_nsec, tstamp.tv_nsec, __ATOMIC_RELAXED);
+	/* never 0, which means nothing published */
+	seq++;
+	__atomic_store_n(&slave->pub_seq, seq ? seq : 2, __ATOMIC_RELEASE);
+	return avail;
+}
+
+/* read the published values, -EAGAIN if there are none */
+static int snd_pcm_share_slave_published(snd_pcm_share_slave_t *slave,
+					 snd_pcm_uframes_t *avail,
+					 snd_pcm_sframes_t *delay,
+					 snd_htimestamp_t *tstamp)
+{
+	unsigned int seq, retries;
+
+	for (retries = 0; retries < SHARE_PUB_RETRIES; retries++) {
+		seq = __atomic_load_n(&slave->pub_seq, __ATOMIC_ACQUIRE);
+		if (!seq)
+			return -EAGAIN;
+		if (seq & 1)
+			continue;
+		*avail = __atomic_load_n(&slave->pub_avail, __ATOMIC_RELAXED);
+		*delay = __atomic_load_n(&slave->pub_delay, __ATOMIC_RELAXED);
+		tstamp->tv_sec = __atomic_load_n(&slave->pub_tstamp.tv_sec, __ATOMIC_RELAXED);
+		tstamp->tv_nsec = __atomic_load_n(&slave->pub_tstamp.tv_nsec, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slave->pub_seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+	return -EAGAIN;
+}
+
+static void snd_pcm_share_slave_release(snd_pcm_share_slave_t *slave)
+{
+	do {
+		_snd_pcm_share_run(slave);
+		/* published values of a stopped slave are stale */
+		if (!slave->running_count)
+			__atomic_store_n(&slave->pub_seq, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&slave->busy, 0, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&slave->waiters, __ATOMIC_SEQ_CST)) {
+			pthread_mutex_lock(&slave->busy_mutex);
+			pthread_cond_broadcast(&slave->busy_cond);
+			pthread_mutex_unlock(&slave->busy_mutex);
+		}
+		/* a commit left pending after the run is ours again */
+		if (!__atomic_load_n(&slave->pending, __ATOMIC_SEQ_CST))
+			return;
+	} while (snd_pcm_share_slave_trylock(slave));
+}
+
+/* sleep until the current owner releases the slave */
+static void snd_pcm_share_slave_acquire(snd_pcm_share_slave_t *slave)
+{
+	if (snd_pcm_share_slave_trylock(slave))
+		return;
+	pthread_mutex_lock(&slave->busy_mutex);
+	/* counted before the trylock, so the release cannot miss us */
+	__atomic_add_fetch(&slave->waiters, 1, __ATOMIC_SEQ_CST);
+	while (!snd_pcm_share_slave_trylock(slave))
+		pthread_cond_wait(&slave->busy_cond, &slave->busy_mutex);
+	__atomic_sub_fetch(&slave->waiters, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&slave->busy_mutex);
+}
+
+/*
+ * queries: own the slave if it is free, otherwise serve the values
+ * published by its owner.  Returns 1 if the caller owns the slave and
+ * must release it, 0 if the published values were read.
+ */
+static int snd_pcm_share_slave_query(snd_pcm_share_slave_t *slave,
+				     snd_pcm_uframes_t *avail,
+				     snd_pcm_sframes_t *delay,
+				     snd_htimestamp_t *tstamp)
+{
+	if (snd_pcm_share_slave_trylock(slave))
+		return 1;
+	if (!snd_pcm_share_slave_published(slave, avail, delay, tstamp))
+		return 0;
+	/* nothing published yet: the slave is not running */
+	snd_pcm_share_slave_acquire(slave);
+	return 1;
+}
+
+/* state changes: exclude the other state changes, then wait for the owner */
+static void snd_pcm_share_slave_lock(snd_pcm_share_slave_t *slave)
+{
+	Pthread_mutex_lock(&slave->mutex);
+	snd_pcm_share_slave_acquire(slave);
+}
+
+static void snd_pcm_share_slave_unlock(snd_pcm_share_slave_t *slave)
+{
+	snd_pcm_share_slave_release(slave);
+	Pthread_mutex_unlock(&slave->mutex);
+}
+
+/* return once the error of a commit run by another owner */
+static inline int snd_pcm_share_take_error(snd_pcm_share_t *share)
+{
+	if (!__atomic_load_n(&share->error, __ATOMIC_RELAXED))
+		return 0;
+	return __atomic_exchange_n(&share->error, 0, __ATOMIC_ACQ_REL);
+}
+
+static void snd_pcm_share_slave_wakeup(snd_pcm_share_slave_t *slave)
+{
+	char buf[1] = { 0 };
+	/* the pipe is non-blocking, a full one wakes the thread anyway */
+	if (write(slave->poll[1], buf, 1) < 0 && errno != EAGAIN)
+		SYSMSG("cannot wake up the share thread");
+}
 
 static snd_pcm_uframes_t snd_pcm_share_slave_avail(snd_pcm_share_slave_t *slave)
 {
@@ -187,6 +372,26 @@ static snd_pcm_uframes_t _snd_pcm_share_slave_forward(snd_pcm_share_slave_t *sla
 	return frames;
 }
 
+/* Call it with the slave locked: update the poll state of a client */
+static void _snd_pcm_share_set_ready(snd_pcm_t *pcm, int ready)
+{
+	snd_pcm_share_t *share = pcm->private_data;
+	char buf[1];
+	if (ready == share->ready)
+		return;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		if (ready)
+			read(share->slave_socket, buf, 1);
+		else
+			write(share->client_socket, buf, 1);
+	} else {
+		if (ready)
+			write(share->slave_socket, buf, 1);
+		else
+			read(share->client_socket, buf, 1);
+	}
+	share->ready = ready;
+}
 
 /* 
    - stop PCM on xrun
@@ -216,7 +421,7 @@ static snd_pcm_uframes_t _snd_pcm_share_missing(snd_pcm_t *pcm)
 	default:
 		return INT_MAX;
 	}
-	share->hw_ptr = slave->hw_ptr;
+	__atomic_store_n(&share->hw_ptr, slave->hw_ptr, __ATOMIC_RELAXED);
 	avail = snd_pcm_mmap_avail(pcm);
 	if (avail >= pcm->stop_threshold) {
 		_snd_pcm_share_stop(pcm, share->state == SND_PCM_STATE_DRAINING ? SND_PCM_STATE_SETUP : SND_PCM_STATE_XRUN);
@@ -286,21 +491,7 @@ static snd_pcm_uframes_t _snd_pcm_share_missing(snd_pcm_t *pcm)
 	}
 
  update_poll:
-	if (ready != share->ready) {
-		char buf[1];
-		if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
-			if (ready)
-				read(share->slave_socket, buf, 1);
-			else
-				write(share->client_socket, buf, 1);
-		} else {
-			if (ready)
-				write(share->slave_socket, buf, 1);
-			else
-				read(share->client_socket, buf, 1);
-		}
-		share->ready = ready;
-	}
+	_snd_pcm_share_set_ready(pcm, ready);
 	if (!running)
 		return INT_MAX;
 	if (pcm->stream == SND_PCM_STREAM_PLAYBACK &&
@@ -338,8 +529,7 @@ static snd_pcm_uframes_t _snd_pcm_share_slave_missing(snd_pcm_share_slave_t *sla
 {
 	snd_pcm_uframes_t missing = INT_MAX;
 	struct list_head *i;
-	/* snd_pcm_sframes_t avail = */ snd_pcm_avail_update(slave->pcm);
-	slave->hw_ptr = *slave->pcm->hw.ptr;
+	snd_pcm_share_slave_sync(slave);
 	list_for_each(i, &slave->clients) {
 		snd_pcm_share_t *share = list_entry(i, snd_pcm_share_t, list);
 		snd_pcm_t *pcm = share->pcm;
@@ -364,15 +554,19 @@ static void *snd_pcm_share_thread(void *data)
 		SNDERR("invalid poll descriptors %d", err);
 		return NULL;
 	}
-	Pthread_mutex_lock(&slave->mutex);
-	err = pipe(slave->poll);
-	if (err < 0) {
-		SYSERR("can't create a pipe");
-		Pthread_mutex_unlock(&slave->mutex);
-		return NULL;
-	}
-	while (slave->open_count > 0) {
+	pfd[1].revents = 0;
+	for (;;) {
 		snd_pcm_uframes_t missing;
+		unsigned int nfds = 1;
+		unsigned short revents;
+		snd_pcm_share_slave_acquire(slave);
+		if (slave->open_count == 0) {
+			snd_pcm_share_slave_release(slave);
+			break;
+		}
+		/* let the slave consume its wakeup, e.g. a timer expiration */
+		if (pfd[1].revents)
+			snd_pcm_poll_descriptors_revents(spcm, &pfd[1], 1, &revents);
 		// printf("begin min_missing\n");
 		missing = _snd_pcm_share_slave_missing(slave);
 		// printf("min_missing=%ld\n", missing);
@@ -395,24 +589,30 @@ static void *snd_pcm_share_thread(void *data)
 				err = snd_pcm_sw_params(spcm, &slave->sw_params);
 				if (err < 0) {
 					SYSERR("snd_pcm_sw_params error");
-					Pthread_mutex_unlock(&slave->mutex);
+					snd_pcm_share_slave_release(slave);
 					return NULL;
 				}
 			}
-			slave->polling = 1;
-			Pthread_mutex_unlock(&slave->mutex);
-			err = poll(pfd, 2, -1);
-			Pthread_mutex_lock(&slave->mutex);
-			if (pfd[0].revents & POLLIN) {
-				char buf[1];
-				read(pfd[0].fd, buf, 1);
+			/* some slaves arm their wakeup for avail_min only here */
+			err = snd_pcm_poll_descriptors(spcm, &pfd[1], 1);
+			if (err != 1) {
+				SNDERR("invalid poll descriptors %d", err);
+				snd_pcm_share_slave_release(slave);
+				return NULL;
 			}
-		} else {
-			slave->polling = 0;
-			pthread_cond_wait(&slave->poll_cond, &slave->mutex);
+			nfds = 2;
+		}
+		/* idle: sleep on the pipe until a client wakes us up */
+		slave->polling = nfds > 1;
+		snd_pcm_share_slave_release(slave);
+		pfd[1].revents = 0;
+		err = poll(pfd, nfds, -1);
+		if (err > 0 && (pfd[0].revents & POLLIN)) {
+			char buf[64];
+			while (read(pfd[0].fd, buf, sizeof(buf)) == sizeof(buf))
+				;
 		}
 	}
-	Pthread_mutex_unlock(&slave->mutex);
 	return NULL;
 }
 
@@ -422,12 +622,11 @@ static void _snd_pcm_share_update(snd_pcm_t *pcm)
 	snd_pcm_share_slave_t *slave = share->slave;
 	snd_pcm_t *spcm = slave->pcm;
 	snd_pcm_uframes_t missing;
-	/* snd_pcm_sframes_t avail = */ snd_pcm_avail_update(spcm);
-	slave->hw_ptr = *slave->pcm->hw.ptr;
+	snd_pcm_share_slave_sync(slave);
 	missing = _snd_pcm_share_missing(pcm);
 	// printf("missing %ld\n", missing);
 	if (!slave->polling) {
-		pthread_cond_signal(&slave->poll_cond);
+		snd_pcm_share_slave_wakeup(slave);
 		return;
 	}
 	if (missing < INT_MAX) {
@@ -444,6 +643,7 @@ static void _snd_pcm_share_update(snd_pcm_t *pcm)
 		if (avail_min < 0)
 			avail_min += spcm->boundary;
 		if ((snd_pcm_uframes_t)avail_min < spcm->avail_min) {
+			struct pollfd pfd;
 			int err;
 			snd_pcm_sw_params_set_avail_min(spcm, &slave->sw_params, avail_min);
 			err = snd_pcm_sw_params(spcm, &slave->sw_params);
@@ -451,6 +651,8 @@ static void _snd_pcm_share_update(snd_pcm_t *pcm)
 				SYSERR("snd_pcm_sw_params error");
 				return;
 			}
+			/* rearm the wakeup the thread is polling for */
+			snd_pcm_poll_descriptors(spcm, &pfd, 1);
 		}
 	}
 }
@@ -617,7 +819,7 @@ static int snd_pcm_share_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	snd_pcm_share_slave_t *slave = share->slave;
 	snd_pcm_t *spcm = slave->pcm;
 	int err = 0;
-	Pthread_mutex_lock(&slave->mutex);
+	snd_pcm_share_slave_lock(slave);
 	if (slave->setup_count) {
 		err = _snd_pcm_hw_params_set_format(params, spcm->format);
 		if (err < 0)
@@ -660,10 +862,10 @@ static int snd_pcm_share_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		if (slave->pcm->stream == SND_PCM_STREAM_PLAYBACK)
 			snd_pcm_areas_silence(slave->pcm->running_areas, 0, slave->pcm->channels, slave->pcm->buffer_size, slave->pcm->format);
 	}
-	share->state = SND_PCM_STATE_SETUP;
+	snd_pcm_share_set_state(share, SND_PCM_STATE_SETUP);
 	slave->setup_count++;
  _end:
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -672,12 +874,12 @@ static int snd_pcm_share_hw_free(snd_pcm_t *pcm)
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
 	int err = 0;
-	Pthread_mutex_lock(&slave->mutex);
+	snd_pcm_share_slave_lock(slave);
 	slave->setup_count--;
 	if (slave->setup_count == 0)
 		err = snd_pcm_hw_free(slave->pcm);
-	share->state = SND_PCM_STATE_OPEN;
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_set_state(share, SND_PCM_STATE_OPEN);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -690,70 +892,71 @@ static int snd_pcm_share_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
 {
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
+	snd_pcm_state_t state = snd_pcm_share_get_state(share);
+	snd_pcm_uframes_t savail;
+	snd_htimestamp_t tstamp;
 	int err = 0;
 	snd_pcm_sframes_t sd = 0, d = 0;
-	Pthread_mutex_lock(&slave->mutex);
 	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
 		status->avail = snd_pcm_mmap_playback_avail(pcm);
-		if (share->state != SND_PCM_STATE_RUNNING &&
-		    share->state != SND_PCM_STATE_DRAINING)
+		if (state != SND_PCM_STATE_RUNNING &&
+		    state != SND_PCM_STATE_DRAINING)
 			goto _notrunning;
 		d = pcm->buffer_size - status->avail;
 	} else {
 		status->avail = snd_pcm_mmap_capture_avail(pcm);
-		if (share->state != SND_PCM_STATE_RUNNING)
+		if (state != SND_PCM_STATE_RUNNING)
 			goto _notrunning;
 		d = status->avail;
 	}
-	err = snd_pcm_delay(slave->pcm, &sd);
+	if (snd_pcm_share_slave_query(slave, &savail, &sd, &tstamp)) {
+		err = snd_pcm_delay(slave->pcm, &sd);
+		snd_pcm_share_slave_release(slave);
+	}
 	if (err < 0)
-		goto _end;
+		return err;
  _notrunning:
 	status->delay = sd + d;
-	status->state = share->state;
+	status->state = state;
 	status->appl_ptr = *pcm->appl.ptr;
 	status->hw_ptr = *pcm->hw.ptr;
 	status->trigger_tstamp = share->trigger_tstamp;
- _end:
-	Pthread_mutex_unlock(&slave->mutex);
-	return err;
+	return 0;
 }
 
 static snd_pcm_state_t snd_pcm_share_state(snd_pcm_t *pcm)
 {
 	snd_pcm_share_t *share = pcm->private_data;
-	return share->state;
+	return snd_pcm_share_get_state(share);
 }
 
-static int _snd_pcm_share_hwsync(snd_pcm_t *pcm)
+static int snd_pcm_share_hwsync(snd_pcm_t *pcm)
 {
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
-	switch (share->state) {
+	int err;
+	switch (snd_pcm_share_get_state(share)) {
 	case SND_PCM_STATE_XRUN:
 		return -EPIPE;
 	default:
 		break;
 	}
-	return snd_pcm_hwsync(slave->pcm);
-}
-
-static int snd_pcm_share_hwsync(snd_pcm_t *pcm)
-{
-	snd_pcm_share_t *share = pcm->private_data;
-	snd_pcm_share_slave_t *slave = share->slave;
-	int err;
-	Pthread_mutex_lock(&slave->mutex);
-	err = _snd_pcm_share_hwsync(pcm);
-	Pthread_mutex_unlock(&slave->mutex);
+	/* a busy slave is being synced by its owner */
+	if (!snd_pcm_share_slave_trylock(slave))
+		return 0;
+	err = snd_pcm_hwsync(slave->pcm);
+	snd_pcm_share_slave_release(slave);
 	return err;
 }
 
-static int _snd_pcm_share_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
+static int snd_pcm_share_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 {
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
-	switch (share->state) {
+	snd_pcm_uframes_t avail;
+	snd_htimestamp_t tstamp;
+	int err;
+	switch (snd_pcm_share_get_state(share)) {
 	case SND_PCM_STATE_XRUN:
 		return -EPIPE;
 	case SND_PCM_STATE_RUNNING:
@@ -765,17 +968,10 @@ static int _snd_pcm_share_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 	default:
 		return -EBADFD;
 	}
-	return snd_pcm_delay(slave->pcm, delayp);
-}
-
-static int snd_pcm_share_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
-{
-	snd_pcm_share_t *share = pcm->private_data;
-	snd_pcm_share_slave_t *slave = share->slave;
-	int err;
-	Pthread_mutex_lock(&slave->mutex);
-	err = _snd_pcm_share_delay(pcm, delayp);
-	Pthread_mutex_unlock(&slave->mutex);
+	if (!snd_pcm_share_slave_query(slave, &avail, delayp, &tstamp))
+		return 0;
+	err = snd_pcm_delay(slave->pcm, delayp);
+	snd_pcm_share_slave_release(slave);
 	return err;
 }
 
@@ -784,19 +980,32 @@ static snd_pcm_sframes_t snd_pcm_share_avail_update(snd_pcm_t *pcm)
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
 	snd_pcm_sframes_t avail;
-	Pthread_mutex_lock(&slave->mutex);
-	if (share->state == SND_PCM_STATE_RUNNING) {
-		avail = snd_pcm_avail_update(slave->pcm);
-		if (avail < 0) {
-			Pthread_mutex_unlock(&slave->mutex);
-			return avail;
+	int err;
+	err = snd_pcm_share_take_error(share);
+	if (err < 0)
+		return err;
+	if (snd_pcm_share_get_state(share) == SND_PCM_STATE_RUNNING) {
+		/* the owner of the slave is updating its hw_ptr anyway */
+		if (snd_pcm_share_slave_trylock(slave)) {
+			avail = snd_pcm_share_slave_sync(slave);
+			snd_pcm_share_slave_release(slave);
+			if (avail < 0)
+				return avail;
 		}
-		share->hw_ptr = *slave->pcm->hw.ptr;
+		__atomic_store_n(&share->hw_ptr,
+				 __atomic_load_n(&slave->hw_ptr, __ATOMIC_RELAXED),
+				 __ATOMIC_RELAXED);
 	}
-	Pthread_mutex_unlock(&slave->mutex);
 	avail = snd_pcm_mmap_avail(pcm);
-	if ((snd_pcm_uframes_t)avail > pcm->buffer_size)
+	if ((snd_pcm_uframes_t)avail > pcm->buffer_size) {
+		/* stop it now, the owner may not run its update before
+		 * the application tries to prepare it again */
+		snd_pcm_share_slave_lock(slave);
+		if (share->state == SND_PCM_STATE_RUNNING)
+			_snd_pcm_share_stop(pcm, SND_PCM_STATE_XRUN);
+		snd_pcm_share_slave_unlock(slave);
 		return -EPIPE;
+	}
 	return avail;
 }
 
@@ -805,14 +1014,75 @@ static int snd_pcm_share_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail,
 {
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
+	snd_pcm_sframes_t delay;
 	int err;
-	Pthread_mutex_lock(&slave->mutex);
+	if (!snd_pcm_share_slave_query(slave, avail, &delay, tstamp))
+		return 0;
 	err = snd_pcm_htimestamp(slave->pcm, avail, tstamp);
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_release(slave);
 	return err;
 }
 
-/* Call it with mutex held */
+/* Frames of the slave already committed past a playback client */
+static snd_pcm_sframes_t _snd_pcm_share_latecomer(snd_pcm_t *pcm)
+{
+	snd_pcm_share_t *share = pcm->private_data;
+	snd_pcm_t *spcm = share->slave->pcm;
+	snd_pcm_sframes_t frames;
+	frames = __atomic_load_n(spcm->appl.ptr, __ATOMIC_RELAXED) - share->appl_ptr;
+	if (frames > (snd_pcm_sframes_t)pcm->buffer_size)
+		frames -= pcm->boundary;
+	else if (frames < -(snd_pcm_sframes_t)pcm->buffer_size)
+		frames += pcm->boundary;
+	return frames;
+}
+
+/* Call it with the slave locked */
+static snd_pcm_sframes_t _snd_pcm_share_commit(snd_pcm_t *pcm)
+{
+	snd_pcm_share_t *share = pcm->private_data;
+	snd_pcm_share_slave_t *slave = share->slave;
+	snd_pcm_t *spcm = slave->pcm;
+	snd_pcm_sframes_t frames;
+	if (share->state != SND_PCM_STATE_RUNNING)
+		return 0;
+	frames = _snd_pcm_share_slave_forward(slave);
+	if (frames > 0) {
+		snd_pcm_sframes_t err;
+		err = snd_pcm_mmap_commit(spcm, snd_pcm_mmap_offset(spcm), frames);
+		if (err < 0) {
+			SYSMSG("snd_pcm_mmap_commit error");
+			if (err == -EPIPE)
+				_snd_pcm_share_slave_xrun(slave);
+			return err;
+		}
+		if (err != frames) {
+			SYSMSG("commit returns %ld for size %ld", err, frames);
+			return err;
+		}
+	}
+	_snd_pcm_share_update(pcm);
+	return 0;
+}
+
+/* Call it with the slave locked */
+static void _snd_pcm_share_run(snd_pcm_share_slave_t *slave)
+{
+	struct list_head *i;
+	snd_pcm_sframes_t err;
+	while (__atomic_exchange_n(&slave->pending, 0, __ATOMIC_SEQ_CST)) {
+		list_for_each(i, &slave->clients) {
+			snd_pcm_share_t *share = list_entry(i, snd_pcm_share_t, list);
+			if (!__atomic_exchange_n(&share->update, 0, __ATOMIC_SEQ_CST))
+				continue;
+			err = _snd_pcm_share_commit(share->pcm);
+			if (err < 0)
+				__atomic_store_n(&share->error, err, __ATOMIC_RELEASE);
+		}
+	}
+}
+
+/* Call it with the slave locked */
 static snd_pcm_sframes_t _snd_pcm_share_mmap_commit(snd_pcm_t *pcm,
 						    snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
 						    snd_pcm_uframes_t size)
@@ -824,11 +1094,7 @@ static snd_pcm_sframes_t _snd_pcm_share_mmap_commit(snd_pcm_t *pcm,
 	snd_pcm_sframes_t frames;
 	if (pcm->stream == SND_PCM_STREAM_PLAYBACK &&
 	    share->state == SND_PCM_STATE_RUNNING) {
-		frames = *spcm->appl.ptr - share->appl_ptr;
-		if (frames > (snd_pcm_sframes_t)pcm->buffer_size)
-			frames -= pcm->boundary;
-		else if (frames < -(snd_pcm_sframes_t)pcm->buffer_size)
-			frames += pcm->boundary;
+		frames = _snd_pcm_share_latecomer(pcm);
 		if (frames > 0) {
 			/* Latecomer PCM */
 			ret = snd_pcm_rewind(spcm, frames);
@@ -837,22 +1103,9 @@ static snd_pcm_sframes_t _snd_pcm_share_mmap_commit(snd_pcm_t *pcm,
 		}
 	}
 	snd_pcm_mmap_appl_forward(pcm, size);
-	if (share->state == SND_PCM_STATE_RUNNING) {
-		frames = _snd_pcm_share_slave_forward(slave);
-		if (frames > 0) {
-			snd_pcm_sframes_t err;
-			err = snd_pcm_mmap_commit(spcm, snd_pcm_mmap_offset(spcm), frames);
-			if (err < 0) {
-				SYSMSG("snd_pcm_mmap_commit error");
-				return err;
-			}
-			if (err != frames) {
-				SYSMSG("commit returns %ld for size %ld", err, frames);
-				return err;
-			}
-		}
-		_snd_pcm_share_update(pcm);
-	}
+	ret = _snd_pcm_share_commit(pcm);
+	if (ret)
+		return ret;
 	return size;
 }
 
@@ -862,11 +1115,37 @@ static snd_pcm_sframes_t snd_pcm_share_mmap_commit(snd_pcm_t *pcm,
 {
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
+	snd_pcm_state_t state = snd_pcm_share_get_state(share);
+	snd_pcm_uframes_t appl_ptr;
 	snd_pcm_sframes_t ret;
-	Pthread_mutex_lock(&slave->mutex);
-	ret = _snd_pcm_share_mmap_commit(pcm, offset, size);
-	Pthread_mutex_unlock(&slave->mutex);
-	return ret;
+	int err;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK &&
+	    state == SND_PCM_STATE_RUNNING &&
+	    _snd_pcm_share_latecomer(pcm) > 0) {
+		/* the slave has to be rewound */
+		snd_pcm_share_slave_lock(slave);
+		ret = _snd_pcm_share_mmap_commit(pcm, offset, size);
+		snd_pcm_share_slave_unlock(slave);
+		if (ret < 0)
+			return ret;
+		err = snd_pcm_share_take_error(share);
+		return err < 0 ? err : ret;
+	}
+	appl_ptr = share->appl_ptr + size;
+	if (appl_ptr >= pcm->boundary)
+		appl_ptr -= pcm->boundary;
+	__atomic_store_n(&share->appl_ptr, appl_ptr, __ATOMIC_RELEASE);
+	if (state != SND_PCM_STATE_RUNNING)
+		return size;
+	/* leave the commit to the owner of the slave if there's one */
+	__atomic_store_n(&share->update, 1, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&slave->pending, 1, __ATOMIC_SEQ_CST);
+	if (snd_pcm_share_slave_trylock(slave))
+		snd_pcm_share_slave_release(slave);
+	err = snd_pcm_share_take_error(share);
+	if (err < 0)
+		return err;
+	return size;
 }
 
 static int snd_pcm_share_prepare(snd_pcm_t *pcm)
@@ -874,7 +1153,7 @@ static int snd_pcm_share_prepare(snd_pcm_t *pcm)
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
 	int err = 0;
-	Pthread_mutex_lock(&slave->mutex);
+	snd_pcm_share_slave_lock(slave);
 	switch (share->state) {
 	case SND_PCM_STATE_OPEN:
 		err = -EBADFD;
@@ -896,9 +1175,10 @@ static int snd_pcm_share_prepare(snd_pcm_t *pcm)
 	slave->prepared_count++;
 	share->hw_ptr = 0;
 	share->appl_ptr = 0;
-	share->state = SND_PCM_STATE_PREPARED;
+	share->error = 0;
+	snd_pcm_share_set_state(share, SND_PCM_STATE_PREPARED);
  _end:
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -908,11 +1188,11 @@ static int snd_pcm_share_reset(snd_pcm_t *pcm)
 	snd_pcm_share_slave_t *slave = share->slave;
 	int err = 0;
 	/* FIXME? */
-	Pthread_mutex_lock(&slave->mutex);
+	snd_pcm_share_slave_lock(slave);
 	snd_pcm_areas_silence(pcm->running_areas, 0, pcm->channels, pcm->buffer_size, pcm->format);
 	share->hw_ptr = *slave->pcm->hw.ptr;
 	share->appl_ptr = share->hw_ptr;
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -922,10 +1202,10 @@ static int snd_pcm_share_start(snd_pcm_t *pcm)
 	snd_pcm_share_slave_t *slave = share->slave;
 	snd_pcm_t *spcm = slave->pcm;
 	int err = 0;
-	if (share->state != SND_PCM_STATE_PREPARED)
+	if (snd_pcm_share_get_state(share) != SND_PCM_STATE_PREPARED)
 		return -EBADFD;
-	Pthread_mutex_lock(&slave->mutex);
-	share->state = SND_PCM_STATE_RUNNING;
+	snd_pcm_share_slave_lock(slave);
+	snd_pcm_share_set_state(share, SND_PCM_STATE_RUNNING);
 	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
 		snd_pcm_uframes_t hw_avail = snd_pcm_mmap_playback_hw_avail(pcm);
 		snd_pcm_uframes_t xfer = 0;
@@ -968,6 +1248,11 @@ static int snd_pcm_share_start(snd_pcm_t *pcm)
 			}
 			assert((snd_pcm_uframes_t)res == hw_avail);
 		}
+	} else if (slave->running_count) {
+		/* Latecomer PCM: capture from the current position */
+		snd_pcm_avail_update(spcm);
+		share->hw_ptr = *spcm->hw.ptr;
+		share->appl_ptr = share->hw_ptr;
 	}
 	if (slave->running_count == 0) {
 		err = snd_pcm_start(spcm);
@@ -978,7 +1263,7 @@ static int snd_pcm_share_start(snd_pcm_t *pcm)
 	_snd_pcm_share_update(pcm);
 	gettimestamp(&share->trigger_tstamp, pcm->tstamp_type);
  _end:
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -1045,10 +1330,13 @@ static snd_pcm_sframes_t snd_pcm_share_rewindable(snd_pcm_t *pcm)
 {
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
-	snd_pcm_sframes_t ret;
-	Pthread_mutex_lock(&slave->mutex);
+	snd_pcm_uframes_t avail;
+	snd_pcm_sframes_t delay, ret;
+	snd_htimestamp_t tstamp;
+	if (!snd_pcm_share_slave_query(slave, &avail, &delay, &tstamp))
+		return slave->pcm->buffer_size - avail;
 	ret = snd_pcm_rewindable(slave->pcm);
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_release(slave);
 	return ret;
 }
 
@@ -1057,9 +1345,9 @@ static snd_pcm_sframes_t snd_pcm_share_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
 	snd_pcm_sframes_t ret;
-	Pthread_mutex_lock(&slave->mutex);
+	snd_pcm_share_slave_lock(slave);
 	ret = _snd_pcm_share_rewind(pcm, frames);
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return ret;
 }
 
@@ -1102,10 +1390,13 @@ static snd_pcm_sframes_t snd_pcm_share_forwardable(snd_pcm_t *pcm)
 {
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
-	snd_pcm_sframes_t ret;
-	Pthread_mutex_lock(&slave->mutex);
+	snd_pcm_uframes_t avail;
+	snd_pcm_sframes_t delay, ret;
+	snd_htimestamp_t tstamp;
+	if (!snd_pcm_share_slave_query(slave, &avail, &delay, &tstamp))
+		return avail;
 	ret = snd_pcm_forwardable(slave->pcm);
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_release(slave);
 	return ret;
 }
 
@@ -1114,9 +1405,9 @@ static snd_pcm_sframes_t snd_pcm_share_forward(snd_pcm_t *pcm, snd_pcm_uframes_t
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
 	snd_pcm_sframes_t ret;
-	Pthread_mutex_lock(&slave->mutex);
+	snd_pcm_share_slave_lock(slave);
 	ret = _snd_pcm_share_forward(pcm, frames);
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return ret;
 }
 
@@ -1133,10 +1424,11 @@ static void _snd_pcm_share_stop(snd_pcm_t *pcm, snd_pcm_state_t state)
 #endif
 	gettimestamp(&share->trigger_tstamp, pcm->tstamp_type);
 	if (pcm->stream == SND_PCM_STREAM_CAPTURE) {
-		snd_pcm_areas_copy(pcm->stopped_areas, 0,
-				   pcm->running_areas, 0,
-				   pcm->channels, pcm->buffer_size,
-				   pcm->format);
+		if (pcm->stopped_areas != NULL)
+			snd_pcm_areas_copy(pcm->stopped_areas, 0,
+					   pcm->running_areas, 0,
+					   pcm->channels, pcm->buffer_size,
+					   pcm->format);
 	} else if (slave->running_count > 1) {
 		int err;
 		snd_pcm_sframes_t delay;
@@ -1147,7 +1439,7 @@ static void _snd_pcm_share_stop(snd_pcm_t *pcm, snd_pcm_state_t state)
 			snd_pcm_rewind(slave->pcm, delay);
 		share->drain_silenced = 0;
 	}
-	share->state = state;
+	snd_pcm_share_set_state(share, state);
 	slave->prepared_count--;
 	slave->running_count--;
 	if (slave->running_count == 0) {
@@ -1156,18 +1448,39 @@ static void _snd_pcm_share_stop(snd_pcm_t *pcm, snd_pcm_state_t state)
 	}
 }
 
+/* the slave stopped on its own: no client can go on, stop them all */
+static void _snd_pcm_share_slave_xrun(snd_pcm_share_slave_t *slave)
+{
+	struct list_head *i;
+	list_for_each(i, &slave->clients) {
+		snd_pcm_share_t *share = list_entry(i, snd_pcm_share_t, list);
+		switch (share->state) {
+		case SND_PCM_STATE_RUNNING:
+			_snd_pcm_share_stop(share->pcm, SND_PCM_STATE_XRUN);
+			break;
+		case SND_PCM_STATE_DRAINING:
+			_snd_pcm_share_stop(share->pcm, SND_PCM_STATE_SETUP);
+			break;
+		default:
+			continue;
+		}
+		/* wake up the waiting client */
+		_snd_pcm_share_set_ready(share->pcm, 1);
+	}
+}
+
 static int snd_pcm_share_drain(snd_pcm_t *pcm)
 {
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
 	int err = 0;
-	Pthread_mutex_lock(&slave->mutex);
+	snd_pcm_share_slave_lock(slave);
 	switch (share->state) {
 	case SND_PCM_STATE_OPEN:
 		err = -EBADFD;
 		goto _end;
 	case SND_PCM_STATE_PREPARED:
-		share->state = SND_PCM_STATE_SETUP;
+		snd_pcm_share_set_state(share, SND_PCM_STATE_SETUP);
 		goto _end;
 	case SND_PCM_STATE_SETUP:
 		goto _end;
@@ -1177,13 +1490,13 @@ static int snd_pcm_share_drain(snd_pcm_t *pcm)
 	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
 		switch (share->state) {
 		case SND_PCM_STATE_XRUN:
-			share->state = SND_PCM_STATE_SETUP;
+			snd_pcm_share_set_state(share, SND_PCM_STATE_SETUP);
 			goto _end;
 		case SND_PCM_STATE_DRAINING:
 		case SND_PCM_STATE_RUNNING:
-			share->state = SND_PCM_STATE_DRAINING;
+			snd_pcm_share_set_state(share, SND_PCM_STATE_DRAINING);
 			_snd_pcm_share_update(pcm);
-			Pthread_mutex_unlock(&slave->mutex);
+			snd_pcm_share_slave_unlock(slave);
 			if (!(pcm->mode & SND_PCM_NONBLOCK))
 				snd_pcm_wait(pcm, -1);
 			return 0;
@@ -1200,9 +1513,9 @@ static int snd_pcm_share_drain(snd_pcm_t *pcm)
 		case SND_PCM_STATE_XRUN:
 		case SND_PCM_STATE_DRAINING:
 			if (snd_pcm_mmap_capture_avail(pcm) <= 0)
-				share->state = SND_PCM_STATE_SETUP;
+				snd_pcm_share_set_state(share, SND_PCM_STATE_SETUP);
 			else
-				share->state = SND_PCM_STATE_DRAINING;
+				snd_pcm_share_set_state(share, SND_PCM_STATE_DRAINING);
 			break;
 		default:
 			assert(0);
@@ -1210,7 +1523,7 @@ static int snd_pcm_share_drain(snd_pcm_t *pcm)
 		}
 	}
  _end:
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -1219,7 +1532,7 @@ static int snd_pcm_share_drop(snd_pcm_t *pcm)
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
 	int err = 0;
-	Pthread_mutex_lock(&slave->mutex);
+	snd_pcm_share_slave_lock(slave);
 	switch (share->state) {
 	case SND_PCM_STATE_OPEN:
 		err = -EBADFD;
@@ -1228,7 +1541,7 @@ static int snd_pcm_share_drop(snd_pcm_t *pcm)
 		break;
 	case SND_PCM_STATE_DRAINING:
 		if (pcm->stream == SND_PCM_STREAM_CAPTURE) {
-			share->state = SND_PCM_STATE_SETUP;
+			snd_pcm_share_set_state(share, SND_PCM_STATE_SETUP);
 			break;
 		}
 		/* Fall through */
@@ -1238,7 +1551,7 @@ static int snd_pcm_share_drop(snd_pcm_t *pcm)
 		break;
 	case SND_PCM_STATE_PREPARED:
 	case SND_PCM_STATE_XRUN:
-		share->state = SND_PCM_STATE_SETUP;
+		snd_pcm_share_set_state(share, SND_PCM_STATE_SETUP);
 		break;
 	default:
 		assert(0);
@@ -1247,7 +1560,7 @@ static int snd_pcm_share_drop(snd_pcm_t *pcm)
 	
 	share->appl_ptr = share->hw_ptr = 0;
  _end:
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -1258,22 +1571,24 @@ static int snd_pcm_share_close(snd_pcm_t *pcm)
 	int err = 0;
 
 	Pthread_mutex_lock(&snd_pcm_share_slaves_mutex);
-	Pthread_mutex_lock(&slave->mutex);
+	snd_pcm_share_slave_lock(slave);
 	slave->open_count--;
+	list_del(&share->list);
 	if (slave->open_count == 0) {
-		pthread_cond_signal(&slave->poll_cond);
-		Pthread_mutex_unlock(&slave->mutex);
+		snd_pcm_share_slave_unlock(slave);
+		snd_pcm_share_slave_wakeup(slave);
 		err = pthread_join(slave->thread, 0);
 		assert(err == 0);
 		err = snd_pcm_close(slave->pcm);
+		close(slave->poll[0]);
+		close(slave->poll[1]);
 		pthread_mutex_destroy(&slave->mutex);
-		pthread_cond_destroy(&slave->poll_cond);
+		pthread_mutex_destroy(&slave->busy_mutex);
+		pthread_cond_destroy(&slave->busy_cond);
 		list_del(&slave->list);
 		free(slave);
-		list_del(&share->list);
 	} else {
-		list_del(&share->list);
-		Pthread_mutex_unlock(&slave->mutex);
+		snd_pcm_share_slave_unlock(slave);
 	}
 	Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
 	close(share->client_socket);
@@ -1493,22 +1808,38 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 		slave->rate = srate;
 		slave->period_time = speriod_time;
 		slave->buffer_time = sbuffer_time;
+		if (pipe(slave->poll) < 0) {
+			err = -errno;
+			SYSERR("can't create a pipe");
+			Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
+			free(slave);
+			snd_pcm_close(spcm);
+			close(sd[0]);
+			close(sd[1]);
+			snd_pcm_free(pcm);
+			free(share->slave_channels);
+			free(share);
+			return err;
+		}
+		fcntl(slave->poll[0], F_SETFL, O_NONBLOCK);
+		fcntl(slave->poll[1], F_SETFL, O_NONBLOCK);
 		pthread_mutex_init(&slave->mutex, NULL);
-		pthread_cond_init(&slave->poll_cond, NULL);
+		pthread_mutex_init(&slave->busy_mutex, NULL);
+		pthread_cond_init(&slave->busy_cond, NULL);
 		list_add_tail(&slave->list, &snd_pcm_share_slaves);
-		Pthread_mutex_lock(&slave->mutex);
+		snd_pcm_share_slave_lock(slave);
 		err = pthread_create(&slave->thread, NULL, snd_pcm_share_thread, slave);
 		assert(err == 0);
 		Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
 	} else {
-		Pthread_mutex_lock(&slave->mutex);
+		snd_pcm_share_slave_lock(slave);
 		Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
 		list_for_each(i, &slave->clients) {
 			snd_pcm_share_t *sh = list_entry(i, snd_pcm_share_t, list);
 			for (k = 0; k < sh->channels; ++k) {
 				if (slave_map[sh->slave_channels[k]]) {
 					SNDERR("Slave channel %d is already in use", sh->slave_channels[k]);
-					Pthread_mutex_unlock(&slave->mutex);
+					snd_pcm_share_slave_unlock(slave);
 					close(sd[0]);
 					close(sd[1]);
 					snd_pcm_free(pcm);
@@ -1538,7 +1869,7 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 	slave->open_count++;
 	list_add_tail(&share->list, &slave->clients);
 
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 
 	*pcmp = pcm;
 	return 0;
@@ -53,6 +53,15 @@ typedef struct {
 	double min_dB;
 	double max_dB;
 	unsigned int *dB_value;
+	unsigned int ramp_frames;	/* gain ramp length, 0 = step changes */
+	unsigned int ramp_left;		/* frames left in the current ramp */
+	int ramp_valid;			/* ramp_gain holds the applied gains */
+	unsigned int ramp_vol[3];	/* target scales: left, right, center */
+	float ramp_gain[3];
+	float ramp_step[3];
+	float *ramp_buf;		/* per sample gains and increments */
+	void (*ramp_func)(void *dst, const void *src, float *gain,
+			  const float *inc, unsigned int samples);
 } snd_pcm_softvol_t;
 
 #define VOL_SCALE_SHIFT		16
@@ -426,6 +435,377 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 	}
 }
 
+/*
+ * gain ramping
+ *
+ * When ramp_frames is set, a volume change does not step the gain at
+ * the next period but moves it linearly to the new value over
+ * ramp_frames frames.  During the ramp each sample gets its own gain:
+ * a buffer holds the gain of every sample of a block of
+ * SOFTVOL_RAMP_BLOCK frames together with its increment to the next
+ * block, so the kernels are plain loops over contiguous samples which
+ * the compiler vectorizes.  Once the ramp is over, the fixed point
+ * code above takes over again.
+ */
+
+#ifndef DOC_HIDDEN
+
+#define SOFTVOL_RAMP_BLOCK	64
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define SOFTVOL_SIMD_X86
+#endif
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#define RAMP_FORMAT_S16_SWAP	SND_PCM_FORMAT_S16_BE
+#define RAMP_FORMAT_S32_SWAP	SND_PCM_FORMAT_S32_BE
+#else
+#define RAMP_FORMAT_S16_SWAP	SND_PCM_FORMAT_S16_LE
+#define RAMP_FORMAT_S32_SWAP	SND_PCM_FORMAT_S32_LE
+#endif
+
+#define RAMP_LOAD(x)		(x)
+#define RAMP_LOAD_SWAP16(x)	((int16_t)bswap_16(x))
+#define RAMP_LOAD_SWAP32(x)	((int32_t)bswap_32(x))
+#define RAMP_LOAD_S24(x)	((int32_t)((uint32_t)(x) << 8) >> 8)
+#define RAMP_STORE(x)		(x)
+#define RAMP_STORE_SWAP16(x)	bswap_16(x)
+#define RAMP_STORE_SWAP32(x)	bswap_32(x)
+
+/* samples may be converted in place, so dst and src can be equal */
+#define SOFTVOL_RAMP_KERNEL(isa, attr, name, type, load, store, lo, hi) \
+static attr void isa##_softvol_ramp_##name(void *dst, const void *src,	\
+					   float *restrict gain,	\
+					   const float *restrict inc,	\
+					   unsigned int samples)	\
+{									\
+	type *d = dst;							\
+	const type *s = src;						\
+	unsigned int i;							\
+	for (i = 0; i < samples; i++) {					\
+		float v = (float)load(s[i]) * gain[i];			\
+		v = v > (lo) ? v : (lo);				\
+		v = v < (hi) ? v : (hi);				\
+		d[i] = store((type)(int32_t)v);				\
+		gain[i] += inc[i];					\
+	}								\
+}
+
+#define SOFTVOL_RAMP_KERNELS(isa, attr)					\
+SOFTVOL_RAMP_KERNEL(isa, attr, s16, int16_t, RAMP_LOAD, RAMP_STORE,	\
+		    -32768.0f, 32767.0f)				\
+SOFTVOL_RAMP_KERNEL(isa, attr, s16_swap, uint16_t,			\
+		    RAMP_LOAD_SWAP16, RAMP_STORE_SWAP16,		\
+		    -32768.0f, 32767.0f)				\
+SOFTVOL_RAMP_KERNEL(isa, attr, s24, int32_t, RAMP_LOAD_S24, RAMP_STORE, \
+		    -8388608.0f, 8388607.0f)				\
+SOFTVOL_RAMP_KERNEL(isa, attr, s32, int32_t, RAMP_LOAD, RAMP_STORE,	\
+		    -2147483648.0f, 2147483520.0f)			\
+SOFTVOL_RAMP_KERNEL(isa, attr, s32_swap, uint32_t,			\
+		    RAMP_LOAD_SWAP32, RAMP_STORE_SWAP32,		\
+		    -2147483648.0f, 2147483520.0f)
+
+SOFTVOL_RAMP_KERNELS(generic, SND_PCM_VECTORIZE)
+#ifdef SOFTVOL_SIMD_X86
+SOFTVOL_RAMP_KERNELS(avx2, SND_PCM_VECTORIZE __attribute__((target("avx2"))))
+#endif
+
+#define SOFTVOL_RAMP_SELECT(isa, format)				\
+	switch (format) {						\
+	case SND_PCM_FORMAT_S16:					\
+		return isa##_softvol_ramp_s16;				\
+	case RAMP_FORMAT_S16_SWAP:				\
+		return isa##_softvol_ramp_s16_swap;			\
+	case SND_PCM_FORMAT_S24_LE:					\
+		return __BYTE_ORDER == __LITTLE_ENDIAN ?		\
+			isa##_softvol_ramp_s24 : NULL;			\
+	case SND_PCM_FORMAT_S32:					\
+		return isa##_softvol_ramp_s32;				\
+	case RAMP_FORMAT_S32_SWAP:				\
+		return isa##_softvol_ramp_s32_swap;			\
+	default:							\
+		return NULL;						\
+	}
+
+#endif /* DOC_HIDDEN */
+
+/* pick the ramp kernel for the slave format; NULL for S24_3LE */
+static void (*softvol_ramp_select(snd_pcm_format_t format))
+	(void *, const void *, float *, const float *, unsigned int)
+{
+#ifdef SOFTVOL_SIMD_X86
+	if (__builtin_cpu_supports("avx2"))
+		SOFTVOL_RAMP_SELECT(avx2, format);
+#endif
+	SOFTVOL_RAMP_SELECT(generic, format);
+}
+
+/* index of the gain applied to a channel, as in GET_VOL_SCALE */
+static unsigned int softvol_ramp_index(snd_pcm_softvol_t *svol,
+				       unsigned int ch, unsigned int channels)
+{
+	if (svol->cchannels == 1)
+		return 0;
+	switch (ch) {
+	case 0:
+	case 2:
+		return (channels == ch + 1) ? 2 : 0;
+	case 4:
+	case 5:
+		return 2;
+	default:
+		return ch & 1;
+	}
+}
+
+/* left, right and center scales, as applied by the fixed point code */
+static void softvol_ramp_scales(snd_pcm_softvol_t *svol, unsigned int *vol)
+{
+	unsigned int i;
+
+	for (i = 0; i < svol->cchannels; i++) {
+		if (svol->max_val == 1)
+			vol[i] = svol->cur_vol[i] ? 0xffff : 0;
+		else
+			vol[i] = svol->dB_value[svol->cur_vol[i]];
+	}
+	if (svol->cchannels == 1)
+		vol[1] = vol[2] = vol[0];
+	else if (svol->max_val == 1)
+		vol[2] = vol[0] | vol[1];
+	else
+		vol[2] = svol->dB_value[(svol->cur_vol[0] + svol->cur_vol[1]) / 2];
+}
+
+/* 0xffff is the unity gain of the fixed point code */
+static inline float softvol_ramp_gain(unsigned int vol)
+{
+	return vol == 0xffff ? 1.0f : (float)vol / (1 << VOL_SCALE_SHIFT);
+}
+
+/* one sample with a given gain, for the layouts the kernels don't take */
+static void softvol_ramp_sample(snd_pcm_format_t format, char *dst,
+				const char *src, float gain)
+{
+	float v, lo, hi;
+	int32_t x;
+
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		x = (int16_t)(snd_pcm_format_cpu_endian(format) ?
+			      *(const uint16_t *)src :
+			      bswap_16(*(const uint16_t *)src));
+		lo = -32768.0f;
+		hi = 32767.0f;
+		break;
+	case SND_PCM_FORMAT_S24_LE:
+		x = RAMP_LOAD_S24(*(const int32_t *)src);
+		lo = -8388608.0f;
+		hi = 8388607.0f;
+		break;
+	case SND_PCM_FORMAT_S24_3LE:
+		x = ((const unsigned char *)src)[0] |
+		    (((const unsigned char *)src)[1] << 8) |
+		    (((const signed char *)src)[2] << 16);
+		lo = -8388608.0f;
+		hi = 8388607.0f;
+		break;
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+		x = snd_pcm_format_cpu_endian(format) ?
+			*(const int32_t *)src :
+			(int32_t)bswap_32(*(const uint32_t *)src);
+		lo = -2147483648.0f;
+		hi = 2147483520.0f;
+		break;
+	default:
+		return;
+	}
+	v = x * gain;
+	v = v > lo ? v : lo;
+	v = v < hi ? v : hi;
+	x = (int32_t)v;
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		*(uint16_t *)dst = snd_pcm_format_cpu_endian(format) ?
+			(uint16_t)x : bswap_16((uint16_t)x);
+		break;
+	case SND_PCM_FORMAT_S24_LE:
+		*(int32_t *)dst = x;
+		break;
+	case SND_PCM_FORMAT_S24_3LE:
+		dst[0] = x;
+		dst[1] = x >> 8;
+		dst[2] = x >> 16;
+		break;
+	default:
+		*(uint32_t *)dst = snd_pcm_format_cpu_endian(format) ?
+			(uint32_t)x : bswap_32((uint32_t)x);
+		break;
+	}
+}
+
+/* all channels adjacent in one buffer, frames back to back */
+static int softvol_ramp_interleaved(const snd_pcm_channel_area_t *areas,
+				    unsigned int channels, unsigned int width)
+{
+	unsigned int ch;
+
+	for (ch = 0; ch < channels; ch++) {
+		if (areas[ch].addr != areas[0].addr ||
+		    areas[ch].first != areas[0].first + ch * width ||
+		    areas[ch].step != channels * width)
+			return 0;
+	}
+	return areas[0].first % 8 == 0;
+}
+
+/*
+ * apply the gain ramp to the first frames; returns the number of frames
+ * done, the rest is left to the fixed point code
+ */
+static snd_pcm_uframes_t softvol_convert_ramp(snd_pcm_softvol_t *svol,
+					      const snd_pcm_channel_area_t *dst_areas,
+					      snd_pcm_uframes_t dst_offset,
+					      const snd_pcm_channel_area_t *src_areas,
+					      snd_pcm_uframes_t src_offset,
+					      unsigned int channels,
+					      snd_pcm_uframes_t frames)
+{
+	unsigned int vol[3], width, bytes, ch, f, k, n;
+	snd_pcm_uframes_t done, size;
+	float *gain, *inc;
+
+	softvol_ramp_scales(svol, vol);
+	if (!svol->ramp_valid) {
+		for (k = 0; k < 3; k++) {
+			svol->ramp_vol[k] = vol[k];
+			svol->ramp_gain[k] = softvol_ramp_gain(vol[k]);
+		}
+		svol->ramp_left = 0;
+		svol->ramp_valid = 1;
+	} else if (memcmp(vol, svol->ramp_vol, sizeof(vol))) {
+		/* (re)start from the gains applied so far */
+		for (k = 0; k < 3; k++) {
+			svol->ramp_vol[k] = vol[k];
+			svol->ramp_step[k] = (softvol_ramp_gain(vol[k]) -
+					      svol->ramp_gain[k]) /
+					     svol->ramp_frames;
+		}
+		svol->ramp_left = svol->ramp_frames;
+	}
+	if (!svol->ramp_left)
+		return 0;
+
+	size = frames < svol->ramp_left ? frames : svol->ramp_left;
+	width = snd_pcm_format_physical_width(svol->sformat);
+	bytes = width / 8;
+	gain = svol->ramp_buf;
+	inc = gain + SOFTVOL_RAMP_BLOCK * channels;
+
+	if (svol->ramp_func &&
+	    softvol_ramp_interleaved(src_areas, channels, width) &&
+	    softvol_ramp_interleaved(dst_areas, channels, width)) {
+		char *dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+		const char *src = snd_pcm_channel_area_addr(src_areas, src_offset);
+
+		for (ch = 0; ch < channels; ch++) {
+			k = softvol_ramp_index(svol, ch, channels);
+			for (f = 0; f < SOFTVOL_RAMP_BLOCK; f++) {
+				gain[f * channels + ch] = svol->ramp_gain[k] +
+					svol->ramp_step[k] * f;
+				inc[f * channels + ch] =
+					svol->ramp_step[k] * SOFTVOL_RAMP_BLOCK;
+			}
+		}
+		for (done = 0; done < size; done += n) {
+			n = size - done < SOFTVOL_RAMP_BLOCK ?
+				size - done : SOFTVOL_RAMP_BLOCK;
+			svol->ramp_func(dst, src, gain, inc, n * channels);
+			dst += n * channels * bytes;
+			src += n * channels * bytes;
+		}
+	} else {
+		for (ch = 0; ch < channels; ch++) {
+			const snd_pcm_channel_area_t *src_area = &src_areas[ch];
+			const snd_pcm_channel_area_t *dst_area = &dst_areas[ch];
+			char *dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+			const char *src = snd_pcm_channel_area_addr(src_area, src_offset);
+			int src_step = snd_pcm_channel_area_step(src_area);
+			int dst_step = snd_pcm_channel_area_step(dst_area);
+
+			k = softvol_ramp_index(svol, ch, channels);
+			if (svol->ramp_func && src_area->first % 8 == 0 &&
+			    dst_area->first % 8 == 0 &&
+			    src_step == (int)bytes && dst_step == (int)bytes) {
+				for (f = 0; f < SOFTVOL_RAMP_BLOCK; f++) {
+					gain[f] = svol->ramp_gain[k] +
+						svol->ramp_step[k] * f;
+					inc[f] = svol->ramp_step[k] *
+						SOFTVOL_RAMP_BLOCK;
+				}
+				for (done = 0; done < size; done += n) {
+					n = size - done < SOFTVOL_RAMP_BLOCK ?
+						size - done : SOFTVOL_RAMP_BLOCK;
+					svol->ramp_func(dst, src, gain, inc, n);
+					dst += n * bytes;
+					src += n * bytes;
+				}
+				continue;
+			}
+			for (done = 0; done < size; done++) {
+				softvol_ramp_sample(svol->sformat, dst, src,
+						    svol->ramp_gain[k] +
+						    svol->ramp_step[k] * done);
+				dst += dst_step;
+				src += src_step;
+			}
+		}
+	}
+
+	svol->ramp_left -= size;
+	for (k = 0; k < 3; k++) {
+		if (svol->ramp_left)
+			svol->ramp_gain[k] += svol->ramp_step[k] * size;
+		else
+			svol->ramp_gain[k] = softvol_ramp_gain(svol->ramp_vol[k]);
+	}
+	return size;
+}
+
+static void softvol_convert(snd_pcm_softvol_t *svol,
+			    const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_offset,
+			    unsigned int channels,
+			    snd_pcm_uframes_t frames)
+{
+	snd_pcm_uframes_t done;
+
+	if (svol->ramp_frames) {
+		done = softvol_convert_ramp(svol, dst_areas, dst_offset,
+					    src_areas, src_offset,
+					    channels, frames);
+		if (done == frames)
+			return;
+		dst_offset += done;
+		src_offset += done;
+		frames -= done;
+	}
+	if (svol->cchannels == 1)
+		softvol_convert_mono_vol(svol, dst_areas, dst_offset,
+					 src_areas, src_offset,
+					 channels, frames);
+	else
+		softvol_convert_stereo_vol(svol, dst_areas, dst_offset,
+					   src_areas, src_offset,
+					   channels, frames);
+}
+
 /*
  * get the current volume value from driver
  *
@@ -454,6 +834,7 @@ static void softvol_free(snd_pcm_softvol_t *svol)
 		snd_ctl_close(svol->ctl);
 	if (svol->dB_value && svol->dB_value != preset_dB_value)
 		free(svol->dB_value);
+	free(svol->ramp_buf);
 	free(svol);
 }
 
@@ -638,6 +1019,15 @@ static int snd_pcm_softvol_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * param
 		return -EINVAL;
 	}
 	svol->sformat = slave->format;
+	if (svol->ramp_frames) {
+		free(svol->ramp_buf);
+		svol->ramp_buf = malloc(2 * SOFTVOL_RAMP_BLOCK * slave->channels *
+					sizeof(*svol->ramp_buf));
+		if (!svol->ramp_buf)
+			return -ENOMEM;
+		svol->ramp_func = softvol_ramp_select(svol->sformat);
+		svol->ramp_valid = 0;
+	}
 	return 0;
 }
 
@@ -654,12 +1044,8 @@ snd_pcm_softvol_write_areas(snd_pcm_t *pcm,
 	if (size > *slave_sizep)
 		size = *slave_sizep;
 	get_current_volume(svol);
-	if (svol->cchannels == 1)
-		softvol_convert_mono_vol(svol, slave_areas, slave_offset,
-					 areas, offset, pcm->channels, size);
-	else
-		softvol_convert_stereo_vol(svol, slave_areas, slave_offset,
-					   areas, offset, pcm->channels, size);
+	softvol_convert(svol, slave_areas, slave_offset,
+			areas, offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -677,12 +1063,8 @@ snd_pcm_softvol_read_areas(snd_pcm_t *pcm,
 	if (size > *slave_sizep)
 		size = *slave_sizep;
 	get_current_volume(svol);
-	if (svol->cchannels == 1)
-		softvol_convert_mono_vol(svol, areas, offset, slave_areas,
-					 slave_offset, pcm->channels, size);
-	else
-		softvol_convert_stereo_vol(svol, areas, offset, slave_areas,
-					   slave_offset, pcm->channels, size);
+	softvol_convert(svol, areas, offset, slave_areas,
+			slave_offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -699,6 +1081,8 @@ static void snd_pcm_softvol_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "max_dB: %g\n", svol->max_dB);
 		snd_output_printf(out, "resolution: %d\n", svol->max_val + 1);
 	}
+	if (svol->ramp_frames)
+		snd_output_printf(out, "ramp_frames: %u\n", svol->ramp_frames);
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -1092,6 +1476,10 @@ static int _snd_pcm_parse_control_id(snd_config_t *conf, snd_ctl_elem_id_t *ctl_
 This plugin applies the software volume attenuation.
 The format, rate and channels must match for both of source and destination.
 
+With ramp_frames set, a volume change is applied as a linear gain ramp
+over the given number of frames instead of a step at the next period,
+which avoids zipper noise with long periods.
+
 When the control is stereo (count=2), the channels are assumed to be either
 mono, 2.0, 2.1, 4.0, 4.1, 5.1 or 7.1.
 
@@ -1123,6 +1511,8 @@ pcm.name {
 	[max_dB REAL]           # maximal dB value (default:   0.0)
 	[resolution INT]        # resolution (default: 256)
 				# resolution = 2 means a mute switch
+	[ramp_frames INT]       # frames over which the gain moves to a new
+				# volume (default: 0, change at once)
 }
 \endcode
 
@@ -1163,6 +1553,7 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	double min_dB = PRESET_MIN_DB;
 	double max_dB = ZERO_DB;
 	int card = -1, cchannels = 2;
+	long ramp_frames = 0;
 
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1205,6 +1596,14 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "ramp_frames") == 0) {
+			err = snd_config_get_integer(n, &ramp_frames);
+			if (err < 0) {
+				SNDERR("Invalid ramp_frames value");
+				return err;
+			}
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1229,6 +1628,10 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 		SNDERR("Invalid resolution value %d", resolution);
 		return -EINVAL;
 	}
+	if (ramp_frames < 0 || ramp_frames > 1000000) {
+		SNDERR("Invalid ramp_frames value %ld", ramp_frames);
+		return -EINVAL;
+	}
 	if (mode & SND_PCM_NO_SOFTVOL) {
 		err = snd_pcm_slave_conf(root, slave, &sconf, 0);
 		if (err < 0)
@@ -1266,6 +1669,11 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 					   resolution, spcm, 1);
 		if (err < 0)
 			snd_pcm_close(spcm);
+		else if (*pcmp != spcm) {
+			/* not passed through to a hardware control */
+			snd_pcm_softvol_t *svol = (*pcmp)->private_data;
+			svol->ramp_frames = ramp_frames;
+		}
 	}
 	return err;
 }
@@ -0,0 +1,500 @@
+/**
+ * \file pcm/pcm_stats.c
+ * \ingroup PCM
+ * \brief PCM run-time statistics
+ *
+ * Wakeup, poll, xrun and per plugin layer processing counters of a PCM
+ * handle (see \ref pcm_stats).
+ */
+/*
+ *  PCM Interface - run-time statistics
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "config.h"
+#include <string.h>
+#include <time.h>
+#include "pcm_local.h"
+
+#ifdef HAVE___THREAD
+#define TLS_PFX		__thread
+#else
+#define TLS_PFX		/* NOP */
+#endif
+
+#define stats_add(ptr, n)	__atomic_fetch_add(ptr, n, __ATOMIC_RELAXED)
+#define stats_read(ptr)		__atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define stats_set(ptr, n)	__atomic_store_n(ptr, n, __ATOMIC_RELAXED)
+
+#ifndef DOC_HIDDEN
+int snd_pcm_stats_users;
+
+/*
+ * The plugin layers below a PCM with statistics enabled are followed
+ * through the nesting of their avail_update and mmap_commit calls: the
+ * thread doing the transfer keeps the statistics being filled and the
+ * depth of the next layer, and each layer subtracts the time spent in
+ * its slaves.  A layer is named after the PCM whose operations run
+ * (fast_op_arg), so a plug PCM shows up as its first converter.
+ */
+static TLS_PFX struct snd_pcm_stats_scope stats_ctx;
+
+struct stats_frame {
+	struct snd_pcm_stats_scope prev;
+	snd_pcm_stats_t *sink;
+	unsigned int depth;
+	unsigned long long start;
+};
+
+unsigned long long snd_pcm_stats_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* the statistics collecting the operations of this PCM, if any */
+snd_pcm_stats_t *snd_pcm_stats_current(snd_pcm_t *pcm)
+{
+	return pcm->stats ? pcm->stats : stats_ctx.sink;
+}
+
+/* a read or write call on a PCM with statistics enabled */
+void snd_pcm_stats_begin(snd_pcm_t *pcm, struct snd_pcm_stats_scope *scope)
+{
+	*scope = stats_ctx;
+	stats_ctx.sink = pcm->stats;
+	stats_ctx.next = 0;
+	stats_ctx.child_ns = 0;
+}
+
+void snd_pcm_stats_end(struct snd_pcm_stats_scope *scope)
+{
+	stats_ctx = *scope;
+}
+
+static int stats_enter(snd_pcm_t *pcm, struct stats_frame *f)
+{
+	f->prev = stats_ctx;
+	if (pcm->stats && pcm->stats != stats_ctx.sink) {
+		f->sink = pcm->stats;
+		f->depth = 0;
+	} else if (stats_ctx.sink && stats_ctx.next < SND_PCM_STATS_LAYERS) {
+		f->sink = stats_ctx.sink;
+		f->depth = stats_ctx.next;
+	} else {
+		return 0;
+	}
+	stats_ctx.sink = f->sink;
+	stats_ctx.next = f->depth + 1;
+	stats_ctx.child_ns = 0;
+	f->start = snd_pcm_stats_time();
+	return 1;
+}
+
+static void stats_leave(snd_pcm_t *pcm, struct stats_frame *f,
+			snd_pcm_sframes_t frames)
+{
+	unsigned long long elapsed = snd_pcm_stats_time() - f->start;
+	snd_pcm_stats_t *s = f->sink;
+	unsigned int d = f->depth;
+
+	stats_add(&s->layer[d].ns, elapsed - stats_ctx.child_ns);
+	if (frames > 0)
+		stats_add(&s->layer[d].frames, frames);
+	stats_set(&s->layer[d].type, pcm->fast_op_arg->type);
+	stats_set(&s->layer[d].period_size, pcm->fast_op_arg->period_size);
+	if (stats_read(&s->layers) <= d)
+		stats_set(&s->layers, d + 1);
+	stats_ctx = f->prev;
+	stats_ctx.child_ns += elapsed;
+}
+
+/* the first avail_update after a wakeup, seen from the top layer */
+static void stats_avail(snd_pcm_t *pcm, snd_pcm_stats_t *s,
+			snd_pcm_sframes_t avail)
+{
+	unsigned int bucket;
+
+	s->woken = 0;
+	if (avail < 0 || !pcm->buffer_size)
+		return;
+	bucket = (snd_pcm_uframes_t)avail * SND_PCM_STATS_AVAIL_BUCKETS /
+		 pcm->buffer_size;
+	if (bucket >= SND_PCM_STATS_AVAIL_BUCKETS)
+		bucket = SND_PCM_STATS_AVAIL_BUCKETS - 1;
+	stats_add(&s->avail[bucket], 1);
+}
+
+/* __snd_pcm_avail_update() while some PCM has the statistics enabled */
+snd_pcm_sframes_t snd_pcm_stats_avail_update(snd_pcm_t *pcm)
+{
+	struct stats_frame f;
+	snd_pcm_sframes_t result;
+
+	if (!stats_enter(pcm, &f))
+		return pcm->fast_ops->avail_update(pcm->fast_op_arg);
+	result = pcm->fast_ops->avail_update(pcm->fast_op_arg);
+	stats_leave(pcm, &f, 0);
+	if (!f.depth && f.sink->woken)
+		stats_avail(pcm, f.sink, result);
+	return result;
+}
+
+/* __snd_pcm_mmap_commit() while some PCM has the statistics enabled */
+snd_pcm_sframes_t snd_pcm_stats_mmap_commit(snd_pcm_t *pcm,
+					    snd_pcm_uframes_t offset,
+					    snd_pcm_uframes_t frames)
+{
+	struct stats_frame f;
+	snd_pcm_sframes_t result;
+
+	if (!stats_enter(pcm, &f))
+		return pcm->fast_ops->mmap_commit(pcm->fast_op_arg, offset, frames);
+	result = pcm->fast_ops->mmap_commit(pcm->fast_op_arg, offset, frames);
+	stats_leave(pcm, &f, result);
+	return result;
+}
+
+/* called after poll() returned or timed out */
+void snd_pcm_stats_wakeup(snd_pcm_stats_t *stats, unsigned long long poll_ns,
+			  int woken)
+{
+	if (poll_ns)
+		stats_add(&stats->poll_ns, poll_ns);
+	if (woken) {
+		stats_add(&stats->wakeups, 1);
+		stats->woken = 1;
+	}
+}
+
+void snd_pcm_stats_recover(snd_pcm_t *pcm, int err)
+{
+	if (err == -EPIPE)
+		stats_add(&pcm->stats->xruns, 1);
+	else if (err == -ESTRPIPE)
+		stats_add(&pcm->stats->suspends, 1);
+}
+
+/* called from snd_pcm_free() */
+void snd_pcm_stats_release(snd_pcm_t *pcm)
+{
+	if (pcm->stats) {
+		free(pcm->stats);
+		pcm->stats = NULL;
+		stats_add(&snd_pcm_stats_users, -1);
+	}
+}
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief Enable or disable the statistics of a PCM
+ * \param pcm PCM handle
+ * \param enable 1 to start collecting the statistics, 0 to stop
+ * \return 0 on success otherwise a negative error code
+ *
+ * Enabling the statistics resets them.  The plugin layers below \p pcm
+ * are followed as long as the transfers go through this handle.  The
+ * function must not be called while another thread transfers data on
+ * the PCM.
+ */
+int snd_pcm_stats_enable(snd_pcm_t *pcm, int enable)
+{
+	snd_pcm_stats_t *stats = NULL;
+
+	assert(pcm);
+	if (enable) {
+		stats = calloc(1, sizeof(*stats));
+		if (!stats)
+			return -ENOMEM;
+	}
+	__snd_pcm_lock(pcm->fast_op_arg);
+	if (!pcm->stats != !stats)
+		stats_add(&snd_pcm_stats_users, stats ? 1 : -1);
+	free(pcm->stats);
+	pcm->stats = stats;
+	__snd_pcm_unlock(pcm->fast_op_arg);
+	return 0;
+}
+
+/**
+ * \brief Obtain the statistics of a PCM
+ * \param pcm PCM handle
+ * \param stats Returned statistics
+ * \return 0 on success, -EINVAL when the statistics are not enabled
+ *
+ * The function may be called from another thread while the stream is
+ * running.
+ */
+int snd_pcm_stats(snd_pcm_t *pcm, snd_pcm_stats_t *stats)
+{
+	snd_pcm_stats_t *s;
+	unsigned int k;
+
+	assert(pcm && stats);
+	__snd_pcm_lock(pcm->fast_op_arg);
+	s = pcm->stats;
+	if (!s) {
+		__snd_pcm_unlock(pcm->fast_op_arg);
+		return -EINVAL;
+	}
+	memset(stats, 0, sizeof(*stats));
+	stats->wakeups = stats_read(&s->wakeups);
+	stats->poll_ns = stats_read(&s->poll_ns);
+	stats->xruns = stats_read(&s->xruns);
+	stats->suspends = stats_read(&s->suspends);
+	for (k = 0; k < SND_PCM_STATS_AVAIL_BUCKETS; k++)
+		stats->avail[k] = stats_read(&s->avail[k]);
+	stats->layers = stats_read(&s->layers);
+	for (k = 0; k < stats->layers; k++) {
+		stats->layer[k].type = stats_read(&s->layer[k].type);
+		stats->layer[k].period_size = stats_read(&s->layer[k].period_size);
+		stats->layer[k].ns = stats_read(&s->layer[k].ns);
+		stats->layer[k].frames = stats_read(&s->layer[k].frames);
+	}
+	__snd_pcm_unlock(pcm->fast_op_arg);
+	return 0;
+}
+
+/**
+ * \brief Reset the statistics of a PCM
+ * \param pcm PCM handle
+ * \return 0 on success, -EINVAL when the statistics are not enabled
+ */
+int snd_pcm_stats_reset(snd_pcm_t *pcm)
+{
+	int err = 0;
+
+	assert(pcm);
+	__snd_pcm_lock(pcm->fast_op_arg);
+	if (pcm->stats)
+		memset(pcm->stats, 0, sizeof(*pcm->stats));
+	else
+		err = -EINVAL;
+	__snd_pcm_unlock(pcm->fast_op_arg);
+	return err;
+}
+
+/**
+ * \brief Dump the statistics of a PCM
+ * \param pcm PCM handle
+ * \param out Output handle
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_pcm_stats_dump(snd_pcm_t *pcm, snd_output_t *out)
+{
+	snd_pcm_stats_t s;
+	unsigned int k;
+	int err;
+
+	assert(pcm && out);
+	err = snd_pcm_stats(pcm, &s);
+	if (err < 0)
+		return err;
+	snd_output_printf(out, "Statistics of PCM %s:\n", pcm->name ? pcm->name : "");
+	snd_output_printf(out, "  wakeups      : %lu\n", s.wakeups);
+	snd_output_printf(out, "  poll time    : %llu.%03llu ms\n",
+			  s.poll_ns / 1000000, s.poll_ns / 1000 % 1000);
+	snd_output_printf(out, "  xruns        : %lu\n", s.xruns);
+	snd_output_printf(out, "  suspends     : %lu\n", s.suspends);
+	snd_output_printf(out, "  avail/buffer :");
+	for (k = 0; k < SND_PCM_STATS_AVAIL_BUCKETS; k++)
+		snd_output_printf(out, " <%u/%u:%lu", k + 1,
+				  SND_PCM_STATS_AVAIL_BUCKETS, s.avail[k]);
+	snd_output_printf(out, "\n");
+	for (k = 0; k < s.layers; k++) {
+		snd_output_printf(out, "  layer %u      : %-8s %llu frames, %llu us",
+				  k, snd_pcm_type_name(s.layer[k].type),
+				  s.layer[k].frames, s.layer[k].ns / 1000);
+		if (s.layer[k].frames && s.layer[k].period_size)
+			snd_output_printf(out, ", %llu ns/period",
+					  s.layer[k].ns * s.layer[k].period_size /
+					  s.layer[k].frames);
+		snd_output_printf(out, "\n");
+	}
+	return 0;
+}
+
+/**
+ * \brief get size of #snd_pcm_stats_t
+ * \return size in bytes
+ */
+size_t snd_pcm_stats_sizeof(void)
+{
+	return sizeof(snd_pcm_stats_t);
+}
+
+/**
+ * \brief allocate an invalid #snd_pcm_stats_t using standard malloc
+ * \param ptr returned pointer
+ * \return 0 on success otherwise negative error code
+ */
+int snd_pcm_stats_malloc(snd_pcm_stats_t **ptr)
+{
+	assert(ptr);
+	*ptr = calloc(1, sizeof(snd_pcm_stats_t));
+	if (!*ptr)
+		return -ENOMEM;
+	return 0;
+}
+
+/**
+ * \brief frees a previously allocated #snd_pcm_stats_t
+ * \param obj pointer to object to free
+ */
+void snd_pcm_stats_free(snd_pcm_stats_t *obj)
+{
+	free(obj);
+}
+
+/**
+ * \brief copy one #snd_pcm_stats_t to another
+ * \param dst pointer to destination
+ * \param src pointer to source
+ */
+void snd_pcm_stats_copy(snd_pcm_stats_t *dst, const snd_pcm_stats_t *src)
+{
+	assert(dst && src);
+	*dst = *src;
+}
+
+/**
+ * \brief Get the number of wakeups from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \return number of times #snd_pcm_wait() or the poll descriptors reported
+ *         the PCM ready
+ */
+unsigned long snd_pcm_stats_get_wakeups(const snd_pcm_stats_t *obj)
+{
+	assert(obj);
+	return obj->wakeups;
+}
+
+/**
+ * \brief Get the time blocked in poll from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \return time spent blocked in #snd_pcm_wait() in nanoseconds
+ */
+unsigned long long snd_pcm_stats_get_poll_time(const snd_pcm_stats_t *obj)
+{
+	assert(obj);
+	return obj->poll_ns;
+}
+
+/**
+ * \brief Get the number of xruns from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \return number of xruns handled by #snd_pcm_recover()
+ */
+unsigned long snd_pcm_stats_get_xruns(const snd_pcm_stats_t *obj)
+{
+	assert(obj);
+	return obj->xruns;
+}
+
+/**
+ * \brief Get the number of suspends from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \return number of suspends handled by #snd_pcm_recover()
+ */
+unsigned long snd_pcm_stats_get_suspends(const snd_pcm_stats_t *obj)
+{
+	assert(obj);
+	return obj->suspends;
+}
+
+/**
+ * \brief Get one bucket of the avail histogram from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \param bucket bucket index, from 0 to #SND_PCM_STATS_AVAIL_BUCKETS - 1
+ * \return number of wakeups after which the avail was in the given part
+ *         of the buffer (bucket k counts avail from k/8 to (k+1)/8 of
+ *         the buffer size, the last one also counts a full buffer)
+ */
+unsigned long snd_pcm_stats_get_avail_histogram(const snd_pcm_stats_t *obj,
+						unsigned int bucket)
+{
+	assert(obj);
+	if (bucket >= SND_PCM_STATS_AVAIL_BUCKETS)
+		return 0;
+	return obj->avail[bucket];
+}
+
+/**
+ * \brief Get the number of plugin layers from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \return number of layers seen, layer 0 is the PCM handle itself
+ */
+unsigned int snd_pcm_stats_get_layers(const snd_pcm_stats_t *obj)
+{
+	assert(obj);
+	return obj->layers;
+}
+
+/**
+ * \brief Get the type of a plugin layer from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \param layer layer index
+ * \return PCM type of the layer
+ */
+snd_pcm_type_t snd_pcm_stats_get_layer_type(const snd_pcm_stats_t *obj,
+					     unsigned int layer)
+{
+	assert(obj && layer < SND_PCM_STATS_LAYERS);
+	return obj->layer[layer].type;
+}
+
+/**
+ * \brief Get the processing time of a plugin layer from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \param layer layer index
+ * \return time spent in the avail_update and mmap_commit operations of the
+ *         layer, without its slaves, in nanoseconds
+ */
+unsigned long long snd_pcm_stats_get_layer_time(const snd_pcm_stats_t *obj,
+						unsigned int layer)
+{
+	assert(obj && layer < SND_PCM_STATS_LAYERS);
+	return obj->layer[layer].ns;
+}
+
+/**
+ * \brief Get the committed frames of a plugin layer from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \param layer layer index
+ * \return number of frames committed to the layer
+ */
+unsigned long long snd_pcm_stats_get_layer_frames(const snd_pcm_stats_t *obj,
+						  unsigned int layer)
+{
+	assert(obj && layer < SND_PCM_STATS_LAYERS);
+	return obj->layer[layer].frames;
+}
+
+/**
+ * \brief Get the period size of a plugin layer from a PCM statistics container
+ * \param obj #snd_pcm_stats_t pointer
+ * \param layer layer index
+ * \return period size of the layer in frames
+ */
+snd_pcm_uframes_t snd_pcm_stats_get_layer_period_size(const snd_pcm_stats_t *obj,
+						     unsigned int layer)
+{
+	assert(obj && layer < SND_PCM_STATS_LAYERS);
+	return obj->layer[layer].period_size;
+}
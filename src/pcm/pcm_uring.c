@@ -0,0 +1,487 @@
+/**
+ * \file pcm/pcm_uring.c
+ * \ingroup PCM
+ * \brief PCM transfers batched through io_uring
+ *
+ * The interleaved transfers of hw PCMs are queued as read() and write()
+ * requests on the PCM file descriptors, submitted to an io_uring with one
+ * io_uring_enter() call and finished by the hw plugin when reaped.  The
+ * other transfers fall back to snd_pcm_writei() and snd_pcm_readi().
+ */
+/*
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "config.h"
+#include "pcm_local.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#endif
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup)
+#define PCM_URING
+#endif
+
+#ifndef DOC_HIDDEN
+struct uring_op {
+	struct list_head list;		/* free, queued, kernel or done list */
+	snd_pcm_t *pcm;
+	void *private_data;
+	void *buf;
+	snd_pcm_uframes_t frames;
+	snd_pcm_sframes_t result;
+	int write;
+	int fd;				/* hw transfer fd, -1 for the fallback */
+};
+
+struct _snd_pcm_uring {
+	unsigned int entries;
+	struct uring_op *ops;
+	struct list_head free;
+	struct list_head queued;
+	struct list_head kernel;	/* submitted to io_uring, not reaped yet */
+	struct list_head done;
+	unsigned int ndone;
+	unsigned int inflight;		/* in the kernel ring */
+	unsigned int unsubmitted;	/* in the SQ, not taken by the kernel yet */
+	int fd;				/* -1 without io_uring */
+#ifdef PCM_URING
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+#endif
+};
+#endif
+
+#ifdef PCM_URING
+static void uring_unmap(snd_pcm_uring_t *ring)
+{
+	if (ring->sqes)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sq_ring)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	close(ring->fd);
+	ring->fd = -1;
+}
+
+static int uring_setup(snd_pcm_uring_t *ring)
+{
+	struct io_uring_params p;
+	char *sq, *cq;
+	int fd;
+
+	memset(&p, 0, sizeof(p));
+	fd = syscall(__NR_io_uring_setup, ring->entries, &p);
+	if (fd < 0)
+		return -errno;
+	ring->fd = fd;
+	ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_ring_size > ring->sq_ring_size)
+			ring->sq_ring_size = ring->cq_ring_size;
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED) {
+		ring->sq_ring = NULL;
+		goto _err;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ring = ring->sq_ring;
+	} else {
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+				     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED) {
+			ring->cq_ring = NULL;
+			goto _err;
+		}
+	}
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		goto _err;
+	}
+	sq = ring->sq_ring;
+	cq = ring->cq_ring;
+	ring->sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+	ring->sq_mask = (unsigned int *)(sq + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)(sq + p.sq_off.array);
+	ring->cq_head = (unsigned int *)(cq + p.cq_off.head);
+	ring->cq_tail = (unsigned int *)(cq + p.cq_off.tail);
+	ring->cq_mask = (unsigned int *)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	return 0;
+
+ _err:
+	fd = -errno;
+	uring_unmap(ring);
+	return fd;
+}
+
+static int uring_enter(snd_pcm_uring_t *ring, unsigned int wait_nr)
+{
+	unsigned int flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+	int ret;
+
+	do {
+		ret = syscall(__NR_io_uring_enter, ring->fd, ring->unsubmitted,
+			      wait_nr, flags, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0)
+		return -errno;
+	ring->unsubmitted -= ret;
+	return 0;
+}
+
+/* completions in the CQ, not reaped yet */
+static unsigned int uring_ready(snd_pcm_uring_t *ring)
+{
+	return __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) - *ring->cq_head;
+}
+
+/* put the transfer in the SQ; link it to prev, the SQE just before */
+static struct io_uring_sqe *uring_prep(snd_pcm_uring_t *ring,
+				       struct uring_op *op,
+				       struct io_uring_sqe *prev)
+{
+	unsigned int tail = *ring->sq_tail;
+	unsigned int idx = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = op->write ? IORING_OP_WRITE : IORING_OP_READ;
+	sqe->fd = op->fd;
+	sqe->off = (__u64)-1;
+	sqe->addr = (unsigned long)op->buf;
+	sqe->len = snd_pcm_frames_to_bytes(op->pcm, op->frames);
+	sqe->user_data = (unsigned long)op;
+	if (prev)
+		prev->flags |= IOSQE_IO_LINK;
+	ring->sq_array[idx] = idx;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	ring->unsubmitted++;
+	ring->inflight++;
+	list_add_tail(&op->list, &ring->kernel);
+	return sqe;
+}
+#endif /* PCM_URING */
+
+/**
+ * \brief Create a batch of PCM transfers
+ * \param ringp Returned batch
+ * \param entries Maximum number of transfers queued or not reaped yet
+ * \return 0 on success otherwise a negative error code
+ *
+ * The io_uring is set up when the kernel provides it, unless the
+ * environment variable LIBASOUND_PCM_URING is set to 0; otherwise all
+ * transfers use the fallback, see #snd_pcm_uring_native().
+ */
+int snd_pcm_uring_open(snd_pcm_uring_t **ringp, unsigned int entries)
+{
+	snd_pcm_uring_t *ring;
+	unsigned int i;
+
+	assert(ringp);
+	if (!entries || entries > 4096)
+		return -EINVAL;
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return -ENOMEM;
+	ring->ops = calloc(entries, sizeof(*ring->ops));
+	if (!ring->ops) {
+		free(ring);
+		return -ENOMEM;
+	}
+	ring->entries = entries;
+	INIT_LIST_HEAD(&ring->free);
+	INIT_LIST_HEAD(&ring->queued);
+	INIT_LIST_HEAD(&ring->kernel);
+	INIT_LIST_HEAD(&ring->done);
+	for (i = 0; i < entries; i++)
+		list_add_tail(&ring->ops[i].list, &ring->free);
+	ring->fd = -1;
+#ifdef PCM_URING
+	{
+		const char *p = getenv("LIBASOUND_PCM_URING");
+
+		if (!p || *p != '0')
+			uring_setup(ring);
+	}
+#endif
+	*ringp = ring;
+	return 0;
+}
+
+/**
+ * \brief Free a batch of PCM transfers
+ * \param ring Batch
+ * \return 0 on success otherwise a negative error code
+ *
+ * The transfers still in the kernel are waited for and dropped.
+ */
+int snd_pcm_uring_close(snd_pcm_uring_t *ring)
+{
+	assert(ring);
+#ifdef PCM_URING
+	if (ring->fd >= 0) {
+		while (ring->inflight) {
+			unsigned int ready = uring_ready(ring);
+
+			if (!ready) {
+				if (uring_enter(ring, 1) < 0)
+					break;
+				continue;
+			}
+			__atomic_store_n(ring->cq_head, *ring->cq_head + ready,
+					 __ATOMIC_RELEASE);
+			ring->inflight -= ready;
+		}
+		uring_unmap(ring);
+	}
+#endif
+	free(ring->ops);
+	free(ring);
+	return 0;
+}
+
+/**
+ * \brief Tell whether the transfers of hw PCMs go through io_uring
+ * \param ring Batch
+ * \return 1 when io_uring is used, 0 when all transfers fall back
+ *         to #snd_pcm_writei() and #snd_pcm_readi()
+ */
+int snd_pcm_uring_native(snd_pcm_uring_t *ring)
+{
+	assert(ring);
+	return ring->fd >= 0;
+}
+
+static int uring_queue(snd_pcm_uring_t *ring, snd_pcm_t *pcm, void *buffer,
+		       snd_pcm_uframes_t size, int write, void *private_data)
+{
+	struct uring_op *op;
+	struct list_head *pos;
+
+	assert(ring && pcm && buffer);
+	if (CHECK_SANITY(! pcm->setup)) {
+		SNDMSG("PCM not set up");
+		return -EIO;
+	}
+	if (pcm->stream != (write ? SND_PCM_STREAM_PLAYBACK : SND_PCM_STREAM_CAPTURE))
+		return -EINVAL;
+	if (list_empty(&ring->free))
+		return -EAGAIN;
+	/* only the transfers submitted together are kept in order */
+	list_for_each(pos, &ring->kernel) {
+		if (list_entry(pos, struct uring_op, list)->pcm == pcm)
+			return -EBUSY;
+	}
+	op = list_entry(ring->free.next, struct uring_op, list);
+	list_del(&op->list);
+	op->pcm = pcm;
+	op->private_data = private_data;
+	op->buf = buffer;
+	op->frames = size;
+	op->write = write;
+	op->result = 0;
+	op->fd = ring->fd >= 0 ? snd_pcm_hw_xfer_fd(pcm) : -1;
+	if (op->fd < 0)
+		op->fd = -1;
+	list_add_tail(&op->list, &ring->queued);
+	return 0;
+}
+
+/**
+ * \brief Queue a write of interleaved frames
+ * \param ring Batch
+ * \param pcm Playback PCM handle
+ * \param buffer Frames containing buffer, valid until the transfer is reaped
+ * \param size Frames to be written
+ * \param private_data Value returned with the result
+ * \return 0 on success otherwise a negative error code
+ * \retval -EAGAIN the batch is full, reap some transfers first
+ * \retval -EBUSY a transfer of the PCM is still in the kernel, reap it first
+ *
+ * The transfer is started by #snd_pcm_uring_submit().
+ */
+int snd_pcm_uring_writei(snd_pcm_uring_t *ring, snd_pcm_t *pcm,
+			 const void *buffer, snd_pcm_uframes_t size,
+			 void *private_data)
+{
+	return uring_queue(ring, pcm, (void *)buffer, size, 1, private_data);
+}
+
+/**
+ * \brief Queue a read of interleaved frames
+ * \param ring Batch
+ * \param pcm Capture PCM handle
+ * \param buffer Frames containing buffer, valid until the transfer is reaped
+ * \param size Frames to be read
+ * \param private_data Value returned with the result
+ * \return 0 on success otherwise a negative error code
+ * \retval -EAGAIN the batch is full, reap some transfers first
+ * \retval -EBUSY a transfer of the PCM is still in the kernel, reap it first
+ *
+ * The transfer is started by #snd_pcm_uring_submit().
+ */
+int snd_pcm_uring_readi(snd_pcm_uring_t *ring, snd_pcm_t *pcm,
+			void *buffer, snd_pcm_uframes_t size,
+			void *private_data)
+{
+	return uring_queue(ring, pcm, buffer, size, 0, private_data);
+}
+
+/**
+ * \brief Start the queued transfers
+ * \param ring Batch
+ * \param wait_nr Number of completed transfers to wait for
+ * \return the number of transfers started, otherwise a negative error code
+ *
+ * The transfers through io_uring are submitted with a single system
+ * call, which also waits until \p wait_nr transfers (or all which are
+ * pending, if less) can be reaped.  The transfers of one PCM are linked
+ * in their queueing order, so that they run one after another.  The
+ * fallback transfers are done before returning.
+ */
+int snd_pcm_uring_submit(snd_pcm_uring_t *ring, unsigned int wait_nr)
+{
+	struct uring_op *op;
+	int count = 0;
+#ifdef PCM_URING
+	struct list_head *pos, *npos;
+	struct io_uring_sqe *prev;
+	struct uring_op *next;
+	unsigned int ready;
+	int err;
+#endif
+
+	assert(ring);
+	while (!list_empty(&ring->queued)) {
+		op = list_entry(ring->queued.next, struct uring_op, list);
+		list_del(&op->list);
+		count++;
+#ifdef PCM_URING
+		if (op->fd >= 0) {
+			/* a link chain is made of adjacent SQEs: gather the
+			 * other transfers of the PCM behind this one */
+			prev = uring_prep(ring, op, NULL);
+			list_for_each_safe(pos, npos, &ring->queued) {
+				next = list_entry(pos, struct uring_op, list);
+				if (next->pcm != op->pcm)
+					continue;
+				list_del(&next->list);
+				count++;
+				prev = uring_prep(ring, next, prev);
+			}
+			continue;
+		}
+#endif
+		if (op->write)
+			op->result = snd_pcm_writei(op->pcm, op->buf, op->frames);
+		else
+			op->result = snd_pcm_readi(op->pcm, op->buf, op->frames);
+		list_add_tail(&op->list, &ring->done);
+		ring->ndone++;
+	}
+#ifdef PCM_URING
+	if (ring->fd < 0)
+		return count;
+	ready = ring->ndone + uring_ready(ring);
+	wait_nr = wait_nr > ready ? wait_nr - ready : 0;
+	if (wait_nr > ring->inflight - uring_ready(ring))
+		wait_nr = ring->inflight - uring_ready(ring);
+	if (ring->unsubmitted || wait_nr) {
+		err = uring_enter(ring, wait_nr);
+		if (err < 0)
+			return err;
+	}
+#endif
+	return count;
+}
+
+/**
+ * \brief Collect the completed transfers
+ * \param ring Batch
+ * \param results Array receiving the completed transfers
+ * \param space Number of entries of \p results
+ * \return the number of completed transfers returned
+ *
+ * The position and the state of the PCM are updated as by
+ * #snd_pcm_writei() or #snd_pcm_readi() for each reaped transfer; an
+ * error (e.g. -EPIPE for an xrun) is returned in the result.
+ */
+int snd_pcm_uring_reap(snd_pcm_uring_t *ring, snd_pcm_uring_result_t *results,
+		       unsigned int space)
+{
+	struct uring_op *op;
+	unsigned int n = 0;
+
+	assert(ring && results);
+	while (n < space && !list_empty(&ring->done)) {
+		op = list_entry(ring->done.next, struct uring_op, list);
+		list_del(&op->list);
+		ring->ndone--;
+		results[n].pcm = op->pcm;
+		results[n].private_data = op->private_data;
+		results[n].result = op->result;
+		n++;
+		list_add_tail(&op->list, &ring->free);
+	}
+#ifdef PCM_URING
+	if (ring->fd >= 0) {
+		unsigned int head = *ring->cq_head;
+		unsigned int tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+		struct io_uring_cqe *cqe;
+
+		while (n < space && head != tail) {
+			cqe = &ring->cqes[head & *ring->cq_mask];
+			op = (struct uring_op *)(unsigned long)cqe->user_data;
+			if (cqe->res == -ECANCELED)
+				op->result = -ECANCELED;
+			else
+				op->result = snd_pcm_hw_xfer_done(op->pcm, cqe->res);
+			results[n].pcm = op->pcm;
+			results[n].private_data = op->private_data;
+			results[n].result = op->result;
+			n++;
+			head++;
+			ring->inflight--;
+			list_del(&op->list);
+			list_add_tail(&op->list, &ring->free);
+		}
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	}
+#endif
+	return n;
+}
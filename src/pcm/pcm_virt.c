@@ -0,0 +1,1298 @@
+/**
+ * \file pcm/pcm_virt.c
+ * \ingroup PCM_Plugins
+ * \brief PCM Virtual Card Plugin Interface
+ */
+/*
+ *  PCM - Virtual card plugin
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/shm.h>
+#include <sys/sem.h>
+#include <sys/timerfd.h>
+#include "pcm_direct.h"
+
+#ifndef PIC
+/* entry for static linking */
+const char *_snd_module_pcm_virt = "";
+#endif
+
+#ifndef DOC_HIDDEN
+#define SND_PCM_VIRT_MAGIC	0x76697274	/* "virt" */
+
+/*
+ * State of the card, shared by all handles opened with the same ipc_key.
+ * The clock is defined by the trigger time: the end of the k-th period
+ * is at start_ns + k * period time (+ jitter), so every handle of every
+ * process computes the same position from the same time.
+ */
+typedef struct {
+	unsigned int magic;
+	int buf_shmid;			/* ring buffer, -1 until hw_params */
+	snd_pcm_state_t state;
+	unsigned int rate;
+	snd_pcm_uframes_t period_size;
+	snd_pcm_uframes_t stop_threshold;	/* sw_params of the card */
+	snd_pcm_uframes_t silence_size;
+	unsigned long long period_q;	/* period time is q + r / rate ns */
+	unsigned long long period_r;
+	unsigned long long jitter_ns;
+	unsigned long xrun_period;
+	unsigned int seed;
+	unsigned long long start_ns;	/* CLOCK_MONOTONIC time of the trigger */
+	snd_pcm_uframes_t start_ptr;	/* hw_ptr at the trigger */
+	unsigned long periods;		/* periods elapsed since the trigger */
+	unsigned long long tstamp_ns;	/* CLOCK_MONOTONIC time of the last period */
+	unsigned long xruns;
+	snd_pcm_uframes_t hw_ptr;
+	snd_pcm_uframes_t appl_ptr;
+	snd_htimestamp_t trigger_tstamp;
+} snd_pcm_virt_share_t;
+
+typedef struct {
+	key_t ipc_key;
+	mode_t ipc_perm;
+	unsigned int jitter;		/* us */
+	unsigned long xrun_period;
+	unsigned int seed;
+	int shmid;
+	snd_pcm_virt_share_t *shm;
+	void *buf;			/* attached ring buffer */
+	int poll_fd;			/* timerfd */
+} snd_pcm_virt_t;
+
+typedef struct {
+	snd_pcm_t *pcm;
+	int fd;
+	int running;
+	int early_event;
+	int tread;
+	unsigned int ticks;
+} snd_timer_virt_t;
+#endif
+
+static unsigned long long virt_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* nominal end of the k-th period after the trigger */
+static unsigned long long virt_period_end(const snd_pcm_virt_share_t *sh,
+					  unsigned long k)
+{
+	return sh->start_ns + k * sh->period_q + k * sh->period_r / sh->rate;
+}
+
+/* delay of the k-th period wakeup, the same for every handle */
+static unsigned long long virt_jitter(const snd_pcm_virt_share_t *sh,
+				      unsigned long k)
+{
+	uint64_t x;
+
+	if (!sh->jitter_ns)
+		return 0;
+	x = ((uint64_t)sh->seed << 32) ^ k;
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x % sh->jitter_ns;
+}
+
+static unsigned long long virt_wakeup(const snd_pcm_virt_share_t *sh,
+				      unsigned long k)
+{
+	return virt_period_end(sh, k) + virt_jitter(sh, k);
+}
+
+/* number of periods elapsed at the given time */
+static unsigned long virt_periods_at(const snd_pcm_virt_share_t *sh,
+				     unsigned long long now)
+{
+	unsigned long long elapsed;
+	unsigned long k;
+
+	if (now <= sh->start_ns)
+		return 0;
+	elapsed = now - sh->start_ns;
+	k = (double)elapsed * sh->rate /
+	    ((double)sh->period_q * sh->rate + sh->period_r);
+	while (virt_period_end(sh, k + 1) <= now)
+		k++;
+	while (k && virt_period_end(sh, k) > now)
+		k--;
+	/* the jitter is less than a period */
+	if (k && virt_wakeup(sh, k) > now)
+		k--;
+	return k;
+}
+
+static int virt_running(const snd_pcm_virt_share_t *sh)
+{
+	snd_pcm_state_t state = __atomic_load_n(&sh->state, __ATOMIC_ACQUIRE);
+
+	return state == SND_PCM_STATE_RUNNING || state == SND_PCM_STATE_DRAINING;
+}
+
+static snd_pcm_uframes_t virt_ptr_at(snd_pcm_t *pcm, unsigned long periods)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+	snd_pcm_virt_share_t *sh = virt->shm;
+
+	return (sh->start_ptr + (unsigned long long)periods * sh->period_size) %
+		pcm->boundary;
+}
+
+/* silence the played frames, as the kernel does with silence_size >= boundary */
+static void virt_silence(snd_pcm_t *pcm, snd_pcm_uframes_t from,
+			 snd_pcm_uframes_t frames)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+
+	if (pcm->stream != SND_PCM_STREAM_PLAYBACK || !pcm->running_areas ||
+	    virt->shm->silence_size < pcm->boundary)
+		return;
+	if (frames > pcm->buffer_size)
+		frames = pcm->buffer_size;
+	from %= pcm->buffer_size;
+	while (frames > 0) {
+		snd_pcm_uframes_t cont = pcm->buffer_size - from;
+
+		if (cont > frames)
+			cont = frames;
+		snd_pcm_areas_silence(pcm->running_areas, from, pcm->channels,
+				      cont, pcm->format);
+		frames -= cont;
+		from = 0;
+	}
+}
+
+/*
+ * Advance the hardware pointer to the current time.  Concurrent callers
+ * agree on the elapsed periods through the atomic counter, and the one
+ * which moves it forward handles the played frames and the xruns.
+ */
+static void virt_update(snd_pcm_t *pcm)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+	snd_pcm_virt_share_t *sh = virt->shm;
+	unsigned long old, done;
+	snd_pcm_uframes_t old_ptr, frames;
+	snd_pcm_sframes_t avail;
+	int inject = 0;
+
+	if (!virt_running(sh))
+		return;
+	done = virt_periods_at(sh, virt_now());
+	if (sh->xrun_period && done >= sh->xrun_period) {
+		done = sh->xrun_period;
+		inject = 1;
+	}
+	old = __atomic_load_n(&sh->periods, __ATOMIC_ACQUIRE);
+	do {
+		if (old >= done)
+			return;
+	} while (!__atomic_compare_exchange_n(&sh->periods, &old, done, 0,
+					      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	old_ptr = virt_ptr_at(pcm, old);
+	frames = (done - old) * sh->period_size;
+	sh->tstamp_ns = virt_wakeup(sh, done);
+	if (sh->state == SND_PCM_STATE_DRAINING) {
+		snd_pcm_uframes_t queued;
+
+		queued = pcm_frame_diff(sh->appl_ptr, old_ptr, pcm->boundary);
+		if (frames >= queued) {
+			__atomic_store_n(&sh->hw_ptr, sh->appl_ptr, __ATOMIC_RELEASE);
+			__atomic_store_n(&sh->state, SND_PCM_STATE_SETUP,
+					 __ATOMIC_RELEASE);
+			return;
+		}
+	}
+	virt_silence(pcm, old_ptr, frames);
+	/* a later update may have won meanwhile, store the newest position */
+	do {
+		done = __atomic_load_n(&sh->periods, __ATOMIC_ACQUIRE);
+		__atomic_store_n(&sh->hw_ptr, virt_ptr_at(pcm, done),
+				 __ATOMIC_RELEASE);
+	} while (__atomic_load_n(&sh->periods, __ATOMIC_ACQUIRE) != done);
+
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		avail = snd_pcm_mmap_playback_avail(pcm);
+	else
+		avail = snd_pcm_mmap_capture_avail(pcm);
+	if (inject || (snd_pcm_uframes_t)avail >= sh->stop_threshold) {
+		if (inject)
+			sh->xruns++;
+		__atomic_store_n(&sh->state, SND_PCM_STATE_XRUN, __ATOMIC_RELEASE);
+	}
+}
+
+/* convert a CLOCK_MONOTONIC time to the timestamp type of the PCM */
+static void virt_tstamp(snd_pcm_t *pcm, unsigned long long ns,
+			snd_htimestamp_t *tstamp)
+{
+	if (pcm->tstamp_type != SND_PCM_TSTAMP_TYPE_MONOTONIC &&
+	    pcm->tstamp_type != SND_PCM_TSTAMP_TYPE_MONOTONIC_RAW) {
+		snd_htimestamp_t now;
+		unsigned long long mono = virt_now();
+
+		gettimestamp(&now, pcm->tstamp_type);
+		ns = now.tv_sec * 1000000000ULL + now.tv_nsec - (mono - ns);
+	}
+	tstamp->tv_sec = ns / 1000000000ULL;
+	tstamp->tv_nsec = ns % 1000000000ULL;
+}
+
+#ifndef DOC_HIDDEN
+/* time of the last hw_ptr update, for the direct plugins */
+struct timespec snd_pcm_virt_fast_tstamp(snd_pcm_t *pcm)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+	snd_htimestamp_t tstamp;
+
+	virt_tstamp(pcm, virt->shm->tstamp_ns, &tstamp);
+	return tstamp;
+}
+#endif
+
+/* arm the poll timer for the next time avail reaches avail_min */
+static void virt_arm(snd_pcm_t *pcm)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+	snd_pcm_virt_share_t *sh = virt->shm;
+	struct itimerspec its;
+	unsigned long long when = 1;	/* in the past: ready now */
+	snd_pcm_uframes_t avail, need;
+
+	memset(&its, 0, sizeof(its));
+	switch (sh->state) {
+	case SND_PCM_STATE_RUNNING:
+	case SND_PCM_STATE_DRAINING:
+		avail = snd_pcm_mmap_avail(pcm);
+		if (sh->state == SND_PCM_STATE_DRAINING)
+			need = snd_pcm_mmap_hw_avail(pcm);
+		else if (avail < pcm->avail_min)
+			need = pcm->avail_min - avail;
+		else
+			break;
+		when = virt_wakeup(sh, sh->periods +
+				   (need + sh->period_size - 1) / sh->period_size);
+		break;
+	case SND_PCM_STATE_PREPARED:
+		if (pcm->stream == SND_PCM_STREAM_CAPTURE ||
+		    snd_pcm_mmap_avail(pcm) < pcm->avail_min)
+			when = 0;	/* wait for the start */
+		break;
+	default:
+		break;
+	}
+	its.it_value.tv_sec = when / 1000000000ULL;
+	its.it_value.tv_nsec = when % 1000000000ULL;
+	timerfd_settime(virt->poll_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void virt_free(snd_pcm_virt_t *virt)
+{
+	struct shmid_ds buf;
+
+	if (virt->buf)
+		shmdt(virt->buf);
+	if (virt->shm) {
+		shmdt(virt->shm);
+		/* the last user removes the card */
+		if (!shmctl(virt->shmid, IPC_STAT, &buf) && !buf.shm_nattch)
+			shmctl(virt->shmid, IPC_RMID, NULL);
+	}
+	close(virt->poll_fd);
+	free(virt);
+}
+
+static int snd_pcm_virt_close(snd_pcm_t *pcm)
+{
+	virt_free(pcm->private_data);
+	return 0;
+}
+
+static int snd_pcm_virt_nonblock(snd_pcm_t *pcm ATTRIBUTE_UNUSED, int nonblock ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int snd_pcm_virt_async(snd_pcm_t *pcm ATTRIBUTE_UNUSED, int sig ATTRIBUTE_UNUSED, pid_t pid ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+
+static int snd_pcm_virt_info(snd_pcm_t *pcm, snd_pcm_info_t * info)
+{
+	memset(info, 0, sizeof(*info));
+	info->stream = pcm->stream;
+	info->card = -1;
+	if (pcm->name) {
+		snd_strlcpy((char *)info->id, pcm->name, sizeof(info->id));
+		snd_strlcpy((char *)info->name, pcm->name, sizeof(info->name));
+		snd_strlcpy((char *)info->subname, pcm->name, sizeof(info->subname));
+	}
+	info->subdevices_count = 1;
+	return 0;
+}
+
+static snd_pcm_state_t snd_pcm_virt_state(snd_pcm_t *pcm)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+
+	virt_update(pcm);
+	return __atomic_load_n(&virt->shm->state, __ATOMIC_ACQUIRE);
+}
+
+static int snd_pcm_virt_hwsync(snd_pcm_t *pcm)
+{
+	switch (snd_pcm_virt_state(pcm)) {
+	case SND_PCM_STATE_XRUN:
+		return -EPIPE;
+	default:
+		return 0;
+	}
+}
+
+static snd_pcm_sframes_t snd_pcm_virt_avail_update(snd_pcm_t *pcm)
+{
+	snd_pcm_sframes_t avail;
+	int err;
+
+	err = snd_pcm_virt_hwsync(pcm);
+	if (err < 0)
+		return err;
+	avail = snd_pcm_mmap_avail(pcm);
+	if (avail > (snd_pcm_sframes_t)pcm->buffer_size)
+		avail = pcm->buffer_size;
+	return avail;
+}
+
+static int snd_pcm_virt_status(snd_pcm_t *pcm, snd_pcm_status_t * status)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+	snd_pcm_virt_share_t *sh = virt->shm;
+
+	memset(status, 0, sizeof(*status));
+	status->state = snd_pcm_virt_state(pcm);
+	status->trigger_tstamp = sh->trigger_tstamp;
+	virt_tstamp(pcm, sh->tstamp_ns, &status->tstamp);
+	status->appl_ptr = *pcm->appl.ptr;
+	status->hw_ptr = *pcm->hw.ptr;
+	status->avail = snd_pcm_mmap_avail(pcm);
+	status->delay = pcm->stream == SND_PCM_STREAM_PLAYBACK ?
+		snd_pcm_mmap_playback_delay(pcm) :
+		snd_pcm_mmap_capture_delay(pcm);
+	status->avail_max = status->avail;
+	return 0;
+}
+
+static int snd_pcm_virt_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail,
+				   snd_htimestamp_t *tstamp)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+
+	virt_update(pcm);
+	*avail = snd_pcm_mmap_avail(pcm);
+	virt_tstamp(pcm, virt->shm->tstamp_ns, tstamp);
+	return 0;
+}
+
+static int snd_pcm_virt_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
+{
+	int err;
+
+	err = snd_pcm_virt_hwsync(pcm);
+	if (err < 0)
+		return err;
+	*delayp = pcm->stream == SND_PCM_STREAM_PLAYBACK ?
+		snd_pcm_mmap_playback_delay(pcm) :
+		snd_pcm_mmap_capture_delay(pcm);
+	return 0;
+}
+
+static int snd_pcm_virt_reset(snd_pcm_t *pcm)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+
+	virt_update(pcm);
+	virt->shm->appl_ptr = virt->shm->hw_ptr;
+	return 0;
+}
+
+static int snd_pcm_virt_prepare(snd_pcm_t *pcm)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+	snd_pcm_virt_share_t *sh = virt->shm;
+
+	/* keep the position in the buffer as the kernel does */
+	sh->hw_ptr %= pcm->buffer_size;
+	sh->appl_ptr = sh->hw_ptr;
+	sh->periods = 0;
+	__atomic_store_n(&sh->state, SND_PCM_STATE_PREPARED, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int snd_pcm_virt_start(snd_pcm_t *pcm)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+	snd_pcm_virt_share_t *sh = virt->shm;
+
+	if (sh->state != SND_PCM_STATE_PREPARED)
+		return -EBADFD;
+	/* an empty playback can run only without xrun detection */
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK &&
+	    sh->stop_threshold < pcm->boundary &&
+	    !snd_pcm_mmap_playback_hw_avail(pcm))
+		return -EPIPE;
+	sh->rate = pcm->rate;
+	sh->period_size = pcm->period_size;
+	sh->period_q = pcm->period_size * 1000000000ULL / pcm->rate;
+	sh->period_r = pcm->period_size * 1000000000ULL % pcm->rate;
+	if (sh->jitter_ns >= sh->period_q)
+		sh->jitter_ns = sh->period_q ? sh->period_q - 1 : 0;
+	sh->start_ptr = sh->hw_ptr;
+	sh->periods = 0;
+	sh->start_ns = virt_now();
+	sh->tstamp_ns = sh->start_ns;
+	gettimestamp(&sh->trigger_tstamp, pcm->tstamp_type);
+	__atomic_store_n(&sh->state, SND_PCM_STATE_RUNNING, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int snd_pcm_virt_drop(snd_pcm_t *pcm)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+	snd_pcm_virt_share_t *sh = virt->shm;
+
+	if (sh->state == SND_PCM_STATE_OPEN)
+		return -EBADFD;
+	virt_update(pcm);
+	__atomic_store_n(&sh->state, SND_PCM_STATE_SETUP, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int snd_pcm_virt_drain(snd_pcm_t *pcm)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+	snd_pcm_virt_share_t *sh = virt->shm;
+	struct timespec ts;
+	unsigned long long when;
+	int err = 0;
+
+	__snd_pcm_lock(pcm);
+	if (pcm->stream == SND_PCM_STREAM_CAPTURE) {
+		err = snd_pcm_virt_drop(pcm);
+		goto unlock;
+	}
+	switch (snd_pcm_virt_state(pcm)) {
+	case SND_PCM_STATE_PREPARED:
+		if (!snd_pcm_mmap_playback_hw_avail(pcm)) {
+			sh->state = SND_PCM_STATE_SETUP;
+			goto unlock;
+		}
+		err = snd_pcm_virt_start(pcm);
+		if (err < 0)
+			goto unlock;
+		/* fallthrough */
+	case SND_PCM_STATE_RUNNING:
+		__atomic_store_n(&sh->state, SND_PCM_STATE_DRAINING,
+				 __ATOMIC_RELEASE);
+		break;
+	case SND_PCM_STATE_DRAINING:
+		break;
+	default:
+		err = snd_pcm_virt_drop(pcm);
+		goto unlock;
+	}
+	if (pcm->mode & SND_PCM_NONBLOCK) {
+		err = -EAGAIN;
+		goto unlock;
+	}
+	while (snd_pcm_virt_state(pcm) == SND_PCM_STATE_DRAINING) {
+		when = virt_wakeup(sh, sh->periods + 1);
+		ts.tv_sec = when / 1000000000ULL;
+		ts.tv_nsec = when % 1000000000ULL;
+		__snd_pcm_unlock(pcm);
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		__snd_pcm_lock(pcm);
+	}
+ unlock:
+	__snd_pcm_unlock(pcm);
+	return err;
+}
+
+static snd_pcm_sframes_t snd_pcm_virt_rewindable(snd_pcm_t *pcm)
+{
+	return snd_pcm_mmap_hw_rewindable(pcm);
+}
+
+static snd_pcm_sframes_t snd_pcm_virt_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
+{
+	snd_pcm_sframes_t rewindable = snd_pcm_virt_rewindable(pcm);
+
+	if (rewindable < 0)
+		return rewindable;
+	if (frames > (snd_pcm_uframes_t)rewindable)
+		frames = rewindable;
+	snd_pcm_mmap_appl_backward(pcm, frames);
+	return frames;
+}
+
+static snd_pcm_sframes_t snd_pcm_virt_forwardable(snd_pcm_t *pcm)
+{
+	return snd_pcm_mmap_avail(pcm);
+}
+
+static snd_pcm_sframes_t snd_pcm_virt_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
+{
+	snd_pcm_sframes_t forwardable = snd_pcm_virt_forwardable(pcm);
+
+	if (forwardable < 0)
+		return forwardable;
+	if (frames > (snd_pcm_uframes_t)forwardable)
+		frames = forwardable;
+	snd_pcm_mmap_appl_forward(pcm, frames);
+	return frames;
+}
+
+static int snd_pcm_virt_resume(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+
+static snd_pcm_sframes_t snd_pcm_virt_mmap_commit(snd_pcm_t *pcm,
+						  snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
+						  snd_pcm_uframes_t size)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+
+	if (virt->shm->state == SND_PCM_STATE_XRUN)
+		return -EPIPE;
+	snd_pcm_mmap_appl_forward(pcm, size);
+	return size;
+}
+
+static int snd_pcm_virt_poll_descriptors(snd_pcm_t *pcm, struct pollfd *pfds,
+					 unsigned int space)
+{
+	if (!space)
+		return 0;
+	virt_update(pcm);
+	virt_arm(pcm);
+	pfds->fd = pcm->poll_fd;
+	pfds->events = pcm->poll_events | POLLERR | POLLNVAL;
+	return 1;
+}
+
+static int snd_pcm_virt_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds,
+				     unsigned int nfds, unsigned short *revents)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+	unsigned short events = 0;
+	uint64_t expirations;
+
+	if (nfds != 1 || pfds->fd != pcm->poll_fd)
+		return -EINVAL;
+	if (pfds->revents & POLLIN) {
+		if (read(virt->poll_fd, &expirations, sizeof(expirations)) < 0 &&
+		    errno != EAGAIN)
+			return -errno;
+	}
+	switch (snd_pcm_virt_state(pcm)) {
+	case SND_PCM_STATE_RUNNING:
+	case SND_PCM_STATE_PREPARED:
+		if ((snd_pcm_uframes_t)snd_pcm_mmap_avail(pcm) >= pcm->avail_min)
+			events = pcm->stream == SND_PCM_STREAM_PLAYBACK ?
+				POLLOUT : POLLIN;
+		break;
+	case SND_PCM_STATE_DRAINING:
+		break;
+	default:
+		events = POLLERR;
+		break;
+	}
+	virt_arm(pcm);
+	*revents = events;
+	return 0;
+}
+
+static int snd_pcm_virt_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+	snd_pcm_access_mask_t access_mask = { SND_PCM_ACCBIT_SHM };
+	int err;
+
+	err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_ACCESS,
+					 &access_mask);
+	if (err < 0)
+		return err;
+	err = _snd_pcm_hw_param_set_min(params, SND_PCM_HW_PARAM_PERIOD_SIZE, 1,
+					0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_refine_soft(pcm, params);
+	params->info = SND_PCM_INFO_MMAP | SND_PCM_INFO_MMAP_VALID |
+		       SND_PCM_INFO_INTERLEAVED | SND_PCM_INFO_NONINTERLEAVED |
+		       SND_PCM_INFO_BLOCK_TRANSFER | SND_PCM_INFO_BATCH;
+	params->fifo_size = 0;
+	return err;
+}
+
+static int snd_pcm_virt_hw_free(snd_pcm_t *pcm)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+
+	if (virt->buf) {
+		shmdt(virt->buf);
+		virt->buf = NULL;
+	}
+	virt->shm->buf_shmid = -1;
+	virt->shm->state = SND_PCM_STATE_OPEN;
+	return 0;
+}
+
+static int snd_pcm_virt_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+	snd_pcm_format_t format;
+	snd_pcm_uframes_t buffer_size;
+	unsigned int channels;
+	size_t size;
+	int id, err;
+
+	INTERNAL(snd_pcm_hw_params_get_format)(params, &format);
+	INTERNAL(snd_pcm_hw_params_get_channels)(params, &channels);
+	INTERNAL(snd_pcm_hw_params_get_buffer_size)(params, &buffer_size);
+	snd_pcm_virt_hw_free(pcm);
+	size = page_align(snd_pcm_format_size(format, buffer_size * channels));
+	id = shmget(IPC_PRIVATE, size, IPC_CREAT | virt->ipc_perm);
+	if (id < 0) {
+		err = -errno;
+		SYSERR("shmget failed");
+		return err;
+	}
+	virt->buf = shmat(id, NULL, 0);
+	/* the segment goes away with its last attachment */
+	shmctl(id, IPC_RMID, NULL);
+	if (virt->buf == (void *)-1) {
+		err = -errno;
+		virt->buf = NULL;
+		SYSERR("shmat failed");
+		return err;
+	}
+	snd_pcm_format_set_silence(format, virt->buf, buffer_size * channels);
+	virt->shm->buf_shmid = id;
+	virt->shm->hw_ptr = 0;
+	virt->shm->appl_ptr = 0;
+	virt->shm->state = SND_PCM_STATE_SETUP;
+	return 0;
+}
+
+/*
+ * The handles opened with SND_PCM_APPEND (e.g. by the secondary clients of
+ * dmix) get the setup of the card without its sw_params, so the card keeps
+ * the ones which drive it, as the kernel does for a substream.
+ */
+static int snd_pcm_virt_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+
+	virt->shm->stop_threshold = params->stop_threshold;
+	virt->shm->silence_size = params->silence_size;
+	return 0;
+}
+
+static int snd_pcm_virt_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t *info)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+
+	/* attached by snd_pcm_virt_mmap(), released by hw_free and close */
+	switch (pcm->access) {
+	case SND_PCM_ACCESS_MMAP_INTERLEAVED:
+	case SND_PCM_ACCESS_RW_INTERLEAVED:
+		info->addr = virt->buf;
+		info->first = info->channel * pcm->sample_bits;
+		info->step = pcm->frame_bits;
+		break;
+	case SND_PCM_ACCESS_MMAP_NONINTERLEAVED:
+	case SND_PCM_ACCESS_RW_NONINTERLEAVED:
+		info->addr = (char *)virt->buf + info->channel *
+			pcm->buffer_size * pcm->sample_bits / 8;
+		info->first = 0;
+		info->step = pcm->sample_bits;
+		break;
+	default:
+		return -EINVAL;
+	}
+	info->type = SND_PCM_AREA_SHM;
+	info->u.shm.shmid = virt->shm->buf_shmid;
+	info->u.shm.area = NULL;
+	return 0;
+}
+
+/* a secondary handle (SND_PCM_APPEND) attaches the buffer of the card */
+static int snd_pcm_virt_mmap(snd_pcm_t *pcm)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+	void *buf;
+
+	if (virt->buf)
+		return 0;
+	if (virt->shm->buf_shmid < 0)
+		return -EBADFD;
+	buf = shmat(virt->shm->buf_shmid, NULL, 0);
+	if (buf == (void *)-1) {
+		SYSERR("shmat failed");
+		return -errno;
+	}
+	virt->buf = buf;
+	return 0;
+}
+
+static int snd_pcm_virt_munmap(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static void snd_pcm_virt_dump(snd_pcm_t *pcm, snd_output_t *out)
+{
+	snd_pcm_virt_t *virt = pcm->private_data;
+
+	snd_output_printf(out, "Virtual card PCM\n");
+	snd_output_printf(out, "  ipc_key: %d, jitter: %uus, xrun period: %lu\n",
+			  (int)virt->ipc_key, virt->jitter, virt->xrun_period);
+	snd_output_printf(out, "  injected xruns: %lu\n", virt->shm->xruns);
+	if (pcm->setup) {
+		snd_output_printf(out, "Its setup is:\n");
+		snd_pcm_dump_setup(pcm, out);
+	}
+}
+
+static const snd_pcm_ops_t snd_pcm_virt_ops = {
+	.close = snd_pcm_virt_close,
+	.info = snd_pcm_virt_info,
+	.hw_refine = snd_pcm_virt_hw_refine,
+	.hw_params = snd_pcm_virt_hw_params,
+	.hw_free = snd_pcm_virt_hw_free,
+	.sw_params = snd_pcm_virt_sw_params,
+	.channel_info = snd_pcm_virt_channel_info,
+	.dump = snd_pcm_virt_dump,
+	.nonblock = snd_pcm_virt_nonblock,
+	.async = snd_pcm_virt_async,
+	.mmap = snd_pcm_virt_mmap,
+	.munmap = snd_pcm_virt_munmap,
+};
+
+static const snd_pcm_fast_ops_t snd_pcm_virt_fast_ops = {
+	.status = snd_pcm_virt_status,
+	.state = snd_pcm_virt_state,
+	.hwsync = snd_pcm_virt_hwsync,
+	.delay = snd_pcm_virt_delay,
+	.prepare = snd_pcm_virt_prepare,
+	.reset = snd_pcm_virt_reset,
+	.start = snd_pcm_virt_start,
+	.drop = snd_pcm_virt_drop,
+	.drain = snd_pcm_virt_drain,
+	.rewindable = snd_pcm_virt_rewindable,
+	.rewind = snd_pcm_virt_rewind,
+	.forwardable = snd_pcm_virt_forwardable,
+	.forward = snd_pcm_virt_forward,
+	.resume = snd_pcm_virt_resume,
+	.writei = snd_pcm_mmap_writei,
+	.writen = snd_pcm_mmap_writen,
+	.readi = snd_pcm_mmap_readi,
+	.readn = snd_pcm_mmap_readn,
+	.avail_update = snd_pcm_virt_avail_update,
+	.mmap_commit = snd_pcm_virt_mmap_commit,
+	.htimestamp = snd_pcm_virt_htimestamp,
+	.poll_descriptors = snd_pcm_virt_poll_descriptors,
+	.poll_revents = snd_pcm_virt_poll_revents,
+};
+
+/*
+ * Period timer of the card, used by the direct plugins in place of the
+ * PCM class timer of a hardware card.
+ */
+
+static unsigned long long virt_period_ns(snd_pcm_t *pcm)
+{
+	return pcm->period_size * 1000000000ULL / pcm->rate;
+}
+
+static void virt_timer_arm(snd_timer_virt_t *vt, unsigned long long when)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = when / 1000000000ULL;
+	its.it_value.tv_nsec = when % 1000000000ULL;
+	timerfd_settime(vt->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/* arm for the period boundary in ticks periods */
+static void virt_timer_next(snd_timer_virt_t *vt)
+{
+	snd_pcm_virt_t *virt = vt->pcm->private_data;
+	snd_pcm_virt_share_t *sh = virt->shm;
+
+	virt_update(vt->pcm);
+	if (virt_running(sh))
+		virt_timer_arm(vt, virt_wakeup(sh, sh->periods + vt->ticks));
+	else
+		virt_timer_arm(vt, virt_now() + vt->ticks * virt_period_ns(vt->pcm));
+}
+
+static int snd_timer_virt_close(snd_timer_t *timer)
+{
+	snd_timer_virt_t *vt = timer->private_data;
+
+	close(vt->fd);
+	free(vt);
+	return 0;
+}
+
+static int snd_timer_virt_nonblock(snd_timer_t *timer ATTRIBUTE_UNUSED,
+				   int nonblock ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int snd_timer_virt_async(snd_timer_t *timer ATTRIBUTE_UNUSED,
+				int sig ATTRIBUTE_UNUSED, pid_t pid ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+
+static int snd_timer_virt_info(snd_timer_t *timer, snd_timer_info_t *info)
+{
+	snd_timer_virt_t *vt = timer->private_data;
+
+	memset(info, 0, sizeof(*info));
+	info->card = -1;
+	snd_strlcpy((char *)info->id, "virt", sizeof(info->id));
+	snd_strlcpy((char *)info->name, timer->name, sizeof(info->name));
+	info->resolution = virt_period_ns(vt->pcm);
+	return 0;
+}
+
+static int snd_timer_virt_params(snd_timer_t *timer, snd_timer_params_t *params)
+{
+	snd_timer_virt_t *vt = timer->private_data;
+
+	/* new parameters stop the timer and flush its events */
+	vt->running = 0;
+	virt_timer_arm(vt, 0);
+	vt->ticks = params->ticks ? params->ticks : 1;
+	vt->early_event = !!(params->flags & SNDRV_TIMER_PSFLG_EARLY_EVENT);
+	return 0;
+}
+
+static int snd_timer_virt_status(snd_timer_t *timer, snd_timer_status_t *status)
+{
+	snd_timer_virt_t *vt = timer->private_data;
+
+	memset(status, 0, sizeof(*status));
+	clock_gettime(CLOCK_MONOTONIC, &status->tstamp);
+	status->resolution = virt_period_ns(vt->pcm);
+	return 0;
+}
+
+static int snd_timer_virt_start(snd_timer_t *timer)
+{
+	snd_timer_virt_t *vt = timer->private_data;
+
+	vt->running = 1;
+	if (vt->early_event)
+		virt_timer_arm(vt, 1);
+	else
+		virt_timer_next(vt);
+	return 0;
+}
+
+static int snd_timer_virt_stop(snd_timer_t *timer)
+{
+	snd_timer_virt_t *vt = timer->private_data;
+
+	vt->running = 0;
+	virt_timer_arm(vt, 0);
+	return 0;
+}
+
+static ssize_t snd_timer_virt_read(snd_timer_t *timer, void *buffer, size_t size)
+{
+	snd_timer_virt_t *vt = timer->private_data;
+	uint64_t expirations;
+	snd_timer_tread_t *tr = buffer;
+	snd_timer_read_t *r = buffer;
+
+	if (read(vt->fd, &expirations, sizeof(expirations)) < 0)
+		return -errno;
+	if (vt->running)
+		virt_timer_next(vt);
+	if (vt->tread) {
+		if (size < sizeof(*tr))
+			return -EINVAL;
+		tr->event = SND_TIMER_EVENT_TICK;
+		tr->val = expirations;
+		clock_gettime(CLOCK_MONOTONIC, &tr->tstamp);
+		return sizeof(*tr);
+	}
+	if (size < sizeof(*r))
+		return -EINVAL;
+	r->resolution = virt_period_ns(vt->pcm);
+	r->ticks = expirations;
+	return sizeof(*r);
+}
+
+static const snd_timer_ops_t snd_timer_virt_ops = {
+	.close = snd_timer_virt_close,
+	.nonblock = snd_timer_virt_nonblock,
+	.async = snd_timer_virt_async,
+	.info = snd_timer_virt_info,
+	.params = snd_timer_virt_params,
+	.status = snd_timer_virt_status,
+	.rt_start = snd_timer_virt_start,
+	.rt_stop = snd_timer_virt_stop,
+	.rt_continue = snd_timer_virt_start,
+	.read = snd_timer_virt_read,
+};
+
+#ifndef DOC_HIDDEN
+/* open the period timer of a virt PCM, as a PCM class timer of a card */
+int snd_pcm_virt_timer_open(snd_timer_t **timerp, snd_pcm_t *pcm, int mode)
+{
+	snd_timer_t *tmr;
+	snd_timer_virt_t *vt;
+	int err;
+
+	assert(timerp && pcm->type == SND_PCM_TYPE_VIRT);
+	vt = calloc(1, sizeof(*vt));
+	tmr = calloc(1, sizeof(*tmr));
+	if (!vt || !tmr) {
+		free(vt);
+		free(tmr);
+		return -ENOMEM;
+	}
+	vt->pcm = pcm;
+	vt->ticks = 1;
+	vt->tread = !!(mode & SND_TIMER_OPEN_TREAD);
+	vt->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (vt->fd < 0) {
+		err = -errno;
+		SYSERR("timerfd_create failed");
+		free(vt);
+		free(tmr);
+		return err;
+	}
+	tmr->type = SND_TIMER_TYPE_HW;
+	tmr->mode = O_RDONLY;
+	if (mode & SND_TIMER_OPEN_NONBLOCK)
+		tmr->mode |= O_NONBLOCK;
+	tmr->name = strdup(pcm->name ? pcm->name : "virt");
+	tmr->poll_fd = vt->fd;
+	tmr->ops = &snd_timer_virt_ops;
+	tmr->private_data = vt;
+	INIT_LIST_HEAD(&tmr->async_handlers);
+	*timerp = tmr;
+	return 0;
+}
+#endif
+
+/* attach the state of the card, creating it unless appending */
+static int virt_attach(snd_pcm_virt_t *virt, int append)
+{
+	struct shmid_ds buf;
+	key_t key = virt->ipc_key ? virt->ipc_key : IPC_PRIVATE;
+	int first = 0, err;
+
+	if (key == IPC_PRIVATE) {
+		if (append)
+			return -EBADFD;
+		virt->shmid = shmget(key, sizeof(*virt->shm),
+				     IPC_CREAT | virt->ipc_perm);
+		first = 1;
+	} else {
+	retryget:
+		virt->shmid = shmget(key, sizeof(*virt->shm), virt->ipc_perm);
+		if (virt->shmid < 0 && errno == ENOENT) {
+			if (append)
+				return -EBADFD;
+			virt->shmid = shmget(key, sizeof(*virt->shm),
+					     IPC_CREAT | IPC_EXCL | virt->ipc_perm);
+			if (virt->shmid < 0 && errno == EEXIST)
+				goto retryget;
+			first = 1;
+		}
+		/* a segment of another size without users is destroyed */
+		if (virt->shmid < 0 && errno == EINVAL) {
+			int tmpid = shmget(key, 0, virt->ipc_perm);
+			if (tmpid >= 0 && !shmctl(tmpid, IPC_STAT, &buf) &&
+			    !buf.shm_nattch && !shmctl(tmpid, IPC_RMID, NULL))
+				goto retryget;
+			errno = EINVAL;
+		}
+	}
+	if (virt->shmid < 0) {
+		err = -errno;
+		SYSERR("shmget failed");
+		return err;
+	}
+	virt->shm = shmat(virt->shmid, NULL, 0);
+	if (virt->shm == (void *)-1) {
+		err = -errno;
+		virt->shm = NULL;
+		SYSERR("shmat failed");
+		return err;
+	}
+	if (shmctl(virt->shmid, IPC_STAT, &buf) < 0) {
+		err = -errno;
+		goto _err;
+	}
+	if (key == IPC_PRIVATE)
+		shmctl(virt->shmid, IPC_RMID, NULL);
+	if (!first) {
+		if (virt->shm->magic != SND_PCM_VIRT_MAGIC) {
+			err = -EINVAL;
+			goto _err;
+		}
+		if (append) {
+			if (buf.shm_nattch <= 1 || virt->shm->buf_shmid < 0) {
+				err = -EBADFD;
+				goto _err;
+			}
+			return 0;
+		}
+		if (buf.shm_nattch > 1) {
+			err = -EBUSY;
+			goto _err;
+		}
+		/* left over by a dead process, take it over */
+	}
+	memset(virt->shm, 0, sizeof(*virt->shm));
+	virt->shm->magic = SND_PCM_VIRT_MAGIC;
+	virt->shm->buf_shmid = -1;
+	virt->shm->state = SND_PCM_STATE_OPEN;
+	virt->shm->jitter_ns = virt->jitter * 1000ULL;
+	virt->shm->xrun_period = virt->xrun_period;
+	virt->shm->seed = virt->seed;
+	return 0;
+
+ _err:
+	shmdt(virt->shm);
+	virt->shm = NULL;
+	return err;
+}
+
+/**
+ * \brief Creates a new virtual card PCM
+ * \param pcmp Returns created PCM handle
+ * \param name Name of PCM
+ * \param ipc_key IPC key of the card shared by the handles, 0 for a private card
+ * \param ipc_perm Permissions of the shared memory
+ * \param jitter Maximum delay of the period wakeups in microseconds
+ * \param xrun_period Number of periods after which an xrun is forced, 0 for none
+ * \param seed Seed of the wakeup jitter
+ * \param stream Stream type
+ * \param mode Stream mode
+ * \retval zero on success otherwise a negative error code
+ * \warning Using of this function might be dangerous in the sense
+ *          of compatibility reasons. The prototype might be freely
+ *          changed in future.
+ */
+int snd_pcm_virt_open(snd_pcm_t **pcmp, const char *name,
+		      key_t ipc_key, mode_t ipc_perm,
+		      unsigned int jitter, unsigned long xrun_period,
+		      unsigned int seed, snd_pcm_stream_t stream, int mode)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_virt_t *virt;
+	int err;
+
+	assert(pcmp);
+	virt = calloc(1, sizeof(snd_pcm_virt_t));
+	if (!virt)
+		return -ENOMEM;
+	virt->ipc_key = ipc_key;
+	virt->ipc_perm = ipc_perm;
+	virt->jitter = jitter;
+	virt->xrun_period = xrun_period;
+	virt->seed = seed;
+	virt->poll_fd = timerfd_create(CLOCK_MONOTONIC,
+				       TFD_NONBLOCK | TFD_CLOEXEC);
+	if (virt->poll_fd < 0) {
+		err = -errno;
+		SYSERR("timerfd_create failed");
+		free(virt);
+		return err;
+	}
+	err = virt_attach(virt, mode & SND_PCM_APPEND);
+	if (err < 0) {
+		close(virt->poll_fd);
+		free(virt);
+		return err;
+	}
+
+	err = snd_pcm_new(&pcm, SND_PCM_TYPE_VIRT, name, stream, mode);
+	if (err < 0) {
+		virt_free(virt);
+		return err;
+	}
+	pcm->ops = &snd_pcm_virt_ops;
+	pcm->fast_ops = &snd_pcm_virt_fast_ops;
+	pcm->private_data = virt;
+	pcm->mmap_rw = 1;
+	pcm->poll_fd = virt->poll_fd;
+	pcm->poll_events = POLLIN;	/* the timerfd is readable */
+	snd_pcm_set_hw_ptr(pcm, &virt->shm->hw_ptr, -1, 0);
+	snd_pcm_set_appl_ptr(pcm, &virt->shm->appl_ptr, -1, 0);
+	*pcmp = pcm;
+
+	return 0;
+}
+
+/*! \page pcm_plugins
+
+\section pcm_plugins_virt Plugin: Virtual card
+
+This plugin emulates a sound card in memory.  The ring buffer is a shared
+memory area which can be mmapped, and the hardware pointer moves by
+whole periods at the real-time rate, driven by the monotonic clock.  The
+poll descriptor wakes up when avail_min frames are available.  Playback
+data is discarded and capture data is silence.
+
+The plugin can be used as the slave of the \ref pcm_plugins_dmix "dmix",
+\ref pcm_plugins_dsnoop "dsnoop" and \ref pcm_plugins_dshare "dshare"
+plugins.  Their clients in other processes share the card through the
+ipc_key; without it, the card is private to its handle.
+
+The period wakeups can be delayed by a pseudo-random jitter and an xrun
+can be forced periodically, both reproducible from the seed, to test the
+timing and the error handling of applications and plugins.
+
+\code
+pcm.name {
+	type virt		# Virtual card PCM
+	[ipc_key INT]		# Unique IPC key to share the card
+	[ipc_perm INT]		# Permissions of the shared memory (octal, default 0600)
+	[jitter INT]		# Maximum delay of the period wakeups in us
+	[xrun_period INT]	# Force an xrun every INT periods
+	[seed INT]		# Seed of the jitter
+}
+\endcode
+
+\subsection pcm_plugins_virt_funcref Function reference
+
+<UL>
+  <LI>snd_pcm_virt_open()
+  <LI>_snd_pcm_virt_open()
+</UL>
+
+*/
+
+/**
+ * \brief Creates a new virtual card PCM
+ * \param pcmp Returns created PCM handle
+ * \param name Name of PCM
+ * \param root Root configuration node
+ * \param conf Configuration node with virtual card PCM description
+ * \param stream Stream type
+ * \param mode Stream mode
+ * \retval zero on success otherwise a negative error code
+ * \warning Using of this function might be dangerous in the sense
+ *          of compatibility reasons. The prototype might be freely
+ *          changed in future.
+ */
+int _snd_pcm_virt_open(snd_pcm_t **pcmp, const char *name,
+		       snd_config_t *root ATTRIBUTE_UNUSED, snd_config_t *conf,
+		       snd_pcm_stream_t stream, int mode)
+{
+	snd_config_iterator_t i, next;
+	long ipc_key = 0, jitter = 0, xrun_period = 0, seed = 0;
+	mode_t ipc_perm = 0600;
+	int err;
+
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (snd_pcm_conf_generic_id(id))
+			continue;
+		if (strcmp(id, "ipc_key") == 0) {
+			err = snd_config_get_integer(n, &ipc_key);
+			if (err < 0) {
+				SNDERR("The field ipc_key must be an integer type");
+				return err;
+			}
+			continue;
+		}
+		if (strcmp(id, "ipc_perm") == 0) {
+			long perm;
+			err = snd_config_get_integer(n, &perm);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return err;
+			}
+			if ((perm & ~0777) != 0) {
+				SNDERR("The field ipc_perm must be a valid file permission");
+				return -EINVAL;
+			}
+			ipc_perm = perm;
+			continue;
+		}
+		if (strcmp(id, "jitter") == 0) {
+			err = snd_config_get_integer(n, &jitter);
+			if (err < 0 || jitter < 0) {
+				SNDERR("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "xrun_period") == 0) {
+			err = snd_config_get_integer(n, &xrun_period);
+			if (err < 0 || xrun_period < 0) {
+				SNDERR("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "seed") == 0) {
+			err = snd_config_get_integer(n, &seed);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return err;
+			}
+			continue;
+		}
+		SNDERR("Unknown field %s", id);
+		return -EINVAL;
+	}
+	return snd_pcm_virt_open(pcmp, name, ipc_key, ipc_perm, jitter,
+				 xrun_period, seed, stream, mode);
+}
+#ifndef DOC_HIDDEN
+SND_DLSYM_BUILD_VERSION(_snd_pcm_virt_open, SND_PCM_DLSYM_VERSION);
+#endif
@@ -1140,6 +1140,42 @@ int snd_seq_poll_descriptors_revents(snd_seq_t *seq, struct pollfd *pfds, unsign
         return -EINVAL;
 }
 
+static int seq_wait_revents(void *handle, struct pollfd *pfds,
+			    unsigned int nfds, unsigned short *revents)
+{
+	return snd_seq_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+/**
+ * \brief Add a sequencer handle to a wait set
+ * \param ws Wait set
+ * \param seq sequencer handle
+ * \param events the poll events to be checked (POLLIN and/or POLLOUT)
+ * \param private_data Value returned with the events of the handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The handle is reported by #snd_wait_set_wait() when
+ * #snd_seq_poll_descriptors_revents() returns events for it.
+ */
+int snd_wait_set_add_seq(snd_wait_set_t *ws, snd_seq_t *seq, short events, void *private_data)
+{
+	struct pollfd *pfds;
+	int count, err;
+
+	assert(ws && seq);
+	count = snd_seq_poll_descriptors_count(seq, events);
+	if (count <= 0)
+		return count < 0 ? count : -EINVAL;
+	pfds = alloca(count * sizeof(*pfds));
+	err = snd_seq_poll_descriptors(seq, pfds, count, events);
+	if (err < 0)
+		return err;
+	if (err == 0)
+		return -EINVAL;
+	return _snd_wait_set_add(ws, seq, pfds, err, seq_wait_revents,
+				 private_data);
+}
+
 /**
  * \brief Set nonblock mode
  * \param seq sequencer handle
@@ -396,6 +396,41 @@ int snd_timer_poll_descriptors_revents(snd_timer_t *timer, struct pollfd *pfds,
         return -EINVAL;
 }
 
+static int timer_wait_revents(void *handle, struct pollfd *pfds,
+			      unsigned int nfds, unsigned short *revents)
+{
+	return snd_timer_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+/**
+ * \brief Add a timer handle to a wait set
+ * \param ws Wait set
+ * \param timer timer handle
+ * \param private_data Value returned with the events of the handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The handle is reported by #snd_wait_set_wait() when
+ * #snd_timer_poll_descriptors_revents() returns events for it.
+ */
+int snd_wait_set_add_timer(snd_wait_set_t *ws, snd_timer_t *timer, void *private_data)
+{
+	struct pollfd *pfds;
+	int count, err;
+
+	assert(ws && timer);
+	count = snd_timer_poll_descriptors_count(timer);
+	if (count <= 0)
+		return count < 0 ? count : -EINVAL;
+	pfds = alloca(count * sizeof(*pfds));
+	err = snd_timer_poll_descriptors(timer, pfds, count);
+	if (err < 0)
+		return err;
+	if (err == 0)
+		return -EINVAL;
+	return _snd_wait_set_add(ws, timer, pfds, err, timer_wait_revents,
+				 private_data);
+}
+
 /**
  * \brief set nonblock mode
  * \param timer timer handle
@@ -0,0 +1,469 @@
+/**
+ * \file wait.c
+ * \brief Wait sets of PCM, control, sequencer and timer handles
+ *
+ * A wait set registers the poll descriptors of many handles once into an
+ * epoll instance.  #snd_wait_set_wait() then asks only the handles with
+ * ready descriptors to translate their events, so the cost of a wakeup
+ * doesn't grow with the number of idle handles.
+ */
+/*
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "local.h"
+#include <sys/epoll.h>
+#include <time.h>
+
+#ifndef DOC_HIDDEN
+/* milliseconds between two checks of the always ready handles */
+#define WAIT_ALWAYS_MS	10
+
+struct wait_source;
+struct wait_fd;
+
+/*
+ * fd registered into epoll, the epoll data; plugin chains share the fd
+ * of their slave, so an fd may be used by many descriptors
+ */
+struct wait_entry {
+	struct list_head list;
+	int fd;
+	unsigned int events;	/* union of the events of the users */
+	int always;		/* not pollable by epoll (e.g. /dev/null) */
+	struct wait_fd *users;
+};
+
+/* registered descriptor */
+struct wait_fd {
+	struct wait_source *src;
+	struct wait_entry *entry;
+	struct wait_fd *next;	/* next user of the same fd */
+	unsigned int idx;
+	int always;
+};
+
+struct wait_source {
+	struct list_head list;
+	void *handle;
+	void *private_data;
+	snd_wait_revents_t revents;
+	unsigned int gen;		/* wakeup which found it ready */
+	unsigned int nfds;
+	unsigned int nalways;		/* descriptors which are always ready */
+	struct wait_fd *fds;
+	struct pollfd pfds[];
+};
+
+struct _snd_wait_set {
+	int epfd;
+	struct list_head sources;
+	struct list_head entries;
+	unsigned int nsources;
+	unsigned int nfds;
+	unsigned int nalways;		/* sources with always ready descriptors */
+	unsigned int gen;
+	struct epoll_event *events;	/* nfds entries */
+	struct wait_source **ready;	/* nsources entries */
+};
+#endif
+
+/**
+ * \brief Create an empty wait set
+ * \param wsp Returned wait set
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_wait_set_open(snd_wait_set_t **wsp)
+{
+	snd_wait_set_t *ws;
+
+	assert(wsp);
+	ws = calloc(1, sizeof(*ws));
+	if (!ws)
+		return -ENOMEM;
+	ws->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (ws->epfd < 0) {
+		int err = -errno;
+		SYSERR("epoll_create1 failed");
+		free(ws);
+		return err;
+	}
+	INIT_LIST_HEAD(&ws->sources);
+	INIT_LIST_HEAD(&ws->entries);
+	*wsp = ws;
+	return 0;
+}
+
+static int entry_update(snd_wait_set_t *ws, struct wait_entry *entry,
+			unsigned int events)
+{
+	struct epoll_event ev;
+
+	if (entry->always || entry->events == events)
+		return 0;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.ptr = entry;
+	if (epoll_ctl(ws->epfd, EPOLL_CTL_MOD, entry->fd, &ev) < 0) {
+		int err = -errno;
+		SYSERR("epoll_ctl failed");
+		return err;
+	}
+	entry->events = events;
+	return 0;
+}
+
+/* register a descriptor, sharing the epoll entry of its fd */
+static int wait_fd_add(snd_wait_set_t *ws, struct wait_fd *wfd,
+		       const struct pollfd *pfd)
+{
+	struct wait_entry *entry;
+	struct epoll_event ev;
+	struct list_head *pos;
+	int err;
+
+	list_for_each(pos, &ws->entries) {
+		entry = list_entry(pos, struct wait_entry, list);
+		if (entry->fd != pfd->fd)
+			continue;
+		err = entry_update(ws, entry, entry->events | pfd->events);
+		if (err < 0)
+			return err;
+		goto _link;
+	}
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return -ENOMEM;
+	entry->fd = pfd->fd;
+	entry->events = pfd->events;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = pfd->events;
+	ev.data.ptr = entry;
+	if (epoll_ctl(ws->epfd, EPOLL_CTL_ADD, pfd->fd, &ev) < 0) {
+		/* files without poll support are always ready for poll() */
+		if (errno != EPERM) {
+			err = -errno;
+			SYSERR("epoll_ctl failed");
+			free(entry);
+			return err;
+		}
+		entry->always = 1;
+	}
+	list_add_tail(&entry->list, &ws->entries);
+ _link:
+	wfd->entry = entry;
+	wfd->always = entry->always;
+	wfd->next = entry->users;
+	entry->users = wfd;
+	return 0;
+}
+
+/* unregister a descriptor, the fd stays while other descriptors use it */
+static void wait_fd_remove(snd_wait_set_t *ws, struct wait_fd *wfd)
+{
+	struct wait_entry *entry = wfd->entry;
+	struct wait_fd **p;
+	unsigned int events = 0;
+
+	for (p = &entry->users; *p != wfd; p = &(*p)->next)
+		;
+	*p = wfd->next;
+	if (!entry->users) {
+		if (!entry->always)
+			epoll_ctl(ws->epfd, EPOLL_CTL_DEL, entry->fd, NULL);
+		list_del(&entry->list);
+		free(entry);
+		return;
+	}
+	for (wfd = entry->users; wfd; wfd = wfd->next)
+		events |= wfd->src->pfds[wfd->idx].events;
+	entry_update(ws, entry, events);
+}
+
+static void source_free(snd_wait_set_t *ws, struct wait_source *src,
+			unsigned int nfds)
+{
+	unsigned int i;
+
+	for (i = 0; i < nfds; i++)
+		wait_fd_remove(ws, &src->fds[i]);
+	free(src->fds);
+	free(src);
+}
+
+/**
+ * \brief Close a wait set
+ * \param ws Wait set
+ * \return 0 on success otherwise a negative error code
+ *
+ * The registered handles are not closed.
+ */
+int snd_wait_set_close(snd_wait_set_t *ws)
+{
+	struct wait_source *src;
+
+	assert(ws);
+	while (!list_empty(&ws->sources)) {
+		src = list_entry(ws->sources.next, struct wait_source, list);
+		list_del(&src->list);
+		free(src->fds);
+		free(src);
+	}
+	while (!list_empty(&ws->entries)) {
+		struct wait_entry *entry;
+
+		entry = list_entry(ws->entries.next, struct wait_entry, list);
+		list_del(&entry->list);
+		free(entry);
+	}
+	close(ws->epfd);
+	free(ws->events);
+	free(ws->ready);
+	free(ws);
+	return 0;
+}
+
+#ifndef DOC_HIDDEN
+/*
+ * Register the poll descriptors of a handle; called by
+ * snd_wait_set_add_pcm() & co. with the descriptors of the handle and
+ * its revents translation.
+ */
+int _snd_wait_set_add(snd_wait_set_t *ws, void *handle,
+		      const struct pollfd *pfds, unsigned int nfds,
+		      snd_wait_revents_t revents, void *private_data)
+{
+	struct wait_source *src, **ready;
+	struct epoll_event *events;
+	unsigned int i;
+	int err;
+
+	if (!nfds)
+		return -EINVAL;
+	src = calloc(1, sizeof(*src) + nfds * sizeof(*pfds));
+	if (!src)
+		return -ENOMEM;
+	src->fds = calloc(nfds, sizeof(*src->fds));
+	if (!src->fds) {
+		free(src);
+		return -ENOMEM;
+	}
+	events = realloc(ws->events, (ws->nfds + nfds) * sizeof(*events));
+	if (!events)
+		goto _nomem;
+	ws->events = events;
+	ready = realloc(ws->ready, (ws->nsources + 1) * sizeof(*ready));
+	if (!ready)
+		goto _nomem;
+	ws->ready = ready;
+
+	src->handle = handle;
+	src->private_data = private_data;
+	src->revents = revents;
+	src->nfds = nfds;
+	memcpy(src->pfds, pfds, nfds * sizeof(*pfds));
+	for (i = 0; i < nfds; i++) {
+		src->fds[i].src = src;
+		src->fds[i].idx = i;
+		src->pfds[i].revents = 0;
+		err = wait_fd_add(ws, &src->fds[i], &src->pfds[i]);
+		if (err < 0) {
+			source_free(ws, src, i);
+			return err;
+		}
+		if (src->fds[i].always)
+			src->nalways++;
+	}
+	/* keep the sources with always ready descriptors first */
+	if (src->nalways) {
+		list_add(&src->list, &ws->sources);
+		ws->nalways++;
+	} else {
+		list_add_tail(&src->list, &ws->sources);
+	}
+	ws->nsources++;
+	ws->nfds += nfds;
+	return 0;
+
+ _nomem:
+	free(src->fds);
+	free(src);
+	return -ENOMEM;
+}
+#endif
+
+/**
+ * \brief Remove a handle from a wait set
+ * \param ws Wait set
+ * \param handle Handle given to snd_wait_set_add_*()
+ * \return 0 on success otherwise a negative error code
+ *
+ * A handle has to be removed before it is closed.  After a change which
+ * replaces its poll descriptors (e.g. a new PCM setup), remove the
+ * handle and add it again.
+ */
+int snd_wait_set_remove(snd_wait_set_t *ws, void *handle)
+{
+	struct list_head *pos;
+	struct wait_source *src;
+
+	assert(ws);
+	list_for_each(pos, &ws->sources) {
+		src = list_entry(pos, struct wait_source, list);
+		if (src->handle != handle)
+			continue;
+		list_del(&src->list);
+		ws->nsources--;
+		ws->nfds -= src->nfds;
+		if (src->nalways)
+			ws->nalways--;
+		source_free(ws, src, src->nfds);
+		return 0;
+	}
+	return -ENOENT;
+}
+
+static long long wait_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/**
+ * \brief Wait for the handles of a wait set to be ready
+ * \param ws Wait set
+ * \param events Array receiving the ready handles
+ * \param space Number of entries of \p events
+ * \param timeout Maximum time in milliseconds to wait,
+ *        a negative value means infinity
+ * \return the number of ready handles, 0 on timeout,
+ *         otherwise a negative error code
+ *
+ * The events of the ready descriptors are translated by the handles, as
+ * #snd_pcm_poll_descriptors_revents() & co. do, and the handles whose
+ * translated events are empty (e.g. a PCM below its avail_min) are not
+ * reported; the function keeps waiting for the rest of the timeout.
+ * When a handle fails to translate its events, it is reported with
+ * POLLERR.
+ *
+ * When more than \p space handles are ready, the others are reported by
+ * the next call.
+ *
+ * Handles with descriptors which epoll cannot watch (always ready for
+ * poll()) are checked at once and then again on each wakeup of the
+ * other descriptors, or after at most 10 milliseconds, so they do not
+ * keep the function spinning while their translated events are empty.
+ *
+ * Handles may share descriptors (e.g. PCM plugins on the same slave);
+ * each of them gets the events it asked for.
+ */
+int snd_wait_set_wait(snd_wait_set_t *ws, snd_wait_event_t *events,
+		      unsigned int space, int timeout)
+{
+	long long end = 0;
+	int idle = 0;			/* always ready handles were empty */
+	unsigned int i, j, nready, count;
+	unsigned short revents;
+	struct list_head *pos;
+	struct wait_source *src;
+	struct wait_entry *entry;
+	struct wait_fd *fd;
+	int n, wait_ms;
+
+	assert(ws && events);
+	if (!space || !ws->nfds)
+		return -EINVAL;
+	if (timeout > 0)
+		end = wait_now_ms() + timeout;
+	for (;;) {
+		wait_ms = timeout;
+		if (ws->nalways) {
+			if (!idle)
+				wait_ms = 0;
+			else if (timeout < 0 || timeout > WAIT_ALWAYS_MS)
+				wait_ms = WAIT_ALWAYS_MS;
+		}
+		n = epoll_wait(ws->epfd, ws->events, ws->nfds, wait_ms);
+		if (n < 0) {
+			if (errno == EINTR)
+				goto _again;
+			return -errno;
+		}
+		if (n == 0 && !ws->nalways)
+			return 0;
+		ws->gen++;
+		nready = 0;
+		list_for_each(pos, &ws->sources) {
+			src = list_entry(pos, struct wait_source, list);
+			if (!src->nalways)
+				break;
+			for (j = 0; j < src->nfds; j++) {
+				if (src->fds[j].always)
+					src->pfds[j].revents = src->pfds[j].events &
+						(POLLIN | POLLOUT | POLLRDNORM | POLLWRNORM);
+			}
+			src->gen = ws->gen;
+			ws->ready[nready++] = src;
+		}
+		for (i = 0; i < (unsigned int)n; i++) {
+			entry = ws->events[i].data.ptr;
+			for (fd = entry->users; fd; fd = fd->next) {
+				struct pollfd *pfd = &fd->src->pfds[fd->idx];
+
+				pfd->revents = ws->events[i].events &
+					(pfd->events | POLLERR | POLLHUP);
+				if (!pfd->revents)
+					continue;
+				src = fd->src;
+				if (src->gen != ws->gen) {
+					src->gen = ws->gen;
+					ws->ready[nready++] = src;
+				}
+			}
+		}
+		count = 0;
+		for (i = 0; i < nready; i++) {
+			src = ws->ready[i];
+			if (count < space) {
+				if (src->revents(src->handle, src->pfds,
+						 src->nfds, &revents) < 0)
+					revents = POLLERR;
+				if (revents) {
+					events[count].handle = src->handle;
+					events[count].private_data = src->private_data;
+					events[count].revents = revents;
+					count++;
+				}
+			}
+			/* level-triggered: the rest come back next time */
+			for (j = 0; j < src->nfds; j++)
+				src->pfds[j].revents = 0;
+		}
+		if (count)
+			return count;
+		idle = 1;
+	_again:
+		if (timeout > 0) {
+			timeout = end - wait_now_ms();
+			if (timeout <= 0)
+				return 0;
+		} else if (timeout == 0) {
+			return 0;
+		}
+	}
+}
@@ -0,0 +1,125 @@
+/*
+ * helpers shared by the benchmark programs
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "bench.h"
+
+/* monotonic time in nanoseconds */
+unsigned long long bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* open the playback PCM given by the body of a PCM definition */
+int bench_open(snd_pcm_t **pcmp, const char *definition)
+{
+	snd_config_t *conf;
+	snd_input_t *in;
+	char *buf;
+	size_t len = strlen(definition) + 32;
+	int err;
+
+	buf = malloc(len);
+	if (!buf)
+		return -ENOMEM;
+	snprintf(buf, len, "pcm.bench { %s }", definition);
+	err = snd_config_top(&conf);
+	if (err < 0)
+		goto _free;
+	err = snd_input_buffer_open(&in, buf, strlen(buf));
+	if (err < 0)
+		goto _end;
+	err = snd_config_load(conf, in);
+	snd_input_close(in);
+	if (err < 0)
+		goto _end;
+	err = snd_pcm_open_lconf(pcmp, "bench", SND_PCM_STREAM_PLAYBACK, 0, conf);
+ _end:
+	snd_config_delete(conf);
+ _free:
+	free(buf);
+	return err;
+}
+
+/*
+ * set up the PCM with four periods; the rate and the period size are
+ * the nearest ones supported by the PCM on return
+ */
+int bench_setup(snd_pcm_t *pcm, snd_pcm_access_t access,
+		snd_pcm_format_t format, unsigned int channels,
+		unsigned int *rate, snd_pcm_uframes_t *period_size)
+{
+	snd_pcm_hw_params_t *hw;
+	int err;
+
+	snd_pcm_hw_params_alloca(&hw);
+	err = snd_pcm_hw_params_any(pcm, hw);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_access(pcm, hw, access);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_format(pcm, hw, format);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_channels(pcm, hw, channels);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_rate_near(pcm, hw, rate, 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_period_size_near(pcm, hw, period_size, 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_periods(pcm, hw, 4, 0);
+	if (err < 0)
+		return err;
+	return snd_pcm_hw_params(pcm, hw);
+}
+
+/*
+ * fill frames of a two-tone signal, continuing from frame pos; each
+ * channel gets another level.  Only S16, S24, S32 and FLOAT are known.
+ */
+int bench_fill(void *buf, snd_pcm_format_t format, unsigned int channels,
+	       unsigned int rate, snd_pcm_uframes_t pos,
+	       snd_pcm_uframes_t frames)
+{
+	unsigned int ch, k = 0;
+	snd_pcm_uframes_t i;
+	double v;
+
+	for (i = 0; i < frames; i++) {
+		v = 0.4 * sin(2 * M_PI * 997.0 * (pos + i) / rate) +
+		    0.3 * sin(2 * M_PI * 5011.0 * (pos + i) / rate);
+		for (ch = 0; ch < channels; ch++, k++) {
+			double s = v * (ch + 1) / channels;
+
+			switch (format) {
+			case SND_PCM_FORMAT_S16:
+				((int16_t *)buf)[k] = s * 0x7fff;
+				break;
+			case SND_PCM_FORMAT_S24:
+				((int32_t *)buf)[k] = s * 0x7fffff;
+				break;
+			case SND_PCM_FORMAT_S32:
+				((int32_t *)buf)[k] = s * 0x7fffffff;
+				break;
+			case SND_PCM_FORMAT_FLOAT:
+				((float *)buf)[k] = s;
+				break;
+			default:
+				return -EINVAL;
+			}
+		}
+	}
+	return 0;
+}
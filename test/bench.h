@@ -0,0 +1,19 @@
+/*
+ * helpers shared by the benchmark programs
+ */
+
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include "../include/asoundlib.h"
+
+unsigned long long bench_now_ns(void);
+int bench_open(snd_pcm_t **pcmp, const char *definition);
+int bench_setup(snd_pcm_t *pcm, snd_pcm_access_t access,
+		snd_pcm_format_t format, unsigned int channels,
+		unsigned int *rate, snd_pcm_uframes_t *period_size);
+int bench_fill(void *buf, snd_pcm_format_t format, unsigned int channels,
+	       unsigned int rate, snd_pcm_uframes_t pos,
+	       snd_pcm_uframes_t frames);
+
+#endif /* __BENCH_H */
@@ -0,0 +1,440 @@
+/*
+ * dmix mixing kernel benchmark
+ *
+ * Runs the generic and the vectorized dmix mix/remix kernels on the same
+ * synthetic data (interleaved, as used by dmix with interleaved access)
+ * and prints the cost per frame.  The results of both paths are compared
+ * so this program doubles as a correctness check; the exit code is
+ * non-zero when they differ.
+ *
+ * On x86 the cost is measured in TSC cycles, elsewhere in nanoseconds.
+ *
+ * With -t, the given number of threads additionally act as concurrent
+ * clients writing a whole slave buffer per loop, once through the
+ * lock-free mixing slots (mix_slots) and once through the kernels
+ * serialized by a SysV semaphore like dmix does.  The throughput is
+ * printed in frames per second over all clients and the final slot mix
+ * is checked against the saturated sum of all clients.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <errno.h>
+#include <signal.h>
+#include <alloca.h>
+#include <pthread.h>
+#include <sys/sem.h>
+#include "pcm_direct.h"
+#include "pcm_dmix_generic.c"
+#include "pcm_dmix_simd.c"
+#include "pcm_dmix_slots.c"
+#include "bench.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define UNIT	"cycles"
+static unsigned long long now(void)
+{
+	return __rdtsc();
+}
+#else
+#define UNIT	"ns"
+#define now()	bench_now_ns()
+#endif
+
+static unsigned int channels = 8;
+static unsigned int frames = 1024;
+static unsigned int clients = 16;
+static unsigned int loops = 200;
+static unsigned int threads = 0;
+
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S16_LE,
+	SND_PCM_FORMAT_S16_BE,
+	SND_PCM_FORMAT_S32_LE,
+	SND_PCM_FORMAT_S32_BE,
+	SND_PCM_FORMAT_S24_3LE,
+	SND_PCM_FORMAT_U8,
+};
+
+struct bench {
+	unsigned int sample_size;
+	unsigned int samples;
+	unsigned char **src;
+	unsigned char *dst;
+	signed int *sum;
+};
+
+static mix_areas_t *get_mix(snd_pcm_direct_t *dmix, snd_pcm_format_t format,
+			    int remix)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		return (mix_areas_t *)(remix ? dmix->u.dmix.remix_areas_16 :
+				       dmix->u.dmix.mix_areas_16);
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+		return (mix_areas_t *)(remix ? dmix->u.dmix.remix_areas_32 :
+				       dmix->u.dmix.mix_areas_32);
+	case SND_PCM_FORMAT_S24_3LE:
+		return (mix_areas_t *)(remix ? dmix->u.dmix.remix_areas_24 :
+				       dmix->u.dmix.mix_areas_24);
+	case SND_PCM_FORMAT_U8:
+		return (mix_areas_t *)(remix ? dmix->u.dmix.remix_areas_u8 :
+				       dmix->u.dmix.mix_areas_u8);
+	default:
+		return NULL;
+	}
+}
+
+static void bench_init(struct bench *b, snd_pcm_format_t format)
+{
+	unsigned int c, i;
+
+	b->sample_size = snd_pcm_format_physical_width(format) / 8;
+	b->samples = frames * channels;
+	b->src = calloc(clients, sizeof(*b->src));
+	for (c = 0; c < clients; c++) {
+		b->src[c] = malloc(b->samples * b->sample_size);
+		for (i = 0; i < b->samples * b->sample_size; i++)
+			b->src[c][i] = rand();
+	}
+	b->dst = malloc(b->samples * b->sample_size);
+	b->sum = malloc(b->samples * sizeof(*b->sum));
+}
+
+static void bench_free(struct bench *b)
+{
+	unsigned int c;
+
+	for (c = 0; c < clients; c++)
+		free(b->src[c]);
+	free(b->src);
+	free(b->dst);
+	free(b->sum);
+}
+
+/* mix all clients into a silent buffer, the last one removes itself again */
+static unsigned long long bench_run(struct bench *b, snd_pcm_format_t format,
+				    mix_areas_t *mix, mix_areas_t *remix)
+{
+	unsigned long long t;
+	unsigned int c;
+
+	snd_pcm_format_set_silence(format, b->dst, b->samples);
+	memset(b->sum, 0, b->samples * sizeof(*b->sum));
+	t = now();
+	for (c = 0; c < clients; c++)
+		mix(b->samples, b->dst, b->src[c], b->sum,
+		    b->sample_size, b->sample_size, sizeof(*b->sum));
+	remix(b->samples, b->dst, b->src[clients - 1], b->sum,
+	      b->sample_size, b->sample_size, sizeof(*b->sum));
+	return now() - t;
+}
+
+static int bench_format(snd_pcm_format_t format)
+{
+	snd_pcm_direct_share_t share;
+	snd_pcm_direct_t generic, simd;
+	struct bench b;
+	unsigned char *ref_dst;
+	signed int *ref_sum;
+	unsigned long long tg = 0, ts = 0;
+	unsigned int l, size;
+	int err = 0;
+
+	memset(&share, 0, sizeof(share));
+	memset(&generic, 0, sizeof(generic));
+	memset(&simd, 0, sizeof(simd));
+	share.s.format = format;
+	generic.shmptr = simd.shmptr = &share;
+	generic_mix_select_callbacks(&generic);
+	if (!simd_mix_select_callbacks(&simd)) {
+		printf("%-8s no SIMD kernels for this CPU\n",
+		       snd_pcm_format_name(format));
+		return 0;
+	}
+
+	bench_init(&b, format);
+	size = b.samples * b.sample_size;
+	ref_dst = malloc(size);
+	ref_sum = malloc(b.samples * sizeof(*ref_sum));
+	for (l = 0; l < loops; l++) {
+		tg += bench_run(&b, format, get_mix(&generic, format, 0),
+				get_mix(&generic, format, 1));
+		memcpy(ref_dst, b.dst, size);
+		memcpy(ref_sum, b.sum, b.samples * sizeof(*ref_sum));
+		ts += bench_run(&b, format, get_mix(&simd, format, 0),
+				get_mix(&simd, format, 1));
+		if (!err && (memcmp(ref_dst, b.dst, size) ||
+			     memcmp(ref_sum, b.sum, b.samples * sizeof(*ref_sum)))) {
+			printf("%-8s MISMATCH between generic and SIMD kernels\n",
+			       snd_pcm_format_name(format));
+			err = 1;
+		}
+	}
+	printf("%-8s generic %8.2f, simd %8.2f " UNIT "/frame (%.2fx)\n",
+	       snd_pcm_format_name(format),
+	       (double)tg / ((double)loops * frames),
+	       (double)ts / ((double)loops * frames),
+	       ts ? (double)tg / ts : 0.0);
+	free(ref_dst);
+	free(ref_sum);
+	bench_free(&b);
+	return err;
+}
+
+#define MT_PERIODS	4
+
+struct mt_client {
+	struct mt *mt;
+	snd_pcm_direct_t dmix;
+	unsigned char *src;
+	pthread_t thread;
+};
+
+struct mt {
+	snd_pcm_format_t format;
+	snd_pcm_uframes_t buffer_size;
+	snd_pcm_channel_area_t *dst_areas;
+	int semid;
+	mix_areas_t *mix;
+	unsigned char *dst;
+	signed int *sum;
+	unsigned int sample_size;
+	pthread_barrier_t cycle;
+};
+
+static double wall(void)
+{
+	return bench_now_ns() / 1e9;
+}
+
+static void mt_areas(snd_pcm_channel_area_t *areas, void *buf,
+		     unsigned int sample_size)
+{
+	unsigned int chn;
+
+	for (chn = 0; chn < channels; chn++) {
+		areas[chn].addr = buf;
+		areas[chn].first = chn * sample_size * 8;
+		areas[chn].step = channels * sample_size * 8;
+	}
+}
+
+static void *mt_slots_thread(void *arg)
+{
+	struct mt_client *c = arg;
+	struct mt *mt = c->mt;
+	snd_pcm_channel_area_t *src_areas = alloca(channels * sizeof(*src_areas));
+	unsigned int l;
+
+	mt_areas(src_areas, c->src, mt->sample_size);
+	for (l = 0; l < loops; l++) {
+		/* the clients of a slave write in the same buffer cycle,
+		 * of which nothing was played yet */
+		pthread_barrier_wait(&mt->cycle);
+		c->dmix.slave_hw_ptr = l * mt->buffer_size;
+		mix_slots_areas(&c->dmix, src_areas, mt->dst_areas, 0,
+				l * mt->buffer_size, mt->buffer_size, 0);
+	}
+	return NULL;
+}
+
+static void *mt_locked_thread(void *arg)
+{
+	struct mt_client *c = arg;
+	struct mt *mt = c->mt;
+	struct sembuf down = { 0, -1, SEM_UNDO };
+	struct sembuf up = { 0, 1, SEM_UNDO | IPC_NOWAIT };
+	unsigned int l;
+	snd_pcm_uframes_t ofs;
+
+	/* one period at a time, like snd_pcm_dmix_sync_area() */
+	for (l = 0; l < loops; l++) {
+		for (ofs = 0; ofs < mt->buffer_size; ofs += frames) {
+			semop(mt->semid, &down, 1);
+			mt->mix(frames * channels,
+				mt->dst + ofs * channels * mt->sample_size,
+				c->src + ofs * channels * mt->sample_size,
+				mt->sum + ofs * channels,
+				mt->sample_size, mt->sample_size, sizeof(*mt->sum));
+			semop(mt->semid, &up, 1);
+		}
+	}
+	return NULL;
+}
+
+static double mt_run(struct mt_client *clis, void *(*fn)(void *))
+{
+	unsigned int t;
+	double start = wall();
+
+	for (t = 0; t < threads; t++)
+		pthread_create(&clis[t].thread, NULL, fn, &clis[t]);
+	for (t = 0; t < threads; t++)
+		pthread_join(clis[t].thread, NULL);
+	return wall() - start;
+}
+
+static int bench_threads(snd_pcm_format_t format)
+{
+	snd_pcm_direct_share_t share;
+	snd_pcm_direct_t generic, best;
+	struct mt_client *clis;
+	struct mt mt;
+	unsigned char *ref;
+	signed int *acc;
+	unsigned int t, i, samples, size;
+	double tl, ts, total;
+	int err = 0;
+
+	memset(&share, 0, sizeof(share));
+	memset(&generic, 0, sizeof(generic));
+	memset(&best, 0, sizeof(best));
+	share.s.format = format;
+	share.s.channels = channels;
+	share.s.period_size = frames;
+	share.s.buffer_size = frames * MT_PERIODS;
+	share.u.dmix.mix_slots = threads;
+	generic.shmptr = best.shmptr = &share;
+	generic_mix_select_callbacks(&generic);
+	if (!simd_mix_select_callbacks(&best))
+		generic_mix_select_callbacks(&best);
+
+	memset(&mt, 0, sizeof(mt));
+	mt.format = format;
+	mt.buffer_size = share.s.buffer_size;
+	mt.sample_size = snd_pcm_format_physical_width(format) / 8;
+	samples = mt.buffer_size * channels;
+	size = samples * mt.sample_size;
+	mt.dst = malloc(size);
+	mt.sum = calloc(samples, sizeof(*mt.sum));
+	mt.dst_areas = calloc(channels, sizeof(*mt.dst_areas));
+	mt_areas(mt.dst_areas, mt.dst, mt.sample_size);
+	mt.mix = get_mix(&best, format, 0);
+	mt.semid = semget(IPC_PRIVATE, 1, IPC_CREAT | 0600);
+	if (mt.semid < 0 || semctl(mt.semid, 0, SETVAL, 1) < 0) {
+		perror("semget");
+		exit(1);
+	}
+	pthread_barrier_init(&mt.cycle, NULL, threads);
+	ref = malloc(size);
+	acc = malloc(samples * sizeof(*acc));
+
+	generic.u.dmix.sum_buffer = calloc(1, dmix_slots_shm_size(&share));
+	generic.u.dmix.semid_slots = semget(IPC_PRIVATE, threads,
+					    IPC_CREAT | 0600);
+	if (generic.u.dmix.semid_slots < 0) {
+		perror("semget");
+		exit(1);
+	}
+	generic.interleaved = 1;
+	clis = calloc(threads, sizeof(*clis));
+	for (t = 0; t < threads; t++) {
+		clis[t].mt = &mt;
+		clis[t].dmix = generic;
+		clis[t].src = malloc(size);
+		for (i = 0; i < size; i++)
+			clis[t].src[i] = rand();
+		dmix_slots_claim(&clis[t].dmix);
+		/* reference: saturated sum of all clients */
+		dmix_slots_load(format, acc, 1, clis[t].src, mt.sample_size,
+				samples);
+		for (i = 0; i < samples; i++)
+			mt.sum[i] += acc[i];
+	}
+	dmix_slots_store(format, ref, mt.sample_size, mt.sum, 1, samples);
+
+	snd_pcm_format_set_silence(format, mt.dst, samples);
+	ts = mt_run(clis, mt_slots_thread);
+	if (memcmp(ref, mt.dst, size)) {
+		printf("%-8s MISMATCH of the slot mix\n",
+		       snd_pcm_format_name(format));
+		err = 1;
+	}
+	snd_pcm_format_set_silence(format, mt.dst, samples);
+	memset(mt.sum, 0, samples * sizeof(*mt.sum));
+	tl = mt_run(clis, mt_locked_thread);
+
+	total = (double)threads * loops * mt.buffer_size;
+	printf("%-8s %u threads: locked %8.2f, slots %8.2f Mframes/s (%.2fx)\n",
+	       snd_pcm_format_name(format), threads,
+	       total / tl / 1e6, total / ts / 1e6, tl / ts);
+
+	for (t = 0; t < threads; t++) {
+		dmix_slots_release(&clis[t].dmix);
+		free(clis[t].src);
+	}
+	free(clis);
+	free(generic.u.dmix.sum_buffer);
+	dmix_slots_sem_discard(&generic);
+	semctl(mt.semid, 0, IPC_RMID);
+	pthread_barrier_destroy(&mt.cycle);
+	free(mt.dst_areas);
+	free(mt.dst);
+	free(mt.sum);
+	free(ref);
+	free(acc);
+	return err;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: dmix-bench [-options]\n");
+	fprintf(stderr, "  -c val  Set number of channels (default 8)\n");
+	fprintf(stderr, "  -p val  Set period size in frames (default 1024)\n");
+	fprintf(stderr, "  -n val  Set number of mixed clients (default 16)\n");
+	fprintf(stderr, "  -l val  Set number of loops (default 200)\n");
+	fprintf(stderr, "  -t val  Run the multi-client test with val threads (default off)\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+	int c, err = 0;
+
+	while ((c = getopt(argc, argv, "c:p:n:l:t:")) >= 0) {
+		switch (c) {
+		case 'c':
+			channels = atoi(optarg);
+			break;
+		case 'p':
+			frames = atoi(optarg);
+			break;
+		case 'n':
+			clients = atoi(optarg);
+			break;
+		case 'l':
+			loops = atoi(optarg);
+			break;
+		case 't':
+			threads = atoi(optarg);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (!channels || !frames || !clients || !loops) {
+		usage();
+		return 1;
+	}
+
+	printf("%u clients, %u channels, %u frames per period\n",
+	       clients, channels, frames);
+	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+		err |= bench_format(formats[i]);
+	if (!threads)
+		return err;
+	if (channels > DMIX_SLOT_BLOCK) {
+		fprintf(stderr, "too many channels for the multi-client test\n");
+		return 1;
+	}
+	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+		err |= bench_threads(formats[i]);
+	return err;
+}
@@ -0,0 +1,288 @@
+/*
+ * offline benchmark of PCM plugin chains
+ *
+ * Builds the chain given as a PCM definition (by default a plug PCM on
+ * top of the null plugin, converting to S32 7.1 48kHz), writes a fixed
+ * length of a synthetic two-tone signal through it as fast as possible
+ * for each combination of the given client formats, channel counts and
+ * rates, and prints the frames per second, the time per frame of the
+ * whole chain and of each plugin layer (from snd_pcm_stats), and the
+ * memory allocations made while streaming.  The data are committed
+ * through the mmap API by default, so that each plugin layer is
+ * charged with its own conversion.
+ *
+ * The chain must end in a PCM which doesn't need a sound card, e.g.
+ *
+ *   pcm-bench -C 'type rate slave { pcm { type null } rate 48000 }' -r 44100,32000
+ *   pcm-bench -C 'type route slave { pcm { type null } channels 2 }
+ *                 ttable.0.0 0.5 ttable.1.1 0.5' -c 2
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "bench.h"
+
+#define MAX_VALUES	16
+
+static const char *chain =
+	"type plug slave { pcm { type null } format S32 channels 8 rate 48000 }";
+static snd_pcm_format_t formats[MAX_VALUES] = { SND_PCM_FORMAT_S16 };
+static unsigned int num_formats = 1;
+static unsigned int channels[MAX_VALUES] = { 2 };
+static unsigned int num_channels = 1;
+static unsigned int rates[MAX_VALUES] = { 44100 };
+static unsigned int num_rates = 1;
+static snd_pcm_uframes_t period_size = 1024;
+static unsigned int seconds = 60;
+static int rw_access;
+
+#ifdef __GLIBC__
+/* count the allocations of the library while streaming */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+static int count_allocs;
+static unsigned long allocs;
+
+void *malloc(size_t size)
+{
+	if (count_allocs)
+		allocs++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	if (count_allocs)
+		allocs++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	if (count_allocs)
+		allocs++;
+	return __libc_realloc(ptr, size);
+}
+#define ALLOCS_BEGIN()	(allocs = 0, count_allocs = 1)
+#define ALLOCS_END()	(count_allocs = 0, allocs)
+#else
+#define ALLOCS_BEGIN()	do { } while (0)
+#define ALLOCS_END()	0UL
+#endif
+
+static int setup(snd_pcm_t *pcm, snd_pcm_format_t format,
+		 unsigned int chans, unsigned int rate)
+{
+	snd_pcm_uframes_t period = period_size;
+	unsigned int r = rate;
+	int err;
+
+	err = bench_setup(pcm, rw_access ? SND_PCM_ACCESS_RW_INTERLEAVED :
+					   SND_PCM_ACCESS_MMAP_INTERLEAVED,
+			  format, chans, &r, &period);
+	if (err < 0)
+		return err;
+	/* the chain must take the rate and the period size as they are */
+	if (r != rate || period != period_size)
+		return -EINVAL;
+	return 0;
+}
+
+static int run(snd_pcm_format_t format, unsigned int chans, unsigned int rate)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_stats_t *stats;
+	snd_pcm_uframes_t pos, total = (snd_pcm_uframes_t)rate * seconds;
+	snd_pcm_sframes_t r;
+	unsigned long long t, spent;
+	unsigned long nallocs;
+	unsigned int i, layers;
+	size_t bytes;
+	void *buf;
+	int err;
+
+	err = bench_open(&pcm, chain);
+	if (err < 0) {
+		fprintf(stderr, "open failed: %s\n", snd_strerror(err));
+		return err;
+	}
+	err = setup(pcm, format, chans, rate);
+	if (err < 0) {
+		printf("%-8s %2uch %6uHz  not supported by the chain: %s\n",
+		       snd_pcm_format_name(format), chans, rate, snd_strerror(err));
+		snd_pcm_close(pcm);
+		return 0;
+	}
+	bytes = snd_pcm_frames_to_bytes(pcm, period_size);
+	buf = malloc(bytes);
+	if (!buf) {
+		snd_pcm_close(pcm);
+		return -ENOMEM;
+	}
+	snd_pcm_format_set_silence(format, buf, period_size * chans);
+	snd_pcm_stats_enable(pcm, 1);
+	snd_pcm_stats_malloc(&stats);
+
+	spent = 0;
+	ALLOCS_BEGIN();
+	for (pos = 0; pos < total; pos += period_size) {
+		bench_fill(buf, format, chans, rate, pos, period_size);
+		t = bench_now_ns();
+		if (rw_access)
+			r = snd_pcm_writei(pcm, buf, period_size);
+		else
+			r = snd_pcm_mmap_writei(pcm, buf, period_size);
+		spent += bench_now_ns() - t;
+		if (r < 0) {
+			r = snd_pcm_recover(pcm, r, 0);
+			if (r < 0) {
+				err = r;
+				break;
+			}
+		}
+	}
+	nallocs = ALLOCS_END();
+
+	if (!err) {
+		snd_pcm_stats(pcm, stats);
+		printf("%-8s %2uch %6uHz  %8.2f Mframes/s %8.2f ns/frame %6lu allocs\n",
+		       snd_pcm_format_name(format), chans, rate,
+		       pos * 1000.0 / spent, (double)spent / pos, nallocs);
+		layers = snd_pcm_stats_get_layers(stats);
+		for (i = 0; i < layers; i++) {
+			unsigned long long frames = snd_pcm_stats_get_layer_frames(stats, i);
+
+			if (!frames)
+				continue;
+			printf("    %-12s %8.2f ns/frame\n",
+			       snd_pcm_type_name(snd_pcm_stats_get_layer_type(stats, i)),
+			       (double)snd_pcm_stats_get_layer_time(stats, i) / frames);
+		}
+	} else {
+		fprintf(stderr, "write failed: %s\n", snd_strerror(err));
+	}
+	snd_pcm_stats_free(stats);
+	free(buf);
+	snd_pcm_drop(pcm);
+	snd_pcm_close(pcm);
+	return err;
+}
+
+/* parse a comma separated list of values */
+static int parse_list(const char *arg, unsigned int *vals, unsigned int *count,
+		      int formats_list)
+{
+	char *str = strdup(arg), *p, *save = NULL;
+	unsigned int n = 0;
+
+	if (!str)
+		return -ENOMEM;
+	for (p = strtok_r(str, ",", &save); p; p = strtok_r(NULL, ",", &save)) {
+		if (n >= MAX_VALUES)
+			break;
+		if (formats_list) {
+			snd_pcm_format_t f = snd_pcm_format_value(p);
+
+			if (f == SND_PCM_FORMAT_UNKNOWN) {
+				free(str);
+				return -EINVAL;
+			}
+			vals[n++] = f;
+		} else {
+			vals[n] = atoi(p);
+			if (!vals[n]) {
+				free(str);
+				return -EINVAL;
+			}
+			n++;
+		}
+	}
+	free(str);
+	if (!n)
+		return -EINVAL;
+	*count = n;
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: pcm-bench [-options]\n");
+	fprintf(stderr, "  -C str   PCM definition of the chain (default a plug to S32 8ch 48kHz null)\n");
+	fprintf(stderr, "  -f list  Client formats: S16, S24, S32 and FLOAT (default S16)\n");
+	fprintf(stderr, "  -c list  Client channel counts (default 2)\n");
+	fprintf(stderr, "  -r list  Client rates (default 44100)\n");
+	fprintf(stderr, "  -p val   Period size in frames (default 1024)\n");
+	fprintf(stderr, "  -l val   Length of the written signal in seconds (default 60)\n");
+	fprintf(stderr, "  -w       Use RW instead of MMAP access; the conversions are then\n");
+	fprintf(stderr, "           accounted to the slave layers\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int f, c, r, fmts[MAX_VALUES];
+	int opt, err = 0;
+
+	while ((opt = getopt(argc, argv, "C:f:c:r:p:l:w")) >= 0) {
+		switch (opt) {
+		case 'C':
+			chain = optarg;
+			break;
+		case 'f':
+			if (parse_list(optarg, fmts, &num_formats, 1) < 0) {
+				usage();
+				return 1;
+			}
+			for (f = 0; f < num_formats; f++)
+				formats[f] = fmts[f];
+			break;
+		case 'c':
+			if (parse_list(optarg, channels, &num_channels, 0) < 0) {
+				usage();
+				return 1;
+			}
+			break;
+		case 'r':
+			if (parse_list(optarg, rates, &num_rates, 0) < 0) {
+				usage();
+				return 1;
+			}
+			break;
+		case 'p':
+			period_size = atoi(optarg);
+			break;
+		case 'l':
+			seconds = atoi(optarg);
+			break;
+		case 'w':
+			rw_access = 1;
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (!period_size || !seconds) {
+		usage();
+		return 1;
+	}
+	for (f = 0; f < num_formats; f++) {
+		if (formats[f] != SND_PCM_FORMAT_S16 &&
+		    formats[f] != SND_PCM_FORMAT_S24 &&
+		    formats[f] != SND_PCM_FORMAT_S32 &&
+		    formats[f] != SND_PCM_FORMAT_FLOAT) {
+			usage();
+			return 1;
+		}
+	}
+
+	printf("chain: %s\n", chain);
+	printf("%lu frames per period, %u seconds\n", period_size, seconds);
+	for (f = 0; f < num_formats && !err; f++)
+		for (c = 0; c < num_channels && !err; c++)
+			for (r = 0; r < num_rates && !err; r++)
+				err = run(formats[f], channels[c], rates[r]);
+	return err ? 1 : 0;
+}
@@ -15,11 +15,19 @@
  * (0-9).  In addition, it puts the mode suffix ('a' for avail, 'd' for
  * delay, etc) for the random mode, as well as the suffix '!' indicating
  * the error from the called function.
+ *
+ * The -S option enables the status snapshot mode, where the status
+ * queries don't wait for the lock held by the main thread.  With -l, the
+ * test stops after the given time and prints how long the calls of the
+ * worker threads and the transfers of the main thread took, to compare
+ * the lock contention with and without -S.
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <pthread.h>
 #include <getopt.h>
+#include <time.h>
 #include "../include/asoundlib.h"
 
 #define MAX_THREADS	10
@@ -49,11 +57,48 @@ static snd_pcm_format_t format = SND_PCM_FORMAT_S16_LE;
 static int running_mode = MODE_AVAIL_UPDATE;
 static int show_value = 0;
 static int quiet = 0;
+static int snapshot = 0;
+static int seconds = 0;
 
 static pthread_t peeper_threads[MAX_THREADS];
 static int running = 1;
 static snd_pcm_t *pcm;
 
+/* time spent in the calls, per thread */
+struct call_time {
+	unsigned long calls;
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+};
+
+static struct call_time peeper_times[MAX_THREADS];
+static struct call_time transfer_time;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void add_time(struct call_time *t, unsigned long long start)
+{
+	unsigned long long ns = now_ns() - start;
+
+	t->calls++;
+	t->total_ns += ns;
+	if (ns > t->max_ns)
+		t->max_ns = ns;
+}
+
+static void show_time(const char *name, const struct call_time *t)
+{
+	printf("%-10s %10lu calls, avg %8.0f ns, max %10llu ns\n", name,
+	       t->calls, t->calls ? (double)t->total_ns / t->calls : 0.0,
+	       t->max_ns);
+}
+
 static void *peeper(void *data)
 {
 	int thread_no = (long)data;
@@ -61,12 +106,14 @@ static void *peeper(void *data)
 	snd_pcm_status_t *stat;
 	snd_htimestamp_t tstamp;
 	int mode = running_mode, err;
+	unsigned long long start;
 
 	snd_pcm_status_alloca(&stat);
 
 	while (running) {
 		if (running_mode == MODE_RANDOM)
 			mode = rand() % MODE_RANDOM;
+		start = now_ns();
 		switch (mode) {
 		case MODE_AVAIL_UPDATE:
 			val = snd_pcm_avail_update(pcm);
@@ -87,6 +134,7 @@ static void *peeper(void *data)
 			err = snd_pcm_delay(pcm, &val);
 			break;
 		}
+		add_time(&peeper_times[thread_no], start);
 
 		if (quiet)
 			continue;
@@ -116,6 +164,8 @@ static void usage(void)
 	fprintf(stderr, "  -s str  Set stream direction (playback or capture)\n");
 	fprintf(stderr, "  -t val  Set number of threads\n");
 	fprintf(stderr, "  -m str  Running mode (avail, status, hwsync, timestamp, delay, random)\n");
+	fprintf(stderr, "  -S      Use the status snapshot mode\n");
+	fprintf(stderr, "  -l val  Stop after the given seconds and show the call times\n");
 	fprintf(stderr, "  -v      Show value\n");
 	fprintf(stderr, "  -q      Quiet mode\n");
 }
@@ -124,7 +174,7 @@ static int parse_options(int argc, char **argv)
 {
 	int c, i;
 
-	while ((c = getopt(argc, argv, "D:r:f:p:b:s:t:m:vq")) >= 0) {
+	while ((c = getopt(argc, argv, "D:r:f:p:b:c:s:t:m:Sl:vq")) >= 0) {
 		switch (c) {
 		case 'D':
 			devname = optarg;
@@ -171,6 +221,12 @@ static int parse_options(int argc, char **argv)
 			}
 			running_mode = i;
 			break;
+		case 'S':
+			snapshot = 1;
+			break;
+		case 'l':
+			seconds = atoi(optarg);
+			break;
 		case 'v':
 			show_value = 1;
 			break;
@@ -209,6 +265,7 @@ int main(int argc, char **argv)
 {
 	char *buf;
 	int i, err;
+	unsigned long long start, end = 0;
 
 	if (parse_options(argc, argv))
 		return 1;
@@ -221,6 +278,10 @@ int main(int argc, char **argv)
 
 	if (setup_params())
 		return 1;
+	if (snapshot && snd_pcm_set_status_snapshot(pcm, 1) < 0) {
+		fprintf(stderr, "cannot enable the status snapshot mode\n");
+		return 1;
+	}
 
 	buf = calloc(1, snd_pcm_format_size(format, bufsize) * channels);
 	if (!buf) {
@@ -237,12 +298,20 @@ int main(int argc, char **argv)
 
 	if (stream == SND_PCM_STREAM_CAPTURE)
 		snd_pcm_start(pcm);
+	if (seconds)
+		end = now_ns() + seconds * 1000000000ULL;
 	for (;;) {
 		int size = rand() % (bufsize / 2);
+		start = now_ns();
+		if (end && start >= end) {
+			err = 0;
+			break;
+		}
 		if (stream == SND_PCM_STREAM_PLAYBACK)
 			err = snd_pcm_writei(pcm, buf, size);
 		else
 			err = snd_pcm_readi(pcm, buf, size);
+		add_time(&transfer_time, start);
 		if (err < 0) {
 			fprintf(stderr, "read/write error %d\n", err);
 			err = snd_pcm_recover(pcm, err, 0);
@@ -254,10 +323,26 @@ int main(int argc, char **argv)
 	}
 
 	running = 0;
-	for (i = 0; i < num_threads; i++)
-		pthread_cancel(peeper_threads[i]);
+	if (!end) {
+		for (i = 0; i < num_threads; i++)
+			pthread_cancel(peeper_threads[i]);
+	}
 	for (i = 0; i < num_threads; i++)
 		pthread_join(peeper_threads[i], NULL);
 
-	return 1;
+	if (!end)
+		return 1;
+	if (!quiet)
+		fprintf(stderr, "\n");
+	printf("status snapshot mode %s\n", snapshot ? "on" : "off");
+	show_time("transfer", &transfer_time);
+	for (i = 0; i < num_threads; i++) {
+		char name[24];
+
+		snprintf(name, sizeof(name), "thread %d", i);
+		show_time(name, &peeper_times[i]);
+	}
+	snd_pcm_close(pcm);
+	free(buf);
+	return err < 0 ? 1 : 0;
 }
@@ -0,0 +1,258 @@
+/*
+ * multi-client test for the share PCM plugin
+ *
+ * Each thread opens its own share client, bound to one channel of the
+ * same slave, and streams to or from it for the given time.  After each
+ * transfer it queries the delay, the status and the rewindable frames,
+ * timing these calls: they must not wait for the other clients.
+ *
+ * The clients are opened at once, or one after another with -o, so
+ * that the later ones join the running slave.  All of them close while
+ * the others may still run.  The slave is the virtual card plugin by
+ * default, so no sound card is needed; another slave PCM name can be
+ * given with -D.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define MAX_CLIENTS	8
+
+static const char *slave = "share_virt";
+static int stream = SND_PCM_STREAM_PLAYBACK;
+static int num_clients = 4;
+static int seconds = 3;
+static int stagger_ms = 0;
+static int rate = 48000;
+static int period_time = 10666;
+
+struct client {
+	pthread_t thread;
+	int index;
+	int failed;
+	unsigned long frames;
+	unsigned long xruns;
+	unsigned long queries;
+	unsigned long long query_ns;
+	unsigned long long query_max_ns;
+};
+
+static struct client clients[MAX_CLIENTS];
+
+static int query(struct client *c, snd_pcm_t *pcm, snd_pcm_status_t *st)
+{
+	unsigned long long start = bench_now_ns(), ns;
+	snd_pcm_sframes_t delay;
+	int err;
+
+	err = snd_pcm_delay(pcm, &delay);
+	if (err >= 0)
+		err = snd_pcm_status(pcm, st);
+	if (err >= 0) {
+		err = snd_pcm_rewindable(pcm);
+		if (err > 0)
+			err = 0;
+	}
+	ns = bench_now_ns() - start;
+	c->queries++;
+	c->query_ns += ns;
+	if (ns > c->query_max_ns)
+		c->query_max_ns = ns;
+	return err;
+}
+
+static void *client_thread(void *data)
+{
+	struct client *c = data;
+	snd_pcm_status_t *st;
+	snd_pcm_t *pcm;
+	char name[16];
+	short buf[1024];
+	snd_pcm_uframes_t size = 512;
+	unsigned long long end;
+	int err;
+
+	snd_pcm_status_alloca(&st);
+	memset(buf, 0, sizeof(buf));
+	if (stagger_ms)
+		usleep(c->index * stagger_ms * 1000);
+	snprintf(name, sizeof(name), "share%d", c->index);
+	err = snd_pcm_open(&pcm, name, stream, 0);
+	if (err < 0) {
+		fprintf(stderr, "%s: open: %s\n", name, snd_strerror(err));
+		goto _fail;
+	}
+	err = snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+				 SND_PCM_ACCESS_RW_INTERLEAVED, 1, rate, 0,
+				 period_time * 8);
+	if (err < 0) {
+		fprintf(stderr, "%s: params: %s\n", name, snd_strerror(err));
+		snd_pcm_close(pcm);
+		goto _fail;
+	}
+	end = bench_now_ns() + seconds * 1000000000ULL;
+	while (bench_now_ns() < end) {
+		snd_pcm_sframes_t r;
+
+		if (stream == SND_PCM_STREAM_PLAYBACK)
+			r = snd_pcm_writei(pcm, buf, size);
+		else
+			r = snd_pcm_readi(pcm, buf, size);
+		if (r < 0) {
+			c->xruns++;
+			err = snd_pcm_recover(pcm, r, 1);
+			if (err < 0) {
+				fprintf(stderr, "%s: transfer: %s\n", name,
+					snd_strerror(err));
+				break;
+			}
+			continue;
+		}
+		c->frames += r;
+		/* the delay is defined only while running */
+		if (snd_pcm_state(pcm) != SND_PCM_STATE_RUNNING)
+			continue;
+		err = query(c, pcm, st);
+		if (err < 0 && err != -EPIPE) {
+			fprintf(stderr, "%s: query: %s\n", name,
+				snd_strerror(err));
+			break;
+		}
+		err = 0;
+	}
+	if (stream == SND_PCM_STREAM_PLAYBACK)
+		snd_pcm_drain(pcm);
+	snd_pcm_close(pcm);
+	if (err >= 0)
+		return NULL;
+ _fail:
+	c->failed = 1;
+	return NULL;
+}
+
+static int load_config(void)
+{
+	snd_input_t *in;
+	char *text;
+	size_t len;
+	int i, err;
+
+	err = snd_config_update();
+	if (err < 0)
+		return err;
+	len = (strlen(slave) + 160) * (MAX_CLIENTS + 1);
+	text = malloc(len);
+	if (!text)
+		return -ENOMEM;
+	strcpy(text, "pcm.share_virt { type virt }\n");
+	for (i = 0; i < num_clients; i++)
+		snprintf(text + strlen(text), len - strlen(text),
+			 "pcm.share%d { type share bindings [ %d ] "
+			 "slave { pcm \"%s\" channels %d rate %d format S16_LE } }\n",
+			 i, i, slave, num_clients, rate);
+	err = snd_input_buffer_open(&in, text, -1);
+	if (err >= 0) {
+		/* the share plugin opens its slave from the global tree */
+		err = snd_config_load(snd_config, in);
+		snd_input_close(in);
+	}
+	free(text);
+	return err;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: pcm-share-multi [-options]\n");
+	fprintf(stderr, "  -D str  Slave PCM name (default share_virt, a virtual card)\n");
+	fprintf(stderr, "  -n val  Number of clients\n");
+	fprintf(stderr, "  -s str  Stream direction (playback or capture)\n");
+	fprintf(stderr, "  -l val  Seconds to run each client\n");
+	fprintf(stderr, "  -o val  Open the clients the given msec apart\n");
+	fprintf(stderr, "  -r val  Sample rate\n");
+}
+
+static int parse_options(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "D:n:s:l:o:r:")) >= 0) {
+		switch (c) {
+		case 'D':
+			slave = optarg;
+			break;
+		case 'n':
+			num_clients = atoi(optarg);
+			if (num_clients < 1 || num_clients > MAX_CLIENTS) {
+				fprintf(stderr, "invalid number of clients\n");
+				return 1;
+			}
+			break;
+		case 's':
+			if (*optarg == 'p' || *optarg == 'P')
+				stream = SND_PCM_STREAM_PLAYBACK;
+			else if (*optarg == 'c' || *optarg == 'C')
+				stream = SND_PCM_STREAM_CAPTURE;
+			else {
+				fprintf(stderr, "invalid stream direction\n");
+				return 1;
+			}
+			break;
+		case 'l':
+			seconds = atoi(optarg);
+			break;
+		case 'o':
+			stagger_ms = atoi(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int i, err, failed = 0;
+
+	if (parse_options(argc, argv))
+		return 1;
+	err = load_config();
+	if (err < 0) {
+		fprintf(stderr, "cannot load the configuration: %s\n",
+			snd_strerror(err));
+		return 1;
+	}
+
+	for (i = 0; i < num_clients; i++) {
+		clients[i].index = i;
+		if (pthread_create(&clients[i].thread, NULL, client_thread,
+				   &clients[i])) {
+			fprintf(stderr, "pthread_create error\n");
+			return 1;
+		}
+	}
+	for (i = 0; i < num_clients; i++)
+		pthread_join(clients[i].thread, NULL);
+
+	for (i = 0; i < num_clients; i++) {
+		struct client *c = &clients[i];
+
+		printf("client %d: %s %8lu frames/s, %lu xruns, "
+		       "queries avg %8.0f ns, max %10llu ns\n", i,
+		       c->failed ? "FAILED" : "ok    ",
+		       c->frames / (seconds ? seconds : 1), c->xruns,
+		       c->queries ? (double)c->query_ns / c->queries : 0.0,
+		       c->query_max_ns);
+		failed |= c->failed;
+	}
+	return failed;
+}
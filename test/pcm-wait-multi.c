@@ -0,0 +1,197 @@
+/*
+ * many playback streams serviced by one thread through a wait set
+ *
+ * Opens the given number of non-blocking playback PCMs, registers them
+ * into one snd_wait_set_t and writes silence to each stream whenever the
+ * wait set reports it ready.  At the end, the number of wakeups, the
+ * average number of ready streams per wakeup and the frames written per
+ * stream are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <time.h>
+#include "../include/asoundlib.h"
+
+#define MAX_STREAMS	256
+
+static const char *devname = "default";
+static unsigned int num_streams = 4;
+static unsigned int rate = 48000;
+static unsigned int channels = 2;
+static snd_pcm_uframes_t period_size = 1024;
+static unsigned int seconds = 5;
+
+static snd_pcm_t *pcms[MAX_STREAMS];
+static unsigned long long written[MAX_STREAMS];
+
+static int setup(snd_pcm_t *pcm)
+{
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_sw_params_t *sw;
+	snd_pcm_uframes_t period = period_size;
+	int err;
+
+	snd_pcm_hw_params_alloca(&hw);
+	snd_pcm_sw_params_alloca(&sw);
+	err = snd_pcm_hw_params_any(pcm, hw);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_channels(pcm, hw, channels);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_rate(pcm, hw, rate, 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_period_size_near(pcm, hw, &period, 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_periods(pcm, hw, 4, 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params(pcm, hw);
+	if (err < 0)
+		return err;
+	period_size = period;
+	err = snd_pcm_sw_params_current(pcm, sw);
+	if (err < 0)
+		return err;
+	err = snd_pcm_sw_params_set_avail_min(pcm, sw, period);
+	if (err < 0)
+		return err;
+	err = snd_pcm_sw_params_set_start_threshold(pcm, sw, period);
+	if (err < 0)
+		return err;
+	return snd_pcm_sw_params(pcm, sw);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: pcm-wait-multi [-options]\n");
+	fprintf(stderr, "  -D str  Set device name (default \"default\")\n");
+	fprintf(stderr, "  -n val  Set number of streams (default 4)\n");
+	fprintf(stderr, "  -r val  Set sample rate (default 48000)\n");
+	fprintf(stderr, "  -c val  Set number of channels (default 2)\n");
+	fprintf(stderr, "  -p val  Set period size in frames (default 1024)\n");
+	fprintf(stderr, "  -l val  Set running time in seconds (default 5)\n");
+}
+
+int main(int argc, char **argv)
+{
+	snd_wait_set_t *ws;
+	snd_wait_event_t events[MAX_STREAMS];
+	unsigned long wakeups = 0, ready = 0;
+	time_t end;
+	short *buf;
+	unsigned int i;
+	int c, n, err;
+
+	while ((c = getopt(argc, argv, "D:n:r:c:p:l:")) >= 0) {
+		switch (c) {
+		case 'D':
+			devname = optarg;
+			break;
+		case 'n':
+			num_streams = atoi(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'c':
+			channels = atoi(optarg);
+			break;
+		case 'p':
+			period_size = atoi(optarg);
+			break;
+		case 'l':
+			seconds = atoi(optarg);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (!num_streams || num_streams > MAX_STREAMS || !rate ||
+	    !channels || !period_size) {
+		usage();
+		return 1;
+	}
+
+	err = snd_wait_set_open(&ws);
+	if (err < 0) {
+		fprintf(stderr, "cannot create the wait set: %s\n", snd_strerror(err));
+		return 1;
+	}
+	for (i = 0; i < num_streams; i++) {
+		err = snd_pcm_open(&pcms[i], devname, SND_PCM_STREAM_PLAYBACK,
+				   SND_PCM_NONBLOCK);
+		if (err < 0) {
+			fprintf(stderr, "cannot open %s: %s\n", devname, snd_strerror(err));
+			return 1;
+		}
+		err = setup(pcms[i]);
+		if (err < 0) {
+			fprintf(stderr, "cannot set up %s: %s\n", devname, snd_strerror(err));
+			return 1;
+		}
+		err = snd_wait_set_add_pcm(ws, pcms[i], (void *)(long)i);
+		if (err < 0) {
+			fprintf(stderr, "cannot add stream %u: %s\n", i, snd_strerror(err));
+			return 1;
+		}
+	}
+	buf = calloc(period_size, channels * sizeof(*buf));
+	if (!buf)
+		return 1;
+
+	end = time(NULL) + seconds;
+	while (time(NULL) < end) {
+		n = snd_wait_set_wait(ws, events, num_streams, 1000);
+		if (n < 0) {
+			fprintf(stderr, "wait failed: %s\n", snd_strerror(n));
+			break;
+		}
+		if (!n)
+			continue;
+		wakeups++;
+		ready += n;
+		for (c = 0; c < n; c++) {
+			snd_pcm_t *pcm = events[c].handle;
+			long idx = (long)events[c].private_data;
+			snd_pcm_sframes_t r;
+
+			if (events[c].revents & POLLERR) {
+				snd_pcm_recover(pcm, -EPIPE, 1);
+				continue;
+			}
+			r = snd_pcm_writei(pcm, buf, period_size);
+			if (r < 0)
+				r = snd_pcm_recover(pcm, r, 1);
+			else
+				written[idx] += r;
+			if (r < 0 && r != -EAGAIN) {
+				fprintf(stderr, "write error on stream %ld: %s\n",
+					idx, snd_strerror(r));
+				end = 0;
+			}
+		}
+	}
+
+	printf("%u streams, %lu wakeups, %.2f ready streams per wakeup\n",
+	       num_streams, wakeups, wakeups ? (double)ready / wakeups : 0.0);
+	for (i = 0; i < num_streams; i++) {
+		printf("  stream %u: %llu frames\n", i, written[i]);
+		snd_wait_set_remove(ws, pcms[i]);
+		snd_pcm_close(pcms[i]);
+	}
+	snd_wait_set_close(ws);
+	free(buf);
+	return 0;
+}
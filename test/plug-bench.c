@@ -0,0 +1,237 @@
+/*
+ * plug conversion chain benchmark
+ *
+ * Opens a plug PCM on top of a null slave which needs a rate, channel
+ * and format conversion (by default S16 stereo 44.1kHz to S32 7.1
+ * 48kHz), once with the fused rate+route path and once with the layered
+ * chain of separate plugins, writes the same synthetic signal through
+ * both and prints the time spent per client frame and per period.
+ *
+ * With -v, the slave is wrapped by a file PCM and the data written by
+ * both chains are compared; the exit code is non-zero when they differ.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include "bench.h"
+
+static const char *converter = "linear";
+static snd_pcm_format_t cformat = SND_PCM_FORMAT_S16;
+static snd_pcm_format_t sformat = SND_PCM_FORMAT_S32;
+static unsigned int cchannels = 2;
+static unsigned int schannels = 8;
+static unsigned int crate = 44100;
+static unsigned int srate = 48000;
+static snd_pcm_uframes_t period_size = 1024;
+static unsigned int seconds = 60;
+static int verify;
+
+static int open_plug(snd_pcm_t **pcmp, int fused, const char *file)
+{
+	char slave[256], buf[1024];
+
+	if (file)
+		snprintf(slave, sizeof(slave),
+			 "{ type file file \"%s\" format raw slave.pcm { type null } }",
+			 file);
+	else
+		snprintf(slave, sizeof(slave), "{ type null }");
+	snprintf(buf, sizeof(buf),
+		 "type plug fused %s rate_converter \"%s\" "
+		 "slave { pcm %s format %s channels %u rate %u }",
+		 fused ? "true" : "false", converter, slave,
+		 snd_pcm_format_name(sformat), schannels, srate);
+	return bench_open(pcmp, buf);
+}
+
+static int setup(snd_pcm_t *pcm)
+{
+	unsigned int rate = crate;
+
+	return bench_setup(pcm, SND_PCM_ACCESS_RW_INTERLEAVED, cformat,
+			   cchannels, &rate, &period_size);
+}
+
+static int run(int fused, const char *file, double *ns_frame, double *ns_period)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_uframes_t pos, total = (snd_pcm_uframes_t)crate * seconds;
+	snd_pcm_sframes_t r;
+	unsigned long long t, spent = 0;
+	unsigned long periods = 0;
+	void *buf;
+	int err;
+
+	err = open_plug(&pcm, fused, file);
+	if (err < 0) {
+		fprintf(stderr, "open failed: %s\n", snd_strerror(err));
+		return err;
+	}
+	err = setup(pcm);
+	if (err < 0) {
+		fprintf(stderr, "setup failed: %s\n", snd_strerror(err));
+		snd_pcm_close(pcm);
+		return err;
+	}
+	buf = malloc(period_size * cchannels * snd_pcm_format_physical_width(cformat) / 8);
+	if (!buf) {
+		snd_pcm_close(pcm);
+		return -ENOMEM;
+	}
+	for (pos = 0; pos < total; pos += period_size) {
+		bench_fill(buf, cformat, cchannels, crate, pos, period_size);
+		t = bench_now_ns();
+		r = snd_pcm_writei(pcm, buf, period_size);
+		spent += bench_now_ns() - t;
+		if (r < 0) {
+			r = snd_pcm_recover(pcm, r, 0);
+			if (r < 0) {
+				fprintf(stderr, "write failed: %s\n", snd_strerror(r));
+				err = r;
+				break;
+			}
+		}
+		periods++;
+	}
+	if (!err) {
+		snd_pcm_drain(pcm);
+		*ns_frame = (double)spent / (periods * period_size);
+		*ns_period = (double)spent / periods;
+	}
+	free(buf);
+	snd_pcm_close(pcm);
+	return err;
+}
+
+static int compare(const char *a, const char *b)
+{
+	FILE *fa, *fb;
+	char ba[4096], bb[4096];
+	size_t na, nb, size = 0;
+	int err = 1;
+
+	fa = fopen(a, "rb");
+	fb = fopen(b, "rb");
+	if (!fa || !fb)
+		goto _end;
+	do {
+		na = fread(ba, 1, sizeof(ba), fa);
+		nb = fread(bb, 1, sizeof(bb), fb);
+		if (na != nb || memcmp(ba, bb, na))
+			goto _end;
+		size += na;
+	} while (na);
+	err = size ? 0 : 1;
+ _end:
+	if (fa)
+		fclose(fa);
+	if (fb)
+		fclose(fb);
+	return err;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: plug-bench [-options]\n");
+	fprintf(stderr, "  -r str  Set rate converter (default linear)\n");
+	fprintf(stderr, "  -f str  Set client format: S16, S24, S32 or FLOAT (default S16)\n");
+	fprintf(stderr, "  -F str  Set slave format (default S32)\n");
+	fprintf(stderr, "  -c val  Set client channels (default 2)\n");
+	fprintf(stderr, "  -C val  Set slave channels (default 8)\n");
+	fprintf(stderr, "  -s val  Set client rate (default 44100)\n");
+	fprintf(stderr, "  -S val  Set slave rate (default 48000)\n");
+	fprintf(stderr, "  -p val  Set client period size in frames (default 1024)\n");
+	fprintf(stderr, "  -l val  Set length of the written signal in seconds (default 60)\n");
+	fprintf(stderr, "  -v      Compare the data written by both chains\n");
+}
+
+int main(int argc, char **argv)
+{
+	char fused_file[] = "/tmp/plug-bench-XXXXXX";
+	char layered_file[] = "/tmp/plug-bench-XXXXXX";
+	double fused_frame = 0, fused_period = 0;
+	double layered_frame = 0, layered_period = 0;
+	int c, fd, err;
+
+	while ((c = getopt(argc, argv, "r:f:F:c:C:s:S:p:l:v")) >= 0) {
+		switch (c) {
+		case 'r':
+			converter = optarg;
+			break;
+		case 'f':
+			cformat = snd_pcm_format_value(optarg);
+			break;
+		case 'F':
+			sformat = snd_pcm_format_value(optarg);
+			break;
+		case 'c':
+			cchannels = atoi(optarg);
+			break;
+		case 'C':
+			schannels = atoi(optarg);
+			break;
+		case 's':
+			crate = atoi(optarg);
+			break;
+		case 'S':
+			srate = atoi(optarg);
+			break;
+		case 'p':
+			period_size = atoi(optarg);
+			break;
+		case 'l':
+			seconds = atoi(optarg);
+			break;
+		case 'v':
+			verify = 1;
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if ((cformat != SND_PCM_FORMAT_S16 && cformat != SND_PCM_FORMAT_S24 &&
+	     cformat != SND_PCM_FORMAT_S32 && cformat != SND_PCM_FORMAT_FLOAT) ||
+	    sformat == SND_PCM_FORMAT_UNKNOWN ||
+	    !cchannels || !schannels || !crate || !srate ||
+	    !period_size || !seconds) {
+		usage();
+		return 1;
+	}
+
+	if (verify) {
+		fd = mkstemp(fused_file);
+		if (fd >= 0)
+			close(fd);
+		fd = mkstemp(layered_file);
+		if (fd >= 0)
+			close(fd);
+	}
+
+	printf("%s %uch %uHz -> %s %uch %uHz, converter %s\n",
+	       snd_pcm_format_name(cformat), cchannels, crate,
+	       snd_pcm_format_name(sformat), schannels, srate, converter);
+	err = run(1, verify ? fused_file : NULL, &fused_frame, &fused_period);
+	if (!err)
+		err = run(0, verify ? layered_file : NULL,
+			  &layered_frame, &layered_period);
+	if (!err) {
+		printf("%lu frames per period\n", period_size);
+		printf("  fused:   %8.2f ns/frame %10.0f ns/period\n",
+		       fused_frame, fused_period);
+		printf("  layered: %8.2f ns/frame %10.0f ns/period\n",
+		       layered_frame, layered_period);
+	}
+	if (verify) {
+		if (!err) {
+			err = compare(fused_file, layered_file);
+			printf("  output:  %s\n", err ? "MISMATCH" : "identical");
+		}
+		unlink(fused_file);
+		unlink(layered_file);
+	}
+	return err ? 1 : 0;
+}